@@ -0,0 +1,511 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "fat.h"
+#include "batch.h"
+#include "async.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct _async_request
+{
+    fatfs_async_completion_struct_t completion;
+    uint32_t first_cluster;
+    uint32_t offset;
+    uint32_t length;
+    uint8_t name[FATFS_FILE_NAME_SIZE];
+    struct _async_request *p_next;
+} fatfs_async_request_struct_t;
+
+typedef struct
+{
+    fatfs_async_request_struct_t *p_head;
+    fatfs_async_request_struct_t *p_tail;
+} fatfs_async_queue_struct_t;
+
+static pthread_t s_async_thread;
+static pthread_mutex_t s_async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_async_cond = PTHREAD_COND_INITIALIZER;
+static fatfs_async_queue_struct_t s_async_pending = {NULL, NULL};
+static fatfs_async_queue_struct_t s_async_done = {NULL, NULL};
+static bool s_async_running = false;
+static bool s_async_stop = false;
+static int s_async_event_fd = -1;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Append request to queue
+ *
+ * @param [inout] p_queue is queue
+ * @param [in] p_request is request to append
+ */
+static void fatfs_async_append(fatfs_async_queue_struct_t *const p_queue,
+                               fatfs_async_request_struct_t *const p_request);
+
+/**
+ * @brief Queue request for I/O engine
+ *
+ * @param [in] p_request is request to queue
+ * @return fatfs_error_enum_t is error code of submission
+ */
+static fatfs_error_enum_t fatfs_async_submit(fatfs_async_request_struct_t
+        *const p_request);
+
+/**
+ * @brief List a directory into a private entry list
+ *
+ * @param [inout] p_request is directory request
+ */
+static void fatfs_async_list(fatfs_async_request_struct_t *const p_request);
+
+/**
+ * @brief Run every request of a drained queue
+ *
+ * @param [inout] p_requests is drained requests
+ */
+static void fatfs_async_execute(fatfs_async_request_struct_t *const
+                                p_requests);
+
+/**
+ * @brief I/O engine thread
+ *
+ * @param [in] p_arg is not used
+ * @return void* is not used
+ */
+static void *fatfs_async_worker(void *p_arg);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to append request to queue */
+static void fatfs_async_append(fatfs_async_queue_struct_t *const p_queue,
+                               fatfs_async_request_struct_t *const p_request)
+{
+    p_request->p_next = NULL;
+    if (NULL == p_queue->p_head)
+    {
+        p_queue->p_head = p_request;
+    }
+    else
+    {
+        p_queue->p_tail->p_next = p_request;
+    }
+    p_queue->p_tail = p_request;
+}
+
+/* Function is used to queue request */
+static fatfs_error_enum_t fatfs_async_submit(fatfs_async_request_struct_t
+        *const p_request)
+{
+    fatfs_error_enum_t error = SUCCESS;
+
+    pthread_mutex_lock(&s_async_lock);
+    if ((true == s_async_running) && (false == s_async_stop))
+    {
+        fatfs_async_append(&s_async_pending, p_request);
+        pthread_cond_signal(&s_async_cond);
+    }
+    else
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+    pthread_mutex_unlock(&s_async_lock);
+    if (error != SUCCESS)
+    {
+        free(p_request);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to list directory into private list */
+static void fatfs_async_list(fatfs_async_request_struct_t *const p_request)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_dir_struct_t *p_dir = NULL;
+    fatfs_entry_info_struct_t *p_entry = NULL;
+    fatfs_entry_info_struct_t *p_tail = NULL;
+
+    error = fatfs_dir_open(p_request->first_cluster, &p_dir);
+    while (SUCCESS == error)
+    {
+        p_entry = (fatfs_entry_info_struct_t *)malloc(sizeof(
+                      fatfs_entry_info_struct_t));
+        error = (NULL == p_entry) ? FATFS_INITIALIZE_FAILED :
+                fatfs_dir_next(p_dir, p_entry);
+        if (SUCCESS == error)
+        {
+            if (NULL == p_tail)
+            {
+                p_request->completion.p_list = p_entry;
+            }
+            else
+            {
+                p_tail->p_next = p_entry;
+            }
+            p_tail = p_entry;
+        }
+        else
+        {
+            free(p_entry);
+        }
+    }
+    fatfs_dir_close(p_dir);
+    p_request->completion.error = (FATFS_END_OF_DIRECTORY == error) ?
+                                  SUCCESS : error;
+}
+
+/* Function is used to run drained requests */
+static void fatfs_async_execute(fatfs_async_request_struct_t *const
+                                p_requests)
+{
+    fatfs_async_request_struct_t *p_request = NULL;
+    fatfs_read_request_struct_t *p_reads = NULL;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    /* File reads of one drain go to disk as a single sorted batch */
+    for (p_request = p_requests; p_request != NULL;
+            p_request = p_request->p_next)
+    {
+        count += (FATFS_ASYNC_READ_FILE == p_request->completion.operation);
+    }
+    if (count > 0)
+    {
+        p_reads = (fatfs_read_request_struct_t *)calloc(count,
+                  sizeof(fatfs_read_request_struct_t));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_reads != NULL)
+    {
+        for (p_request = p_requests, i = 0; p_request != NULL;
+                p_request = p_request->p_next)
+        {
+            if (FATFS_ASYNC_READ_FILE == p_request->completion.operation)
+            {
+                p_reads[i].p_file = &p_request->completion.entry;
+                p_reads[i].offset = p_request->offset;
+                p_reads[i].length = p_request->length;
+                p_reads[i].p_buff = p_request->completion.p_buff;
+                i++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        fatfs_read_batch(p_reads, count);
+        for (p_request = p_requests, i = 0; p_request != NULL;
+                p_request = p_request->p_next)
+        {
+            if (FATFS_ASYNC_READ_FILE == p_request->completion.operation)
+            {
+                p_request->completion.bytes = p_reads[i].bytes;
+                p_request->completion.error = p_reads[i].error;
+                i++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        free(p_reads);
+    }
+    else
+    {
+        /* No file read in drain, or no memory to batch them */
+        for (p_request = p_requests; p_request != NULL;
+                p_request = p_request->p_next)
+        {
+            if (FATFS_ASYNC_READ_FILE == p_request->completion.operation)
+            {
+                p_request->completion.error = FATFS_INITIALIZE_FAILED;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+    }
+    for (p_request = p_requests; p_request != NULL;
+            p_request = p_request->p_next)
+    {
+        switch (p_request->completion.operation)
+        {
+            case FATFS_ASYNC_READ_DIRECTORY:
+                fatfs_async_list(p_request);
+                break;
+            case FATFS_ASYNC_LOOKUP:
+                p_request->completion.error =
+                    fatfs_lookup(p_request->first_cluster, p_request->name,
+                                 &p_request->completion.entry);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Function is used to run I/O engine */
+static void *fatfs_async_worker(void *p_arg)
+{
+    fatfs_async_request_struct_t *p_requests = NULL;
+    fatfs_async_request_struct_t *p_request = NULL;
+    uint64_t count = 0;
+    bool stop = false;
+
+    (void)p_arg;
+    while (false == stop)
+    {
+        pthread_mutex_lock(&s_async_lock);
+        while ((NULL == s_async_pending.p_head) && (false == s_async_stop))
+        {
+            pthread_cond_wait(&s_async_cond, &s_async_lock);
+        }
+        p_requests = s_async_pending.p_head;
+        s_async_pending.p_head = NULL;
+        s_async_pending.p_tail = NULL;
+        stop = (NULL == p_requests) && (true == s_async_stop);
+        pthread_mutex_unlock(&s_async_lock);
+
+        fatfs_async_execute(p_requests);
+
+        count = 0;
+        pthread_mutex_lock(&s_async_lock);
+        while (p_requests != NULL)
+        {
+            p_request = p_requests;
+            p_requests = p_requests->p_next;
+            fatfs_async_append(&s_async_done, p_request);
+            count++;
+        }
+        pthread_mutex_unlock(&s_async_lock);
+        if (count > 0)
+        {
+            /* eventfd adds up, one write wakes the loop for whole drain */
+            write(s_async_event_fd, &count, sizeof(count));
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return NULL;
+}
+
+/* Function is used to start I/O engine */
+fatfs_error_enum_t fatfs_async_init(int *const p_event_fd)
+{
+    fatfs_error_enum_t error = SUCCESS;
+
+    if (false == s_async_running)
+    {
+        s_async_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        s_async_stop = false;
+        if ((s_async_event_fd >= 0) &&
+                (0 == pthread_create(&s_async_thread, NULL, fatfs_async_worker,
+                                     NULL)))
+        {
+            s_async_running = true;
+        }
+        else
+        {
+            if (s_async_event_fd >= 0)
+            {
+                close(s_async_event_fd);
+                s_async_event_fd = -1;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            error = FATFS_INITIALIZE_FAILED;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_event_fd = s_async_event_fd;
+
+    return error;
+}
+
+/* Function is used to submit directory listing */
+fatfs_error_enum_t fatfs_async_read_directory(const uint32_t first_cluster,
+        const uint64_t tag)
+{
+    fatfs_error_enum_t error = FATFS_INITIALIZE_FAILED;
+    fatfs_async_request_struct_t *p_request = NULL;
+
+    p_request = (fatfs_async_request_struct_t *)calloc(1,
+                sizeof(fatfs_async_request_struct_t));
+    if (p_request != NULL)
+    {
+        p_request->completion.tag = tag;
+        p_request->completion.operation = FATFS_ASYNC_READ_DIRECTORY;
+        p_request->first_cluster = first_cluster;
+        error = fatfs_async_submit(p_request);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to submit file read */
+fatfs_error_enum_t fatfs_async_read_file(const fatfs_entry_info_struct_t
+        *const p_file, const uint32_t offset, const uint32_t length,
+        uint8_t *const p_buff, const uint64_t tag)
+{
+    fatfs_error_enum_t error = FATFS_INITIALIZE_FAILED;
+    fatfs_async_request_struct_t *p_request = NULL;
+
+    p_request = (fatfs_async_request_struct_t *)calloc(1,
+                sizeof(fatfs_async_request_struct_t));
+    if (p_request != NULL)
+    {
+        p_request->completion.tag = tag;
+        p_request->completion.operation = FATFS_ASYNC_READ_FILE;
+        p_request->completion.entry = *p_file;
+        p_request->completion.entry.p_next = NULL;
+        p_request->completion.p_buff = p_buff;
+        p_request->offset = offset;
+        p_request->length = length;
+        error = fatfs_async_submit(p_request);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to submit lookup */
+fatfs_error_enum_t fatfs_async_lookup(const uint32_t first_cluster,
+                                      const uint8_t *const p_name,
+                                      const uint64_t tag)
+{
+    fatfs_error_enum_t error = FATFS_INITIALIZE_FAILED;
+    fatfs_async_request_struct_t *p_request = NULL;
+
+    p_request = (fatfs_async_request_struct_t *)calloc(1,
+                sizeof(fatfs_async_request_struct_t));
+    if (p_request != NULL)
+    {
+        p_request->completion.tag = tag;
+        p_request->completion.operation = FATFS_ASYNC_LOOKUP;
+        p_request->first_cluster = first_cluster;
+        strncpy(p_request->name, p_name, FATFS_FILE_NAME_SIZE - 1);
+        error = fatfs_async_submit(p_request);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to take finished requests */
+uint32_t fatfs_async_poll(fatfs_async_completion_struct_t *const
+                          p_completions, const uint32_t max)
+{
+    fatfs_async_request_struct_t *p_request = NULL;
+    uint64_t count = 0;
+    uint32_t taken = 0;
+
+    /* Reset eventfd before taking, a completion after this re-arms it */
+    read(s_async_event_fd, &count, sizeof(count));
+    pthread_mutex_lock(&s_async_lock);
+    while ((taken < max) && (s_async_done.p_head != NULL))
+    {
+        p_request = s_async_done.p_head;
+        s_async_done.p_head = p_request->p_next;
+        p_completions[taken++] = p_request->completion;
+        free(p_request);
+    }
+    if (NULL == s_async_done.p_head)
+    {
+        s_async_done.p_tail = NULL;
+    }
+    else
+    {
+        /* Left over completions, keep loop woken up */
+        count = 1;
+        write(s_async_event_fd, &count, sizeof(count));
+    }
+    pthread_mutex_unlock(&s_async_lock);
+
+    return taken;
+}
+
+/* Function is used to free entry list */
+void fatfs_async_free_list(fatfs_entry_info_struct_t *p_list)
+{
+    fatfs_entry_info_struct_t *p_temp = NULL;
+
+    while (p_list != NULL)
+    {
+        p_temp = p_list->p_next;
+        free(p_list);
+        p_list = p_temp;
+    }
+}
+
+/* Function is used to stop I/O engine */
+void fatfs_async_deinit(void)
+{
+    fatfs_async_request_struct_t *p_request = NULL;
+
+    if (true == s_async_running)
+    {
+        pthread_mutex_lock(&s_async_lock);
+        s_async_stop = true;
+        pthread_cond_signal(&s_async_cond);
+        pthread_mutex_unlock(&s_async_lock);
+        pthread_join(s_async_thread, NULL);
+        while (s_async_done.p_head != NULL)
+        {
+            p_request = s_async_done.p_head;
+            s_async_done.p_head = p_request->p_next;
+            fatfs_async_free_list(p_request->completion.p_list);
+            free(p_request);
+        }
+        s_async_done.p_tail = NULL;
+        close(s_async_event_fd);
+        s_async_event_fd = -1;
+        s_async_running = false;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
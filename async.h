@@ -0,0 +1,103 @@
+#ifndef _ASYNC_H_
+#define _ASYNC_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef enum
+{
+    FATFS_ASYNC_READ_DIRECTORY,
+    FATFS_ASYNC_READ_FILE,
+    FATFS_ASYNC_LOOKUP
+} fatfs_async_operation_enum_t;
+
+typedef struct
+{
+    uint64_t tag;
+    fatfs_async_operation_enum_t operation;
+    fatfs_error_enum_t error;
+    fatfs_entry_info_struct_t *p_list;
+    fatfs_entry_info_struct_t entry;
+    uint8_t *p_buff;
+    uint32_t bytes;
+} fatfs_async_completion_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Start I/O engine of volume opened by fatfs_init
+ *
+ * While engine runs, the volume must only be used through fatfs_async_*.
+ *
+ * @param [out] p_event_fd is eventfd readable when completions are ready
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_async_init(int *const p_event_fd);
+
+/**
+ * @brief Submit listing of a directory
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] tag is user value returned with completion
+ * @return fatfs_error_enum_t is error code of submission
+ */
+fatfs_error_enum_t fatfs_async_read_directory(const uint32_t first_cluster,
+        const uint64_t tag);
+
+/**
+ * @brief Submit read of part of a file
+ *
+ * Reads submitted together are merged and sorted by disk position.
+ *
+ * @param [in] p_file is file to read, copied at submission
+ * @param [in] offset is byte offset in file
+ * @param [in] length is number of bytes to read
+ * @param [out] p_buff is where is data stored, owned by caller
+ * @param [in] tag is user value returned with completion
+ * @return fatfs_error_enum_t is error code of submission
+ */
+fatfs_error_enum_t fatfs_async_read_file(const fatfs_entry_info_struct_t
+        *const p_file, const uint32_t offset, const uint32_t length,
+        uint8_t *const p_buff, const uint64_t tag);
+
+/**
+ * @brief Submit lookup of a name in a directory
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] p_name is name to find, copied at submission
+ * @param [in] tag is user value returned with completion
+ * @return fatfs_error_enum_t is error code of submission
+ */
+fatfs_error_enum_t fatfs_async_lookup(const uint32_t first_cluster,
+                                      const uint8_t *const p_name,
+                                      const uint64_t tag);
+
+/**
+ * @brief Take finished requests without blocking
+ *
+ * @param [out] p_completions is array to fill
+ * @param [in] max is size of array
+ * @return uint32_t is number of completions taken
+ */
+uint32_t fatfs_async_poll(fatfs_async_completion_struct_t *const
+                          p_completions, const uint32_t max);
+
+/**
+ * @brief Free entry list of a directory completion
+ *
+ * @param [in] p_list is entry list
+ */
+void fatfs_async_free_list(fatfs_entry_info_struct_t *p_list);
+
+/**
+ * @brief Stop I/O engine, pending requests are completed first
+ *
+ */
+void fatfs_async_deinit(void);
+
+#endif /* _ASYNC_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "batch.h"
+#include "sidecar.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+/* Gap of unused sectors read through rather than splitting a read */
+#define FATFS_BATCH_MAX_GAP_SECTORS 8U
+#define FATFS_BATCH_MAX_READ_BYTES (1024U * 1024U)
+
+typedef struct
+{
+    uint32_t first_sector;
+    uint32_t sector_count;
+    uint32_t skip;
+    uint32_t bytes;
+    uint8_t *p_dest;
+    uint32_t request;
+} fatfs_batch_piece_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Split one request into sector ranges of its extents
+ *
+ * @param [inout] p_request is request to split
+ * @param [in] request is position of request
+ * @param [inout] pp_pieces is array of pieces
+ * @param [inout] p_count is number of pieces
+ * @param [inout] p_capacity is capacity of pieces
+ */
+static void fatfs_batch_split(fatfs_read_request_struct_t *const p_request,
+                              const uint32_t request,
+                              fatfs_batch_piece_struct_t **const pp_pieces,
+                              uint32_t *const p_count,
+                              uint32_t *const p_capacity);
+
+/**
+ * @brief Compare two pieces by first sector for qsort
+ *
+ * @param [in] p_first is first piece
+ * @param [in] p_second is second piece
+ * @return int is order of pieces
+ */
+static int fatfs_batch_compare(const void *p_first, const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to compare pieces */
+static int fatfs_batch_compare(const void *p_first, const void *p_second)
+{
+    uint32_t first = ((const fatfs_batch_piece_struct_t *)p_first)->
+                     first_sector;
+    uint32_t second = ((const fatfs_batch_piece_struct_t *)p_second)->
+                      first_sector;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to split request into pieces */
+static void fatfs_batch_split(fatfs_read_request_struct_t *const p_request,
+                              const uint32_t request,
+                              fatfs_batch_piece_struct_t **const pp_pieces,
+                              uint32_t *const p_count,
+                              uint32_t *const p_capacity)
+{
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_extent_struct_t *p_chain = NULL;
+    fatfs_batch_piece_struct_t *p_piece = NULL;
+    fatfs_batch_piece_struct_t *p_temp = NULL;
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t extent_count = 0;
+    uint32_t position = 0;
+    uint32_t extent_bytes = 0;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t skip = 0;
+    uint32_t bytes = 0;
+    uint32_t capacity = 0;
+    uint32_t i = 0;
+
+    p_request->bytes = 0;
+    p_request->error = SUCCESS;
+    if (p_request->offset >= p_request->p_file->file_size)
+    {
+        p_request->length = 0;
+    }
+    else if (p_request->length > p_request->p_file->file_size -
+             p_request->offset)
+    {
+        p_request->length = p_request->p_file->file_size - p_request->offset;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((p_request->length > 0) &&
+            (false == fatfs_sidecar_get_extents(p_request->p_file->first_cluster,
+                    &p_extents, &extent_count)))
+    {
+        p_request->error = fatfs_get_extents(p_request->p_file->first_cluster,
+                                             &p_chain, &extent_count);
+        p_extents = p_chain;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (i < extent_count) && (SUCCESS == p_request->error) &&
+            (position < p_request->offset + p_request->length); i++)
+    {
+        extent_bytes = p_extents[i].cluster_count * cluster_bytes;
+        /* Part of requested range that falls in this extent */
+        start = (p_request->offset > position) ? p_request->offset : position;
+        end = position + extent_bytes;
+        if (end > p_request->offset + p_request->length)
+        {
+            end = p_request->offset + p_request->length;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        /* No piece is larger than read buffer of fatfs_read_batch */
+        while ((start < end) && (SUCCESS == p_request->error))
+        {
+            skip = (start - position) % p_boot->byte_per_sector;
+            bytes = end - start;
+            bytes = (bytes > FATFS_BATCH_MAX_READ_BYTES - skip) ?
+                    FATFS_BATCH_MAX_READ_BYTES - skip : bytes;
+            if (*p_count == *p_capacity)
+            {
+                capacity = (0 == *p_capacity) ? 64 : *p_capacity * 2;
+                p_temp = (fatfs_batch_piece_struct_t *)realloc(*pp_pieces,
+                         capacity * sizeof(fatfs_batch_piece_struct_t));
+                *pp_pieces = (NULL == p_temp) ? *pp_pieces : p_temp;
+                *p_capacity = (NULL == p_temp) ? *p_capacity : capacity;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if (*p_count < *p_capacity)
+            {
+                p_piece = &(*pp_pieces)[(*p_count)++];
+                p_piece->first_sector =
+                    fatfs_cluster_to_sector(p_extents[i].first_cluster) +
+                    (start - position) / p_boot->byte_per_sector;
+                p_piece->skip = skip;
+                p_piece->bytes = bytes;
+                p_piece->sector_count = (skip + bytes +
+                                         p_boot->byte_per_sector - 1) /
+                                        p_boot->byte_per_sector;
+                p_piece->p_dest = p_request->p_buff +
+                                  (start - p_request->offset);
+                p_piece->request = request;
+                start += bytes;
+            }
+            else
+            {
+                p_request->error = FATFS_INITIALIZE_FAILED;
+            }
+        }
+        position += extent_bytes;
+    }
+    if ((SUCCESS == p_request->error) &&
+            (position < p_request->offset + p_request->length))
+    {
+        /* Chain is shorter than file size */
+        p_request->error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_chain);
+}
+
+/* Function is used to read many files */
+fatfs_error_enum_t fatfs_read_batch(fatfs_read_request_struct_t *const
+                                    p_requests, const uint32_t count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_batch_piece_struct_t *p_pieces = NULL;
+    fatfs_batch_piece_struct_t *p_piece = NULL;
+    uint32_t piece_count = 0;
+    uint32_t capacity = 0;
+    uint32_t max_sectors = FATFS_BATCH_MAX_READ_BYTES /
+                           p_boot->byte_per_sector;
+    uint8_t *p_buff = NULL;
+    uint32_t run_start = 0;
+    uint32_t run_end = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        fatfs_batch_split(&p_requests[i], i, &p_pieces, &piece_count,
+                          &capacity);
+    }
+    qsort(p_pieces, piece_count, sizeof(fatfs_batch_piece_struct_t),
+          fatfs_batch_compare);
+    /* Pieces are split to fit, one buffer serves every run */
+    p_buff = (uint8_t *)malloc((size_t)max_sectors * p_boot->byte_per_sector);
+    for (i = 0; (NULL == p_buff) && (i < piece_count); i++)
+    {
+        p_requests[p_pieces[i].request].error = FATFS_INITIALIZE_FAILED;
+    }
+    first = (NULL == p_buff) ? piece_count : 0;
+    while (first < piece_count)
+    {
+        /* Grow run while next piece starts inside or just after it */
+        run_start = p_pieces[first].first_sector;
+        run_end = run_start + p_pieces[first].sector_count;
+        last = first + 1;
+        while ((last < piece_count) &&
+                (p_pieces[last].first_sector <=
+                 run_end + FATFS_BATCH_MAX_GAP_SECTORS) &&
+                (p_pieces[last].first_sector + p_pieces[last].sector_count -
+                 run_start <= max_sectors))
+        {
+            if (p_pieces[last].first_sector + p_pieces[last].sector_count >
+                    run_end)
+            {
+                run_end = p_pieces[last].first_sector +
+                          p_pieces[last].sector_count;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            last++;
+        }
+        bytes = kmc_read_multi_sector(run_start, run_end - run_start, p_buff);
+        for (i = first; i < last; i++)
+        {
+            p_piece = &p_pieces[i];
+            if (bytes == (run_end - run_start) * p_boot->byte_per_sector)
+            {
+                memcpy(p_piece->p_dest, p_buff + (p_piece->first_sector -
+                                                  run_start) *
+                       p_boot->byte_per_sector + p_piece->skip,
+                       p_piece->bytes);
+                p_requests[p_piece->request].bytes += p_piece->bytes;
+            }
+            else
+            {
+                p_requests[p_piece->request].error = FATFS_READ_SECTOR_FAILED;
+            }
+        }
+        first = last;
+    }
+    for (i = 0; (i < count) && (SUCCESS == error); i++)
+    {
+        error = p_requests[i].error;
+    }
+    free(p_buff);
+    free(p_pieces);
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
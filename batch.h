@@ -0,0 +1,38 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    const fatfs_entry_info_struct_t *p_file;
+    uint32_t offset;
+    uint32_t length;
+    uint8_t *p_buff;
+    uint32_t bytes;
+    fatfs_error_enum_t error;
+} fatfs_read_request_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Read parts of many files with as few disk reads as possible
+ *
+ * Extents of every request are resolved first, then the sector ranges are
+ * sorted by position and adjacent or overlapping ranges are read together.
+ *
+ * @param [inout] p_requests is array of requests, bytes and error are set
+ *                for each request, length is clamped to file size
+ * @param [in] count is number of requests
+ * @return fatfs_error_enum_t is first error of requests
+ */
+fatfs_error_enum_t fatfs_read_batch(fatfs_read_request_struct_t *const
+                                    p_requests, const uint32_t count);
+
+#endif /* _BATCH_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,627 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "check.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_CHECK_DEFAULT_THREADS 4U
+#define FATFS_CHECK_MAX_THREADS 64U
+#define FATFS_CHECK_ENTRY_SIZE 32U
+#define FATFS_CHECK_ATTRIBUTE_OFFSET 11U
+#define FATFS_CHECK_CLUSTER_OFFSET 26U
+#define FATFS_CHECK_SIZE_OFFSET 28U
+#define FATFS_CHECK_LFN_ATTRIBUTE 0x0FU
+#define FATFS_CHECK_VOLUME_ATTRIBUTE 0x08U
+#define FATFS_CHECK_DIRECTORY_ATTRIBUTE 0x10U
+#define FATFS_CHECK_DELETED_ENTRY 0xE5U
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t length;
+} fatfs_check_directory_struct_t;
+
+typedef struct
+{
+    const fatfs_boot_sector_struct_t *p_boot;
+    uint32_t *p_next;           /* Decoded FAT, one value per cluster */
+    uint8_t *p_owned;           /* Bit n set once cluster n has an owner */
+    uint32_t max_cluster;
+    uint32_t bad_cluster;
+    uint32_t cluster_bytes;
+    fatfs_check_directory_struct_t *p_queue;
+    uint32_t queue_count;
+    uint32_t queue_capacity;
+    uint32_t busy;
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    fatfs_check_report_struct_t *p_report;
+    uint32_t problem_capacity;
+} fatfs_check_context_struct_t;
+
+static fatfs_check_context_struct_t s_check;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Add problem to report
+ *
+ * @param [in] p_problem is problem to add
+ */
+static void fatfs_check_add(const fatfs_check_problem_struct_t *const
+                            p_problem);
+
+/**
+ * @brief Take ownership of cluster
+ *
+ * @param [in] cluster is cluster index
+ * @return true if cluster had no owner before
+ * @return false if cluster is already owned
+ */
+static bool fatfs_check_own(const uint32_t cluster);
+
+/**
+ * @brief Check if cluster is among first clusters of a chain
+ *
+ * @param [in] first_cluster is first cluster of chain
+ * @param [in] cluster is cluster to find
+ * @param [in] length is number of clusters to search
+ * @return true if cluster is found
+ * @return false if cluster is not found
+ */
+static bool fatfs_check_in_chain(const uint32_t first_cluster,
+                                 const uint32_t cluster,
+                                 const uint32_t length);
+
+/**
+ * @brief Walk chain of an entry, take ownership and report problems
+ *
+ * @param [inout] p_problem is problem filled with entry details
+ * @param [out] p_length is number of valid clusters in chain
+ * @return true if chain is valid
+ * @return false if a problem is reported
+ */
+static bool fatfs_check_chain(fatfs_check_problem_struct_t *const p_problem,
+                              uint32_t *const p_length);
+
+/**
+ * @brief Queue directory for walkers
+ *
+ * @param [in] first_cluster is first cluster of directory
+ * @param [in] length is number of clusters in directory
+ */
+static void fatfs_check_push(const uint32_t first_cluster,
+                             const uint32_t length);
+
+/**
+ * @brief Check every entry of a directory
+ *
+ * @param [in] p_directory is directory to check
+ */
+static void fatfs_check_directory(const fatfs_check_directory_struct_t *const
+                                  p_directory);
+
+/**
+ * @brief Directory walker thread
+ *
+ * @param [in] p_arg is not used
+ * @return void* is not used
+ */
+static void *fatfs_check_worker(void *p_arg);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to add problem to report */
+static void fatfs_check_add(const fatfs_check_problem_struct_t *const
+                            p_problem)
+{
+    fatfs_check_report_struct_t *p_report = s_check.p_report;
+    fatfs_check_problem_struct_t *p_temp = NULL;
+
+    pthread_mutex_lock(&s_check.lock);
+    if (p_report->problem_count == s_check.problem_capacity)
+    {
+        s_check.problem_capacity = (0 == s_check.problem_capacity) ? 16 :
+                                   s_check.problem_capacity * 2;
+        p_temp = (fatfs_check_problem_struct_t *)realloc(p_report->p_problems,
+                 s_check.problem_capacity *
+                 sizeof(fatfs_check_problem_struct_t));
+        if (p_temp != NULL)
+        {
+            p_report->p_problems = p_temp;
+        }
+        else
+        {
+            s_check.problem_capacity = p_report->problem_count;
+            s_check.failed = true;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_report->problem_count < s_check.problem_capacity)
+    {
+        p_report->p_problems[p_report->problem_count++] = *p_problem;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    pthread_mutex_unlock(&s_check.lock);
+}
+
+/* Function is used to take ownership of cluster */
+static bool fatfs_check_own(const uint32_t cluster)
+{
+    uint8_t mask = (uint8_t)(1U << (cluster & 7));
+    uint8_t old = 0;
+
+    old = __atomic_fetch_or(&s_check.p_owned[cluster >> 3], mask,
+                            __ATOMIC_RELAXED);
+
+    return (0 == (old & mask));
+}
+
+/* Function is used to find cluster in chain */
+static bool fatfs_check_in_chain(const uint32_t first_cluster,
+                                 const uint32_t cluster,
+                                 const uint32_t length)
+{
+    bool found = false;
+    uint32_t current = first_cluster;
+    uint32_t i = 0;
+
+    for (i = 0; (i < length) && (false == found); i++)
+    {
+        found = (current == cluster);
+        current = s_check.p_next[current];
+    }
+
+    return found;
+}
+
+/* Function is used to walk chain of an entry */
+static bool fatfs_check_chain(fatfs_check_problem_struct_t *const p_problem,
+                              uint32_t *const p_length)
+{
+    bool valid = true;
+    bool end = false;
+    uint32_t cluster = p_problem->first_cluster;
+    uint32_t next = 0;
+    uint32_t length = 0;
+
+    /* Ownership bits visit each cluster once, so walk is bounded */
+    while ((false == end) && (true == valid))
+    {
+        if ((cluster < 2) || (cluster >= s_check.max_cluster))
+        {
+            p_problem->problem = FATFS_CHECK_BAD_CHAIN;
+            valid = false;
+        }
+        else if (false == fatfs_check_own(cluster))
+        {
+            p_problem->problem =
+                (true == fatfs_check_in_chain(p_problem->first_cluster,
+                                              cluster, length)) ?
+                FATFS_CHECK_LOOP : FATFS_CHECK_CROSS_LINK;
+            valid = false;
+        }
+        else
+        {
+            length++;
+            next = s_check.p_next[cluster];
+            if ((0 == next) || (s_check.bad_cluster == next))
+            {
+                p_problem->problem = FATFS_CHECK_BAD_CHAIN;
+                valid = false;
+            }
+            else if (true == fatfs_is_end_cluster(next))
+            {
+                end = true;
+            }
+            else
+            {
+                cluster = next;
+            }
+        }
+    }
+    if (false == valid)
+    {
+        p_problem->cluster = cluster;
+        p_problem->actual = length;
+        fatfs_check_add(p_problem);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_length = length;
+
+    return valid;
+}
+
+/* Function is used to queue directory */
+static void fatfs_check_push(const uint32_t first_cluster,
+                             const uint32_t length)
+{
+    fatfs_check_directory_struct_t *p_temp = NULL;
+
+    pthread_mutex_lock(&s_check.lock);
+    if (s_check.queue_count == s_check.queue_capacity)
+    {
+        s_check.queue_capacity = (0 == s_check.queue_capacity) ? 64 :
+                                 s_check.queue_capacity * 2;
+        p_temp = (fatfs_check_directory_struct_t *)realloc(s_check.p_queue,
+                 s_check.queue_capacity *
+                 sizeof(fatfs_check_directory_struct_t));
+        if (p_temp != NULL)
+        {
+            s_check.p_queue = p_temp;
+        }
+        else
+        {
+            s_check.queue_capacity = s_check.queue_count;
+            s_check.failed = true;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (s_check.queue_count < s_check.queue_capacity)
+    {
+        s_check.p_queue[s_check.queue_count].first_cluster = first_cluster;
+        s_check.p_queue[s_check.queue_count].length = length;
+        s_check.queue_count++;
+        pthread_cond_signal(&s_check.cond);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    pthread_mutex_unlock(&s_check.lock);
+}
+
+/* Function is used to check entries of a directory */
+static void fatfs_check_directory(const fatfs_check_directory_struct_t *const
+                                  p_directory)
+{
+    const fatfs_boot_sector_struct_t *p_boot = s_check.p_boot;
+    fatfs_check_problem_struct_t problem;
+    uint8_t *p_buff = NULL;
+    const uint8_t *p_entry = NULL;
+    uint32_t bytes = 0;
+    uint32_t run = 0;
+    uint32_t cluster = p_directory->first_cluster;
+    uint32_t length = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint8_t count = 0;
+    uint8_t attribute = 0;
+    bool end = false;
+
+    if (0 == p_directory->first_cluster) /* Root directory region */
+    {
+        bytes = (p_boot->data_index - p_boot->root_directory_index) *
+                p_boot->byte_per_sector;
+        p_buff = (uint8_t *)malloc(bytes);
+        if ((p_buff != NULL) &&
+                (kmc_read_multi_sector(p_boot->root_directory_index,
+                                       p_boot->data_index -
+                                       p_boot->root_directory_index,
+                                       p_buff) != (int32_t)bytes))
+        {
+            s_check.failed = true;
+            bytes = 0;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        bytes = p_directory->length * s_check.cluster_bytes;
+        p_buff = (uint8_t *)malloc(bytes);
+        /* Chain is already validated, read contiguous runs at once */
+        for (i = 0; (p_buff != NULL) && (i < p_directory->length); i += run)
+        {
+            for (run = 1; (i + run < p_directory->length) &&
+                    (s_check.p_next[cluster + run - 1] == cluster + run); run++)
+            {
+            }
+            if (kmc_read_multi_sector(fatfs_cluster_to_sector(cluster),
+                                      run * p_boot->sector_per_cluster,
+                                      p_buff + i * s_check.cluster_bytes) !=
+                    (int32_t)(run * s_check.cluster_bytes))
+            {
+                s_check.failed = true;
+                bytes = 0;
+                break;
+            }
+            else
+            {
+                cluster = s_check.p_next[cluster + run - 1];
+            }
+        }
+    }
+    if (NULL == p_buff)
+    {
+        s_check.failed = true;
+        bytes = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (i + FATFS_CHECK_ENTRY_SIZE <= bytes) && (false == end);
+            i += FATFS_CHECK_ENTRY_SIZE)
+    {
+        p_entry = p_buff + i;
+        attribute = p_entry[FATFS_CHECK_ATTRIBUTE_OFFSET];
+        if (0 == p_entry[0])
+        {
+            end = true;
+        }
+        else if ((FATFS_CHECK_DELETED_ENTRY == p_entry[0]) ||
+                 ('.' == p_entry[0]) ||
+                 (FATFS_CHECK_LFN_ATTRIBUTE == attribute) ||
+                 (0 != (attribute & FATFS_CHECK_VOLUME_ATTRIBUTE)))
+        {
+            /* Not a file or directory */
+        }
+        else
+        {
+            memset(&problem, 0, sizeof(problem));
+            problem.directory_cluster = p_directory->first_cluster;
+            problem.first_cluster =
+                (uint32_t)p_entry[FATFS_CHECK_CLUSTER_OFFSET] |
+                ((uint32_t)p_entry[FATFS_CHECK_CLUSTER_OFFSET + 1] << 8);
+            for (j = 0, count = 0; j < 11; j++)
+            {
+                if ((8 == j) && (p_entry[8] != ' '))
+                {
+                    problem.short_name[count++] = '.';
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+                if (p_entry[j] != ' ')
+                {
+                    problem.short_name[count++] = p_entry[j];
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            problem.short_name[count] = '\0';
+            if (0 != (attribute & FATFS_CHECK_DIRECTORY_ATTRIBUTE))
+            {
+                __atomic_fetch_add(&s_check.p_report->directories, 1,
+                                   __ATOMIC_RELAXED);
+                if (true == fatfs_check_chain(&problem, &length))
+                {
+                    fatfs_check_push(problem.first_cluster, length);
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            else
+            {
+                __atomic_fetch_add(&s_check.p_report->files, 1,
+                                   __ATOMIC_RELAXED);
+                for (j = 0; j < 4; j++)
+                {
+                    problem.expected |=
+                        (uint32_t)p_entry[FATFS_CHECK_SIZE_OFFSET + j] << (8 * j);
+                }
+                problem.expected = (uint32_t)(((uint64_t)problem.expected +
+                                               s_check.cluster_bytes - 1) /
+                                              s_check.cluster_bytes);
+                length = 0;
+                if (((0 == problem.first_cluster) ||
+                        (true == fatfs_check_chain(&problem, &length))) &&
+                        (length != problem.expected))
+                {
+                    problem.problem = FATFS_CHECK_SIZE_MISMATCH;
+                    problem.cluster = problem.first_cluster;
+                    problem.actual = length;
+                    fatfs_check_add(&problem);
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+        }
+    }
+    free(p_buff);
+}
+
+/* Function is used to walk directories */
+static void *fatfs_check_worker(void *p_arg)
+{
+    fatfs_check_directory_struct_t directory;
+    bool done = false;
+
+    (void)p_arg;
+    pthread_mutex_lock(&s_check.lock);
+    while (false == done)
+    {
+        while ((0 == s_check.queue_count) && (s_check.busy > 0))
+        {
+            pthread_cond_wait(&s_check.cond, &s_check.lock);
+        }
+        if (s_check.queue_count > 0)
+        {
+            directory = s_check.p_queue[--s_check.queue_count];
+            s_check.busy++;
+            pthread_mutex_unlock(&s_check.lock);
+            fatfs_check_directory(&directory);
+            pthread_mutex_lock(&s_check.lock);
+            s_check.busy--;
+            if ((0 == s_check.busy) && (0 == s_check.queue_count))
+            {
+                pthread_cond_broadcast(&s_check.cond);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else
+        {
+            /* Queue is empty and nobody can add more */
+            done = true;
+        }
+    }
+    pthread_mutex_unlock(&s_check.lock);
+
+    return NULL;
+}
+
+/* Function is used to check consistency of volume */
+fatfs_error_enum_t fatfs_check(const uint32_t threads,
+                               fatfs_check_report_struct_t *const p_report)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    pthread_t workers[FATFS_CHECK_MAX_THREADS];
+    uint32_t worker_count = (0 == threads) ? FATFS_CHECK_DEFAULT_THREADS :
+                            threads;
+    uint32_t started = 0;
+    uint32_t cluster = 0;
+    uint32_t next = 0;
+    bool used = false;
+    fatfs_check_problem_struct_t problem;
+
+    memset(p_report, 0, sizeof(fatfs_check_report_struct_t));
+    memset(&s_check, 0, sizeof(s_check));
+    pthread_mutex_init(&s_check.lock, NULL);
+    pthread_cond_init(&s_check.cond, NULL);
+    s_check.p_report = p_report;
+    s_check.p_boot = fatfs_get_boot_sector();
+    s_check.max_cluster = s_check.p_boot->cluster_count + 2;
+    s_check.bad_cluster = (12 == s_check.p_boot->fat_type) ? 0xFF7 : 0xFFF7;
+    s_check.cluster_bytes = s_check.p_boot->byte_per_sector *
+                            s_check.p_boot->sector_per_cluster;
+    worker_count = (worker_count > FATFS_CHECK_MAX_THREADS) ?
+                   FATFS_CHECK_MAX_THREADS : worker_count;
+    s_check.p_next = (uint32_t *)calloc(s_check.max_cluster, sizeof(uint32_t));
+    s_check.p_owned = (uint8_t *)calloc((s_check.max_cluster + 7) / 8, 1);
+    if ((NULL == s_check.p_next) || (NULL == s_check.p_owned) ||
+            (0 == s_check.p_boot->cluster_count))
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+    else
+    {
+        /* One pass over FAT, walkers never touch it again */
+        for (cluster = 2; (cluster < s_check.max_cluster) &&
+                (SUCCESS == error); cluster++)
+        {
+            next = cluster;
+            error = fatfs_get_next_cluster(&next);
+            s_check.p_next[cluster] = next;
+            p_report->used_clusters += ((next != 0) &&
+                                        (next != s_check.bad_cluster));
+        }
+    }
+    if (SUCCESS == error)
+    {
+        fatfs_check_push(0, 0);
+        for (started = 0; started < worker_count; started++)
+        {
+            if (pthread_create(&workers[started], NULL, fatfs_check_worker,
+                               NULL) != 0)
+            {
+                break;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        if (0 == started)
+        {
+            fatfs_check_worker(NULL);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        while (started > 0)
+        {
+            pthread_join(workers[--started], NULL);
+        }
+
+        /* Allocated clusters nobody owns, reported as runs */
+        memset(&problem, 0, sizeof(problem));
+        problem.problem = FATFS_CHECK_LOST_CLUSTER;
+        for (cluster = 2; cluster <= s_check.max_cluster; cluster++)
+        {
+            used = (cluster < s_check.max_cluster) &&
+                   (s_check.p_next[cluster] != 0) &&
+                   (s_check.p_next[cluster] != s_check.bad_cluster) &&
+                   (0 == (s_check.p_owned[cluster >> 3] &
+                          (1U << (cluster & 7))));
+            if (true == used)
+            {
+                problem.cluster = (0 == problem.actual) ? cluster :
+                                  problem.cluster;
+                problem.actual++;
+            }
+            else if (problem.actual > 0)
+            {
+                fatfs_check_add(&problem);
+                problem.actual = 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        error = (true == s_check.failed) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(s_check.p_next);
+    free(s_check.p_owned);
+    free(s_check.p_queue);
+    pthread_mutex_destroy(&s_check.lock);
+    pthread_cond_destroy(&s_check.cond);
+
+    return error;
+}
+
+/* Function is used to free problems of a report */
+void fatfs_check_free(fatfs_check_report_struct_t *const p_report)
+{
+    free(p_report->p_problems);
+    p_report->p_problems = NULL;
+    p_report->problem_count = 0;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,62 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef enum
+{
+    FATFS_CHECK_CROSS_LINK,     /* Cluster is owned by more than one chain */
+    FATFS_CHECK_LOOP,           /* Chain comes back to one of its clusters */
+    FATFS_CHECK_BAD_CHAIN,      /* Chain reaches free, bad or invalid cluster */
+    FATFS_CHECK_SIZE_MISMATCH,  /* File size does not match chain length */
+    FATFS_CHECK_LOST_CLUSTER    /* Allocated clusters owned by no entry */
+} fatfs_check_problem_enum_t;
+
+typedef struct
+{
+    fatfs_check_problem_enum_t problem;
+    uint32_t cluster;           /* Cluster where problem is found */
+    uint32_t first_cluster;     /* First cluster of chain, 0 if lost */
+    uint32_t directory_cluster; /* Directory holding entry, 0 for root */
+    uint32_t expected;          /* Clusters needed by file size */
+    uint32_t actual;            /* Clusters found, run length if lost */
+    uint8_t short_name[FATFS_SHORT_NAME_SIZE];
+} fatfs_check_problem_struct_t;
+
+typedef struct
+{
+    uint32_t files;
+    uint32_t directories;
+    uint32_t used_clusters;
+    uint32_t problem_count;
+    fatfs_check_problem_struct_t *p_problems;
+} fatfs_check_report_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Check consistency of volume opened by fatfs_init
+ *
+ * Every chain walk is bounded, so damaged images can not hang the check.
+ *
+ * @param [in] threads is number of directory walkers, 0 for default
+ * @param [out] p_report is report, freed with fatfs_check_free
+ * @return fatfs_error_enum_t is error code, SUCCESS even if problems found
+ */
+fatfs_error_enum_t fatfs_check(const uint32_t threads,
+                               fatfs_check_report_struct_t *const p_report);
+
+/**
+ * @brief Free problems of a report
+ *
+ * @param [inout] p_report is report
+ */
+void fatfs_check_free(fatfs_check_report_struct_t *const p_report);
+
+#endif /* _CHECK_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
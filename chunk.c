@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "hal.h"
+#include "chunk.h"
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Check if every byte of buffer is zero
+ *
+ * @param [in] p_buff is buffer to check
+ * @param [in] length is number of bytes
+ * @return true if buffer is all zero
+ * @return false if any byte is not zero
+ */
+static bool kmc_chunk_is_zero(const uint8_t *const p_buff,
+                              const uint32_t length);
+
+/**
+ * @brief Store value as little-endian bytes
+ *
+ * @param [out] p_buff is where value is stored
+ * @param [in] value is value to store
+ * @param [in] bytes is number of bytes of value
+ */
+static void kmc_chunk_put(uint8_t *const p_buff, const uint64_t value,
+                          const uint8_t bytes);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to check zero buffer */
+static bool kmc_chunk_is_zero(const uint8_t *const p_buff,
+                              const uint32_t length)
+{
+    bool retVal = true;
+    uint32_t i = 0;
+
+    for (i = 0; (true == retVal) && (i < length); i++)
+    {
+        retVal = (0 == p_buff[i]);
+    }
+
+    return retVal;
+}
+
+/* Function is used to store little-endian value */
+static void kmc_chunk_put(uint8_t *const p_buff, const uint64_t value,
+                          const uint8_t bytes)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < bytes; i++)
+    {
+        p_buff[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/* Function is used to convert raw image to chunked image */
+bool kmc_chunk_convert(const uint8_t *const raw_path,
+                       const uint8_t *const chunk_path,
+                       const uint32_t chunk_size,
+                       kmc_chunk_convert_stats_struct_t *const p_stats)
+{
+    bool retVal = true;
+    kmc_chunk_convert_stats_struct_t stats;
+    uint8_t header[KMC_CHUNK_HEADER_SIZE] = {0};
+    uint32_t size = (0 == chunk_size) ? KMC_CHUNK_DEFAULT_SIZE : chunk_size;
+    FILE *p_raw = NULL;
+    FILE *p_chunk = NULL;
+    uint8_t *p_temp_path = NULL;
+    size_t temp_size = strlen(chunk_path) + sizeof(".tmp");
+    uint8_t *p_data = NULL;
+    uint8_t *p_stored = NULL;
+    uint8_t *p_index = NULL;
+    uLongf stored = 0;
+    uint64_t offset = 0;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+    struct stat info;
+
+    memset(&stats, 0, sizeof(stats));
+    retVal = (size <= KMC_CHUNK_MAX_SIZE) && (0 == stat(raw_path, &info));
+    stats.image_bytes = (true == retVal) ? (uint64_t)info.st_size : 0;
+    stats.chunks = (uint32_t)((stats.image_bytes + size - 1) / size);
+    p_raw = (true == retVal) ? fopen(raw_path, "rb") : NULL;
+    /* Write to a temporary file and rename, a crash never leaves half */
+    p_temp_path = (p_raw != NULL) ? (uint8_t *)malloc(temp_size) : NULL;
+    if (p_temp_path != NULL)
+    {
+        snprintf(p_temp_path, temp_size, "%s.tmp", chunk_path);
+        p_chunk = fopen(p_temp_path, "wb");
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    p_data = (uint8_t *)malloc(size);
+    p_stored = (uint8_t *)malloc(compressBound(size));
+    p_index = (uint8_t *)calloc(stats.chunks + 1, 8);
+    retVal = (p_chunk != NULL) && (p_data != NULL) && (p_stored != NULL) &&
+             (p_index != NULL);
+    /* Index is written last, offsets are known once every chunk is stored */
+    offset = KMC_CHUNK_HEADER_SIZE + (uint64_t)(stats.chunks + 1) * 8;
+    retVal = (true == retVal) && (0 == fseeko(p_chunk, (off_t)offset,
+                                             SEEK_SET));
+    for (i = 0; (true == retVal) && (i < stats.chunks); i++)
+    {
+        bytes = (stats.image_bytes - (uint64_t)i * size > size) ? size :
+                (uint32_t)(stats.image_bytes - (uint64_t)i * size);
+        kmc_chunk_put(p_index + i * 8, offset, 8);
+        retVal = (fread(p_data, sizeof(uint8_t), bytes, p_raw) == bytes);
+        stored = compressBound(size);
+        if (false == retVal)
+        {
+            /* Do nothing */
+        }
+        else if (true == kmc_chunk_is_zero(p_data, bytes))
+        {
+            stats.zero_chunks++;
+        }
+        else if ((Z_OK == compress2(p_stored, &stored, p_data, bytes,
+                                     Z_DEFAULT_COMPRESSION)) &&
+                 (stored < bytes))
+        {
+            retVal = (fwrite(p_stored, sizeof(uint8_t), stored, p_chunk) ==
+                      stored);
+            offset += stored;
+        }
+        else
+        {
+            retVal = (fwrite(p_data, sizeof(uint8_t), bytes, p_chunk) ==
+                      bytes);
+            offset += bytes;
+            stats.raw_chunks++;
+        }
+    }
+    if (true == retVal)
+    {
+        kmc_chunk_put(p_index + stats.chunks * 8, offset, 8);
+        memcpy(header, KMC_CHUNK_MAGIC, KMC_CHUNK_MAGIC_BYTES);
+        header[4] = (uint8_t)KMC_CHUNK_VERSION;
+        kmc_chunk_put(header + 8, size, 4);
+        kmc_chunk_put(header + 12, stats.chunks, 4);
+        kmc_chunk_put(header + 16, stats.image_bytes, 8);
+        retVal = (0 == fseeko(p_chunk, 0, SEEK_SET)) &&
+                 (fwrite(header, sizeof(uint8_t), KMC_CHUNK_HEADER_SIZE,
+                         p_chunk) == KMC_CHUNK_HEADER_SIZE) &&
+                 (fwrite(p_index, 8, stats.chunks + 1, p_chunk) ==
+                  stats.chunks + 1);
+        stats.stored_bytes = offset;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_chunk != NULL)
+    {
+        retVal = (true == retVal) && (0 == fflush(p_chunk)) &&
+                 (0 == fsync(fileno(p_chunk)));
+        retVal = (0 == fclose(p_chunk)) && (true == retVal);
+        if (true == retVal)
+        {
+            retVal = (0 == rename(p_temp_path, chunk_path));
+        }
+        else
+        {
+            remove(p_temp_path);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_temp_path);
+    if (p_raw != NULL)
+    {
+        fclose(p_raw);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_data);
+    free(p_stored);
+    free(p_index);
+    if (p_stats != NULL)
+    {
+        *p_stats = stats;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
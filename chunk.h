@@ -0,0 +1,42 @@
+#ifndef _CHUNK_H_
+#define _CHUNK_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t chunks;
+    uint32_t zero_chunks;       /* Elided, nothing stored */
+    uint32_t raw_chunks;        /* Stored as is, compression did not help */
+    uint64_t image_bytes;
+    uint64_t stored_bytes;      /* Size of chunked image file */
+} kmc_chunk_convert_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Convert a raw image to chunked image read by KMC_BACKEND_CHUNKED
+ *
+ * @param [in] raw_path is path to raw image
+ * Chunked image is written to "chunk_path.tmp" and renamed when complete,
+ * a failed conversion leaves any earlier chunk_path as it was.
+ *
+ * @param [in] chunk_path is path to chunked image, replaced if it exists
+ * @param [in] chunk_size is bytes per chunk, 0 for KMC_CHUNK_DEFAULT_SIZE,
+ * at most KMC_CHUNK_MAX_SIZE
+ * @param [out] p_stats is result of conversion, NULL if not needed
+ * @return true if chunked image is written
+ * @return false if an image can not be read or written
+ */
+bool kmc_chunk_convert(const uint8_t *const raw_path,
+                       const uint8_t *const chunk_path,
+                       const uint32_t chunk_size,
+                       kmc_chunk_convert_stats_struct_t *const p_stats);
+
+#endif /* _CHUNK_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
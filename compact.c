@@ -0,0 +1,446 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "dirindex.h"
+#include "sidecar.h"
+#include "compact.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_COMPACT_ENTRY_SIZE 32U
+#define FATFS_COMPACT_ATTRIBUTE_OFFSET 11U
+#define FATFS_COMPACT_LFN_ATTRIBUTE 0x0FU
+#define FATFS_COMPACT_LFN_LAST_FLAG 0x40U
+#define FATFS_COMPACT_LFN_CHECKSUM_OFFSET 13U
+#define FATFS_COMPACT_VOLUME_ATTRIBUTE 0x08U
+#define FATFS_COMPACT_DELETED_ENTRY 0xE5U
+
+typedef struct
+{
+    uint32_t offset;            /* Offset of first slot in directory */
+    uint32_t count;             /* Slots, main entry last */
+    uint32_t order;             /* Position in directory before compaction */
+    bool pinned;                /* '.' entries and volume label stay first */
+    uint8_t name[FATFS_FILE_NAME_SIZE];
+} fatfs_compact_record_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Read every slot of a directory
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [out] p_buff is slots, freed by caller
+ * @param [out] p_bytes is number of bytes read
+ * @param [out] p_extents is chain of directory, NULL for root, freed by caller
+ * @param [out] p_count is number of extents
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_compact_read(const uint32_t first_cluster,
+        uint8_t **const p_buff, uint32_t *const p_bytes,
+        fatfs_extent_struct_t **const p_extents, uint32_t *const p_count);
+
+/**
+ * @brief Collect live entries of a directory with their long names
+ *
+ * @param [in] p_buff is slots of directory
+ * @param [in] bytes is number of bytes in p_buff
+ * @param [in] sort is true to decode names for sorting
+ * @param [out] p_records is array of entries, freed by caller
+ * @param [out] p_count is number of entries
+ * @param [inout] p_result is counters to update
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_compact_parse(const uint8_t *const p_buff,
+        const uint32_t bytes, const bool sort,
+        fatfs_compact_record_struct_t **const p_records,
+        uint32_t *const p_count,
+        fatfs_compact_result_struct_t *const p_result);
+
+/**
+ * @brief Compare two entries by name, pinned entries first
+ *
+ * @param [in] p_first is first entry
+ * @param [in] p_second is second entry
+ * @return int is order of entries
+ */
+static int fatfs_compact_compare(const void *p_first, const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to compare entries */
+static int fatfs_compact_compare(const void *p_first, const void *p_second)
+{
+    const fatfs_compact_record_struct_t *p_a =
+        (const fatfs_compact_record_struct_t *)p_first;
+    const fatfs_compact_record_struct_t *p_b =
+        (const fatfs_compact_record_struct_t *)p_second;
+    int order = 0;
+
+    if (p_a->pinned != p_b->pinned)
+    {
+        order = (true == p_a->pinned) ? -1 : 1;
+    }
+    else if (false == p_a->pinned)
+    {
+        order = strcasecmp(p_a->name, p_b->name);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (0 == order)
+    {
+        order = (p_a->order > p_b->order) - (p_a->order < p_b->order);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return order;
+}
+
+/* Function is used to read slots of a directory */
+static fatfs_error_enum_t fatfs_compact_read(const uint32_t first_cluster,
+        uint8_t **const p_buff, uint32_t *const p_bytes,
+        fatfs_extent_struct_t **const p_extents, uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t sectors = 0;
+    uint32_t bytes = 0;
+    uint32_t done = 0;
+    uint32_t i = 0;
+    uint8_t *p_data = NULL;
+
+    *p_extents = NULL;
+    *p_count = 0;
+    if (0 == first_cluster) /* Root directory region */
+    {
+        sectors = p_boot->data_index - p_boot->root_directory_index;
+        bytes = sectors * p_boot->byte_per_sector;
+        p_data = (uint8_t *)malloc(bytes);
+        if ((NULL == p_data) ||
+                (kmc_read_multi_sector(p_boot->root_directory_index, sectors,
+                                       p_data) != (int32_t)bytes))
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        error = fatfs_get_extents(first_cluster, p_extents, p_count);
+        for (i = 0; (SUCCESS == error) && (i < *p_count); i++)
+        {
+            bytes += (*p_extents)[i].cluster_count * cluster_bytes;
+        }
+        p_data = (SUCCESS == error) ? (uint8_t *)malloc(bytes) : NULL;
+        error = ((SUCCESS == error) && ((NULL == p_data) || (0 == bytes))) ?
+                FATFS_READ_SECTOR_FAILED : error;
+        for (i = 0; (SUCCESS == error) && (i < *p_count); i++)
+        {
+            sectors = (*p_extents)[i].cluster_count *
+                      p_boot->sector_per_cluster;
+            if (kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                          (*p_extents)[i].first_cluster),
+                                      sectors, p_data + done) !=
+                    (int32_t)(sectors * p_boot->byte_per_sector))
+            {
+                error = FATFS_READ_SECTOR_FAILED;
+            }
+            else
+            {
+                done += sectors * p_boot->byte_per_sector;
+            }
+        }
+    }
+    *p_buff = p_data;
+    *p_bytes = bytes;
+
+    return error;
+}
+
+/* Function is used to collect live entries of a directory */
+static fatfs_error_enum_t fatfs_compact_parse(const uint8_t *const p_buff,
+        const uint32_t bytes, const bool sort,
+        fatfs_compact_record_struct_t **const p_records,
+        uint32_t *const p_count,
+        fatfs_compact_result_struct_t *const p_result)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_compact_record_struct_t *p_list = NULL;
+    fatfs_compact_record_struct_t *p_record = NULL;
+    fatfs_entry_info_struct_t info;
+    const uint8_t *p_entry = NULL;
+    uint32_t capacity = bytes / FATFS_COMPACT_ENTRY_SIZE;
+    uint32_t count = 0;
+    uint32_t lfn_count = 0;
+    uint32_t i = 0;
+    uint8_t lfn_checksum = 0;
+    uint8_t attribute = 0;
+    bool end = false;
+
+    /* One record per slot at most, so list never grows */
+    p_list = (fatfs_compact_record_struct_t *)malloc((capacity + 1) *
+             sizeof(fatfs_compact_record_struct_t));
+    error = (NULL == p_list) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+    for (i = 0; (SUCCESS == error) &&
+            (i + FATFS_COMPACT_ENTRY_SIZE <= bytes) && (false == end);
+            i += FATFS_COMPACT_ENTRY_SIZE)
+    {
+        p_entry = p_buff + i;
+        attribute = p_entry[FATFS_COMPACT_ATTRIBUTE_OFFSET];
+        if (0 == p_entry[0])
+        {
+            end = true;
+        }
+        else if (FATFS_COMPACT_DELETED_ENTRY == p_entry[0])
+        {
+            p_result->removed_entries += lfn_count + 1;
+            lfn_count = 0;
+        }
+        else if (FATFS_COMPACT_LFN_ATTRIBUTE == attribute)
+        {
+            /* Same rules as fatfs_read_directory for stray parts */
+            if (0 != (p_entry[0] & FATFS_COMPACT_LFN_LAST_FLAG))
+            {
+                p_result->removed_entries += lfn_count;
+                lfn_count = 1;
+                lfn_checksum = p_entry[FATFS_COMPACT_LFN_CHECKSUM_OFFSET];
+            }
+            else if ((lfn_count > 0) &&
+                     (p_entry[FATFS_COMPACT_LFN_CHECKSUM_OFFSET] ==
+                      lfn_checksum))
+            {
+                lfn_count++;
+            }
+            else
+            {
+                p_result->removed_entries += lfn_count + 1;
+                lfn_count = 0;
+            }
+        }
+        else
+        {
+            if ((lfn_count > FATFS_SUB_ENTRY_MAX) || ((lfn_count > 0) &&
+                    (lfn_checksum != fatfs_short_name_checksum(p_entry))))
+            {
+                p_result->removed_entries += lfn_count;
+                lfn_count = 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            p_record = &p_list[count];
+            p_record->offset = i - lfn_count * FATFS_COMPACT_ENTRY_SIZE;
+            p_record->count = lfn_count + 1;
+            p_record->order = count;
+            p_record->pinned = ('.' == p_entry[0]) ||
+                               (0 != (attribute &
+                                      FATFS_COMPACT_VOLUME_ATTRIBUTE));
+            p_record->name[0] = '\0';
+            if (true == sort)
+            {
+                fatfs_decode_raw_entry(p_buff + p_record->offset,
+                                       p_record->count, &info);
+                strcpy(p_record->name, fatfs_get_entry_name(&info));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            p_result->kept_entries += p_record->count;
+            lfn_count = 0;
+            count++;
+        }
+    }
+    p_result->removed_entries += lfn_count;
+    *p_records = p_list;
+    *p_count = count;
+
+    return error;
+}
+
+/* Function is used to compact a directory */
+fatfs_error_enum_t fatfs_compact_directory(const uint32_t first_cluster,
+        const bool sort, fatfs_compact_result_struct_t *const p_result)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t end_value = (12 == p_boot->fat_type) ? 0xFFF : 0xFFFF;
+    fatfs_compact_record_struct_t *p_records = NULL;
+    fatfs_extent_struct_t *p_extents = NULL;
+    uint8_t *p_old = NULL;
+    uint8_t *p_new = NULL;
+    uint32_t extent_count = 0;
+    uint32_t record_count = 0;
+    uint32_t bytes = 0;
+    uint32_t used = 0;
+    uint32_t keep = 0;
+    uint32_t write = 0;
+    uint32_t done = 0;
+    uint32_t clusters = 0;
+    uint32_t sectors = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    memset(p_result, 0, sizeof(fatfs_compact_result_struct_t));
+    error = fatfs_compact_read(first_cluster, &p_old, &bytes, &p_extents,
+                               &extent_count);
+    if (SUCCESS == error)
+    {
+        error = fatfs_compact_parse(p_old, bytes, sort, &p_records,
+                                    &record_count, p_result);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((SUCCESS == error) && (true == sort))
+    {
+        qsort(p_records, record_count, sizeof(fatfs_compact_record_struct_t),
+              fatfs_compact_compare);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* Live entries back to back, zero slots after them end directory */
+    p_new = (SUCCESS == error) ? (uint8_t *)calloc(bytes, 1) : NULL;
+    error = ((SUCCESS == error) && (NULL == p_new)) ?
+            FATFS_READ_SECTOR_FAILED : error;
+    for (i = 0; (SUCCESS == error) && (i < record_count); i++)
+    {
+        memcpy(p_new + used, p_old + p_records[i].offset,
+               p_records[i].count * FATFS_COMPACT_ENTRY_SIZE);
+        used += p_records[i].count * FATFS_COMPACT_ENTRY_SIZE;
+    }
+    if (0 == first_cluster)
+    {
+        keep = 0;
+    }
+    else
+    {
+        keep = (used + cluster_bytes - 1) / cluster_bytes;
+        keep = (0 == keep) ? 1 : keep;
+    }
+    /* First cluster past kept ones is written too, its zero slots end the
+       directory if kept clusters are full and step 2 never happens */
+    write = (keep < bytes / cluster_bytes) ? keep + 1 : keep;
+
+    /* 1. Rewrite slots front to back, skipped if nothing moves */
+    if ((SUCCESS == error) && (memcmp(p_new, p_old, bytes) != 0))
+    {
+        if (0 == first_cluster)
+        {
+            sectors = p_boot->data_index - p_boot->root_directory_index;
+            error = (kmc_write_multi_sector(p_boot->root_directory_index,
+                                            sectors, p_new) !=
+                     (int32_t)bytes) ? FATFS_WRITE_FAILED : SUCCESS;
+        }
+        else
+        {
+            for (i = 0; (SUCCESS == error) && (i < extent_count) &&
+                    (done < write); i++)
+            {
+                clusters = p_extents[i].cluster_count;
+                clusters = (done + clusters > write) ? write - done :
+                           clusters;
+                sectors = clusters * p_boot->sector_per_cluster;
+                if (kmc_write_multi_sector(fatfs_cluster_to_sector(
+                                               p_extents[i].first_cluster),
+                                           sectors,
+                                           p_new + done * cluster_bytes) !=
+                        (int32_t)(clusters * cluster_bytes))
+                {
+                    error = FATFS_WRITE_FAILED;
+                }
+                else
+                {
+                    done += clusters;
+                }
+            }
+        }
+        if ((SUCCESS == error) && (false == kmc_flush()))
+        {
+            error = FATFS_WRITE_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        fatfs_index_invalidate(first_cluster);
+        /* Sidecar lists old slots, FAT flush below may not drop it */
+        fatfs_sidecar_close();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* 2. End chain after last kept cluster, free the rest */
+    for (i = 0, done = 0; (SUCCESS == error) && (0 != first_cluster) &&
+            (keep < bytes / cluster_bytes) && (i < extent_count); i++)
+    {
+        for (j = 0; (SUCCESS == error) && (j < p_extents[i].cluster_count);
+                j++, done++)
+        {
+            if (done + 1 == keep)
+            {
+                error = fatfs_set_next_cluster(p_extents[i].first_cluster + j,
+                                               end_value);
+            }
+            else if (done >= keep)
+            {
+                error = fatfs_set_next_cluster(p_extents[i].first_cluster + j,
+                                               0);
+                p_result->freed_clusters++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+    }
+    if ((SUCCESS == error) && (p_result->freed_clusters > 0))
+    {
+        error = fatfs_flush_fat();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_records);
+    free(p_extents);
+    free(p_old);
+    free(p_new);
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,38 @@
+#ifndef _COMPACT_H_
+#define _COMPACT_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t kept_entries;      /* Slots kept, long name entries included */
+    uint32_t removed_entries;   /* Deleted and orphaned slots dropped */
+    uint32_t freed_clusters;    /* Trailing clusters given back to FAT */
+} fatfs_compact_result_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Rewrite live entries of a directory densely, in place
+ *
+ * Deleted entries and long name entries of no live entry are dropped,
+ * clusters no longer needed are freed, root directory keeps its region.
+ * Image must be opened writable, see kmc_set_writable. Directory is
+ * rewritten over its own clusters, so a crash part way can leave it half
+ * compacted, run under kmc_set_overlay to make it all or nothing.
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] sort is true to order entries by name, '.' entries first
+ * @param [out] p_result is amount of work done
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_compact_directory(const uint32_t first_cluster,
+        const bool sort, fatfs_compact_result_struct_t *const p_result);
+
+#endif /* _COMPACT_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,647 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "dirindex.h"
+#include "manifest.h"
+#include "check.h"
+#include "defrag.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_DEFRAG_CHUNK_SIZE (1024U * 1024U)
+#define FATFS_DEFRAG_DIRECTORY_ATTRIBUTE 0x10U
+#define FATFS_DEFRAG_FIRST_CLUSTER_OFFSET 26U
+
+typedef struct
+{
+    uint64_t entry_offset;      /* Image offset of directory entry */
+    uint32_t directory_cluster;
+    uint32_t first_cluster;
+    uint32_t size;
+} fatfs_defrag_file_struct_t;
+
+typedef struct
+{
+    fatfs_defrag_file_struct_t *p_files;
+    uint32_t count;
+    uint32_t capacity;
+} fatfs_defrag_list_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Collect free runs of FAT, sorted by cluster
+ *
+ * @param [out] p_runs is array of free runs, freed by caller
+ * @param [out] p_count is number of free runs
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_defrag_free_runs(fatfs_extent_struct_t
+        **const p_runs, uint32_t *const p_count);
+
+/**
+ * @brief Collect every file with location of its directory entry
+ *
+ * @param [out] p_files is array of files, freed by caller
+ * @param [out] p_count is number of files
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_defrag_files(fatfs_defrag_file_struct_t
+        **const p_files, uint32_t *const p_count);
+
+/**
+ * @brief Add file reached by tree walk to list
+ *
+ * @param [in] p_entry is entry walked
+ * @param [inout] p_context is list
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_defrag_add(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/**
+ * @brief Move one file to a free run
+ *
+ * @param [in] p_file is file to move
+ * @param [in] p_extents is current extents of file
+ * @param [in] extent_count is number of extents
+ * @param [in] target is first cluster of free run
+ * @param [in] p_buff is copy buffer
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_defrag_move(const fatfs_defrag_file_struct_t
+        *const p_file, const fatfs_extent_struct_t *const p_extents,
+        const uint32_t extent_count, const uint32_t target,
+        uint8_t *const p_buff);
+
+/**
+ * @brief Compare two extents by first cluster
+ *
+ * @param [in] p_first is first extent
+ * @param [in] p_second is second extent
+ * @return int is order of extents
+ */
+static int fatfs_defrag_compare_extent(const void *p_first,
+                                       const void *p_second);
+
+/**
+ * @brief Compare two files by first cluster
+ *
+ * @param [in] p_first is first file
+ * @param [in] p_second is second file
+ * @return int is order of files
+ */
+static int fatfs_defrag_compare_file(const void *p_first,
+                                     const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to compare extents */
+static int fatfs_defrag_compare_extent(const void *p_first,
+                                       const void *p_second)
+{
+    uint32_t first = ((const fatfs_extent_struct_t *)p_first)->first_cluster;
+    uint32_t second = ((const fatfs_extent_struct_t *)p_second)->first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to compare files */
+static int fatfs_defrag_compare_file(const void *p_first,
+                                     const void *p_second)
+{
+    uint32_t first = ((const fatfs_defrag_file_struct_t *)
+                      p_first)->first_cluster;
+    uint32_t second = ((const fatfs_defrag_file_struct_t *)
+                       p_second)->first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to collect free runs */
+static fatfs_error_enum_t fatfs_defrag_free_runs(fatfs_extent_struct_t
+        **const p_runs, uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_extent_struct_t *p_temp = NULL;
+    fatfs_extent_struct_t *p_list = NULL;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    uint32_t cluster = 0;
+    uint32_t next = 0;
+
+    for (cluster = 2; (SUCCESS == error) &&
+            (cluster < p_boot->cluster_count + 2); cluster++)
+    {
+        next = cluster;
+        error = fatfs_get_next_cluster(&next);
+        if ((SUCCESS == error) && (0 == next))
+        {
+            if ((count > 0) && (p_list[count - 1].first_cluster +
+                                p_list[count - 1].cluster_count == cluster))
+            {
+                p_list[count - 1].cluster_count++;
+            }
+            else
+            {
+                if (count == capacity)
+                {
+                    capacity = (0 == capacity) ? 64 : capacity * 2;
+                    p_temp = (fatfs_extent_struct_t *)realloc(p_list,
+                             capacity * sizeof(fatfs_extent_struct_t));
+                    error = (NULL == p_temp) ? FATFS_READ_SECTOR_FAILED :
+                            SUCCESS;
+                    p_list = (NULL == p_temp) ? p_list : p_temp;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+                if (SUCCESS == error)
+                {
+                    p_list[count].first_cluster = cluster;
+                    p_list[count].cluster_count = 1;
+                    count++;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    *p_runs = p_list;
+    *p_count = count;
+
+    return error;
+}
+
+/* Function is used to collect files with entry location */
+static fatfs_error_enum_t fatfs_defrag_files(fatfs_defrag_file_struct_t
+        **const p_files, uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_defrag_list_struct_t list;
+
+    memset(&list, 0, sizeof(list));
+    error = fatfs_walk(0, "", true, fatfs_defrag_add, &list);
+    *p_files = list.p_files;
+    *p_count = list.count;
+
+    return error;
+}
+
+/* Function is used to add walked file to list */
+static fatfs_error_enum_t fatfs_defrag_add(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_defrag_list_struct_t *p_list =
+        (fatfs_defrag_list_struct_t *)p_context;
+    fatfs_defrag_file_struct_t *p_file = NULL;
+    void *p_temp = NULL;
+
+    /* Directories stay in place, children point back to them */
+    if ((p_entry->info.file_attribute & FATFS_DEFRAG_DIRECTORY_ATTRIBUTE) ||
+            (p_entry->info.first_cluster < 2) ||
+            (p_entry->info.first_cluster >= p_boot->cluster_count + 2))
+    {
+        /* Do nothing */
+    }
+    else
+    {
+        if (p_list->count == p_list->capacity)
+        {
+            p_list->capacity = (0 == p_list->capacity) ? 64 :
+                               p_list->capacity * 2;
+            p_temp = realloc(p_list->p_files, p_list->capacity *
+                             sizeof(fatfs_defrag_file_struct_t));
+            error = (NULL == p_temp) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+            p_list->p_files = (NULL == p_temp) ? p_list->p_files : p_temp;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (SUCCESS == error)
+        {
+            p_file = &p_list->p_files[p_list->count++];
+            p_file->entry_offset = p_entry->entry_offset;
+            p_file->directory_cluster = p_entry->directory_cluster;
+            p_file->first_cluster = p_entry->info.first_cluster;
+            p_file->size = p_entry->info.file_size;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to move one file */
+static fatfs_error_enum_t fatfs_defrag_move(const fatfs_defrag_file_struct_t
+        *const p_file, const fatfs_extent_struct_t *const p_extents,
+        const uint32_t extent_count, const uint32_t target,
+        uint8_t *const p_buff)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t chunk_clusters = FATFS_DEFRAG_CHUNK_SIZE / cluster_bytes;
+    uint32_t end_value = (12 == p_boot->fat_type) ? 0xFFF : 0xFFFF;
+    uint32_t written = 0;
+    uint32_t clusters = 0;
+    uint32_t done = 0;
+    uint32_t sectors = 0;
+    int32_t bytes = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint8_t entry[2];
+
+    chunk_clusters = (0 == chunk_clusters) ? 1 : chunk_clusters;
+
+    /* 1. Copy data into free clusters, nothing points to them yet */
+    for (i = 0; (SUCCESS == error) && (i < extent_count); i++)
+    {
+        for (done = 0; (SUCCESS == error) &&
+                (done < p_extents[i].cluster_count); done += clusters)
+        {
+            clusters = p_extents[i].cluster_count - done;
+            clusters = (clusters > chunk_clusters) ? chunk_clusters : clusters;
+            sectors = clusters * p_boot->sector_per_cluster;
+            bytes = (int32_t)(clusters * cluster_bytes);
+            if (kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                          p_extents[i].first_cluster + done),
+                                      sectors, p_buff) != bytes)
+            {
+                error = FATFS_READ_SECTOR_FAILED;
+            }
+            else if (kmc_write_multi_sector(fatfs_cluster_to_sector(
+                                                target + written),
+                                            sectors, p_buff) != bytes)
+            {
+                error = FATFS_WRITE_FAILED;
+            }
+            else
+            {
+                written += clusters;
+            }
+        }
+    }
+    if ((SUCCESS == error) && (false == kmc_flush()))
+    {
+        error = FATFS_WRITE_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* 2. Allocate new chain, crash leaves it as lost clusters */
+    for (i = 0; (SUCCESS == error) && (i < written); i++)
+    {
+        error = fatfs_set_next_cluster(target + i, (i + 1 == written) ?
+                                       end_value : target + i + 1);
+    }
+    if (SUCCESS == error)
+    {
+        error = fatfs_flush_fat();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* 3. Point entry to new chain, this is the switch over */
+    if (SUCCESS == error)
+    {
+        entry[0] = (uint8_t)target;
+        entry[1] = (uint8_t)(target >> 8);
+        if ((kmc_write_bytes(p_file->entry_offset +
+                             FATFS_DEFRAG_FIRST_CLUSTER_OFFSET, 2, entry) != 2) ||
+                (false == kmc_flush()))
+        {
+            error = FATFS_WRITE_FAILED;
+        }
+        else
+        {
+            fatfs_index_invalidate(p_file->directory_cluster);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* 4. Free old chain, crash before this leaves it as lost clusters */
+    for (i = 0; (SUCCESS == error) && (i < extent_count); i++)
+    {
+        for (j = 0; (SUCCESS == error) && (j < p_extents[i].cluster_count);
+                j++)
+        {
+            error = fatfs_set_next_cluster(p_extents[i].first_cluster + j, 0);
+        }
+    }
+    if (SUCCESS == error)
+    {
+        error = fatfs_flush_fat();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to report fragmentation */
+fatfs_error_enum_t fatfs_frag_report(fatfs_frag_report_struct_t *const
+                                     p_report)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_manifest_entry_struct_t *p_entries = NULL;
+    fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_extent_struct_t *p_runs = NULL;
+    uint32_t extent_count = 0;
+    uint32_t run_count = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    memset(p_report, 0, sizeof(fatfs_frag_report_struct_t));
+    error = fatfs_manifest_list(&p_entries, &count);
+    if ((SUCCESS == error) && (count > 0))
+    {
+        p_report->p_files = (fatfs_frag_file_struct_t *)calloc(count,
+                            sizeof(fatfs_frag_file_struct_t));
+        error = (NULL == p_report->p_files) ? FATFS_READ_SECTOR_FAILED :
+                SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < count); i++)
+    {
+        memcpy(p_report->p_files[i].path, p_entries[i].path,
+               FATFS_MANIFEST_PATH_SIZE);
+        extent_count = 0;
+        if ((p_entries[i].size > 0) &&
+                (SUCCESS == fatfs_get_extents(p_entries[i].first_cluster,
+                                              &p_extents, &extent_count)))
+        {
+            for (j = 0; j < extent_count; j++)
+            {
+                p_report->p_files[i].cluster_count +=
+                    p_extents[j].cluster_count;
+            }
+            free(p_extents);
+            p_extents = NULL;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        p_report->p_files[i].extent_count = extent_count;
+        p_report->files++;
+        p_report->fragmented_files += (extent_count > 1);
+        p_report->clusters += p_report->p_files[i].cluster_count;
+        p_report->extents += extent_count;
+    }
+    if (SUCCESS == error)
+    {
+        p_report->average_extent_bytes = (0 == p_report->extents) ? 0 :
+                                         (uint64_t)p_report->clusters *
+                                         p_boot->byte_per_sector *
+                                         p_boot->sector_per_cluster /
+                                         p_report->extents;
+        error = fatfs_defrag_free_runs(&p_runs, &run_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < run_count); i++)
+    {
+        p_report->free_clusters += p_runs[i].cluster_count;
+        p_report->largest_free_extent =
+            (p_runs[i].cluster_count > p_report->largest_free_extent) ?
+            p_runs[i].cluster_count : p_report->largest_free_extent;
+    }
+    p_report->free_extents = run_count;
+    free(p_runs);
+    free(p_entries);
+    if (error != SUCCESS)
+    {
+        fatfs_frag_free(p_report);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to free files of a report */
+void fatfs_frag_free(fatfs_frag_report_struct_t *const p_report)
+{
+    free(p_report->p_files);
+    p_report->p_files = NULL;
+}
+
+/* Function is used to make files contiguous */
+fatfs_error_enum_t fatfs_defrag(fatfs_defrag_result_struct_t *const p_result)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_defrag_file_struct_t *p_files = NULL;
+    fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_extent_struct_t *p_runs = NULL;
+    fatfs_extent_struct_t *p_temp = NULL;
+    fatfs_check_report_struct_t report;
+    uint8_t *p_buff = NULL;
+    uint32_t file_count = 0;
+    uint32_t extent_count = 0;
+    uint32_t run_count = 0;
+    uint32_t need = 0;
+    uint32_t best = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t k = 0;
+
+    memset(p_result, 0, sizeof(fatfs_defrag_result_struct_t));
+    memset(&report, 0, sizeof(report));
+    p_buff = (uint8_t *)malloc(FATFS_DEFRAG_CHUNK_SIZE +
+                               p_boot->byte_per_sector *
+                               p_boot->sector_per_cluster);
+    error = (NULL == p_buff) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+    if (SUCCESS == error)
+    {
+        error = fatfs_check(0, &report);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    /* Freeing old chain of a shared cluster would destroy its other owner */
+    for (i = 0; (SUCCESS == error) && (i < report.problem_count); i++)
+    {
+        if ((FATFS_CHECK_CROSS_LINK == report.p_problems[i].problem) ||
+                (FATFS_CHECK_LOOP == report.p_problems[i].problem) ||
+                (FATFS_CHECK_BAD_CHAIN == report.p_problems[i].problem))
+        {
+            error = FATFS_VOLUME_DAMAGED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    fatfs_check_free(&report);
+    if (SUCCESS == error)
+    {
+        error = fatfs_defrag_files(&p_files, &file_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        error = fatfs_defrag_free_runs(&p_runs, &run_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((SUCCESS == error) && (file_count > 0))
+    {
+        /* Sources in disk order, reads sweep forward over the image */
+        qsort(p_files, file_count, sizeof(fatfs_defrag_file_struct_t),
+              fatfs_defrag_compare_file);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < file_count); i++)
+    {
+        extent_count = 0;
+        error = fatfs_get_extents(p_files[i].first_cluster, &p_extents,
+                                  &extent_count);
+        if ((SUCCESS == error) && (extent_count > 1))
+        {
+            for (j = 0, need = 0; j < extent_count; j++)
+            {
+                need += p_extents[j].cluster_count;
+            }
+            /* Best fit keeps large free runs for large files */
+            best = run_count;
+            for (j = 0; j < run_count; j++)
+            {
+                if ((p_runs[j].cluster_count >= need) && ((best == run_count) ||
+                        (p_runs[j].cluster_count < p_runs[best].cluster_count)))
+                {
+                    best = j;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            if (best < run_count)
+            {
+                error = fatfs_defrag_move(&p_files[i], p_extents, extent_count,
+                                          p_runs[best].first_cluster, p_buff);
+            }
+            else
+            {
+                p_result->skipped_files++;
+            }
+            if ((SUCCESS == error) && (best < run_count))
+            {
+                p_result->moved_files++;
+                p_result->moved_clusters += need;
+                p_runs[best].first_cluster += need;
+                p_runs[best].cluster_count -= need;
+                /* Old clusters are free now, add and merge them */
+                p_temp = (fatfs_extent_struct_t *)realloc(p_runs,
+                         (run_count + extent_count) *
+                         sizeof(fatfs_extent_struct_t));
+                if (p_temp != NULL)
+                {
+                    p_runs = p_temp;
+                    memcpy(p_runs + run_count, p_extents,
+                           extent_count * sizeof(fatfs_extent_struct_t));
+                    run_count += extent_count;
+                    qsort(p_runs, run_count, sizeof(fatfs_extent_struct_t),
+                          fatfs_defrag_compare_extent);
+                    for (j = 0, k = 0; j < run_count; j++)
+                    {
+                        if (0 == p_runs[j].cluster_count)
+                        {
+                            /* Do nothing */
+                        }
+                        else if ((k > 0) && (p_runs[k - 1].first_cluster +
+                                             p_runs[k - 1].cluster_count ==
+                                             p_runs[j].first_cluster))
+                        {
+                            p_runs[k - 1].cluster_count +=
+                                p_runs[j].cluster_count;
+                        }
+                        else
+                        {
+                            p_runs[k++] = p_runs[j];
+                        }
+                    }
+                    run_count = k;
+                }
+                else
+                {
+                    /* Old clusters are not reused in this pass */
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        free(p_extents);
+        p_extents = NULL;
+    }
+    free(p_runs);
+    free(p_files);
+    free(p_buff);
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
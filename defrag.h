@@ -0,0 +1,71 @@
+#ifndef _DEFRAG_H_
+#define _DEFRAG_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint8_t path[FATFS_MANIFEST_PATH_SIZE];
+    uint32_t cluster_count;
+    uint32_t extent_count;
+} fatfs_frag_file_struct_t;
+
+typedef struct
+{
+    uint32_t files;
+    uint32_t fragmented_files;      /* Files with more than one extent */
+    uint32_t clusters;              /* Clusters used by files */
+    uint32_t extents;               /* Extents of all files */
+    uint64_t average_extent_bytes;  /* Average extent length of files */
+    uint32_t free_clusters;
+    uint32_t free_extents;          /* Runs of free clusters */
+    uint32_t largest_free_extent;   /* Clusters in longest free run */
+    fatfs_frag_file_struct_t *p_files;
+} fatfs_frag_report_struct_t;
+
+typedef struct
+{
+    uint32_t moved_files;
+    uint32_t moved_clusters;
+    uint32_t skipped_files;         /* No free run large enough */
+} fatfs_defrag_result_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Report fragmentation of volume opened by fatfs_init
+ *
+ * @param [out] p_report is report, freed with fatfs_frag_free
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_frag_report(fatfs_frag_report_struct_t *const
+                                     p_report);
+
+/**
+ * @brief Free files of a report
+ *
+ * @param [inout] p_report is report
+ */
+void fatfs_frag_free(fatfs_frag_report_struct_t *const p_report);
+
+/**
+ * @brief Make fragmented files contiguous, in place
+ *
+ * Image must be opened writable, see kmc_set_writable. Each file is copied
+ * to a free run, then FAT, directory entry and old chain are updated with
+ * a flush between steps, so a crash only leaves lost clusters behind.
+ * Volume with cross-linked, looped or broken chains is left untouched.
+ *
+ * @param [out] p_result is amount of work done
+ * @return fatfs_error_enum_t is error code, FATFS_VOLUME_DAMAGED if
+ * fatfs_check finds such chains
+ */
+fatfs_error_enum_t fatfs_defrag(fatfs_defrag_result_struct_t *const p_result);
+
+#endif /* _DEFRAG_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,543 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "hash.h"
+#include "manifest.h"
+#include "diff.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_DIFF_CHUNK_SIZE (1024U * 1024U)
+#define FATFS_DIFF_BLOCK_SIZE 4096U
+
+typedef struct
+{
+    uint32_t old_index;
+    uint32_t new_index;
+    uint32_t block_count;
+    uint64_t *p_hashes;         /* Hash of each block in new image */
+} fatfs_diff_candidate_struct_t;
+
+typedef struct
+{
+    uint8_t *p_fat;
+    uint32_t fat_bytes;
+    uint8_t fat_type;
+    uint32_t cluster_count;
+    fatfs_manifest_entry_struct_t *p_files;
+    uint32_t file_count;
+} fatfs_diff_image_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Mount image, list its files and take its FAT
+ *
+ * @param [in] file_path is path to image
+ * @param [out] p_image is listed image
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_diff_load(const uint8_t *const file_path,
+        fatfs_diff_image_struct_t *const p_image);
+
+/**
+ * @brief Get FAT value of cluster from a FAT copy
+ *
+ * @param [in] p_image is image owning FAT
+ * @param [in] cluster is cluster index
+ * @return uint32_t is next cluster
+ */
+static uint32_t fatfs_diff_next(const fatfs_diff_image_struct_t *const p_image,
+                                const uint32_t cluster);
+
+/**
+ * @brief Check if two chains use the same clusters in the same order
+ *
+ * @param [in] p_old is old image
+ * @param [in] p_new is new image
+ * @param [in] first_cluster is first cluster of both chains
+ * @param [in] fat_equal is true if FATs are identical
+ * @return true if chains are the same
+ * @return false if chains differ
+ */
+static bool fatfs_diff_same_chain(const fatfs_diff_image_struct_t *const p_old,
+                                  const fatfs_diff_image_struct_t *const p_new,
+                                  const uint32_t first_cluster,
+                                  const bool fat_equal);
+
+/**
+ * @brief Hash 4 KiB blocks of file on mounted volume, or compare them
+ *
+ * @param [in] p_file is file to hash
+ * @param [inout] p_candidate is candidate, hashes stored if p_hashes is
+ *                empty and compared otherwise
+ * @param [in] compare is true to compare with stored hashes
+ * @param [inout] p_hashed is counter of hashed clusters
+ * @return true if all clusters match or hashes are stored
+ * @return false if a cluster differs or can not be read
+ */
+static bool fatfs_diff_hash_file(const fatfs_manifest_entry_struct_t *const
+                                 p_file,
+                                 fatfs_diff_candidate_struct_t *const p_candidate,
+                                 const bool compare, uint32_t *const p_hashed);
+
+/**
+ * @brief Add change to result
+ *
+ * @param [inout] p_changes is array of changes
+ * @param [inout] p_count is number of changes
+ * @param [in] p_path is path of file
+ * @param [in] status is kind of change
+ */
+static void fatfs_diff_add(fatfs_diff_entry_struct_t *const p_changes,
+                           uint32_t *const p_count,
+                           const uint8_t *const p_path,
+                           const fatfs_diff_status_enum_t status);
+
+/**
+ * @brief Compare two changes by path
+ *
+ * @param [in] p_first is first change
+ * @param [in] p_second is second change
+ * @return int is order of changes
+ */
+static int fatfs_diff_compare(const void *p_first, const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to load image */
+static fatfs_error_enum_t fatfs_diff_load(const uint8_t *const file_path,
+        fatfs_diff_image_struct_t *const p_image)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+
+    memset(p_image, 0, sizeof(fatfs_diff_image_struct_t));
+    error = fatfs_init(file_path, &p_boot);
+    if (SUCCESS == error)
+    {
+        p_image->fat_type = p_boot->fat_type;
+        p_image->cluster_count = p_boot->cluster_count;
+        error = fatfs_manifest_list(&p_image->p_files, &p_image->file_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        /* FAT stays with caller, it is given back when image is remounted */
+        p_image->p_fat = fatfs_detach_fat(&p_image->fat_bytes);
+        error = (NULL == p_image->p_fat) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    fatfs_deinit();
+
+    return error;
+}
+
+/* Function is used to get FAT value from a FAT copy */
+static uint32_t fatfs_diff_next(const fatfs_diff_image_struct_t *const p_image,
+                                const uint32_t cluster)
+{
+    uint32_t index = cluster * p_image->fat_type / 8;
+    uint32_t value = 0;
+
+    if (index + 1 < p_image->fat_bytes)
+    {
+        value = (uint32_t)p_image->p_fat[index] |
+                ((uint32_t)p_image->p_fat[index + 1] << 8);
+        if (12 == p_image->fat_type)
+        {
+            value = (cluster & 1) ? (value >> 4) : (value & 0xFFF);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return value;
+}
+
+/* Function is used to compare chains */
+static bool fatfs_diff_same_chain(const fatfs_diff_image_struct_t *const p_old,
+                                  const fatfs_diff_image_struct_t *const p_new,
+                                  const uint32_t first_cluster,
+                                  const bool fat_equal)
+{
+    bool same = true;
+    uint32_t cluster = first_cluster;
+    uint32_t old_next = 0;
+    uint32_t new_next = 0;
+    uint32_t steps = 0;
+
+    if ((false == fat_equal) && (cluster >= 2))
+    {
+        /* Walk both FATs together, bounded against loops */
+        while ((true == same) && (steps++ <= p_new->cluster_count))
+        {
+            old_next = fatfs_diff_next(p_old, cluster);
+            new_next = fatfs_diff_next(p_new, cluster);
+            same = (old_next == new_next);
+            if ((true == same) && (new_next >= 2) &&
+                    (new_next < ((12 == p_new->fat_type) ? 0xFF8U : 0xFFF8U)))
+            {
+                cluster = new_next;
+            }
+            else
+            {
+                break;
+            }
+        }
+        same = same && (steps <= p_new->cluster_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return same;
+}
+
+/* Function is used to hash blocks of file */
+static bool fatfs_diff_hash_file(const fatfs_manifest_entry_struct_t *const
+                                 p_file,
+                                 fatfs_diff_candidate_struct_t *const p_candidate,
+                                 const bool compare, uint32_t *const p_hashed)
+{
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_hash64_struct_t state;
+    uint8_t *p_buff = NULL;
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t chunk_clusters = FATFS_DIFF_CHUNK_SIZE / cluster_bytes;
+    uint32_t extent_count = 0;
+    uint32_t remain = p_file->size;
+    uint32_t position = 0;
+    uint32_t block_fill = 0;
+    uint32_t clusters = 0;
+    uint32_t bytes = 0;
+    uint32_t offset = 0;
+    uint32_t piece = 0;
+    uint32_t done = 0;
+    uint32_t i = 0;
+    uint64_t hash = 0;
+    bool same = true;
+
+    chunk_clusters = (0 == chunk_clusters) ? 1 : chunk_clusters;
+    p_buff = (uint8_t *)malloc(chunk_clusters * cluster_bytes);
+    if ((NULL == p_buff) ||
+            ((remain > 0) && (fatfs_get_extents(p_file->first_cluster,
+                              &p_extents, &extent_count) != SUCCESS)))
+    {
+        same = false;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    fatfs_hash64_init(&state);
+    for (i = 0; (true == same) && (i < extent_count) && (remain > 0); i++)
+    {
+        for (done = 0; (true == same) && (remain > 0) &&
+                (done < p_extents[i].cluster_count); done += clusters)
+        {
+            clusters = p_extents[i].cluster_count - done;
+            clusters = (clusters > chunk_clusters) ? chunk_clusters : clusters;
+            bytes = clusters * cluster_bytes;
+            same = (kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                              p_extents[i].first_cluster + done),
+                                          clusters * p_boot->sector_per_cluster,
+                                          p_buff) == (int32_t)bytes);
+            bytes = (bytes > remain) ? remain : bytes;
+            /* Blocks do not depend on cluster size, images may differ */
+            for (offset = 0; (true == same) && (offset < bytes);
+                    offset += piece)
+            {
+                piece = FATFS_DIFF_BLOCK_SIZE - block_fill;
+                piece = (piece > bytes - offset) ? bytes - offset : piece;
+                fatfs_hash64_update(&state, p_buff + offset, piece);
+                block_fill += piece;
+                remain -= piece;
+                if ((FATFS_DIFF_BLOCK_SIZE == block_fill) || (0 == remain))
+                {
+                    hash = fatfs_hash64_final(&state);
+                    fatfs_hash64_init(&state);
+                    block_fill = 0;
+                    (*p_hashed)++;
+                    if (position >= p_candidate->block_count)
+                    {
+                        same = false;
+                    }
+                    else if (true == compare)
+                    {
+                        same = (p_candidate->p_hashes[position] == hash);
+                    }
+                    else
+                    {
+                        p_candidate->p_hashes[position] = hash;
+                    }
+                    position++;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+        }
+    }
+    same = same && (0 == remain);
+    free(p_extents);
+    free(p_buff);
+
+    return same;
+}
+
+/* Function is used to add change */
+static void fatfs_diff_add(fatfs_diff_entry_struct_t *const p_changes,
+                           uint32_t *const p_count,
+                           const uint8_t *const p_path,
+                           const fatfs_diff_status_enum_t status)
+{
+    memcpy(p_changes[*p_count].path, p_path, FATFS_MANIFEST_PATH_SIZE);
+    p_changes[*p_count].status = status;
+    (*p_count)++;
+}
+
+/* Function is used to compare changes by path */
+static int fatfs_diff_compare(const void *p_first, const void *p_second)
+{
+    return strcmp(((const fatfs_diff_entry_struct_t *)p_first)->path,
+                  ((const fatfs_diff_entry_struct_t *)p_second)->path);
+}
+
+/* Function is used to find changes between two images */
+fatfs_error_enum_t fatfs_diff(const uint8_t *const old_path,
+                              const uint8_t *const new_path, const bool deep,
+                              fatfs_diff_entry_struct_t **const p_changes,
+                              uint32_t *const p_count,
+                              fatfs_diff_stats_struct_t *const p_stats)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_diff_image_struct_t old_image;
+    fatfs_diff_image_struct_t new_image;
+    fatfs_diff_candidate_struct_t *p_candidates = NULL;
+    fatfs_diff_entry_struct_t *p_result = NULL;
+    fatfs_diff_stats_struct_t stats;
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+    const fatfs_manifest_entry_struct_t *p_old = NULL;
+    const fatfs_manifest_entry_struct_t *p_new = NULL;
+    uint32_t candidate_count = 0;
+    uint32_t result_count = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    int order = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    error = fatfs_diff_load(old_path, &old_image);
+    if (SUCCESS == error)
+    {
+        error = fatfs_diff_load(new_path, &new_image);
+    }
+    else
+    {
+        memset(&new_image, 0, sizeof(new_image));
+    }
+    if (SUCCESS == error)
+    {
+        stats.fat_equal = (old_image.fat_bytes == new_image.fat_bytes) &&
+                          (old_image.fat_type == new_image.fat_type) &&
+                          (0 == memcmp(old_image.p_fat, new_image.p_fat,
+                                       new_image.fat_bytes));
+        p_result = (fatfs_diff_entry_struct_t *)malloc((old_image.file_count +
+                   new_image.file_count + 1) * sizeof(fatfs_diff_entry_struct_t));
+        p_candidates = (fatfs_diff_candidate_struct_t *)calloc(
+                           new_image.file_count + 1,
+                           sizeof(fatfs_diff_candidate_struct_t));
+        error = ((NULL == p_result) || (NULL == p_candidates)) ?
+                FATFS_READ_SECTOR_FAILED : SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    /* Metadata pass: both lists are sorted by path */
+    while ((SUCCESS == error) &&
+            ((i < old_image.file_count) || (j < new_image.file_count)))
+    {
+        p_old = &old_image.p_files[i];
+        p_new = &new_image.p_files[j];
+        if (i >= old_image.file_count)
+        {
+            order = 1;
+        }
+        else if (j >= new_image.file_count)
+        {
+            order = -1;
+        }
+        else
+        {
+            order = strcmp(p_old->path, p_new->path);
+        }
+        if (order < 0)
+        {
+            fatfs_diff_add(p_result, &result_count, p_old->path,
+                           FATFS_DIFF_REMOVED);
+            i++;
+        }
+        else if (order > 0)
+        {
+            fatfs_diff_add(p_result, &result_count, p_new->path,
+                           FATFS_DIFF_ADDED);
+            j++;
+        }
+        else
+        {
+            stats.files++;
+            if (p_old->size != p_new->size)
+            {
+                fatfs_diff_add(p_result, &result_count, p_new->path,
+                               FATFS_DIFF_MODIFIED);
+            }
+            else if ((true == deep) ||
+                     (p_old->first_cluster != p_new->first_cluster) ||
+                     (0 != memcmp(&p_old->modified_date, &p_new->modified_date,
+                                  sizeof(p_old->modified_date))) ||
+                     (0 != memcmp(&p_old->modified_time, &p_new->modified_time,
+                                  sizeof(p_old->modified_time))) ||
+                     (false == fatfs_diff_same_chain(&old_image, &new_image,
+                             p_new->first_cluster, stats.fat_equal)))
+            {
+                /* Entry or chain moved, only content can tell */
+                p_candidates[candidate_count].old_index = i;
+                p_candidates[candidate_count].new_index = j;
+                candidate_count++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            i++;
+            j++;
+        }
+    }
+
+    /* Content pass: hash candidates in new image, then compare in old one */
+    if ((SUCCESS == error) && (candidate_count > 0))
+    {
+        fatfs_preload_fat(new_image.p_fat, new_image.fat_bytes);
+        new_image.p_fat = NULL;
+        error = fatfs_init(new_path, &p_boot);
+        for (i = 0; (SUCCESS == error) && (i < candidate_count); i++)
+        {
+            p_new = &new_image.p_files[p_candidates[i].new_index];
+            p_candidates[i].block_count = (uint32_t)(((uint64_t)p_new->size +
+                                          FATFS_DIFF_BLOCK_SIZE - 1) /
+                                          FATFS_DIFF_BLOCK_SIZE);
+            p_candidates[i].p_hashes = (uint64_t *)malloc(
+                                           (p_candidates[i].block_count + 1) *
+                                           sizeof(uint64_t));
+            if ((NULL == p_candidates[i].p_hashes) ||
+                    (false == fatfs_diff_hash_file(p_new, &p_candidates[i], false,
+                                                   &stats.hashed_blocks)))
+            {
+                /* Unreadable file is reported as modified */
+                free(p_candidates[i].p_hashes);
+                p_candidates[i].p_hashes = NULL;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        fatfs_deinit();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((SUCCESS == error) && (candidate_count > 0))
+    {
+        fatfs_preload_fat(old_image.p_fat, old_image.fat_bytes);
+        old_image.p_fat = NULL;
+        error = fatfs_init(old_path, &p_boot);
+        for (i = 0; (SUCCESS == error) && (i < candidate_count); i++)
+        {
+            p_old = &old_image.p_files[p_candidates[i].old_index];
+            if ((NULL == p_candidates[i].p_hashes) ||
+                    (false == fatfs_diff_hash_file(p_old, &p_candidates[i], true,
+                                                   &stats.hashed_blocks)))
+            {
+                fatfs_diff_add(p_result, &result_count, p_old->path,
+                               FATFS_DIFF_MODIFIED);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        fatfs_deinit();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    stats.candidates = candidate_count;
+    for (i = 0; i < candidate_count; i++)
+    {
+        free(p_candidates[i].p_hashes);
+    }
+    free(p_candidates);
+    free(old_image.p_fat);
+    free(old_image.p_files);
+    free(new_image.p_fat);
+    free(new_image.p_files);
+    if (SUCCESS == error)
+    {
+        qsort(p_result, result_count, sizeof(fatfs_diff_entry_struct_t),
+              fatfs_diff_compare);
+    }
+    else
+    {
+        free(p_result);
+        p_result = NULL;
+        result_count = 0;
+    }
+    *p_changes = p_result;
+    *p_count = result_count;
+    if (p_stats != NULL)
+    {
+        *p_stats = stats;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,57 @@
+#ifndef _DIFF_H_
+#define _DIFF_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef enum
+{
+    FATFS_DIFF_ADDED,
+    FATFS_DIFF_REMOVED,
+    FATFS_DIFF_MODIFIED
+} fatfs_diff_status_enum_t;
+
+typedef struct
+{
+    uint8_t path[FATFS_MANIFEST_PATH_SIZE];
+    fatfs_diff_status_enum_t status;
+} fatfs_diff_entry_struct_t;
+
+typedef struct
+{
+    uint32_t files;             /* Files present in both images */
+    uint32_t candidates;        /* Files whose content had to be compared */
+    uint32_t hashed_blocks;     /* File blocks read and hashed, both images */
+    bool fat_equal;             /* FATs of both images are identical */
+} fatfs_diff_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Find files added, removed and modified between two images
+ *
+ * FATs and directories are compared first. A file whose entry and chain
+ * are unchanged is taken as unchanged unless deep is set. Only remaining
+ * files are read, hashed block by block. Images are mounted one after the
+ * other, so no volume is mounted afterwards.
+ *
+ * @param [in] old_path is path to old image
+ * @param [in] new_path is path to new image
+ * @param [in] deep is true to also hash files with unchanged entry and chain
+ * @param [out] p_changes is array of changes sorted by path, freed by caller
+ * @param [out] p_count is number of changes
+ * @param [out] p_stats is amount of work done, may be NULL
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_diff(const uint8_t *const old_path,
+                              const uint8_t *const new_path, const bool deep,
+                              fatfs_diff_entry_struct_t **const p_changes,
+                              uint32_t *const p_count,
+                              fatfs_diff_stats_struct_t *const p_stats);
+
+#endif /* _DIFF_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
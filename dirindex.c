@@ -0,0 +1,545 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "fat.h"
+#include "dirindex.h"
+#include "sidecar.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_INDEX_BUCKETS 64U
+#define FATFS_INDEX_MIN_SLOTS 64U
+#define FATFS_INDEX_MIN_ENTRIES 32U
+#define FATFS_INDEX_MIN_NAMES 1024U
+#define FATFS_INDEX_NOT_FOUND 0xFFFFFFFFU
+#define FATFS_INDEX_FNV_OFFSET 2166136261U
+#define FATFS_INDEX_FNV_PRIME 16777619U
+
+typedef struct
+{
+    uint32_t name_hash;
+    uint32_t short_hash;
+    uint32_t name_offset;
+    uint32_t short_offset;
+    uint32_t file_size;
+    uint32_t file_round_up_size;
+    uint32_t first_cluster;
+    fatfs_modified_time_struct_t modified_time;
+    fatfs_modified_date_struct_t modified_date;
+    uint8_t file_attribute;
+    uint8_t file_extension[4];
+    bool short_indexed;
+} fatfs_index_entry_struct_t;
+
+typedef struct _dir_index
+{
+    uint32_t first_cluster;
+    fatfs_dir_struct_t *p_dir; /* NULL once whole directory is indexed */
+    fatfs_index_entry_struct_t *p_entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint8_t *p_names;
+    uint32_t names_size;
+    uint32_t names_capacity;
+    uint32_t *p_slots; /* Entry index + 1, 0 is empty slot */
+    uint32_t slot_count;
+    uint32_t slot_used;
+    struct _dir_index *p_next;
+} fatfs_dir_index_struct_t;
+
+static fatfs_dir_index_struct_t *sp_index_bucket[FATFS_INDEX_BUCKETS];
+static fatfs_index_stats_struct_t s_index_stats;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Hash name ignoring case
+ *
+ * @param [in] p_name is name
+ * @param [in] length is number of characters to hash
+ * @return uint32_t is hash of name
+ */
+static uint32_t fatfs_index_hash(const uint8_t *const p_name,
+                                 const uint32_t length);
+
+/**
+ * @brief Get index of directory, create it if not exist
+ *
+ * @param [in] first_cluster is first cluster of directory
+ * @return fatfs_dir_index_struct_t* is index of directory
+ */
+static fatfs_dir_index_struct_t *fatfs_index_get(const uint32_t
+        first_cluster);
+
+/**
+ * @brief Store name in name pool of index
+ *
+ * @param [inout] p_index is index of directory
+ * @param [in] p_name is name to store
+ * @return uint32_t is offset of name in pool
+ */
+static uint32_t fatfs_index_store_name(fatfs_dir_index_struct_t *const p_index,
+                                       const uint8_t *const p_name);
+
+/**
+ * @brief Insert hash of entry to slot table
+ *
+ * @param [inout] p_index is index of directory
+ * @param [in] hash is hash of name
+ * @param [in] entry is position of entry
+ */
+static void fatfs_index_insert_slot(fatfs_dir_index_struct_t *const p_index,
+                                    const uint32_t hash, const uint32_t entry);
+
+/**
+ * @brief Double slot table and insert every entry again
+ *
+ * @param [inout] p_index is index of directory
+ */
+static void fatfs_index_grow(fatfs_dir_index_struct_t *const p_index);
+
+/**
+ * @brief Add entry to index of directory
+ *
+ * @param [inout] p_index is index of directory
+ * @param [in] p_info is entry to add
+ */
+static void fatfs_index_add(fatfs_dir_index_struct_t *const p_index,
+                            const fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Find name in index of directory
+ *
+ * @param [in] p_index is index of directory
+ * @param [in] p_name is name to find
+ * @return uint32_t is position of entry, FATFS_INDEX_NOT_FOUND if not found
+ */
+static uint32_t fatfs_index_probe(const fatfs_dir_index_struct_t *const
+                                  p_index, const uint8_t *const p_name);
+
+/**
+ * @brief Compare entry name with a name, ignoring case
+ *
+ * @param [in] p_info is entry
+ * @param [in] p_name is name to compare
+ * @return true if long name or short name is equal
+ * @return false if not equal
+ */
+static bool fatfs_index_name_equal(const fatfs_entry_info_struct_t *const
+                                   p_info, const uint8_t *const p_name);
+
+/**
+ * @brief Free index of directory
+ *
+ * @param [in] p_index is index of directory
+ */
+static void fatfs_index_free(fatfs_dir_index_struct_t *const p_index);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to hash name */
+static uint32_t fatfs_index_hash(const uint8_t *const p_name,
+                                 const uint32_t length)
+{
+    uint32_t hash = FATFS_INDEX_FNV_OFFSET;
+    uint32_t i = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)tolower(p_name[i])) * FATFS_INDEX_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/* Function is used to get index of directory */
+static fatfs_dir_index_struct_t *fatfs_index_get(const uint32_t
+        first_cluster)
+{
+    fatfs_dir_index_struct_t *p_index =
+        sp_index_bucket[first_cluster % FATFS_INDEX_BUCKETS];
+    fatfs_entry_info_struct_t info;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    while ((p_index != NULL) && (p_index->first_cluster != first_cluster))
+    {
+        p_index = p_index->p_next;
+    }
+    if (NULL == p_index)
+    {
+        p_index = (fatfs_dir_index_struct_t *)calloc(1,
+                  sizeof(fatfs_dir_index_struct_t));
+        if ((p_index != NULL) &&
+                (true == fatfs_sidecar_find_directory(first_cluster, &first,
+                        &count)))
+        {
+            /* Directory is known from sidecar, index it without disk I/O */
+            for (i = 0; i < count; i++)
+            {
+                fatfs_sidecar_get_entry(first + i, &info);
+                fatfs_index_add(p_index, &info);
+            }
+        }
+        else if (p_index != NULL)
+        {
+            if (fatfs_dir_open(first_cluster, &p_index->p_dir) != SUCCESS)
+            {
+                free(p_index);
+                p_index = NULL;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (p_index != NULL)
+        {
+            p_index->first_cluster = first_cluster;
+            p_index->p_next =
+                sp_index_bucket[first_cluster % FATFS_INDEX_BUCKETS];
+            sp_index_bucket[first_cluster % FATFS_INDEX_BUCKETS] = p_index;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_index;
+}
+
+/* Function is used to store name in pool */
+static uint32_t fatfs_index_store_name(fatfs_dir_index_struct_t *const p_index,
+                                       const uint8_t *const p_name)
+{
+    uint32_t offset = p_index->names_size;
+    uint32_t length = strlen(p_name) + 1;
+
+    if (p_index->names_size + length > p_index->names_capacity)
+    {
+        p_index->names_capacity = (0 == p_index->names_capacity) ?
+                                  FATFS_INDEX_MIN_NAMES :
+                                  p_index->names_capacity * 2;
+        p_index->p_names = (uint8_t *)realloc(p_index->p_names,
+                                              p_index->names_capacity);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    memcpy(p_index->p_names + offset, p_name, length);
+    p_index->names_size += length;
+
+    return offset;
+}
+
+/* Function is used to insert hash to slot table */
+static void fatfs_index_insert_slot(fatfs_dir_index_struct_t *const p_index,
+                                    const uint32_t hash, const uint32_t entry)
+{
+    uint32_t slot = 0;
+
+    /* Keep load factor under 1/2 so probes stay short */
+    if ((p_index->slot_used + 1) * 2 > p_index->slot_count)
+    {
+        fatfs_index_grow(p_index);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    slot = hash & (p_index->slot_count - 1);
+    while (p_index->p_slots[slot] != 0)
+    {
+        slot = (slot + 1) & (p_index->slot_count - 1);
+    }
+    p_index->p_slots[slot] = entry + 1;
+    p_index->slot_used++;
+}
+
+/* Function is used to grow slot table */
+static void fatfs_index_grow(fatfs_dir_index_struct_t *const p_index)
+{
+    uint32_t i = 0;
+
+    free(p_index->p_slots);
+    p_index->slot_count = (0 == p_index->slot_count) ?
+                          FATFS_INDEX_MIN_SLOTS : p_index->slot_count * 2;
+    p_index->p_slots = (uint32_t *)calloc(p_index->slot_count,
+                                          sizeof(uint32_t));
+    p_index->slot_used = 0;
+    for (i = 0; i < p_index->count; i++)
+    {
+        fatfs_index_insert_slot(p_index, p_index->p_entries[i].name_hash, i);
+        if (true == p_index->p_entries[i].short_indexed)
+        {
+            fatfs_index_insert_slot(p_index, p_index->p_entries[i].short_hash,
+                                    i);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+}
+
+/* Function is used to add entry to index */
+static void fatfs_index_add(fatfs_dir_index_struct_t *const p_index,
+                            const fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_index_entry_struct_t *p_entry = NULL;
+    const uint8_t *p_name = fatfs_get_entry_name(p_info);
+
+    if (p_index->count == p_index->capacity)
+    {
+        p_index->capacity = (0 == p_index->capacity) ?
+                            FATFS_INDEX_MIN_ENTRIES : p_index->capacity * 2;
+        p_index->p_entries = (fatfs_index_entry_struct_t *)realloc(
+                                 p_index->p_entries, p_index->capacity *
+                                 sizeof(fatfs_index_entry_struct_t));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    p_entry = &p_index->p_entries[p_index->count];
+    p_entry->name_hash = fatfs_index_hash(p_name, strlen(p_name));
+    p_entry->short_hash = fatfs_index_hash(p_info->short_name,
+                                           strlen(p_info->short_name));
+    p_entry->name_offset = fatfs_index_store_name(p_index, p_info->file_name);
+    p_entry->short_offset = fatfs_index_store_name(p_index,
+                            p_info->short_name);
+    p_entry->file_size = p_info->file_size;
+    p_entry->file_round_up_size = p_info->file_round_up_size;
+    p_entry->first_cluster = p_info->first_cluster;
+    p_entry->modified_time = p_info->modified_time;
+    p_entry->modified_date = p_info->modified_date;
+    p_entry->file_attribute = p_info->file_attribute;
+    memcpy(p_entry->file_extension, p_info->file_extension,
+           sizeof(p_entry->file_extension));
+    /* A name without long entry is already found through its short name */
+    p_entry->short_indexed = (p_name != p_info->short_name) &&
+                             (strcasecmp(p_name, p_info->short_name) != 0);
+    p_index->count++;
+    fatfs_index_insert_slot(p_index, p_entry->name_hash, p_index->count - 1);
+    if (true == p_entry->short_indexed)
+    {
+        fatfs_index_insert_slot(p_index, p_entry->short_hash,
+                                p_index->count - 1);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to find name in index */
+static uint32_t fatfs_index_probe(const fatfs_dir_index_struct_t *const
+                                  p_index, const uint8_t *const p_name)
+{
+    uint32_t retVal = FATFS_INDEX_NOT_FOUND;
+    uint32_t length = strlen(p_name);
+    uint32_t hash = fatfs_index_hash(p_name, length);
+    uint32_t slot = 0;
+    const fatfs_index_entry_struct_t *p_entry = NULL;
+    const uint8_t *p_long = NULL;
+
+    if (p_index->slot_count > 0)
+    {
+        slot = hash & (p_index->slot_count - 1);
+        while ((p_index->p_slots[slot] != 0) &&
+                (FATFS_INDEX_NOT_FOUND == retVal))
+        {
+            p_entry = &p_index->p_entries[p_index->p_slots[slot] - 1];
+            /* Entry without long name is keyed by "NAME.EXT" only */
+            p_long = p_index->p_names + ((true == p_entry->short_indexed) ?
+                                         p_entry->name_offset :
+                                         p_entry->short_offset);
+            if (((hash == p_entry->name_hash) &&
+                    (0 == strcasecmp(p_long, p_name))) ||
+                    ((hash == p_entry->short_hash) &&
+                     (0 == strcasecmp(p_index->p_names +
+                                      p_entry->short_offset, p_name))))
+            {
+                retVal = p_index->p_slots[slot] - 1;
+            }
+            else
+            {
+                slot = (slot + 1) & (p_index->slot_count - 1);
+            }
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to compare entry name */
+static bool fatfs_index_name_equal(const fatfs_entry_info_struct_t *const
+                                   p_info, const uint8_t *const p_name)
+{
+    return ((0 == strcasecmp(fatfs_get_entry_name(p_info), p_name)) ||
+            (0 == strcasecmp(p_info->short_name, p_name)));
+}
+
+/* Function is used to free index of directory */
+static void fatfs_index_free(fatfs_dir_index_struct_t *const p_index)
+{
+    fatfs_dir_close(p_index->p_dir);
+    free(p_index->p_entries);
+    free(p_index->p_names);
+    free(p_index->p_slots);
+    free(p_index);
+}
+
+/* Function is used to find entry through index */
+fatfs_error_enum_t fatfs_index_lookup(const uint32_t first_cluster,
+                                      const uint8_t *const p_name,
+                                      fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_dir_index_struct_t *p_index = fatfs_index_get(first_cluster);
+    const fatfs_index_entry_struct_t *p_entry = NULL;
+    uint32_t position = FATFS_INDEX_NOT_FOUND;
+    bool found = false;
+
+    if (NULL == p_index)
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        position = fatfs_index_probe(p_index, p_name);
+        s_index_stats.lookups++;
+        if (position != FATFS_INDEX_NOT_FOUND)
+        {
+            s_index_stats.hits++;
+            p_entry = &p_index->p_entries[position];
+            strcpy(p_info->file_name, p_index->p_names + p_entry->name_offset);
+            strcpy(p_info->short_name,
+                   p_index->p_names + p_entry->short_offset);
+            memcpy(p_info->file_extension, p_entry->file_extension,
+                   sizeof(p_entry->file_extension));
+            p_info->file_attribute = p_entry->file_attribute;
+            p_info->modified_time = p_entry->modified_time;
+            p_info->modified_date = p_entry->modified_date;
+            p_info->file_size = p_entry->file_size;
+            p_info->file_round_up_size = p_entry->file_round_up_size;
+            p_info->first_cluster = p_entry->first_cluster;
+            p_info->p_next = NULL;
+            found = true;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        /* Continue scanning where the previous lookup stopped */
+        while ((false == found) && (p_index->p_dir != NULL))
+        {
+            error = fatfs_dir_next(p_index->p_dir, p_info);
+            if (SUCCESS == error)
+            {
+                fatfs_index_add(p_index, p_info);
+                found = fatfs_index_name_equal(p_info, p_name);
+            }
+            else
+            {
+                fatfs_dir_close(p_index->p_dir);
+                p_index->p_dir = NULL;
+            }
+        }
+        if (true == found)
+        {
+            error = SUCCESS;
+        }
+        else if (FATFS_END_OF_DIRECTORY == error)
+        {
+            error = FATFS_ENTRY_NOT_FOUND;
+        }
+        else if (SUCCESS == error)
+        {
+            error = FATFS_ENTRY_NOT_FOUND;
+        }
+        else
+        {
+            /* Index of a failed scan is incomplete, build it again later */
+            fatfs_index_invalidate(first_cluster);
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to drop index of directory */
+void fatfs_index_invalidate(const uint32_t first_cluster)
+{
+    fatfs_dir_index_struct_t **p_link =
+        &sp_index_bucket[first_cluster % FATFS_INDEX_BUCKETS];
+    fatfs_dir_index_struct_t *p_index = NULL;
+
+    while ((*p_link != NULL) && ((*p_link)->first_cluster != first_cluster))
+    {
+        p_link = &(*p_link)->p_next;
+    }
+    if (*p_link != NULL)
+    {
+        p_index = *p_link;
+        *p_link = p_index->p_next;
+        fatfs_index_free(p_index);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to drop every index */
+void fatfs_index_clear(void)
+{
+    fatfs_dir_index_struct_t *p_index = NULL;
+    uint32_t i = 0;
+
+    for (i = 0; i < FATFS_INDEX_BUCKETS; i++)
+    {
+        while (sp_index_bucket[i] != NULL)
+        {
+            p_index = sp_index_bucket[i];
+            sp_index_bucket[i] = p_index->p_next;
+            fatfs_index_free(p_index);
+        }
+    }
+}
+
+/* Function is used to get lookup statistics */
+void fatfs_index_get_stats(fatfs_index_stats_struct_t *const p_stats)
+{
+    *p_stats = s_index_stats;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
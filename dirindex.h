@@ -0,0 +1,55 @@
+#ifndef _DIRINDEX_H_
+#define _DIRINDEX_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint64_t lookups;
+    uint64_t hits;          /* Lookups answered without reading entries */
+} fatfs_index_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Find entry in directory through its name index
+ *
+ * The index of a directory is built on first access while scanning, so a
+ * name found early leaves the rest of the directory unread until needed.
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] p_name is name to find, long or short, ignoring case
+ * @param [out] p_info is entry found
+ * @return fatfs_error_enum_t is FATFS_ENTRY_NOT_FOUND if name is not found
+ */
+fatfs_error_enum_t fatfs_index_lookup(const uint32_t first_cluster,
+                                      const uint8_t *const p_name,
+                                      fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Drop index of a directory after it is modified
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ */
+void fatfs_index_invalidate(const uint32_t first_cluster);
+
+/**
+ * @brief Drop index of every directory
+ *
+ */
+void fatfs_index_clear(void);
+
+/**
+ * @brief Get lookup statistics since start
+ *
+ * @param [out] p_stats is statistics, counters only grow
+ */
+void fatfs_index_get_stats(fatfs_index_stats_struct_t *const p_stats);
+
+#endif /* _DIRINDEX_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
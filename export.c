@@ -0,0 +1,254 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#define _GNU_SOURCE /* copy_file_range */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "export.h"
+#include "sidecar.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_EXPORT_BUFF_SIZE (1024U * 1024U)
+
+typedef enum
+{
+    FATFS_EXPORT_COPY_RANGE,
+    FATFS_EXPORT_SENDFILE,
+    FATFS_EXPORT_BUFFERED
+} fatfs_export_method_enum_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Copy a byte range of image inside the kernel
+ *
+ * @param [in] method is kernel copy method
+ * @param [in] out_fd is destination file descriptor
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes to copy
+ * @return int64_t is bytes copied, -1 if method is not supported
+ */
+static int64_t fatfs_export_kernel(const fatfs_export_method_enum_t method,
+                                   const int out_fd, uint64_t offset,
+                                   const uint64_t length);
+
+/**
+ * @brief Copy a byte range of image through a buffer
+ *
+ * @param [in] out_fd is destination file descriptor
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes to copy
+ * @param [inout] pp_buff is copy buffer, allocated on first use
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_export_buffered(const int out_fd,
+        uint64_t offset, uint64_t length, uint8_t **const pp_buff);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to copy range in kernel */
+static int64_t fatfs_export_kernel(const fatfs_export_method_enum_t method,
+                                   const int out_fd, uint64_t offset,
+                                   const uint64_t length)
+{
+    int64_t retVal = 0;
+    ssize_t bytes = 0;
+    loff_t in_offset = (loff_t)offset;
+    off_t send_offset = (off_t)offset;
+    int in_fd = kmc_get_fd();
+
+    while ((uint64_t)retVal < length)
+    {
+        if (FATFS_EXPORT_COPY_RANGE == method)
+        {
+            bytes = copy_file_range(in_fd, &in_offset, out_fd, NULL,
+                                    length - retVal, 0);
+        }
+        else
+        {
+            bytes = sendfile(out_fd, in_fd, &send_offset, length - retVal);
+        }
+        if (bytes > 0)
+        {
+            retVal += bytes;
+        }
+        else
+        {
+            /* Nothing moved yet means the method does not fit these fds */
+            retVal = (0 == retVal) ? -1 : retVal;
+            break;
+        }
+    }
+
+    return retVal;
+}
+
+/* Function is used to copy range through buffer */
+static fatfs_error_enum_t fatfs_export_buffered(const int out_fd,
+        uint64_t offset, uint64_t length, uint8_t **const pp_buff)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint32_t chunk = 0;
+    int32_t bytes = 0;
+    ssize_t written = 0;
+    uint32_t done = 0;
+
+    if (NULL == *pp_buff)
+    {
+        *pp_buff = (uint8_t *)malloc(FATFS_EXPORT_BUFF_SIZE);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    while ((length > 0) && (SUCCESS == error))
+    {
+        chunk = (length > FATFS_EXPORT_BUFF_SIZE) ? FATFS_EXPORT_BUFF_SIZE :
+                (uint32_t)length;
+        bytes = kmc_read_bytes(offset, chunk, *pp_buff);
+        if (bytes == (int32_t)chunk)
+        {
+            for (done = 0; (done < chunk) && (SUCCESS == error);
+                    done += (uint32_t)written)
+            {
+                written = write(out_fd, *pp_buff + done, chunk - done);
+                if (written <= 0)
+                {
+                    error = FATFS_WRITE_FAILED;
+                    written = 0;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            offset += chunk;
+            length -= chunk;
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to export file */
+fatfs_error_enum_t fatfs_export(const fatfs_entry_info_struct_t *const p_file,
+                                const int out_fd)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_extent_struct_t *p_chain = NULL;
+    fatfs_export_method_enum_t method = FATFS_EXPORT_SENDFILE;
+    uint8_t *p_buff = NULL;
+    uint32_t count = 0;
+    uint64_t remain = p_file->file_size;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    int64_t bytes = 0;
+    uint32_t i = 0;
+    struct stat info;
+
+    if ((0 == fstat(out_fd, &info)) && (S_ISREG(info.st_mode)))
+    {
+        method = FATFS_EXPORT_COPY_RANGE;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (kmc_get_fd() < 0)
+    {
+        method = FATFS_EXPORT_BUFFERED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((remain > 0) &&
+            (false == fatfs_sidecar_get_extents(p_file->first_cluster,
+                    &p_extents, &count)))
+    {
+        error = fatfs_get_extents(p_file->first_cluster, &p_chain, &count);
+        p_extents = p_chain;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (i < count) && (remain > 0) && (SUCCESS == error); i++)
+    {
+        offset = kmc_get_sector_offset(fatfs_cluster_to_sector(
+                                           p_extents[i].first_cluster));
+        length = (uint64_t)p_extents[i].cluster_count *
+                 p_boot->sector_per_cluster * p_boot->byte_per_sector;
+        length = (length > remain) ? remain : length;
+        remain -= length;
+        /* Fall back one method at a time until something moves data */
+        while ((method != FATFS_EXPORT_BUFFERED) && (length > 0))
+        {
+            bytes = fatfs_export_kernel(method, out_fd, offset, length);
+            if (bytes < 0)
+            {
+                method = (FATFS_EXPORT_COPY_RANGE == method) ?
+                         FATFS_EXPORT_SENDFILE : FATFS_EXPORT_BUFFERED;
+            }
+            else
+            {
+                offset += bytes;
+                length -= bytes;
+                if (length > 0)
+                {
+                    /* Short copy, finish the rest through the buffer */
+                    break;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+        }
+        if (length > 0)
+        {
+            error = fatfs_export_buffered(out_fd, offset, length, &p_buff);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if ((SUCCESS == error) && (remain > 0))
+    {
+        /* Chain is shorter than file size */
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_buff);
+    free(p_chain);
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,24 @@
+#ifndef _EXPORT_H_
+#define _EXPORT_H_
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Write content of file to a file descriptor
+ *
+ * Extents are moved by the kernel with copy_file_range or sendfile when
+ * possible, otherwise through large buffered writes.
+ *
+ * @param [in] p_file is file to export
+ * @param [in] out_fd is destination file descriptor
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_export(const fatfs_entry_info_struct_t *const p_file,
+                                const int out_fd);
+
+#endif /* _EXPORT_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
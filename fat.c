@@ -1,707 +1,1595 @@
-/*******************************************************************************
- * Includes
- ******************************************************************************/
-#include <stdio.h>
-#include <stdint.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "fat.h"
-#include "hal.h"
-
-/*******************************************************************************
- * Definitions
- ******************************************************************************/
-/* Boot sector */
-#define FATFS_BOOT_SECTOR_SIZE 512U
-#define FATFS_BOOT_SECTOR_INDEX 0U
-#define FATFS_BYTE_PER_SECTOR_OFFSET 0x0BU
-#define FATFS_BYTE_PER_SECTOR_BYTES 2U
-#define FATFS_SECTOR_PER_CLUSTER_OFFSET 0x0DU
-#define FATFS_SECTOR_PER_CLUSTER_BYTES 1U
-#define FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET 0x0EU
-#define FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES 2U
-#define FATFS_NUMBER_FAT_OFFSET 0x10U
-#define FATFS_NUMBER_FAT_BYTES 1U
-#define FATFS_NUMBER_ENTRY_RDET_OFFSET 0x11U
-#define FATFS_NUMBER_ENTRY_RDET_BYTES 2U
-#define FATFS_SECTOR_PER_FAT_OFFSET 0x16U
-#define FATFS_SECTOR_PER_FAT_BYTES 2U
-#define FATFS_ROOT_ENTRY_OFFSET 0x11U
-#define FATFS_ROOT_ENTRY_BYTES 2U
-#define FATFS_FAT_TYPE_OFFSET 0x36U
-#define FATFS_FAT_TYPE_SIZE 8U
-#define FATFS_ENTRY_SIZE 32U
-
-/* Main entry */
-#define FATFS_MAIN_ENTRY_FILE_NAME_OFFSET 0x00U
-#define FATFS_MAIN_ENTRY_FILE_NAME_BYTES 8U
-#define FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET 0x08U
-#define FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES 3U
-#define FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET 0x0BU
-#define FATFS_MAIN_ENTRY_ATTRIBUTE_BYTES 1U
-#define FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET 0x1AU
-#define FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES 2U
-#define FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET 0x1CU
-#define FATFS_MAIN_ENTRY_FILE_SIZE_BYTES 4U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET 0x16U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES 2U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_MASK 0x001FU
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_SHIFT 0U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_MASK 0x07E0U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_SHIFT 5U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_MASK 0xF800U
-#define FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_SHIFT 11U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET 0x18U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES 2U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_MASK 0x001FU
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_SHIFT 0U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_MASK 0x01E0U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_SHIFT 5U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_MASK 0xFE00U
-#define FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_SHIFT 9U
-#define FATFS_FILE_ATTRIBUTE 0x00U
-#define FATFS_SUBDIRECTORY_ATTRIBUTE 0x10U
-#define FATFS_SUBENTRY_ATTRIBUTE 0x0FU
-
-/* Sub entry */
-#define FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET 0x01U
-#define FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_BYTES 10U
-#define FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET 0x0EU
-#define FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_BYTES 12U
-#define FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET 0x1CU
-#define FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_BYTES 4U
-#define FATFS_SUB_ENTRY_DATA_BYTES 13U
-
-#define make_value_little_endian(first_byte, second_byte) \
-    ((second_byte << 8) | first_byte)
-#define make_even_element_fat(first_index, second_index) \
-    (((second_index & 0x0F) << 8) | first_index)
-#define make_odd_element_fat(first_index, second_index) \
-    ((second_index << 4) | ((first_index & 0xF0) >> 4))
-
-typedef enum
-{
-    EMPTY_ENTRY,
-    MAIN_ENTRY,
-    SUB_ENTRY
-} fatfs_entry_type_enum_t;
-
-static fatfs_boot_sector_struct_t s_boot_info = {0, 0, 0, 0};
-static fatfs_entry_info_struct_t *sp_entry_list_head = NULL;
-static fatfs_entry_info_struct_t *sp_entry_list_tail = NULL;
-static uint32_t s_end_cluster = 0;
-
-/*******************************************************************************
- * Prototypes
- ******************************************************************************/
-/**
- * @brief Decode entry
- *
- * @param [in] p_entry is entry to decode
- * @param [out] p_info is data of entry after decode
- * @param [out] p_buff is data of sub-entry
- * @return fatfs_entry_type_enum_t is type of entry
- */
-static fatfs_entry_type_enum_t fatfs_decode_entry(const uint8_t *const
-        p_entry , fatfs_entry_info_struct_t *const p_info,
-        uint8_t *const p_buff);
-
-/**
- * @brief Get next cluster
- *
- * @param [inout] next_cluster is next cluster
- * @return fatfs_error_enum_t is error code
- */
-static fatfs_error_enum_t fatfs_get_next_cluster(uint32_t *const
-        next_cluster);
-
-/**
- * @brief Inset entry to list
- *
- * @param [inout] new_entry is entry to insert
- */
-static void fatfs_insert(fatfs_entry_info_struct_t *const new_entry);
-
-/*******************************************************************************
- * Codes
- ******************************************************************************/
-/* Function is used to decode entry */
-static fatfs_entry_type_enum_t fatfs_decode_entry(const uint8_t *const
-        p_entry,
-        fatfs_entry_info_struct_t *const p_info, uint8_t *const p_buff)
-{
-    static uint8_t count = 0;
-    static uint8_t sub_entry = 0;
-    fatfs_entry_type_enum_t entry_type = EMPTY_ENTRY;
-    uint8_t i = 0;
-    uint8_t j = 0;
-    uint32_t temp = 0;
-
-    if (p_entry[0] != EMPTY_ENTRY) /* check if entry is empty */
-    {
-        if (p_entry[FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET] !=
-                FATFS_SUBENTRY_ATTRIBUTE) /* Main entry */
-        {
-            /* Parse file name */
-            if (0 == p_buff[0])
-            {
-                for (i = 0; i < FATFS_MAIN_ENTRY_FILE_NAME_BYTES; i++)
-                {
-                    p_info->file_name[i] =
-                        p_entry[FATFS_MAIN_ENTRY_FILE_NAME_OFFSET + i];
-                }
-                p_info->file_name[i] = '\0';
-            }
-            else
-            {
-                for (i = 0; i < sub_entry; i++)
-                {
-                    for (j = 0; j < FATFS_SUB_ENTRY_DATA_BYTES; j++)
-                    {
-                        p_info->file_name[i * FATFS_SUB_ENTRY_DATA_BYTES + j] =
-                            p_buff[(sub_entry - 1 - i) *
-                                   FATFS_SUB_ENTRY_DATA_BYTES +
-                                   j];
-                    }
-                }
-                p_buff[0] = '\0';
-                count = 0;
-                sub_entry = 0;
-            }
-
-            /* Parse file attribute */
-            p_info->file_attribute = p_entry[FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET];
-
-            /* Parse file extension */
-            for (i = 0; i < FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES; i++)
-            {
-                p_info->file_extension[i] =
-                    p_entry[FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET + i];
-            }
-            p_info->file_extension[i] = '\0';
-
-            /* Parse modified time */
-            temp = (uint32_t)
-                   p_entry[FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET +
-                           FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES - 1];
-            for (i = FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES - 1; i > 0; i--)
-            {
-                temp = (uint32_t)make_value_little_endian(
-                           p_entry[FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET +
-                                   i - 1], temp);
-            }
-            p_info->modified_time.second =
-                (uint8_t)(((temp &
-                            FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_MASK) >>
-                           (FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_SHIFT)) *
-                          2);
-            p_info->modified_time.minute =
-                (uint8_t)((temp &
-                           FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_MASK) >>
-                          (FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_SHIFT));
-            p_info->modified_time.hour =
-                (uint8_t)((temp &
-                           FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_MASK) >>
-                          (FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_SHIFT));
-
-            /* Parse modified date */
-            temp = (uint32_t)
-                   p_entry[FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET +
-                           FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES - 1];
-            for (i = FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET +
-                                   i - 1], temp);
-            }
-            p_info->modified_date.day =
-                (uint8_t)((temp &
-                           FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_MASK) >>
-                          (FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_SHIFT));
-            p_info->modified_date.month =
-                (uint8_t)((temp &
-                           FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_MASK) >>
-                          (FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_SHIFT));
-            p_info->modified_date.year =
-                (uint16_t)(((temp &
-                             FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_MASK) >>
-                            (FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_SHIFT)) +
-                           1980);
-
-            /* Parse file size */
-            temp = (uint32_t)
-                   p_entry[FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET +
-                           FATFS_MAIN_ENTRY_FILE_SIZE_BYTES - 1];
-            for (i = FATFS_MAIN_ENTRY_FILE_SIZE_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET +
-                                   i - 1], temp);
-            }
-            p_info->file_size = temp;
-            if (0 == (temp % (s_boot_info.byte_per_sector *
-                              s_boot_info.sector_per_cluster)))
-            {
-                temp = (uint32_t)(temp / (s_boot_info.byte_per_sector *
-                                          s_boot_info.sector_per_cluster));
-            }
-            else
-            {
-                temp = (uint32_t)((temp / (s_boot_info.byte_per_sector *
-                                           s_boot_info.sector_per_cluster)) +
-                                  1);
-            }
-
-            p_info->file_round_up_size = temp * s_boot_info.byte_per_sector *
-                                         s_boot_info.sector_per_cluster;
-
-            /* Parse first cluster */
-            temp = (uint32_t)
-                   p_entry[FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET +
-                           FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES - 1];
-            for (i = FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET +
-                                   i - 1], temp);
-            }
-            p_info->first_cluster = temp;
-
-            p_info->p_next = NULL;
-            entry_type = MAIN_ENTRY;
-        }
-        else /* Sub entry */
-        {
-            for (i = 0; i < FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_BYTES;
-                    i = i + 2)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET
-                                   + i],
-                           p_entry[FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET
-                                   + i + 1]);
-                p_buff[count++] = temp;
-            }
-            for (i = 0; i < FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_BYTES; i = i + 2)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET
-                                   + i],
-                           p_entry[FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET
-                                   + i + 1]);
-                p_buff[count++] = temp;
-            }
-            for (i = 0; i < FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_BYTES; i = i + 2)
-            {
-                temp = make_value_little_endian(
-                           p_entry[FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET
-                                   + i],
-                           p_entry[FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET
-                                   + i + 1]);
-                p_buff[count++] = temp;
-            }
-            sub_entry++;
-        }
-    }
-    else
-    {
-        entry_type = EMPTY_ENTRY;
-    }
-
-    return entry_type;
-}
-
-/* Function is used to get index of next cluster */
-static fatfs_error_enum_t fatfs_get_next_cluster(uint32_t *const
-        next_cluster)
-{
-    fatfs_error_enum_t error = SUCCESS;
-    uint8_t *p_temp = NULL;
-    uint32_t fat_element_index = 0;
-    uint32_t temp = 0;
-    uint32_t bytes = 0;
-
-    p_temp = (uint8_t *)malloc(s_boot_info.byte_per_sector * 2);
-    fat_element_index = (uint32_t)((*next_cluster * s_boot_info.fat_type / 8));
-    temp = (uint32_t)(((fat_element_index) / s_boot_info.byte_per_sector));
-    bytes = kmc_read_multi_sector(temp + s_boot_info.sector_before_fat, 2,
-                                  p_temp);
-    if (bytes == s_boot_info.byte_per_sector * 2)
-    {
-        bytes = fat_element_index - (s_boot_info.byte_per_sector * temp);
-        if (s_boot_info.fat_type == 12)
-        {
-            if (*next_cluster % 2 == 0)
-            {
-                *next_cluster = make_even_element_fat(p_temp[bytes],
-                                                      p_temp[bytes + 1]);
-            }
-            else
-            {
-                *next_cluster = make_odd_element_fat(p_temp[bytes],
-                                                     p_temp[bytes + 1]);
-            }
-        }
-        else
-        {
-            *next_cluster = make_value_little_endian(p_temp[bytes],
-                            p_temp[bytes + 1]);
-        }
-    }
-    else
-    {
-        error = FATFS_READ_SECTOR_FAILED;
-    }
-    free(p_temp);
-
-    return error;
-}
-
-/* Function is used to insert entry to list */
-static void fatfs_insert(fatfs_entry_info_struct_t *const new_entry)
-{
-    if (sp_entry_list_head == NULL)
-    {
-        sp_entry_list_head = new_entry;
-        sp_entry_list_tail = new_entry;
-    }
-    else
-    {
-        sp_entry_list_tail->p_next = new_entry;
-        sp_entry_list_tail = new_entry;
-    }
-}
-
-/* Function is used to get error message */
-uint8_t *getErrorMessage(const fatfs_error_enum_t err)
-{
-    uint8_t *errorMessage[] =
-    {
-        "Success",
-        "Initialize failed",
-        "Read sector failed"
-    };
-
-    return errorMessage[err];
-}
-
-/* Function is used to initialize FAT */
-fatfs_error_enum_t fatfs_init(const uint8_t *const file_path,
-                              fatfs_boot_sector_struct_t **const p_boot)
-{
-    fatfs_error_enum_t error = SUCCESS;
-    uint8_t boot_sector[FATFS_BOOT_SECTOR_SIZE] = {};
-    uint8_t fat_type[FATFS_FAT_TYPE_SIZE + 1];
-    uint8_t i = 0;
-    uint32_t temp = 0;
-    uint8_t number_fat = 0;
-    uint16_t sector_per_fat = 0;
-    uint16_t root_entry = 0;
-
-    if (true == kmc_init(file_path))
-    {
-        if (FATFS_BOOT_SECTOR_SIZE == kmc_read_sector(FATFS_BOOT_SECTOR_INDEX,
-                boot_sector))
-        {
-            /* Read sector before fat */
-            temp = (uint32_t)
-                   boot_sector[FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET +
-                               FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES - 1];
-            for (i = FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET +
-                                       i - 1], temp);
-            }
-            s_boot_info.sector_before_fat = (uint16_t)temp;
-
-            /* Read byte per sector */
-            temp = (uint32_t)
-                   boot_sector[FATFS_BYTE_PER_SECTOR_OFFSET +
-                               FATFS_BYTE_PER_SECTOR_BYTES - 1];
-            for (i = FATFS_BYTE_PER_SECTOR_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_BYTE_PER_SECTOR_OFFSET +
-                                       i - 1], temp);
-            }
-            s_boot_info.byte_per_sector = (uint16_t)temp;
-
-            /* Read number FAT */
-            temp = (uint32_t)
-                   boot_sector[FATFS_NUMBER_FAT_OFFSET +
-                               FATFS_NUMBER_FAT_BYTES - 1];
-            for (i = FATFS_NUMBER_FAT_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_NUMBER_FAT_OFFSET + i - 1], temp);
-            }
-            number_fat = (uint8_t)temp;
-
-            /* Read sector per FAT */
-            temp = (uint32_t)
-                   boot_sector[FATFS_SECTOR_PER_FAT_OFFSET +
-                               FATFS_SECTOR_PER_FAT_BYTES - 1];
-            for (i = FATFS_SECTOR_PER_FAT_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_SECTOR_PER_FAT_OFFSET +
-                                       i - 1], temp);
-            }
-            sector_per_fat = (uint16_t)temp;
-
-            /* Read root directory index */
-            temp = s_boot_info.sector_before_fat + sector_per_fat *
-                   (uint16_t)number_fat;
-            s_boot_info.root_directory_index = temp;
-
-            /* Read root entry */
-            temp = (uint32_t)
-                   boot_sector[FATFS_ROOT_ENTRY_OFFSET +
-                               FATFS_ROOT_ENTRY_BYTES - 1];
-            for (i = FATFS_ROOT_ENTRY_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_ROOT_ENTRY_OFFSET + i - 1], temp);
-            }
-            root_entry = (uint16_t)temp;
-
-            /* Read sector per cluster */
-            temp = (uint32_t)
-                   boot_sector[FATFS_SECTOR_PER_CLUSTER_OFFSET +
-                               FATFS_SECTOR_PER_CLUSTER_BYTES - 1];
-            for (i = FATFS_SECTOR_PER_CLUSTER_BYTES - 1; i > 0; i--)
-            {
-                temp = make_value_little_endian(
-                           boot_sector[FATFS_SECTOR_PER_CLUSTER_OFFSET +
-                                       i - 1], temp);
-            }
-            s_boot_info.sector_per_cluster = (uint8_t)temp;
-
-            /* Read data index */
-            temp = (uint32_t)(root_entry * FATFS_ENTRY_SIZE /
-                              s_boot_info.byte_per_sector);
-            s_boot_info.data_index =
-                (uint32_t)(s_boot_info.root_directory_index +
-                           temp);
-
-            /* Read fat type */
-            for (i = 0; i < FATFS_FAT_TYPE_SIZE; i++)
-            {
-                fat_type[i] = boot_sector[FATFS_FAT_TYPE_OFFSET + i];
-            }
-            fat_type[i] = '\0';
-            if (fat_type[4] == '2')
-            {
-                s_boot_info.fat_type = 12;
-                s_end_cluster = 0xFFF;
-            }
-            else if (fat_type[4] == '6')
-            {
-                s_boot_info.fat_type = 16;
-                s_end_cluster = 0xFFFF;
-            }
-            else
-            {
-                s_boot_info.fat_type = 32;
-            }
-        }
-        else
-        {
-            error = FATFS_READ_SECTOR_FAILED;
-        }
-    }
-    else
-    {
-        error = FATFS_INITIALIZE_FAILED;
-    }
-    kmc_update_sector_size(s_boot_info.byte_per_sector);
-    *p_boot = &s_boot_info;
-
-    return error;
-}
-
-/* Function is used to read directory */
-fatfs_error_enum_t fatfs_read_directory(const uint32_t first_cluster,
-                   fatfs_entry_info_struct_t **const p_list)
-{
-    fatfs_error_enum_t error = SUCCESS;
-    uint32_t bytes = 0;
-    uint32_t i = 0;
-    uint8_t j = 0;
-    uint32_t next_cluster = first_cluster;
-    fatfs_entry_info_struct_t *p_entry_info = NULL;
-    uint8_t *p_buff = NULL;
-    fatfs_entry_type_enum_t entry_type = 0;
-    uint8_t *p_name = NULL;
-
-    free(sp_entry_list_head);
-    sp_entry_list_head = NULL;
-    sp_entry_list_tail = NULL;
-    if (0 == first_cluster) /* Read root directory */
-    {
-        p_buff = malloc(
-               (s_boot_info.data_index - s_boot_info.root_directory_index) *
-                     s_boot_info.byte_per_sector);
-        bytes = kmc_read_multi_sector(s_boot_info.root_directory_index,
-        (s_boot_info.data_index - s_boot_info.root_directory_index), p_buff);
-        if (bytes ==
-                (s_boot_info.data_index - s_boot_info.root_directory_index) *
-                s_boot_info.byte_per_sector)
-        {
-            p_entry_info = (fatfs_entry_info_struct_t *)malloc(sizeof(
-                               fatfs_entry_info_struct_t));
-            p_name = (uint8_t *)malloc(256);
-            p_name[0] = '\0';
-            for (i = 0; i < bytes / FATFS_ENTRY_SIZE; i++)
-            {
-                entry_type = fatfs_decode_entry(p_buff + i * FATFS_ENTRY_SIZE,
-                                                p_entry_info, p_name);
-                if (entry_type == MAIN_ENTRY)
-                {
-                    if ((p_entry_info->file_attribute == 0x00) ||
-                            (p_entry_info->file_attribute == 0x10) ||
-                            (p_entry_info->file_attribute == 0x20))
-                    {
-                        fatfs_insert(p_entry_info);
-                        p_entry_info =
-                            (fatfs_entry_info_struct_t *)malloc(sizeof(
-                                    fatfs_entry_info_struct_t));
-                    }
-                }
-            }
-            free(p_entry_info);
-            free(p_name);
-            free(p_buff);
-        }
-        else
-        {
-            error = FATFS_READ_SECTOR_FAILED;
-        }
-    }
-    else
-    {
-        p_buff = malloc(s_boot_info.byte_per_sector *
-                        s_boot_info.sector_per_cluster);
-        while (next_cluster != s_end_cluster)
-        {
-            bytes = kmc_read_multi_sector((next_cluster - 2) *
-                                          s_boot_info.sector_per_cluster +
-                                          s_boot_info.data_index,
-                                          s_boot_info.sector_per_cluster,
-                                          p_buff);
-            if (bytes == s_boot_info.sector_per_cluster *
-                    s_boot_info.byte_per_sector)
-            {
-                p_entry_info = (fatfs_entry_info_struct_t *)malloc(sizeof(
-                                   fatfs_entry_info_struct_t));
-                p_name = (uint8_t *)malloc(256);
-                p_name[0] = '\0';
-                for (i = 0; i < bytes / FATFS_ENTRY_SIZE; i++)
-                {
-                    entry_type = fatfs_decode_entry(p_buff +
-                                                    i * FATFS_ENTRY_SIZE,
-                                                    p_entry_info, p_name);
-                    if (entry_type == MAIN_ENTRY)
-                    {
-
-                        if ((p_entry_info->file_attribute == 0x00) ||
-                                (p_entry_info->file_attribute == 0x10) ||
-                                (p_entry_info->file_attribute == 0x20))
-                        {
-                            if (strcmp(p_entry_info->file_name, ".       ")
-                                    != 0)
-                            {
-                                fatfs_insert(p_entry_info);
-                                p_entry_info =
-                                    (fatfs_entry_info_struct_t *)malloc(sizeof(
-                                            fatfs_entry_info_struct_t));
-                            }
-                            else
-                            {
-                                /* Do nothing */
-                            }
-                        }
-                        else
-                        {
-                            /* Do nothing */
-                        }
-                    }
-                }
-                free(p_entry_info);
-                free(p_name);
-                error = fatfs_get_next_cluster(&next_cluster);
-                if (error != SUCCESS)
-                {
-                    next_cluster = s_end_cluster;
-                }
-                else
-                {
-                    /* Do nothing */
-                }
-            }
-            else
-            {
-                error = FATFS_READ_SECTOR_FAILED;
-            }
-        }
-        free(p_buff);
-    }
-    *p_list = sp_entry_list_head;
-
-    return error;
-}
-
-/* Function is used to read file */
-fatfs_error_enum_t fatfs_read_file(uint32_t first_cluster, uint8_t *p_buff)
-{
-    fatfs_error_enum_t error = SUCCESS;
-    uint32_t next_cluster = first_cluster;
-    uint32_t bytes = 0;
-    uint16_t i = 0;
-    uint32_t fat_element_index = 0;
-    uint32_t temp = 0;
-    uint16_t j = 0;
-
-    while (next_cluster != s_end_cluster)
-    {
-        temp = s_boot_info.byte_per_sector * s_boot_info.sector_per_cluster;
-        bytes = kmc_read_multi_sector((next_cluster - 2) *
-                                      s_boot_info.sector_per_cluster +
-                                      s_boot_info.data_index,
-                                      s_boot_info.sector_per_cluster,
-                                      &p_buff[temp * i]);
-        if (bytes == s_boot_info.sector_per_cluster *
-                s_boot_info.byte_per_sector)
-        {
-            i++;
-            error = fatfs_get_next_cluster(&next_cluster);
-            if (error != SUCCESS)
-            {
-                next_cluster = s_end_cluster;
-            }
-            else
-            {
-                /* Do nothing */
-            }
-        }
-        else
-        {
-            error = FATFS_READ_SECTOR_FAILED;
-        }
-    }
-
-    return error;
-}
-
-/* Function is used to de-initialize FAT */
-void fatfs_deinit(void)
-{
-    kmc_deinit();
-}
-
-/*******************************************************************************
- * EOF
- ******************************************************************************/
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "dirindex.h"
+#include "sidecar.h"
+#include "revmap.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+/* Boot sector */
+#define FATFS_BOOT_SECTOR_SIZE 512U
+#define FATFS_BOOT_SECTOR_INDEX 0U
+#define FATFS_BYTE_PER_SECTOR_OFFSET 0x0BU
+#define FATFS_BYTE_PER_SECTOR_BYTES 2U
+#define FATFS_SECTOR_PER_CLUSTER_OFFSET 0x0DU
+#define FATFS_SECTOR_PER_CLUSTER_BYTES 1U
+#define FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET 0x0EU
+#define FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES 2U
+#define FATFS_NUMBER_FAT_OFFSET 0x10U
+#define FATFS_NUMBER_FAT_BYTES 1U
+#define FATFS_NUMBER_ENTRY_RDET_OFFSET 0x11U
+#define FATFS_NUMBER_ENTRY_RDET_BYTES 2U
+#define FATFS_SECTOR_PER_FAT_OFFSET 0x16U
+#define FATFS_SECTOR_PER_FAT_BYTES 2U
+#define FATFS_ROOT_ENTRY_OFFSET 0x11U
+#define FATFS_ROOT_ENTRY_BYTES 2U
+#define FATFS_TOTAL_SECTOR_16_OFFSET 0x13U
+#define FATFS_TOTAL_SECTOR_16_BYTES 2U
+#define FATFS_TOTAL_SECTOR_32_OFFSET 0x20U
+#define FATFS_TOTAL_SECTOR_32_BYTES 4U
+#define FATFS_FAT_TYPE_OFFSET 0x36U
+#define FATFS_FAT_TYPE_SIZE 8U
+#define FATFS_ENTRY_SIZE 32U
+
+/* Main entry */
+#define FATFS_MAIN_ENTRY_FILE_NAME_OFFSET 0x00U
+#define FATFS_MAIN_ENTRY_FILE_NAME_BYTES 8U
+#define FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET 0x08U
+#define FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES 3U
+#define FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET 0x0BU
+#define FATFS_MAIN_ENTRY_ATTRIBUTE_BYTES 1U
+#define FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET 0x1AU
+#define FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES 2U
+#define FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET 0x1CU
+#define FATFS_MAIN_ENTRY_FILE_SIZE_BYTES 4U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET 0x16U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES 2U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_MASK 0x001FU
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_SHIFT 0U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_MASK 0x07E0U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_SHIFT 5U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_MASK 0xF800U
+#define FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_SHIFT 11U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET 0x18U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES 2U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_MASK 0x001FU
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_SHIFT 0U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_MASK 0x01E0U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_SHIFT 5U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_MASK 0xFE00U
+#define FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_SHIFT 9U
+#define FATFS_FILE_ATTRIBUTE 0x00U
+#define FATFS_SUBDIRECTORY_ATTRIBUTE 0x10U
+#define FATFS_SUBENTRY_ATTRIBUTE 0x0FU
+#define FATFS_VOLUME_ATTRIBUTE 0x08U
+#define FATFS_DELETED_ENTRY 0xE5U
+
+/* Sub entry */
+#define FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET 0x01U
+#define FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_BYTES 10U
+#define FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET 0x0EU
+#define FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_BYTES 12U
+#define FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET 0x1CU
+#define FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_BYTES 4U
+#define FATFS_SUB_ENTRY_DATA_BYTES 13U
+#define FATFS_SUB_ENTRY_LAST_FLAG 0x40U
+#define FATFS_SUB_ENTRY_CHECKSUM_OFFSET 0x0DU
+
+#define make_value_little_endian(first_byte, second_byte) \
+    ((second_byte << 8) | first_byte)
+#define make_even_element_fat(first_index, second_index) \
+    (((second_index & 0x0F) << 8) | first_index)
+#define make_odd_element_fat(first_index, second_index) \
+    ((second_index << 4) | ((first_index & 0xF0) >> 4))
+
+typedef enum
+{
+    EMPTY_ENTRY,
+    MAIN_ENTRY,
+    SUB_ENTRY,
+    DELETED_ENTRY
+} fatfs_entry_type_enum_t;
+
+typedef struct
+{
+    fatfs_dir_struct_t *p_dir;
+    uint32_t first_cluster;
+    uint32_t path_length;       /* Length of directory path in walk buffer */
+} fatfs_walk_level_struct_t;
+
+static fatfs_boot_sector_struct_t s_boot_info = {0, 0, 0, 0};
+static fatfs_entry_info_struct_t *sp_entry_list_head = NULL;
+static fatfs_entry_info_struct_t *sp_entry_list_tail = NULL;
+static uint32_t s_end_cluster = 0;
+static uint8_t *sp_fat = NULL;
+static uint32_t s_fat_bytes = 0;
+static uint8_t *sp_fat_preload = NULL;
+static uint32_t s_fat_preload_bytes = 0;
+static uint32_t s_fat_dirty_start = 0;
+static uint32_t s_fat_dirty_end = 0;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Decode entry
+ *
+ * @param [in] p_entry is entry to decode
+ * @param [out] p_info is data of entry after decode
+ * @param [inout] p_buff is data of sub-entry
+ * @param [inout] p_sub_entry is number of sub-entry in p_buff
+ * @param [inout] p_checksum is short name checksum of sub-entries in p_buff
+ * @return fatfs_entry_type_enum_t is type of entry
+ */
+static fatfs_entry_type_enum_t fatfs_decode_entry(const uint8_t *const
+        p_entry , fatfs_entry_info_struct_t *const p_info,
+        uint8_t *const p_buff, uint8_t *const p_sub_entry,
+        uint8_t *const p_checksum);
+
+/**
+ * @brief Inset entry to list
+ *
+ * @param [inout] new_entry is entry to insert
+ */
+static void fatfs_insert(fatfs_entry_info_struct_t *const new_entry);
+
+/**
+ * @brief Free entry list
+ *
+ */
+static void fatfs_free_list(void);
+
+/**
+ * @brief Load first FAT into memory
+ *
+ */
+static void fatfs_load_fat(void);
+
+/**
+ * @brief Step along chain
+ *
+ * @param [in] cluster is cluster index
+ * @return uint32_t is next cluster, 0 if chain ends or is broken
+ */
+static uint32_t fatfs_chain_step(const uint32_t cluster);
+
+/**
+ * @brief Count clusters of chain before it ends or comes back
+ *
+ * @param [in] first_cluster is first cluster of chain
+ * @return uint32_t is number of distinct clusters, at least 1
+ */
+static uint32_t fatfs_chain_length(const uint32_t first_cluster);
+
+/**
+ * @brief Load next cluster of directory into iterator
+ *
+ * @param [inout] p_dir is directory iterator
+ * @return fatfs_error_enum_t is FATFS_END_OF_DIRECTORY if no cluster left
+ */
+static fatfs_error_enum_t fatfs_dir_load(fatfs_dir_struct_t *const p_dir);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to decode entry */
+static fatfs_entry_type_enum_t fatfs_decode_entry(const uint8_t *const
+        p_entry,
+        fatfs_entry_info_struct_t *const p_info, uint8_t *const p_buff,
+        uint8_t *const p_sub_entry, uint8_t *const p_checksum)
+{
+    fatfs_entry_type_enum_t entry_type = EMPTY_ENTRY;
+    uint8_t i = 0;
+    uint8_t j = 0;
+    uint32_t temp = 0;
+    uint16_t count = 0;
+    bool orphan = false;
+
+    if (FATFS_DELETED_ENTRY == p_entry[0])
+    {
+        /* Sub entries in front of a deleted entry belong to nothing */
+        *p_sub_entry = 0;
+        entry_type = DELETED_ENTRY;
+    }
+    else if (p_entry[0] != EMPTY_ENTRY) /* check if entry is empty */
+    {
+        if (p_entry[FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET] !=
+                FATFS_SUBENTRY_ATTRIBUTE) /* Main entry */
+        {
+            /* Long name of another short name is an orphan, drop it */
+            if ((*p_sub_entry > 0) &&
+                    (*p_checksum != fatfs_short_name_checksum(p_entry)))
+            {
+                *p_sub_entry = 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+
+            /* Parse short name */
+            for (i = 0; i < FATFS_MAIN_ENTRY_FILE_NAME_BYTES; i++)
+            {
+                if (p_entry[FATFS_MAIN_ENTRY_FILE_NAME_OFFSET + i] != ' ')
+                {
+                    p_info->short_name[count++] =
+                        p_entry[FATFS_MAIN_ENTRY_FILE_NAME_OFFSET + i];
+                }
+            }
+            if (p_entry[FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET] != ' ')
+            {
+                p_info->short_name[count++] = '.';
+                for (i = 0; i < FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES; i++)
+                {
+                    if (p_entry[FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET + i] !=
+                            ' ')
+                    {
+                        p_info->short_name[count++] =
+                            p_entry[FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET +
+                                    i];
+                    }
+                }
+            }
+            p_info->short_name[count] = '\0';
+
+            /* Parse file name */
+            if (0 == *p_sub_entry)
+            {
+                for (i = 0; i < FATFS_MAIN_ENTRY_FILE_NAME_BYTES; i++)
+                {
+                    p_info->file_name[i] =
+                        p_entry[FATFS_MAIN_ENTRY_FILE_NAME_OFFSET + i];
+                }
+                p_info->file_name[i] = '\0';
+            }
+            else
+            {
+                count = 0;
+                for (i = 0; i < *p_sub_entry; i++)
+                {
+                    for (j = 0; j < FATFS_SUB_ENTRY_DATA_BYTES; j++)
+                    {
+                        if (count < FATFS_FILE_NAME_SIZE - 1)
+                        {
+                            p_info->file_name[count++] =
+                                p_buff[(*p_sub_entry - 1 - i) *
+                                       FATFS_SUB_ENTRY_DATA_BYTES + j];
+                        }
+                    }
+                }
+                /* Name filling every sub entry has no terminator */
+                p_info->file_name[count] = '\0';
+                *p_sub_entry = 0;
+            }
+
+            /* Parse file attribute */
+            p_info->file_attribute = p_entry[FATFS_MAIN_ENTRY_ATTRIBUTE_OFFSET];
+
+            /* Parse file extension */
+            for (i = 0; i < FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES; i++)
+            {
+                p_info->file_extension[i] =
+                    p_entry[FATFS_MAIN_ENTRY_FILE_EXTENSION_OFFSET + i];
+            }
+            p_info->file_extension[i] = '\0';
+
+            /* Parse modified time */
+            temp = (uint32_t)
+                   p_entry[FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET +
+                           FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES - 1];
+            for (i = FATFS_MAIN_ENTRY_MODIFIED_TIME_BYTES - 1; i > 0; i--)
+            {
+                temp = (uint32_t)make_value_little_endian(
+                           p_entry[FATFS_MAIN_ENTRY_MODIFIED_TIME_OFFSET +
+                                   i - 1], temp);
+            }
+            p_info->modified_time.second =
+                (uint8_t)(((temp &
+                            FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_MASK) >>
+                           (FATFS_MAIN_ENTRY_MODIFIED_TIME_SECOND_SHIFT)) *
+                          2);
+            p_info->modified_time.minute =
+                (uint8_t)((temp &
+                           FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_MASK) >>
+                          (FATFS_MAIN_ENTRY_MODIFIED_TIME_MINUTE_SHIFT));
+            p_info->modified_time.hour =
+                (uint8_t)((temp &
+                           FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_MASK) >>
+                          (FATFS_MAIN_ENTRY_MODIFIED_TIME_HOUR_SHIFT));
+
+            /* Parse modified date */
+            temp = (uint32_t)
+                   p_entry[FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET +
+                           FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES - 1];
+            for (i = FATFS_MAIN_ENTRY_MODIFIED_DATE_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           p_entry[FATFS_MAIN_ENTRY_MODIFIED_DATE_OFFSET +
+                                   i - 1], temp);
+            }
+            p_info->modified_date.day =
+                (uint8_t)((temp &
+                           FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_MASK) >>
+                          (FATFS_MAIN_ENTRY_MODIFIED_DATE_DAY_SHIFT));
+            p_info->modified_date.month =
+                (uint8_t)((temp &
+                           FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_MASK) >>
+                          (FATFS_MAIN_ENTRY_MODIFIED_DATE_MONTH_SHIFT));
+            p_info->modified_date.year =
+                (uint16_t)(((temp &
+                             FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_MASK) >>
+                            (FATFS_MAIN_ENTRY_MODIFIED_DATE_YEAR_SHIFT)) +
+                           1980);
+
+            /* Parse file size */
+            temp = (uint32_t)
+                   p_entry[FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET +
+                           FATFS_MAIN_ENTRY_FILE_SIZE_BYTES - 1];
+            for (i = FATFS_MAIN_ENTRY_FILE_SIZE_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           p_entry[FATFS_MAIN_ENTRY_FILE_SIZE_OFFSET +
+                                   i - 1], temp);
+            }
+            p_info->file_size = temp;
+            if (0 == (temp % (s_boot_info.byte_per_sector *
+                              s_boot_info.sector_per_cluster)))
+            {
+                temp = (uint32_t)(temp / (s_boot_info.byte_per_sector *
+                                          s_boot_info.sector_per_cluster));
+            }
+            else
+            {
+                temp = (uint32_t)((temp / (s_boot_info.byte_per_sector *
+                                           s_boot_info.sector_per_cluster)) +
+                                  1);
+            }
+
+            p_info->file_round_up_size = temp * s_boot_info.byte_per_sector *
+                                         s_boot_info.sector_per_cluster;
+
+            /* Parse first cluster */
+            temp = (uint32_t)
+                   p_entry[FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET +
+                           FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES - 1];
+            for (i = FATFS_MAIN_ENTRY_FIRST_CLUSTER_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           p_entry[FATFS_MAIN_ENTRY_FIRST_CLUSTER_OFFSET +
+                                   i - 1], temp);
+            }
+            p_info->first_cluster = temp;
+
+            p_info->p_next = NULL;
+            entry_type = MAIN_ENTRY;
+        }
+        else /* Sub entry */
+        {
+            /* Last part of a name comes first, others must follow it */
+            if (0 != (p_entry[0] & FATFS_SUB_ENTRY_LAST_FLAG))
+            {
+                *p_sub_entry = 0;
+                *p_checksum = p_entry[FATFS_SUB_ENTRY_CHECKSUM_OFFSET];
+            }
+            else if ((0 == *p_sub_entry) || (*p_checksum !=
+                     p_entry[FATFS_SUB_ENTRY_CHECKSUM_OFFSET]))
+            {
+                orphan = true;
+                *p_sub_entry = 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((false == orphan) && (*p_sub_entry < FATFS_SUB_ENTRY_MAX))
+            {
+                count = *p_sub_entry * FATFS_SUB_ENTRY_DATA_BYTES;
+                for (i = 0; i < FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_BYTES;
+                        i = i + 2)
+                {
+                    temp = make_value_little_endian(
+                               p_entry[FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET
+                                       + i],
+                               p_entry[FATFS_SUB_ENTRY_FIRST_FIVE_CHARACTER_OFFSET
+                                       + i + 1]);
+                    p_buff[count++] = temp;
+                }
+                for (i = 0; i < FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_BYTES;
+                        i = i + 2)
+                {
+                    temp = make_value_little_endian(
+                               p_entry[FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET
+                                       + i],
+                               p_entry[FATFS_SUB_ENTRY_NEXT_SIX_CHARACTER_OFFSET
+                                       + i + 1]);
+                    p_buff[count++] = temp;
+                }
+                for (i = 0; i < FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_BYTES;
+                        i = i + 2)
+                {
+                    temp = make_value_little_endian(
+                               p_entry[FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET
+                                       + i],
+                               p_entry[FATFS_SUB_ENTRY_NEXT_TWO_CHARACTER_OFFSET
+                                       + i + 1]);
+                    p_buff[count++] = temp;
+                }
+                (*p_sub_entry)++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            entry_type = SUB_ENTRY;
+        }
+    }
+    else
+    {
+        entry_type = EMPTY_ENTRY;
+    }
+
+    return entry_type;
+}
+
+/* Function is used to get index of next cluster */
+fatfs_error_enum_t fatfs_get_next_cluster(uint32_t *const next_cluster)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint8_t *p_temp = NULL;
+    uint32_t fat_element_index = 0;
+    uint32_t temp = 0;
+    uint32_t bytes = 0;
+
+    fat_element_index = (uint32_t)((*next_cluster * s_boot_info.fat_type / 8));
+    if ((sp_fat != NULL) && (fat_element_index + 1 < s_fat_bytes))
+    {
+        /* Whole FAT is in memory, no sector read needed */
+        p_temp = sp_fat;
+        bytes = fat_element_index;
+    }
+    else
+    {
+        p_temp = (uint8_t *)malloc(s_boot_info.byte_per_sector * 2);
+        temp = (uint32_t)(((fat_element_index) / s_boot_info.byte_per_sector));
+        bytes = kmc_read_multi_sector(temp + s_boot_info.sector_before_fat, 2,
+                                      p_temp);
+        if (bytes == s_boot_info.byte_per_sector * 2)
+        {
+            bytes = fat_element_index - (s_boot_info.byte_per_sector * temp);
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+    if (SUCCESS == error)
+    {
+        if (s_boot_info.fat_type == 12)
+        {
+            if (*next_cluster % 2 == 0)
+            {
+                *next_cluster = make_even_element_fat(p_temp[bytes],
+                                                      p_temp[bytes + 1]);
+            }
+            else
+            {
+                *next_cluster = make_odd_element_fat(p_temp[bytes],
+                                                     p_temp[bytes + 1]);
+            }
+        }
+        else
+        {
+            *next_cluster = make_value_little_endian(p_temp[bytes],
+                            p_temp[bytes + 1]);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_temp != sp_fat)
+    {
+        free(p_temp);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to load FAT into memory */
+static void fatfs_load_fat(void)
+{
+    uint32_t bytes = 0;
+
+    free(sp_fat);
+    s_fat_bytes = s_boot_info.sector_per_fat * s_boot_info.byte_per_sector;
+    if ((sp_fat_preload != NULL) && (s_fat_preload_bytes == s_fat_bytes))
+    {
+        /* FAT kept by caller from an earlier mount, no read needed */
+        sp_fat = sp_fat_preload;
+        sp_fat_preload = NULL;
+        bytes = s_fat_bytes;
+    }
+    else
+    {
+        sp_fat = (uint8_t *)malloc(s_fat_bytes);
+        if (sp_fat != NULL)
+        {
+            bytes = kmc_read_multi_sector(s_boot_info.sector_before_fat,
+                                          s_boot_info.sector_per_fat, sp_fat);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    free(sp_fat_preload);
+    sp_fat_preload = NULL;
+    if (bytes != s_fat_bytes)
+    {
+        /* Fall back to reading FAT sectors on demand */
+        free(sp_fat);
+        sp_fat = NULL;
+        s_fat_bytes = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to insert entry to list */
+static void fatfs_insert(fatfs_entry_info_struct_t *const new_entry)
+{
+    if (sp_entry_list_head == NULL)
+    {
+        sp_entry_list_head = new_entry;
+        sp_entry_list_tail = new_entry;
+    }
+    else
+    {
+        sp_entry_list_tail->p_next = new_entry;
+        sp_entry_list_tail = new_entry;
+    }
+}
+
+/* Function is used to free entry list */
+static void fatfs_free_list(void)
+{
+    fatfs_entry_info_struct_t *p_temp = NULL;
+
+    while (sp_entry_list_head != NULL)
+    {
+        p_temp = sp_entry_list_head->p_next;
+        free(sp_entry_list_head);
+        sp_entry_list_head = p_temp;
+    }
+    sp_entry_list_tail = NULL;
+}
+
+/* Function is used to check end of chain */
+bool fatfs_is_end_cluster(const uint32_t cluster)
+{
+    /* 0xFF8-0xFFF (FAT12) and 0xFFF8-0xFFFF (FAT16) all mark end of chain */
+    return ((cluster < 2) || (cluster >= (s_end_cluster & ~0x07U)));
+}
+
+/* Function is used to step along chain */
+static uint32_t fatfs_chain_step(const uint32_t cluster)
+{
+    uint32_t next = cluster;
+
+    if ((cluster < 2) || (cluster >= s_boot_info.cluster_count + 2) ||
+            (fatfs_get_next_cluster(&next) != SUCCESS) ||
+            (true == fatfs_is_end_cluster(next)) || (next < 2) ||
+            (next >= s_boot_info.cluster_count + 2))
+    {
+        next = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return next;
+}
+
+/* Function is used to count clusters of chain before it ends or repeats */
+static uint32_t fatfs_chain_length(const uint32_t first_cluster)
+{
+    uint32_t tortoise = first_cluster;
+    uint32_t hare = fatfs_chain_step(first_cluster);
+    uint32_t power = 1;
+    uint32_t loop = 1;
+    uint32_t length = 1;
+    uint32_t i = 0;
+
+    /* Brent's cycle detection, steps bounded by chain length, no memory */
+    while ((hare != 0) && (hare != tortoise))
+    {
+        if (power == loop)
+        {
+            tortoise = hare;
+            power *= 2;
+            loop = 0;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        hare = fatfs_chain_step(hare);
+        loop++;
+        length++;
+    }
+    if (hare != 0)
+    {
+        /* Chain loops over 'loop' clusters, find where loop starts */
+        tortoise = first_cluster;
+        hare = first_cluster;
+        for (i = 0; i < loop; i++)
+        {
+            hare = fatfs_chain_step(hare);
+        }
+        for (length = loop; tortoise != hare; length++)
+        {
+            tortoise = fatfs_chain_step(tortoise);
+            hare = fatfs_chain_step(hare);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return length;
+}
+
+/* Function is used to load next cluster of directory */
+static fatfs_error_enum_t fatfs_dir_load(fatfs_dir_struct_t *const p_dir)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint32_t num = s_boot_info.sector_per_cluster;
+    uint32_t bytes = 0;
+
+    if (0 == p_dir->first_cluster) /* Root directory region */
+    {
+        if (p_dir->next_sector >= s_boot_info.data_index)
+        {
+            error = FATFS_END_OF_DIRECTORY;
+        }
+        else
+        {
+            if (p_dir->next_sector + num > s_boot_info.data_index)
+            {
+                num = s_boot_info.data_index - p_dir->next_sector;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            bytes = kmc_read_multi_sector(p_dir->next_sector, num,
+                                          p_dir->p_buff);
+            p_dir->next_sector += num;
+        }
+    }
+    else
+    {
+        if (0 == p_dir->current_cluster)
+        {
+            p_dir->current_cluster = p_dir->first_cluster;
+            /* Chain is cut where it comes back, a loop repeats no entry */
+            p_dir->cluster_left = fatfs_chain_length(p_dir->first_cluster) - 1;
+        }
+        else if (p_dir->cluster_left > 0)
+        {
+            p_dir->cluster_left--;
+            error = fatfs_get_next_cluster(&p_dir->current_cluster);
+        }
+        else
+        {
+            error = FATFS_END_OF_DIRECTORY;
+        }
+        if ((SUCCESS == error) &&
+                (true == fatfs_is_end_cluster(p_dir->current_cluster)))
+        {
+            error = FATFS_END_OF_DIRECTORY;
+        }
+        else if (SUCCESS == error)
+        {
+            bytes = kmc_read_multi_sector((p_dir->current_cluster - 2) *
+                                          s_boot_info.sector_per_cluster +
+                                          s_boot_info.data_index,
+                                          num, p_dir->p_buff);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if (SUCCESS == error)
+    {
+        if (bytes == num * s_boot_info.byte_per_sector)
+        {
+            p_dir->buff_bytes = bytes;
+            p_dir->position = 0;
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to get boot sector */
+const fatfs_boot_sector_struct_t *fatfs_get_boot_sector(void)
+{
+    return &s_boot_info;
+}
+
+/* Function is used to get first sector of cluster */
+uint32_t fatfs_cluster_to_sector(const uint32_t cluster)
+{
+    return (cluster - 2) * s_boot_info.sector_per_cluster +
+           s_boot_info.data_index;
+}
+
+/* Function is used to get FAT in memory */
+const uint8_t *fatfs_get_fat(uint32_t *const p_size)
+{
+    *p_size = s_fat_bytes;
+
+    return sp_fat;
+}
+
+/* Function is used to take FAT out of volume */
+uint8_t *fatfs_detach_fat(uint32_t *const p_size)
+{
+    uint8_t *p_fat = sp_fat;
+
+    *p_size = s_fat_bytes;
+    sp_fat = NULL;
+    s_fat_bytes = 0;
+
+    return p_fat;
+}
+
+/* Function is used to give FAT for next initialize */
+void fatfs_preload_fat(uint8_t *const p_fat, const uint32_t size)
+{
+    free(sp_fat_preload);
+    sp_fat_preload = p_fat;
+    s_fat_preload_bytes = size;
+}
+
+/* Function is used to get name of entry */
+const uint8_t *fatfs_get_entry_name(const fatfs_entry_info_struct_t
+                                    *const p_info)
+{
+    const uint8_t *p_name = p_info->file_name;
+    uint32_t i = 0;
+    bool short_entry = (FATFS_MAIN_ENTRY_FILE_NAME_BYTES ==
+                        strlen(p_info->file_name));
+
+    /* Entry without long name keeps padded 8-byte base in file_name */
+    for (i = 0; (i < FATFS_MAIN_ENTRY_FILE_NAME_BYTES) && (true == short_entry);
+            i++)
+    {
+        if ((p_info->short_name[i] != '\0') && (p_info->short_name[i] != '.'))
+        {
+            short_entry = (p_info->file_name[i] == p_info->short_name[i]);
+        }
+        else
+        {
+            short_entry = (' ' == p_info->file_name[i]);
+            break;
+        }
+    }
+    if (true == short_entry)
+    {
+        p_name = p_info->short_name;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_name;
+}
+
+/* Function is used to set next cluster of chain */
+fatfs_error_enum_t fatfs_set_next_cluster(const uint32_t cluster,
+        const uint32_t next)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint32_t index = (uint32_t)(cluster * s_boot_info.fat_type / 8);
+
+    if ((NULL == sp_fat) || (index + 1 >= s_fat_bytes) || (cluster < 2))
+    {
+        error = FATFS_WRITE_FAILED;
+    }
+    else
+    {
+        if (12 == s_boot_info.fat_type)
+        {
+            if (cluster % 2 == 0)
+            {
+                sp_fat[index] = (uint8_t)next;
+                sp_fat[index + 1] = (uint8_t)((sp_fat[index + 1] & 0xF0) |
+                                              ((next >> 8) & 0x0F));
+            }
+            else
+            {
+                sp_fat[index] = (uint8_t)((sp_fat[index] & 0x0F) |
+                                          ((next << 4) & 0xF0));
+                sp_fat[index + 1] = (uint8_t)(next >> 4);
+            }
+        }
+        else
+        {
+            sp_fat[index] = (uint8_t)next;
+            sp_fat[index + 1] = (uint8_t)(next >> 8);
+        }
+        if (s_fat_dirty_start == s_fat_dirty_end)
+        {
+            s_fat_dirty_start = index;
+            s_fat_dirty_end = index + 2;
+        }
+        else
+        {
+            s_fat_dirty_start = (index < s_fat_dirty_start) ? index :
+                                s_fat_dirty_start;
+            s_fat_dirty_end = (index + 2 > s_fat_dirty_end) ? index + 2 :
+                              s_fat_dirty_end;
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to write FAT changes to every FAT copy */
+fatfs_error_enum_t fatfs_flush_fat(void)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint32_t copies = 0;
+    uint32_t bytes = s_fat_dirty_end - s_fat_dirty_start;
+    uint32_t i = 0;
+
+    if (bytes > 0)
+    {
+        copies = (s_boot_info.root_directory_index -
+                  s_boot_info.sector_before_fat) / s_boot_info.sector_per_fat;
+        for (i = 0; (i < copies) && (SUCCESS == error); i++)
+        {
+            if (kmc_write_bytes(kmc_get_sector_offset(
+                                    s_boot_info.sector_before_fat +
+                                    i * s_boot_info.sector_per_fat) +
+                                s_fat_dirty_start, bytes,
+                                sp_fat + s_fat_dirty_start) != (int32_t)bytes)
+            {
+                error = FATFS_WRITE_FAILED;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        s_fat_dirty_start = 0;
+        s_fat_dirty_end = 0;
+        /* Sidecar and reverse map describe the old FAT */
+        fatfs_sidecar_close();
+        fatfs_revmap_free();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((SUCCESS == error) && (false == kmc_flush()))
+    {
+        error = FATFS_WRITE_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to get image offset of last entry read */
+uint64_t fatfs_dir_entry_offset(const fatfs_dir_struct_t *const p_dir)
+{
+    uint64_t offset = 0;
+
+    if (0 == p_dir->first_cluster)
+    {
+        offset = kmc_get_sector_offset(p_dir->next_sector) - p_dir->buff_bytes;
+    }
+    else
+    {
+        offset = kmc_get_sector_offset(fatfs_cluster_to_sector(
+                                           p_dir->current_cluster));
+    }
+
+    return offset + p_dir->position - FATFS_ENTRY_SIZE;
+}
+
+/* Function is used to walk a directory tree */
+fatfs_error_enum_t fatfs_walk(const uint32_t first_cluster,
+                              const uint8_t *const p_path,
+                              const bool recursive,
+                              fatfs_walk_callback_t callback,
+                              void *p_context)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint32_t max_cluster = s_boot_info.cluster_count + 2;
+    fatfs_walk_level_struct_t *p_levels = NULL;
+    fatfs_walk_level_struct_t *p_level = NULL;
+    fatfs_walk_entry_struct_t entry;
+    uint8_t *p_visited = NULL;
+    uint8_t *p_buff = NULL;
+    void *p_temp = NULL;
+    uint32_t capacity = 16;
+    uint32_t depth = 0;
+    uint32_t length = strlen(p_path);
+    uint32_t cluster = 0;
+    int written = 0;
+
+    p_levels = (fatfs_walk_level_struct_t *)malloc(capacity *
+               sizeof(fatfs_walk_level_struct_t));
+    p_visited = (uint8_t *)calloc((max_cluster + 7) / 8, 1);
+    p_buff = (uint8_t *)malloc(FATFS_WALK_PATH_SIZE);
+    if ((NULL == p_levels) || (NULL == p_visited) || (NULL == p_buff) ||
+            (length >= FATFS_WALK_PATH_SIZE))
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        /* Children are joined with '/', root "/" becomes "" */
+        length = ((length > 0) && ('/' == p_path[length - 1])) ?
+                 length - 1 : length;
+        memcpy(p_buff, p_path, length);
+        p_buff[length] = '\0';
+        p_levels[0].first_cluster = first_cluster;
+        p_levels[0].path_length = length;
+        error = fatfs_dir_open(first_cluster, &p_levels[0].p_dir);
+        depth = (SUCCESS == error) ? 1 : 0;
+    }
+    if ((first_cluster >= 2) && (first_cluster < max_cluster) &&
+            (p_visited != NULL))
+    {
+        p_visited[first_cluster >> 3] |= (uint8_t)(1U << (first_cluster & 7));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    while ((SUCCESS == error) && (depth > 0))
+    {
+        p_level = &p_levels[depth - 1];
+        error = fatfs_dir_next(p_level->p_dir, &entry.info);
+        if (FATFS_END_OF_DIRECTORY == error)
+        {
+            fatfs_dir_close(p_level->p_dir);
+            depth--;
+            error = SUCCESS;
+        }
+        else if ((error != SUCCESS) || ('.' == entry.info.short_name[0]))
+        {
+            /* Do nothing */
+        }
+        else
+        {
+            /* A path too long to hold would drop entries unseen */
+            written = snprintf(p_buff + p_level->path_length,
+                               FATFS_WALK_PATH_SIZE - p_level->path_length,
+                               "/%s", fatfs_get_entry_name(&entry.info));
+            error = ((written < 0) || ((uint32_t)written >=
+                                       FATFS_WALK_PATH_SIZE -
+                                       p_level->path_length)) ?
+                    FATFS_READ_SECTOR_FAILED : SUCCESS;
+            cluster = entry.info.first_cluster;
+            entry.p_path = p_buff;
+            entry.entry_offset = fatfs_dir_entry_offset(p_level->p_dir);
+            entry.directory_cluster = p_level->first_cluster;
+            /* Directory reached twice is a loop in a damaged image */
+            entry.descended = (true == recursive) &&
+                              (0 != (entry.info.file_attribute &
+                                     FATFS_SUBDIRECTORY_ATTRIBUTE)) &&
+                              (cluster >= 2) && (cluster < max_cluster) &&
+                              (0 == (p_visited[cluster >> 3] &
+                                     (1U << (cluster & 7))));
+            if (true == entry.descended)
+            {
+                p_visited[cluster >> 3] |= (uint8_t)(1U << (cluster & 7));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            error = (SUCCESS == error) ? callback(&entry, p_context) : error;
+            if ((SUCCESS == error) && (true == entry.descended) &&
+                    (depth == capacity))
+            {
+                p_temp = realloc(p_levels, 2 * capacity *
+                                 sizeof(fatfs_walk_level_struct_t));
+                error = (NULL == p_temp) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+                p_levels = (NULL == p_temp) ? p_levels : p_temp;
+                capacity = (NULL == p_temp) ? capacity : capacity * 2;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((SUCCESS == error) && (true == entry.descended))
+            {
+                p_levels[depth].first_cluster = cluster;
+                p_levels[depth].path_length = p_levels[depth - 1].path_length +
+                                              (uint32_t)written;
+                error = fatfs_dir_open(cluster, &p_levels[depth].p_dir);
+                depth += (SUCCESS == error) ? 1 : 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+    }
+    while (depth > 0)
+    {
+        fatfs_dir_close(p_levels[--depth].p_dir);
+    }
+    free(p_levels);
+    free(p_visited);
+    free(p_buff);
+
+    return error;
+}
+
+/* Function is used to decode raw entries of one name */
+void fatfs_decode_raw_entry(const uint8_t *const p_entries,
+                            const uint32_t count,
+                            fatfs_entry_info_struct_t *const p_info)
+{
+    uint8_t lfn_buff[FATFS_LFN_BUFF_SIZE];
+    uint8_t sub_entry = 0;
+    uint8_t checksum = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        (void)fatfs_decode_entry(p_entries + i * FATFS_ENTRY_SIZE, p_info,
+                                 lfn_buff, &sub_entry, &checksum);
+    }
+}
+
+/* Function is used to get checksum of short name */
+uint8_t fatfs_short_name_checksum(const uint8_t *const p_entry)
+{
+    uint8_t checksum = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < FATFS_MAIN_ENTRY_FILE_NAME_BYTES +
+            FATFS_MAIN_ENTRY_FILE_EXTENSION_BYTES; i++)
+    {
+        checksum = (uint8_t)(((checksum & 1) << 7) + (checksum >> 1) +
+                             p_entry[i]);
+    }
+
+    return checksum;
+}
+
+/* Function is used to get extents of chain */
+fatfs_error_enum_t fatfs_get_extents(const uint32_t first_cluster,
+                                     fatfs_extent_struct_t **const p_extents,
+                                     uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_extent_struct_t *p_list = NULL;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    uint32_t cluster = first_cluster;
+    uint32_t steps = 0;
+
+    /* A chain can not be longer than the volume, stop on loops */
+    while ((SUCCESS == error) && (false == fatfs_is_end_cluster(cluster)) &&
+            (steps <= s_boot_info.cluster_count))
+    {
+        if ((count > 0) && (cluster == p_list[count - 1].first_cluster +
+                            p_list[count - 1].cluster_count))
+        {
+            p_list[count - 1].cluster_count++;
+        }
+        else
+        {
+            if (count == capacity)
+            {
+                capacity = (0 == capacity) ? 8 : capacity * 2;
+                p_list = (fatfs_extent_struct_t *)realloc(p_list, capacity *
+                         sizeof(fatfs_extent_struct_t));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            p_list[count].first_cluster = cluster;
+            p_list[count].cluster_count = 1;
+            count++;
+        }
+        error = fatfs_get_next_cluster(&cluster);
+        steps++;
+    }
+    *p_extents = p_list;
+    *p_count = count;
+
+    return error;
+}
+
+/* Function is used to get error message */
+uint8_t *getErrorMessage(const fatfs_error_enum_t err)
+{
+    uint8_t *errorMessage[] =
+    {
+        "Success",
+        "Initialize failed",
+        "Read sector failed",
+        "End of directory",
+        "Entry not found",
+        "Sidecar failed",
+        "Write failed",
+        "Volume damaged"
+    };
+
+    return errorMessage[err];
+}
+
+/* Function is used to initialize FAT */
+fatfs_error_enum_t fatfs_init(const uint8_t *const file_path,
+                              fatfs_boot_sector_struct_t **const p_boot)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint8_t boot_sector[FATFS_BOOT_SECTOR_SIZE] = {};
+    uint8_t fat_type[FATFS_FAT_TYPE_SIZE + 1];
+    uint8_t i = 0;
+    uint32_t temp = 0;
+    uint8_t number_fat = 0;
+    uint16_t sector_per_fat = 0;
+    uint16_t root_entry = 0;
+
+    fatfs_sidecar_close();
+    fatfs_index_clear();
+    fatfs_revmap_free();
+    if (true == kmc_init(file_path))
+    {
+        if (FATFS_BOOT_SECTOR_SIZE == kmc_read_sector(FATFS_BOOT_SECTOR_INDEX,
+                boot_sector))
+        {
+            /* Read sector before fat */
+            temp = (uint32_t)
+                   boot_sector[FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET +
+                               FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES - 1];
+            for (i = FATFS_NUMBER_SECTOR_BEFORE_FAT_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_NUMBER_SECTOR_BEFORE_FAT_OFFSET +
+                                       i - 1], temp);
+            }
+            s_boot_info.sector_before_fat = (uint16_t)temp;
+
+            /* Read byte per sector */
+            temp = (uint32_t)
+                   boot_sector[FATFS_BYTE_PER_SECTOR_OFFSET +
+                               FATFS_BYTE_PER_SECTOR_BYTES - 1];
+            for (i = FATFS_BYTE_PER_SECTOR_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_BYTE_PER_SECTOR_OFFSET +
+                                       i - 1], temp);
+            }
+            s_boot_info.byte_per_sector = (uint16_t)temp;
+
+            /* Read number FAT */
+            temp = (uint32_t)
+                   boot_sector[FATFS_NUMBER_FAT_OFFSET +
+                               FATFS_NUMBER_FAT_BYTES - 1];
+            for (i = FATFS_NUMBER_FAT_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_NUMBER_FAT_OFFSET + i - 1], temp);
+            }
+            number_fat = (uint8_t)temp;
+
+            /* Read sector per FAT */
+            temp = (uint32_t)
+                   boot_sector[FATFS_SECTOR_PER_FAT_OFFSET +
+                               FATFS_SECTOR_PER_FAT_BYTES - 1];
+            for (i = FATFS_SECTOR_PER_FAT_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_SECTOR_PER_FAT_OFFSET +
+                                       i - 1], temp);
+            }
+            sector_per_fat = (uint16_t)temp;
+            s_boot_info.sector_per_fat = sector_per_fat;
+
+            /* Read root directory index */
+            temp = s_boot_info.sector_before_fat + sector_per_fat *
+                   (uint16_t)number_fat;
+            s_boot_info.root_directory_index = temp;
+
+            /* Read root entry */
+            temp = (uint32_t)
+                   boot_sector[FATFS_ROOT_ENTRY_OFFSET +
+                               FATFS_ROOT_ENTRY_BYTES - 1];
+            for (i = FATFS_ROOT_ENTRY_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_ROOT_ENTRY_OFFSET + i - 1], temp);
+            }
+            root_entry = (uint16_t)temp;
+
+            /* Read sector per cluster */
+            temp = (uint32_t)
+                   boot_sector[FATFS_SECTOR_PER_CLUSTER_OFFSET +
+                               FATFS_SECTOR_PER_CLUSTER_BYTES - 1];
+            for (i = FATFS_SECTOR_PER_CLUSTER_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_SECTOR_PER_CLUSTER_OFFSET +
+                                       i - 1], temp);
+            }
+            s_boot_info.sector_per_cluster = (uint8_t)temp;
+
+            /* Read data index */
+            temp = (uint32_t)((root_entry * FATFS_ENTRY_SIZE +
+                               s_boot_info.byte_per_sector - 1) /
+                              s_boot_info.byte_per_sector);
+            s_boot_info.data_index =
+                (uint32_t)(s_boot_info.root_directory_index +
+                           temp);
+
+            /* Read number of cluster */
+            temp = (uint32_t)
+                   boot_sector[FATFS_TOTAL_SECTOR_16_OFFSET +
+                               FATFS_TOTAL_SECTOR_16_BYTES - 1];
+            for (i = FATFS_TOTAL_SECTOR_16_BYTES - 1; i > 0; i--)
+            {
+                temp = make_value_little_endian(
+                           boot_sector[FATFS_TOTAL_SECTOR_16_OFFSET +
+                                       i - 1], temp);
+            }
+            if (0 == temp)
+            {
+                for (i = FATFS_TOTAL_SECTOR_32_BYTES; i > 0; i--)
+                {
+                    temp = (temp << 8) |
+                           boot_sector[FATFS_TOTAL_SECTOR_32_OFFSET + i - 1];
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((temp > s_boot_info.data_index) &&
+                    (s_boot_info.sector_per_cluster > 0))
+            {
+                s_boot_info.cluster_count = (temp - s_boot_info.data_index) /
+                                            s_boot_info.sector_per_cluster;
+            }
+            else
+            {
+                s_boot_info.cluster_count = 0;
+            }
+
+            /* Read fat type */
+            for (i = 0; i < FATFS_FAT_TYPE_SIZE; i++)
+            {
+                fat_type[i] = boot_sector[FATFS_FAT_TYPE_OFFSET + i];
+            }
+            fat_type[i] = '\0';
+            if (fat_type[4] == '2')
+            {
+                s_boot_info.fat_type = 12;
+                s_end_cluster = 0xFFF;
+            }
+            else if (fat_type[4] == '6')
+            {
+                s_boot_info.fat_type = 16;
+                s_end_cluster = 0xFFFF;
+            }
+            else
+            {
+                s_boot_info.fat_type = 32;
+            }
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+    else
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+    kmc_update_sector_size(s_boot_info.byte_per_sector);
+    if (SUCCESS == error)
+    {
+        fatfs_load_fat();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_boot = &s_boot_info;
+
+    return error;
+}
+
+/* Function is used to open directory */
+fatfs_error_enum_t fatfs_dir_open(const uint32_t first_cluster,
+                                  fatfs_dir_struct_t **const p_dir)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_dir_struct_t *p_temp = NULL;
+
+    p_temp = (fatfs_dir_struct_t *)calloc(1, sizeof(fatfs_dir_struct_t));
+    if (p_temp != NULL)
+    {
+        p_temp->first_cluster = first_cluster;
+        p_temp->next_sector = s_boot_info.root_directory_index;
+        p_temp->p_buff = (uint8_t *)malloc(s_boot_info.byte_per_sector *
+                                           s_boot_info.sector_per_cluster);
+        if (NULL == p_temp->p_buff)
+        {
+            free(p_temp);
+            p_temp = NULL;
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    *p_dir = p_temp;
+
+    return error;
+}
+
+/* Function is used to read next entry of directory */
+fatfs_error_enum_t fatfs_dir_next(fatfs_dir_struct_t *const p_dir,
+                                  fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_error_enum_t error = FATFS_END_OF_DIRECTORY;
+    fatfs_entry_type_enum_t entry_type = EMPTY_ENTRY;
+    const uint8_t *p_entry = NULL;
+    bool found = false;
+
+    while ((false == p_dir->end) && (false == found))
+    {
+        if (p_dir->position >= p_dir->buff_bytes)
+        {
+            error = fatfs_dir_load(p_dir);
+        }
+        else
+        {
+            error = SUCCESS;
+        }
+        if (SUCCESS == error)
+        {
+            p_entry = p_dir->p_buff + p_dir->position;
+            p_dir->position += FATFS_ENTRY_SIZE;
+            if (EMPTY_ENTRY == p_entry[0]) /* No entry after this one */
+            {
+                error = FATFS_END_OF_DIRECTORY;
+                p_dir->end = true;
+            }
+            else
+            {
+                entry_type = fatfs_decode_entry(p_entry, p_info,
+                                                p_dir->lfn_buff,
+                                                &p_dir->sub_entry,
+                                                &p_dir->lfn_checksum);
+                /* Read-only, hidden, system and archive bits are kept */
+                if ((MAIN_ENTRY == entry_type) &&
+                        (0 == (p_info->file_attribute &
+                               FATFS_VOLUME_ATTRIBUTE)) &&
+                        (strcmp(p_info->file_name, ".       ") != 0))
+                {
+                    found = true;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+        }
+        else
+        {
+            p_dir->end = true;
+        }
+    }
+    if (false == found)
+    {
+        error = (SUCCESS == error) ? FATFS_END_OF_DIRECTORY : error;
+    }
+    else
+    {
+        error = SUCCESS;
+    }
+
+    return error;
+}
+
+/* Function is used to close directory */
+void fatfs_dir_close(fatfs_dir_struct_t *const p_dir)
+{
+    if (p_dir != NULL)
+    {
+        free(p_dir->p_buff);
+        free(p_dir);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to find entry in directory */
+fatfs_error_enum_t fatfs_lookup(const uint32_t first_cluster,
+                                const uint8_t *const p_name,
+                                fatfs_entry_info_struct_t *const p_info)
+{
+    return fatfs_index_lookup(first_cluster, p_name, p_info);
+}
+
+/* Function is used to read directory */
+fatfs_error_enum_t fatfs_read_directory(const uint32_t first_cluster,
+                   fatfs_entry_info_struct_t **const p_list)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_dir_struct_t *p_dir = NULL;
+    fatfs_entry_info_struct_t *p_entry_info = NULL;
+    uint32_t position = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    fatfs_free_list();
+    if (true == fatfs_sidecar_find_directory(first_cluster, &position,
+            &count))
+    {
+        for (i = 0; i < count; i++)
+        {
+            p_entry_info = (fatfs_entry_info_struct_t *)malloc(sizeof(
+                               fatfs_entry_info_struct_t));
+            fatfs_sidecar_get_entry(position + i, p_entry_info);
+            fatfs_insert(p_entry_info);
+        }
+        error = FATFS_END_OF_DIRECTORY;
+    }
+    else
+    {
+        error = fatfs_dir_open(first_cluster, &p_dir);
+    }
+    while (SUCCESS == error)
+    {
+        p_entry_info = (fatfs_entry_info_struct_t *)malloc(sizeof(
+                           fatfs_entry_info_struct_t));
+        error = fatfs_dir_next(p_dir, p_entry_info);
+        if (SUCCESS == error)
+        {
+            fatfs_insert(p_entry_info);
+        }
+        else
+        {
+            free(p_entry_info);
+        }
+    }
+    if (FATFS_END_OF_DIRECTORY == error)
+    {
+        error = SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    fatfs_dir_close(p_dir);
+    *p_list = sp_entry_list_head;
+
+    return error;
+}
+
+/* Function is used to read file */
+fatfs_error_enum_t fatfs_read_file(uint32_t first_cluster, uint8_t *p_buff,
+                                   uint32_t buff_size)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_extent_struct_t *p_chain = NULL;
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+    uint32_t num = 0;
+
+    if (false == fatfs_sidecar_get_extents(first_cluster, &p_extents, &count))
+    {
+        error = fatfs_get_extents(first_cluster, &p_chain, &count);
+        p_extents = p_chain;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (i < count) && (SUCCESS == error); i++)
+    {
+        num = p_extents[i].cluster_count * s_boot_info.sector_per_cluster;
+        /* Looped or cross-linked chain runs past end of file */
+        if ((uint64_t)num * s_boot_info.byte_per_sector > buff_size)
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+            break;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        bytes = kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                          p_extents[i].first_cluster),
+                                      num, p_buff);
+        if (bytes == num * s_boot_info.byte_per_sector)
+        {
+            p_buff += bytes;
+            buff_size -= bytes;
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+    free(p_chain);
+
+    return error;
+}
+
+/* Function is used to de-initialize FAT */
+void fatfs_deinit(void)
+{
+    fatfs_sidecar_close();
+    fatfs_index_clear();
+    fatfs_revmap_free();
+    fatfs_free_list();
+    free(sp_fat);
+    sp_fat = NULL;
+    s_fat_bytes = 0;
+    free(sp_fat_preload);
+    sp_fat_preload = NULL;
+    s_fat_dirty_start = 0;
+    s_fat_dirty_end = 0;
+    kmc_deinit();
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -1,102 +1,348 @@
-#ifndef _FAT_H_
-#define _FAT_H_
-
-/*******************************************************************************
- * Includes
- ******************************************************************************/
-typedef struct
-{
-    uint8_t hour;
-    uint8_t minute;
-    uint8_t second;
-} fatfs_modified_time_struct_t;
-
-typedef struct
-{
-    uint16_t year;
-    uint8_t month;
-    uint8_t day;
-} fatfs_modified_date_struct_t;
-
-typedef struct _entry_info
-{
-    uint8_t file_name[256];
-    uint8_t file_extension[4];
-    uint8_t file_attribute;
-    fatfs_modified_time_struct_t modified_time;
-    fatfs_modified_date_struct_t modified_date;
-    uint32_t file_size;
-    uint32_t file_round_up_size;
-    uint32_t first_cluster;
-    struct _entry_info *p_next;
-} fatfs_entry_info_struct_t;
-
-typedef struct
-{
-    uint16_t sector_before_fat;
-    uint16_t byte_per_sector;
-    uint32_t root_directory_index;
-    uint32_t data_index;
-    uint8_t sector_per_cluster;
-    uint8_t fat_type;
-} fatfs_boot_sector_struct_t;
-
-typedef enum
-{
-    SUCCESS,
-    FATFS_INITIALIZE_FAILED,
-    FATFS_READ_SECTOR_FAILED
-} fatfs_error_enum_t;
-
-/*******************************************************************************
- * API
- ******************************************************************************/
-/**
- * @brief Initialize FAT
- *
- * @param [in] file_path is path to file
- * @param [out] p_boot is boot sector
- * @return fatfs_error_enum_t is error code
- */
-fatfs_error_enum_t fatfs_init(const uint8_t *const file_path,
-                              fatfs_boot_sector_struct_t **const p_boot);
-
-/**
- * @brief Read directory
- *
- * @param [in] first_cluster is first cluster of directory
- * @param [out] p_list is entry list
- * @return fatfs_error_enum_t is error code
- */
-fatfs_error_enum_t fatfs_read_directory(const uint32_t first_cluster,
-                                        fatfs_entry_info_struct_t **const p_list);
-
-/**
- * @brief Read file
- *
- * @param [in] first_cluster is first cluster of file
- * @param [out] p_buff is content of file
- * @return fatfs_error_enum_t is error code
- */
-fatfs_error_enum_t fatfs_read_file(const uint32_t first_cluster,
-                                   uint8_t *const p_buff);
-
-/**
- * @brief Get error Message
- *
- * @param [in] err is error type
- * @return uint8_t* is content of error
- */
-uint8_t *getErrorMessage(const fatfs_error_enum_t err);
-
-/**
- * @brief De-initialize FAT
- *
- */
-void fatfs_deinit(void);
-
-#endif /* _FAT_H_ */
-
-/*******************************************************************************
- * EOF
- ******************************************************************************/
+#ifndef _FAT_H_
+#define _FAT_H_
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#define FATFS_FILE_NAME_SIZE 256U
+#define FATFS_SHORT_NAME_SIZE 13U
+#define FATFS_SUB_ENTRY_MAX 20U
+#define FATFS_LFN_BUFF_SIZE 260U
+#define FATFS_WALK_PATH_SIZE 1024U
+
+typedef struct
+{
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+} fatfs_modified_time_struct_t;
+
+typedef struct
+{
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+} fatfs_modified_date_struct_t;
+
+typedef struct _entry_info
+{
+    uint8_t file_name[FATFS_FILE_NAME_SIZE];
+    uint8_t short_name[FATFS_SHORT_NAME_SIZE];
+    uint8_t file_extension[4];
+    uint8_t file_attribute;
+    fatfs_modified_time_struct_t modified_time;
+    fatfs_modified_date_struct_t modified_date;
+    uint32_t file_size;
+    uint32_t file_round_up_size;
+    uint32_t first_cluster;
+    struct _entry_info *p_next;
+} fatfs_entry_info_struct_t;
+
+typedef struct
+{
+    uint16_t sector_before_fat;
+    uint16_t byte_per_sector;
+    uint32_t root_directory_index;
+    uint32_t data_index;
+    uint8_t sector_per_cluster;
+    uint8_t fat_type;
+    uint16_t sector_per_fat;
+    uint32_t cluster_count;
+} fatfs_boot_sector_struct_t;
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t cluster_count;
+} fatfs_extent_struct_t;
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t current_cluster;
+    uint32_t cluster_left;      /* Clusters after current one to load */
+    uint32_t next_sector;
+    uint8_t *p_buff;
+    uint32_t buff_bytes;
+    uint32_t position;
+    uint8_t lfn_buff[FATFS_LFN_BUFF_SIZE];
+    uint8_t sub_entry;
+    uint8_t lfn_checksum;
+    bool end;
+} fatfs_dir_struct_t;
+
+typedef enum
+{
+    SUCCESS,
+    FATFS_INITIALIZE_FAILED,
+    FATFS_READ_SECTOR_FAILED,
+    FATFS_END_OF_DIRECTORY,
+    FATFS_ENTRY_NOT_FOUND,
+    FATFS_SIDECAR_FAILED,
+    FATFS_WRITE_FAILED,
+    FATFS_VOLUME_DAMAGED
+} fatfs_error_enum_t;
+
+typedef struct
+{
+    const uint8_t *p_path;      /* "/DIR/NAME", valid during callback only */
+    fatfs_entry_info_struct_t info;
+    uint64_t entry_offset;      /* Image offset of main entry */
+    uint32_t directory_cluster; /* First cluster of parent, 0 for root */
+    bool descended;             /* Directory whose entries follow */
+} fatfs_walk_entry_struct_t;
+
+/**
+ * @brief Called once per entry walked
+ *
+ * @param [in] p_entry is entry
+ * @param [in] p_context is context given to fatfs_walk
+ * @return fatfs_error_enum_t is SUCCESS to go on, error to stop walk
+ */
+typedef fatfs_error_enum_t (*fatfs_walk_callback_t)(
+    const fatfs_walk_entry_struct_t *const p_entry, void *p_context);
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Initialize FAT
+ *
+ * @param [in] file_path is path to file
+ * @param [out] p_boot is boot sector
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_init(const uint8_t *const file_path,
+                              fatfs_boot_sector_struct_t **const p_boot);
+
+/**
+ * @brief Read directory
+ *
+ * @param [in] first_cluster is first cluster of directory
+ * @param [out] p_list is entry list
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_read_directory(const uint32_t first_cluster,
+                                        fatfs_entry_info_struct_t **const p_list);
+
+/**
+ * @brief Open directory for reading entry by entry
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [out] p_dir is directory iterator
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_dir_open(const uint32_t first_cluster,
+                                  fatfs_dir_struct_t **const p_dir);
+
+/**
+ * @brief Read next entry of directory, loading clusters on demand
+ *
+ * @param [inout] p_dir is directory iterator
+ * @param [out] p_info is next entry
+ * @return fatfs_error_enum_t is FATFS_END_OF_DIRECTORY after last entry
+ */
+fatfs_error_enum_t fatfs_dir_next(fatfs_dir_struct_t *const p_dir,
+                                  fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Close directory iterator
+ *
+ * @param [in] p_dir is directory iterator
+ */
+void fatfs_dir_close(fatfs_dir_struct_t *const p_dir);
+
+/**
+ * @brief Find entry in directory by long or short name, ignoring case
+ *
+ * Names are looked up through a hash index of the directory, so repeated
+ * lookups in the same directory do not scan it again.
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] p_name is name to find
+ * @param [out] p_info is entry found
+ * @return fatfs_error_enum_t is FATFS_ENTRY_NOT_FOUND if name is not found
+ */
+fatfs_error_enum_t fatfs_lookup(const uint32_t first_cluster,
+                                const uint8_t *const p_name,
+                                fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Read file
+ *
+ * Each run of contiguous clusters is read with a single request.
+ *
+ * @param [in] first_cluster is first cluster of file
+ * @param [out] p_buff is content of file
+ * @param [in] buff_size is size of p_buff, at least file_round_up_size
+ * @return fatfs_error_enum_t is error code, FATFS_READ_SECTOR_FAILED if
+ * chain is longer than buff_size
+ */
+fatfs_error_enum_t fatfs_read_file(const uint32_t first_cluster,
+                                   uint8_t *const p_buff,
+                                   const uint32_t buff_size);
+
+/**
+ * @brief Get boot sector of volume opened by fatfs_init
+ *
+ * @return const fatfs_boot_sector_struct_t* is boot sector
+ */
+const fatfs_boot_sector_struct_t *fatfs_get_boot_sector(void);
+
+/**
+ * @brief Get name of entry, long name if there is one, else "NAME.EXT"
+ *
+ * @param [in] p_info is entry
+ * @return const uint8_t* is name
+ */
+const uint8_t *fatfs_get_entry_name(const fatfs_entry_info_struct_t
+                                    *const p_info);
+
+/**
+ * @brief Get next cluster of chain
+ *
+ * @param [inout] next_cluster is cluster in, next cluster out
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_get_next_cluster(uint32_t *const next_cluster);
+
+/**
+ * @brief Check if cluster ends a chain
+ *
+ * @param [in] cluster is cluster to check
+ * @return true if cluster is end of chain or invalid
+ * @return false if cluster is a data cluster
+ */
+bool fatfs_is_end_cluster(const uint32_t cluster);
+
+/**
+ * @brief Get first sector of cluster
+ *
+ * @param [in] cluster is cluster index
+ * @return uint32_t is sector index
+ */
+uint32_t fatfs_cluster_to_sector(const uint32_t cluster);
+
+/**
+ * @brief Get first FAT loaded in memory
+ *
+ * @param [out] p_size is size of FAT in bytes, 0 if FAT is not loaded
+ * @return const uint8_t* is FAT content
+ */
+const uint8_t *fatfs_get_fat(uint32_t *const p_size);
+
+/**
+ * @brief Set next cluster of chain in FAT loaded in memory
+ *
+ * Change reaches the image on fatfs_flush_fat.
+ *
+ * @param [in] cluster is cluster index
+ * @param [in] next is next cluster, 0 to free cluster
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_set_next_cluster(const uint32_t cluster,
+        const uint32_t next);
+
+/**
+ * @brief Write FAT changes to every FAT copy and flush image
+ *
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_flush_fat(void);
+
+/**
+ * @brief Get byte offset in image of entry last returned by fatfs_dir_next
+ *
+ * @param [in] p_dir is directory iterator
+ * @return uint64_t is byte offset of 32-byte entry
+ */
+uint64_t fatfs_dir_entry_offset(const fatfs_dir_struct_t *const p_dir);
+
+/**
+ * @brief Walk a directory tree depth first, entries of a directory follow it
+ *
+ * '.' and '..' are skipped. A directory is descended once, so loops and
+ * cross-links of a damaged image end the walk instead of repeating it.
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] p_path is path of directory, "" or "/" for root
+ * @param [in] recursive is true to descend into subdirectories
+ * @param [in] callback is function called for each entry
+ * @param [in] p_context is passed to callback
+ * @return fatfs_error_enum_t is error code, FATFS_READ_SECTOR_FAILED if a
+ *         path does not fit FATFS_WALK_PATH_SIZE
+ */
+fatfs_error_enum_t fatfs_walk(const uint32_t first_cluster,
+                              const uint8_t *const p_path,
+                              const bool recursive,
+                              fatfs_walk_callback_t callback,
+                              void *p_context);
+
+/**
+ * @brief Decode main entry and long name entries stored in front of it
+ *
+ * @param [in] p_entries is first of count raw 32-byte entries, main last
+ * @param [in] count is number of entries, at least 1
+ * @param [out] p_info is entry
+ */
+void fatfs_decode_raw_entry(const uint8_t *const p_entries,
+                            const uint32_t count,
+                            fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Get checksum of 8.3 name kept by its long name entries
+ *
+ * @param [in] p_entry is raw main entry
+ * @return uint8_t is checksum
+ */
+uint8_t fatfs_short_name_checksum(const uint8_t *const p_entry);
+
+/**
+ * @brief Take FAT out of volume, chains are then read from disk
+ *
+ * @param [out] p_size is size of FAT in bytes, 0 if FAT is not loaded
+ * @return uint8_t* is FAT content, freed by caller
+ */
+uint8_t *fatfs_detach_fat(uint32_t *const p_size);
+
+/**
+ * @brief Give FAT to use on next fatfs_init instead of reading it
+ *
+ * FAT is used only if its size matches the volume, it is freed otherwise.
+ *
+ * @param [in] p_fat is FAT content, owned by library afterwards
+ * @param [in] size is size of FAT in bytes
+ */
+void fatfs_preload_fat(uint8_t *const p_fat, const uint32_t size);
+
+/**
+ * @brief Get chain of a file as runs of contiguous clusters
+ *
+ * @param [in] first_cluster is first cluster of chain
+ * @param [out] p_extents is array of extents, freed by caller
+ * @param [out] p_count is number of extents
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_get_extents(const uint32_t first_cluster,
+                                     fatfs_extent_struct_t **const p_extents,
+                                     uint32_t *const p_count);
+
+/**
+ * @brief Get error Message
+ *
+ * @param [in] err is error type
+ * @return uint8_t* is content of error
+ */
+uint8_t *getErrorMessage(const fatfs_error_enum_t err);
+
+/**
+ * @brief De-initialize FAT
+ *
+ */
+void fatfs_deinit(void);
+
+#endif /* _FAT_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,937 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "find.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_FIND_DEFAULT_THREADS 4U
+#define FATFS_FIND_MAX_THREADS 64U
+#define FATFS_FIND_ENTRY_SIZE 32U
+#define FATFS_FIND_ATTRIBUTE_OFFSET 11U
+#define FATFS_FIND_STAMP_OFFSET 22U
+#define FATFS_FIND_CLUSTER_OFFSET 26U
+#define FATFS_FIND_SIZE_OFFSET 28U
+#define FATFS_FIND_LFN_ATTRIBUTE 0x0FU
+#define FATFS_FIND_VOLUME_ATTRIBUTE 0x08U
+#define FATFS_FIND_DIRECTORY_ATTRIBUTE 0x10U
+#define FATFS_FIND_DELETED_ENTRY 0xE5U
+#define FATFS_FIND_LFN_CHARACTERS 13U
+#define FATFS_FIND_LFN_LAST_FLAG 0x40U
+#define FATFS_FIND_LFN_CHECKSUM_OFFSET 13U
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t length;
+    uint32_t depth;             /* Depth of entries, 1 for root */
+    uint8_t *p_path;            /* Path of directory, "" for root */
+} fatfs_find_directory_struct_t;
+
+typedef struct
+{
+    const fatfs_boot_sector_struct_t *p_boot;
+    const fatfs_find_predicate_struct_t *p_predicate;
+    fatfs_find_callback_t callback;
+    void *p_context;
+    uint32_t *p_next;           /* Decoded FAT, one value per cluster */
+    uint8_t *p_owned;           /* Bit n set once a directory owns n */
+    uint32_t max_cluster;
+    uint32_t bad_cluster;
+    uint32_t cluster_bytes;
+    fatfs_find_directory_struct_t *p_queue;
+    uint32_t queue_count;
+    uint32_t queue_capacity;
+    uint32_t busy;
+    bool failed;
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_mutex_t callback_lock;
+    pthread_cond_t cond;
+    fatfs_find_stats_struct_t stats;
+} fatfs_find_context_struct_t;
+
+/* Offsets of the 13 UTF-16 characters of a long name entry */
+static const uint8_t s_lfn_offsets[FATFS_FIND_LFN_CHARACTERS] =
+{
+    1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30
+};
+
+static fatfs_find_context_struct_t s_find;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Match one character against first item of glob
+ *
+ * @param [in] p_pattern is glob, upper case
+ * @param [in] character is character to match, upper case
+ * @return const uint8_t* is glob after item, NULL if not matched
+ */
+static const uint8_t *fatfs_find_glob_item(const uint8_t *p_pattern,
+        const uint8_t character);
+
+/**
+ * @brief Match name against glob, ignoring case
+ *
+ * @param [in] p_pattern is glob, upper case
+ * @param [in] p_name is name
+ * @return true if name matches
+ * @return false if name does not match
+ */
+static bool fatfs_find_glob(const uint8_t *p_pattern, const uint8_t *p_name);
+
+/**
+ * @brief Build "NAME.EXT" from raw main entry
+ *
+ * @param [in] p_entry is raw main entry
+ * @param [out] p_name is name, FATFS_SHORT_NAME_SIZE bytes
+ */
+static void fatfs_find_short_name(const uint8_t *const p_entry,
+                                  uint8_t *const p_name);
+
+/**
+ * @brief Build long name from raw entries in front of main entry
+ *
+ * @param [in] p_entry is raw main entry
+ * @param [in] count is number of long name entries in front of it
+ * @param [out] p_name is name, FATFS_FILE_NAME_SIZE bytes
+ */
+static void fatfs_find_long_name(const uint8_t *const p_entry,
+                                 const uint32_t count, uint8_t *const p_name);
+
+/**
+ * @brief Take ownership of directory cluster
+ *
+ * @param [in] cluster is cluster to own
+ * @return true if cluster had no owner before
+ */
+static bool fatfs_find_own(const uint32_t cluster);
+
+/**
+ * @brief Queue directory for walkers, once per first cluster
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [in] depth is depth of entries in directory
+ * @param [in] p_path is path of directory
+ */
+static void fatfs_find_push(const uint32_t first_cluster,
+                            const uint32_t depth,
+                            const uint8_t *const p_path);
+
+/**
+ * @brief Read every entry of a directory
+ *
+ * @param [in] p_directory is directory to read
+ * @param [out] p_bytes is number of bytes read
+ * @return uint8_t* is entries, freed by caller
+ */
+static uint8_t *fatfs_find_read(const fatfs_find_directory_struct_t *const
+                                p_directory, uint32_t *const p_bytes);
+
+/**
+ * @brief Give match to callback
+ *
+ * @param [in] p_path is path of entry
+ * @param [in] p_info is entry
+ * @return fatfs_find_action_enum_t is action asked by callback
+ */
+static fatfs_find_action_enum_t fatfs_find_report(const uint8_t *const
+        p_path, const fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Test every entry of a directory and queue subdirectories
+ *
+ * @param [in] p_directory is directory to search
+ */
+static void fatfs_find_directory(const fatfs_find_directory_struct_t *const
+                                 p_directory);
+
+/**
+ * @brief Directory walker thread
+ *
+ * @param [in] p_arg is not used
+ * @return void* is not used
+ */
+static void *fatfs_find_worker(void *p_arg);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to match one character against glob item */
+static const uint8_t *fatfs_find_glob_item(const uint8_t *p_pattern,
+        const uint8_t character)
+{
+    const uint8_t *p_next = NULL;
+    const uint8_t *p_item = p_pattern + 1;
+    bool negate = false;
+    bool found = false;
+
+    if ('?' == *p_pattern)
+    {
+        p_next = p_pattern + 1;
+    }
+    else if (('[' == *p_pattern) && (p_pattern[1] != '\0') &&
+             (strchr(p_pattern + 2, ']') != NULL))
+    {
+        negate = ('!' == *p_item);
+        p_item += (true == negate) ? 1 : 0;
+        /* First character of a set may be ']' itself */
+        do
+        {
+            if (('-' == p_item[1]) && (p_item[2] != ']') &&
+                    (p_item[2] != '\0'))
+            {
+                found = found || ((character >= p_item[0]) &&
+                                  (character <= p_item[2]));
+                p_item += 3;
+            }
+            else
+            {
+                found = found || (character == p_item[0]);
+                p_item++;
+            }
+        }
+        while ((*p_item != ']') && (*p_item != '\0'));
+        p_next = ((found != negate) && (']' == *p_item)) ? p_item + 1 : NULL;
+    }
+    else if ((*p_pattern != '\0') && (character == *p_pattern))
+    {
+        p_next = p_pattern + 1;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_next;
+}
+
+/* Function is used to match name against glob */
+static bool fatfs_find_glob(const uint8_t *p_pattern, const uint8_t *p_name)
+{
+    const uint8_t *p_star = NULL;
+    const uint8_t *p_retry = NULL;
+    const uint8_t *p_next = NULL;
+    bool matched = false;
+    bool done = false;
+
+    /* Backtrack only to last '*', which keeps match linear in practice */
+    while (false == done)
+    {
+        if ('*' == *p_pattern)
+        {
+            p_star = ++p_pattern;
+            p_retry = p_name;
+        }
+        else if ('\0' == *p_name)
+        {
+            matched = ('\0' == *p_pattern);
+            done = true;
+        }
+        else
+        {
+            p_next = fatfs_find_glob_item(p_pattern,
+                                          (uint8_t)toupper(*p_name));
+            if (p_next != NULL)
+            {
+                p_pattern = p_next;
+                p_name++;
+            }
+            else if (p_star != NULL)
+            {
+                p_pattern = p_star;
+                p_name = ++p_retry;
+            }
+            else
+            {
+                done = true;
+            }
+        }
+    }
+
+    return matched;
+}
+
+/* Function is used to build short name from raw entry */
+static void fatfs_find_short_name(const uint8_t *const p_entry,
+                                  uint8_t *const p_name)
+{
+    uint32_t i = 0;
+    uint32_t count = 0;
+
+    for (i = 0; i < 11; i++)
+    {
+        if ((8 == i) && (p_entry[8] != ' '))
+        {
+            p_name[count++] = '.';
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (p_entry[i] != ' ')
+        {
+            p_name[count++] = p_entry[i];
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    p_name[count] = '\0';
+}
+
+/* Function is used to build long name from raw entries */
+static void fatfs_find_long_name(const uint8_t *const p_entry,
+                                 const uint32_t count, uint8_t *const p_name)
+{
+    const uint8_t *p_part = NULL;
+    uint32_t length = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    bool end = false;
+
+    /* Entry right in front of main entry holds first characters */
+    for (i = 1; (i <= count) && (false == end); i++)
+    {
+        p_part = p_entry - i * FATFS_FIND_ENTRY_SIZE;
+        for (j = 0; (j < FATFS_FIND_LFN_CHARACTERS) && (false == end); j++)
+        {
+            if (((0 == p_part[s_lfn_offsets[j]]) &&
+                    (0 == p_part[s_lfn_offsets[j] + 1])) ||
+                    (length == FATFS_FILE_NAME_SIZE - 1))
+            {
+                end = true;
+            }
+            else
+            {
+                /* Same low byte as fatfs_read_directory keeps */
+                p_name[length++] = p_part[s_lfn_offsets[j]];
+            }
+        }
+    }
+    p_name[length] = '\0';
+}
+
+/* Function is used to take ownership of directory cluster */
+static bool fatfs_find_own(const uint32_t cluster)
+{
+    uint8_t mask = (uint8_t)(1U << (cluster & 7));
+    uint8_t old = 0;
+
+    old = __atomic_fetch_or(&s_find.p_owned[cluster >> 3], mask,
+                            __ATOMIC_RELAXED);
+
+    return (0 == (old & mask));
+}
+
+/* Function is used to queue directory */
+static void fatfs_find_push(const uint32_t first_cluster,
+                            const uint32_t depth,
+                            const uint8_t *const p_path)
+{
+    fatfs_find_directory_struct_t *p_temp = NULL;
+    fatfs_find_directory_struct_t directory;
+    uint32_t cluster = first_cluster;
+    uint32_t size = strlen(p_path) + 1;
+    bool valid = true;
+
+    directory.first_cluster = first_cluster;
+    directory.length = 0;
+    directory.depth = depth;
+    if (first_cluster != 0)
+    {
+        valid = (first_cluster >= 2) && (first_cluster < s_find.max_cluster) &&
+                (true == fatfs_find_own(first_cluster));
+        /* Stop on free or bad cluster, and on first cluster already owned,
+           so looped or cross-linked chains end at the repeat */
+        while ((true == valid) && (false == fatfs_is_end_cluster(cluster)) &&
+                (cluster >= 2) && (cluster < s_find.max_cluster))
+        {
+            directory.length++;
+            cluster = s_find.p_next[cluster];
+            if ((0 == cluster) || (s_find.bad_cluster == cluster) ||
+                    ((cluster >= 2) && (cluster < s_find.max_cluster) &&
+                     (false == fatfs_find_own(cluster))))
+            {
+                break;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    directory.p_path = (true == valid) ? (uint8_t *)malloc(size) : NULL;
+    if (directory.p_path != NULL)
+    {
+        memcpy(directory.p_path, p_path, size);
+        pthread_mutex_lock(&s_find.lock);
+        if (s_find.queue_count == s_find.queue_capacity)
+        {
+            s_find.queue_capacity = (0 == s_find.queue_capacity) ? 64 :
+                                    s_find.queue_capacity * 2;
+            p_temp = (fatfs_find_directory_struct_t *)realloc(s_find.p_queue,
+                     s_find.queue_capacity *
+                     sizeof(fatfs_find_directory_struct_t));
+            if (p_temp != NULL)
+            {
+                s_find.p_queue = p_temp;
+            }
+            else
+            {
+                s_find.queue_capacity = s_find.queue_count;
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (s_find.queue_count < s_find.queue_capacity)
+        {
+            s_find.p_queue[s_find.queue_count++] = directory;
+            pthread_cond_signal(&s_find.cond);
+        }
+        else
+        {
+            free(directory.p_path);
+            s_find.failed = true;
+        }
+        pthread_mutex_unlock(&s_find.lock);
+    }
+    else if (true == valid)
+    {
+        s_find.failed = true;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to read entries of a directory */
+static uint8_t *fatfs_find_read(const fatfs_find_directory_struct_t *const
+                                p_directory, uint32_t *const p_bytes)
+{
+    const fatfs_boot_sector_struct_t *p_boot = s_find.p_boot;
+    uint8_t *p_buff = NULL;
+    uint32_t bytes = 0;
+    uint32_t sectors = 0;
+    uint32_t cluster = p_directory->first_cluster;
+    uint32_t run = 0;
+    uint32_t i = 0;
+
+    if (0 == p_directory->first_cluster) /* Root directory region */
+    {
+        sectors = p_boot->data_index - p_boot->root_directory_index;
+        bytes = sectors * p_boot->byte_per_sector;
+        p_buff = (uint8_t *)malloc(bytes);
+        if ((p_buff != NULL) &&
+                (kmc_read_multi_sector(p_boot->root_directory_index, sectors,
+                                       p_buff) != (int32_t)bytes))
+        {
+            bytes = 0;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        bytes = p_directory->length * s_find.cluster_bytes;
+        p_buff = (uint8_t *)malloc(bytes);
+        /* Length was walked on push, read contiguous runs at once */
+        for (i = 0; (p_buff != NULL) && (i < p_directory->length); i += run)
+        {
+            for (run = 1; (i + run < p_directory->length) &&
+                    (s_find.p_next[cluster + run - 1] == cluster + run); run++)
+            {
+            }
+            if (kmc_read_multi_sector(fatfs_cluster_to_sector(cluster),
+                                      run * p_boot->sector_per_cluster,
+                                      p_buff + i * s_find.cluster_bytes) !=
+                    (int32_t)(run * s_find.cluster_bytes))
+            {
+                bytes = 0;
+                break;
+            }
+            else
+            {
+                cluster = s_find.p_next[cluster + run - 1];
+            }
+        }
+    }
+    if ((NULL == p_buff) || (0 == bytes))
+    {
+        s_find.failed = true;
+        bytes = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_bytes = bytes;
+
+    return p_buff;
+}
+
+/* Function is used to give match to callback */
+static fatfs_find_action_enum_t fatfs_find_report(const uint8_t *const
+        p_path, const fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_find_action_enum_t action = FATFS_FIND_STOP;
+
+    pthread_mutex_lock(&s_find.callback_lock);
+    /* No match is given once a callback asked to stop */
+    if (false == __atomic_load_n(&s_find.stop, __ATOMIC_RELAXED))
+    {
+        s_find.stats.matches++;
+        action = s_find.callback(p_path, p_info, s_find.p_context);
+        if (FATFS_FIND_STOP == action)
+        {
+            __atomic_store_n(&s_find.stop, true, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    pthread_mutex_unlock(&s_find.callback_lock);
+
+    return action;
+}
+
+/* Function is used to search entries of a directory */
+static void fatfs_find_directory(const fatfs_find_directory_struct_t *const
+                                 p_directory)
+{
+    const fatfs_find_predicate_struct_t *p_predicate = s_find.p_predicate;
+    fatfs_entry_info_struct_t info;
+    uint8_t short_name[FATFS_SHORT_NAME_SIZE];
+    uint8_t long_name[FATFS_FILE_NAME_SIZE];
+    uint8_t path[FATFS_FIND_PATH_SIZE];
+    uint8_t *p_buff = NULL;
+    const uint8_t *p_entry = NULL;
+    const uint8_t *p_name = NULL;
+    uint32_t bytes = 0;
+    uint32_t lfn_first = 0;
+    uint32_t lfn_count = 0;
+    uint8_t lfn_checksum = 0;
+    uint32_t size = 0;
+    uint32_t stamp = 0;
+    uint32_t entries = 0;
+    uint32_t names = 0;
+    uint32_t i = 0;
+    uint8_t attribute = 0;
+    bool matched = false;
+    bool descend = false;
+    bool end = false;
+
+    p_buff = fatfs_find_read(p_directory, &bytes);
+    for (i = 0; (i + FATFS_FIND_ENTRY_SIZE <= bytes) && (false == end);
+            i += FATFS_FIND_ENTRY_SIZE)
+    {
+        p_entry = p_buff + i;
+        attribute = p_entry[FATFS_FIND_ATTRIBUTE_OFFSET];
+        if ((0 == p_entry[0]) ||
+                (true == __atomic_load_n(&s_find.stop, __ATOMIC_RELAXED)))
+        {
+            end = true;
+        }
+        else if (FATFS_FIND_DELETED_ENTRY == p_entry[0])
+        {
+            /* Long name entries in front of it belong to nothing */
+            lfn_count = 0;
+        }
+        else if (FATFS_FIND_LFN_ATTRIBUTE == attribute)
+        {
+            /* Name starts at its last part, stray parts are orphans */
+            if (0 != (p_entry[0] & FATFS_FIND_LFN_LAST_FLAG))
+            {
+                lfn_count = 1;
+                lfn_checksum = p_entry[FATFS_FIND_LFN_CHECKSUM_OFFSET];
+            }
+            else if ((lfn_count > 0) &&
+                     (p_entry[FATFS_FIND_LFN_CHECKSUM_OFFSET] ==
+                      lfn_checksum))
+            {
+                lfn_count++;
+            }
+            else
+            {
+                lfn_count = 0;
+            }
+        }
+        else if (('.' == p_entry[0]) ||
+                 (0 != (attribute & FATFS_FIND_VOLUME_ATTRIBUTE)))
+        {
+            lfn_count = 0;
+        }
+        else
+        {
+            /* Raw fields first, they cost no decoding */
+            entries++;
+            size = (uint32_t)p_entry[FATFS_FIND_SIZE_OFFSET] |
+                   ((uint32_t)p_entry[FATFS_FIND_SIZE_OFFSET + 1] << 8) |
+                   ((uint32_t)p_entry[FATFS_FIND_SIZE_OFFSET + 2] << 16) |
+                   ((uint32_t)p_entry[FATFS_FIND_SIZE_OFFSET + 3] << 24);
+            stamp = (uint32_t)p_entry[FATFS_FIND_STAMP_OFFSET] |
+                    ((uint32_t)p_entry[FATFS_FIND_STAMP_OFFSET + 1] << 8) |
+                    ((uint32_t)p_entry[FATFS_FIND_STAMP_OFFSET + 2] << 16) |
+                    ((uint32_t)p_entry[FATFS_FIND_STAMP_OFFSET + 3] << 24);
+            matched = ((attribute & p_predicate->attribute_mask) ==
+                       p_predicate->attribute_value) &&
+                      (size >= p_predicate->min_size) &&
+                      (size <= p_predicate->max_size) &&
+                      (stamp >= p_predicate->min_stamp) &&
+                      (stamp <= p_predicate->max_stamp);
+            descend = (0 != (attribute & FATFS_FIND_DIRECTORY_ATTRIBUTE)) &&
+                      ((p_entry[FATFS_FIND_CLUSTER_OFFSET] != 0) ||
+                       (p_entry[FATFS_FIND_CLUSTER_OFFSET + 1] != 0)) &&
+                      ((0 == p_predicate->max_depth) ||
+                       (p_directory->depth < p_predicate->max_depth));
+            if ((lfn_count > FATFS_SUB_ENTRY_MAX) || ((lfn_count > 0) &&
+                    (lfn_checksum != fatfs_short_name_checksum(p_entry))))
+            {
+                lfn_count = 0;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            lfn_first = i - lfn_count * FATFS_FIND_ENTRY_SIZE;
+
+            /* Names only for entries still in the running */
+            if (((true == matched) && (p_predicate->name[0] != '\0')) ||
+                    (true == descend))
+            {
+                names++;
+                fatfs_find_short_name(p_entry, short_name);
+                fatfs_find_long_name(p_entry, lfn_count, long_name);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((true == matched) && (p_predicate->name[0] != '\0'))
+            {
+                matched = (true == fatfs_find_glob(p_predicate->name,
+                                                   short_name)) ||
+                          ((long_name[0] != '\0') &&
+                           (true == fatfs_find_glob(p_predicate->name,
+                                                    long_name)));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((true == descend) && (p_predicate->prune[0] != '\0'))
+            {
+                descend = (false == fatfs_find_glob(p_predicate->prune,
+                                                    short_name)) &&
+                          ((long_name[0] == '\0') ||
+                           (false == fatfs_find_glob(p_predicate->prune,
+                                                     long_name)));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+
+            if ((true == matched) || (true == descend))
+            {
+                fatfs_decode_raw_entry(p_buff + lfn_first, lfn_count + 1,
+                                       &info);
+                p_name = fatfs_get_entry_name(&info);
+                snprintf(path, sizeof(path), "%s/%s", p_directory->p_path,
+                         p_name);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if ((true == matched) &&
+                    (FATFS_FIND_CONTINUE != fatfs_find_report(path, &info)))
+            {
+                descend = false;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if (true == descend)
+            {
+                fatfs_find_push(info.first_cluster, p_directory->depth + 1,
+                                path);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            lfn_count = 0;
+        }
+    }
+    __atomic_fetch_add(&s_find.stats.directories, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s_find.stats.entries, entries, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s_find.stats.names, names, __ATOMIC_RELAXED);
+    free(p_buff);
+}
+
+/* Function is used to walk directories */
+static void *fatfs_find_worker(void *p_arg)
+{
+    fatfs_find_directory_struct_t directory;
+    bool done = false;
+
+    (void)p_arg;
+    pthread_mutex_lock(&s_find.lock);
+    while (false == done)
+    {
+        while ((0 == s_find.queue_count) && (s_find.busy > 0))
+        {
+            pthread_cond_wait(&s_find.cond, &s_find.lock);
+        }
+        if (s_find.queue_count > 0)
+        {
+            directory = s_find.p_queue[--s_find.queue_count];
+            s_find.busy++;
+            pthread_mutex_unlock(&s_find.lock);
+            if (false == __atomic_load_n(&s_find.stop, __ATOMIC_RELAXED))
+            {
+                fatfs_find_directory(&directory);
+            }
+            else
+            {
+                /* Drain queue without reading */
+            }
+            free(directory.p_path);
+            pthread_mutex_lock(&s_find.lock);
+            s_find.busy--;
+            if ((0 == s_find.busy) && (0 == s_find.queue_count))
+            {
+                pthread_cond_broadcast(&s_find.cond);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else
+        {
+            /* Queue is empty and nobody can add more */
+            done = true;
+        }
+    }
+    pthread_mutex_unlock(&s_find.lock);
+
+    return NULL;
+}
+
+/* Function is used to compile query into predicate */
+fatfs_error_enum_t fatfs_find_compile(const fatfs_find_query_struct_t *const
+                                      p_query,
+                                      fatfs_find_predicate_struct_t *const
+                                      p_predicate)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const uint8_t *p_globs[2] = {p_query->p_name, p_query->p_prune};
+    uint8_t *p_compiled[2] = {p_predicate->name, p_predicate->prune};
+    const fatfs_modified_date_struct_t *p_date = NULL;
+    const fatfs_modified_time_struct_t *p_time = NULL;
+    uint32_t stamp = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    memset(p_predicate, 0, sizeof(fatfs_find_predicate_struct_t));
+    for (i = 0; i < 2; i++)
+    {
+        if ((p_globs[i] != NULL) &&
+                (strlen(p_globs[i]) < FATFS_FILE_NAME_SIZE))
+        {
+            for (j = 0; p_globs[i][j] != '\0'; j++)
+            {
+                p_compiled[i][j] = (uint8_t)toupper(p_globs[i][j]);
+            }
+            p_compiled[i][j] = '\0';
+        }
+        else if (p_globs[i] != NULL)
+        {
+            error = FATFS_INITIALIZE_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    /* A lone '*' needs no name, so drop it */
+    if (0 == strcmp(p_predicate->name, "*"))
+    {
+        p_predicate->name[0] = '\0';
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    p_predicate->attribute_mask = p_query->attribute_mask;
+    p_predicate->attribute_value = p_query->attribute_value &
+                                   p_query->attribute_mask;
+    p_predicate->min_size = p_query->min_size;
+    p_predicate->max_size = (0 == p_query->max_size) ? UINT32_MAX :
+                            p_query->max_size;
+    p_predicate->max_depth = p_query->max_depth;
+
+    /* Packed as on disk, so raw stamps compare as plain integers */
+    p_predicate->max_stamp = UINT32_MAX;
+    for (i = 0; i < 2; i++)
+    {
+        p_date = (0 == i) ? &p_query->from_date : &p_query->to_date;
+        p_time = (0 == i) ? &p_query->from_time : &p_query->to_time;
+        if (p_date->year >= 1980)
+        {
+            stamp = ((uint32_t)(p_date->year - 1980) << 25) |
+                    ((uint32_t)p_date->month << 21) |
+                    ((uint32_t)p_date->day << 16) |
+                    ((uint32_t)p_time->hour << 11) |
+                    ((uint32_t)p_time->minute << 5) |
+                    ((uint32_t)p_time->second / 2);
+            if (0 == i)
+            {
+                p_predicate->min_stamp = stamp;
+            }
+            else
+            {
+                p_predicate->max_stamp = stamp;
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to find entries matching predicate */
+fatfs_error_enum_t fatfs_find(const fatfs_find_predicate_struct_t *const
+                              p_predicate, const uint32_t threads,
+                              fatfs_find_callback_t callback,
+                              void *p_context,
+                              fatfs_find_stats_struct_t *const p_stats)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    pthread_t workers[FATFS_FIND_MAX_THREADS];
+    uint32_t worker_count = (0 == threads) ? FATFS_FIND_DEFAULT_THREADS :
+                            threads;
+    uint32_t started = 0;
+    uint32_t cluster = 0;
+    uint32_t next = 0;
+
+    memset(&s_find, 0, sizeof(s_find));
+    pthread_mutex_init(&s_find.lock, NULL);
+    pthread_mutex_init(&s_find.callback_lock, NULL);
+    pthread_cond_init(&s_find.cond, NULL);
+    s_find.p_predicate = p_predicate;
+    s_find.callback = callback;
+    s_find.p_context = p_context;
+    s_find.p_boot = fatfs_get_boot_sector();
+    s_find.max_cluster = s_find.p_boot->cluster_count + 2;
+    s_find.bad_cluster = (12 == s_find.p_boot->fat_type) ? 0xFF7 : 0xFFF7;
+    s_find.cluster_bytes = s_find.p_boot->byte_per_sector *
+                           s_find.p_boot->sector_per_cluster;
+    worker_count = (worker_count > FATFS_FIND_MAX_THREADS) ?
+                   FATFS_FIND_MAX_THREADS : worker_count;
+    s_find.p_next = (uint32_t *)calloc(s_find.max_cluster, sizeof(uint32_t));
+    s_find.p_owned = (uint8_t *)calloc((s_find.max_cluster + 7) / 8, 1);
+    if ((NULL == s_find.p_next) || (NULL == s_find.p_owned) ||
+            (0 == s_find.p_boot->cluster_count))
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+    else
+    {
+        /* One pass over FAT, walkers never touch it again */
+        for (cluster = 2; (cluster < s_find.max_cluster) &&
+                (SUCCESS == error); cluster++)
+        {
+            next = cluster;
+            error = fatfs_get_next_cluster(&next);
+            s_find.p_next[cluster] = next;
+        }
+    }
+    if (SUCCESS == error)
+    {
+        fatfs_find_push(0, 1, "");
+        for (started = 0; started < worker_count; started++)
+        {
+            if (pthread_create(&workers[started], NULL, fatfs_find_worker,
+                               NULL) != 0)
+            {
+                break;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        if (0 == started)
+        {
+            fatfs_find_worker(NULL);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        while (started > 0)
+        {
+            pthread_join(workers[--started], NULL);
+        }
+        error = (true == s_find.failed) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_stats != NULL)
+    {
+        *p_stats = s_find.stats;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(s_find.p_next);
+    free(s_find.p_owned);
+    free(s_find.p_queue);
+    pthread_mutex_destroy(&s_find.lock);
+    pthread_mutex_destroy(&s_find.callback_lock);
+    pthread_cond_destroy(&s_find.cond);
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
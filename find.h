@@ -0,0 +1,109 @@
+#ifndef _FIND_H_
+#define _FIND_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_FIND_PATH_SIZE 1024U
+
+typedef enum
+{
+    FATFS_FIND_CONTINUE,        /* Keep searching */
+    FATFS_FIND_SKIP,            /* Do not descend into matched directory */
+    FATFS_FIND_STOP             /* End search */
+} fatfs_find_action_enum_t;
+
+/*
+ * Query as written by caller. Zero fields do not restrict, so a zeroed
+ * query matches every entry. Name globs know '*', '?' and '[a-z]' sets,
+ * '[!...]' negates a set, case is ignored.
+ */
+typedef struct
+{
+    const uint8_t *p_name;      /* Glob on long or 8.3 name, NULL for any */
+    const uint8_t *p_prune;     /* Glob of directories not descended */
+    uint8_t attribute_mask;     /* Attribute bits to compare */
+    uint8_t attribute_value;    /* Expected value of those bits */
+    uint32_t min_size;
+    uint32_t max_size;          /* 0 for no upper limit */
+    fatfs_modified_date_struct_t from_date;    /* Year 0 for no lower limit */
+    fatfs_modified_time_struct_t from_time;
+    fatfs_modified_date_struct_t to_date;      /* Year 0 for no upper limit */
+    fatfs_modified_time_struct_t to_time;
+    uint32_t max_depth;         /* 1 for root only, 0 for no limit */
+} fatfs_find_query_struct_t;
+
+/* Query in the form compared against raw directory entries */
+typedef struct
+{
+    uint8_t name[FATFS_FILE_NAME_SIZE];     /* Upper case, empty for any */
+    uint8_t prune[FATFS_FILE_NAME_SIZE];    /* Upper case, empty for none */
+    uint8_t attribute_mask;
+    uint8_t attribute_value;
+    uint32_t min_size;
+    uint32_t max_size;
+    uint32_t min_stamp;         /* FAT date << 16 | FAT time */
+    uint32_t max_stamp;
+    uint32_t max_depth;
+} fatfs_find_predicate_struct_t;
+
+typedef struct
+{
+    uint32_t directories;       /* Directories read */
+    uint32_t entries;           /* Entries tested */
+    uint32_t names;             /* Entries whose names are decoded */
+    uint32_t matches;
+} fatfs_find_stats_struct_t;
+
+/**
+ * @brief Called once per match, calls never overlap
+ *
+ * @param [in] p_path is path of entry from root, "/DIR/NAME"
+ * @param [in] p_info is entry
+ * @param [in] p_context is context given to fatfs_find
+ * @return fatfs_find_action_enum_t is how search goes on
+ */
+typedef fatfs_find_action_enum_t (*fatfs_find_callback_t)(
+    const uint8_t *const p_path,
+    const fatfs_entry_info_struct_t *const p_info, void *p_context);
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Compile query into predicate
+ *
+ * @param [in] p_query is query
+ * @param [out] p_predicate is predicate
+ * @return fatfs_error_enum_t is FATFS_INITIALIZE_FAILED if a glob is too long
+ */
+fatfs_error_enum_t fatfs_find_compile(const fatfs_find_query_struct_t *const
+                                      p_query,
+                                      fatfs_find_predicate_struct_t *const
+                                      p_predicate);
+
+/**
+ * @brief Find entries of volume opened by fatfs_init matching predicate
+ *
+ * Attributes, size and date are tested on raw entries first, names are
+ * decoded only for entries passing them and for directories to descend.
+ * Matches are given to callback as soon as they are found, in no order.
+ *
+ * @param [in] p_predicate is predicate made by fatfs_find_compile
+ * @param [in] threads is number of directory walkers, 0 for default
+ * @param [in] callback is function called for each match
+ * @param [in] p_context is passed to callback
+ * @param [out] p_stats is amount of work done, NULL if not needed
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_find(const fatfs_find_predicate_struct_t *const
+                              p_predicate, const uint32_t threads,
+                              fatfs_find_callback_t callback,
+                              void *p_context,
+                              fatfs_find_stats_struct_t *const p_stats);
+
+#endif /* _FIND_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
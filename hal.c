@@ -1,107 +1,1765 @@
-/*******************************************************************************
- * Includes
- ******************************************************************************/
-#include <stdio.h>
-#include <stdint.h>
-#include <stdbool.h>
-
-/*******************************************************************************
- * Includes
- ******************************************************************************/
-#define KMC_DEFAULT_SECTOR_SIZE 512U
-
-/*******************************************************************************
- * Global Variables
- ******************************************************************************/
-static FILE *sp_disk = NULL;
-static uint16_t s_byte_per_sector = 0;
-
-/*******************************************************************************
- * Codes
- ******************************************************************************/
-/* Function is used to initialize HAL */
-bool kmc_init(const uint8_t *const file_path)
-{
-    bool retVal = true;
-
-    sp_disk = fopen(file_path, "rb");
-    if (sp_disk != NULL)
-    {
-        s_byte_per_sector = KMC_DEFAULT_SECTOR_SIZE;
-    }
-    else
-    {
-        retVal = false;
-    }
-
-    return retVal;
-}
-
-/* Function is used to update size of sector */
-void kmc_update_sector_size(const uint16_t size)
-{
-    s_byte_per_sector = size;
-}
-
-/* Function is used to read sector */
-int32_t kmc_read_sector(uint32_t index, uint8_t *p_buff)
-{
-    int32_t retVal = 0;
-
-    if ((sp_disk != NULL) && (p_buff != NULL))
-    {
-        if (index != 0)
-        {
-            fseek(sp_disk, KMC_DEFAULT_SECTOR_SIZE +
-                  s_byte_per_sector * (index - 1),
-                  SEEK_SET);
-        }
-        else
-        {
-            /* Do nothing */
-        }
-        retVal = fread(p_buff, sizeof(uint8_t), s_byte_per_sector, sp_disk);
-    }
-    else
-    {
-        /* Do nothing */
-    }
-
-    return retVal;
-}
-
-/* Function is used to read multi sector */
-int32_t kmc_read_multi_sector(uint32_t index, uint32_t num,
-                              uint8_t *p_buff)
-{
-    int32_t retVal = 0;
-    uint8_t i = 0;
-    uint16_t temp = 0;
-
-    if ((sp_disk != NULL) && (p_buff != NULL))
-    {
-        for (i = 0; i < num; i++)
-        {
-            temp = kmc_read_sector(index + i, p_buff + i * s_byte_per_sector);
-            retVal += (uint32_t)temp;
-        }
-    }
-    else
-    {
-        /* Do nothing */
-    }
-
-    return retVal;
-}
-
-/* Function is used to de-initialize HAL */
-void kmc_deinit(void)
-{
-    fclose(sp_disk);
-    sp_disk = NULL;
-    s_byte_per_sector = 0;
-}
-
-/*******************************************************************************
- * EOF
- ******************************************************************************/
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#define _GNU_SOURCE /* O_DIRECT */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "hal.h"
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#define KMC_DEFAULT_SECTOR_SIZE 512U
+/* Alignment accepted by O_DIRECT on 512e and 4Kn devices */
+#define KMC_DIRECT_ALIGN 4096U
+#define KMC_DIRECT_BUFF_SIZE (1024U * 1024U)
+#define KMC_DIRECT_POOL_COUNT 4U
+
+#define kmc_align_down(value) ((value) & ~(uint64_t)(KMC_DIRECT_ALIGN - 1))
+#define kmc_align_up(value) kmc_align_down((value) + KMC_DIRECT_ALIGN - 1)
+
+/* Overlay record: block number then data, slot N is N records after header */
+#define KMC_OVERLAY_RECORD_SIZE (8U + KMC_OVERLAY_BLOCK_SIZE)
+#define kmc_overlay_record_offset(slot) (KMC_OVERLAY_HEADER_SIZE + \
+        (uint64_t)(slot) * KMC_OVERLAY_RECORD_SIZE)
+
+#define KMC_OVERLAY_INDEX_SIZE 1024U
+/* Header flag set while blocks are copied into base */
+#define KMC_OVERLAY_COMMITTING 0x01U
+#define KMC_OVERLAY_FLAGS_OFFSET 5U
+/* Identity bytes of header, modification time is last */
+#define KMC_OVERLAY_IDENTITY_OFFSET 8U
+#define KMC_OVERLAY_MTIME_OFFSET 32U
+/* Decompressed chunks kept for random sector access */
+#define KMC_CHUNK_CACHE_COUNT 16U
+#define KMC_OVERLAY_HASH_PRIME 0x9E3779B97F4A7C15ULL
+
+typedef struct
+{
+    uint64_t block;
+    uint32_t slot;          /* Record index + 1, 0 is empty entry */
+} kmc_overlay_entry_struct_t;
+
+typedef struct
+{
+    uint32_t chunk;
+    uint64_t last_use;
+    uint8_t *p_data;        /* NULL is empty entry */
+} kmc_chunk_cache_struct_t;
+
+/*******************************************************************************
+ * Global Variables
+ ******************************************************************************/
+static FILE *sp_disk = NULL;
+static int s_disk_fd = -1;
+static uint8_t *sp_disk_map = NULL;
+static uint64_t s_disk_size = 0;
+static kmc_backend_enum_t s_backend = KMC_BACKEND_STDIO;
+static kmc_backend_enum_t s_default_backend = KMC_BACKEND_STDIO;
+static uint16_t s_byte_per_sector = 0;
+static FILE *sp_trace = NULL;
+static uint64_t s_trace_start = 0;
+static bool s_direct_io = false;
+static uint8_t *sp_direct_pool[KMC_DIRECT_POOL_COUNT];
+static bool s_direct_busy[KMC_DIRECT_POOL_COUNT];
+static pthread_mutex_t s_direct_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_stdio_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_writable = false;
+static const uint8_t *sp_overlay_path = NULL;
+static uint8_t *sp_overlay_base_path = NULL;
+static uint64_t s_overlay_base_size = 0;
+static int s_overlay_fd = -1;
+static kmc_overlay_entry_struct_t *sp_overlay_index = NULL;
+static uint32_t s_overlay_capacity = 0;
+static uint32_t s_overlay_count = 0;
+static pthread_rwlock_t s_overlay_lock = PTHREAD_RWLOCK_INITIALIZER;
+static uint64_t *sp_chunk_index = NULL;
+static uint32_t s_chunk_size = 0;
+static uint32_t s_chunk_count = 0;
+static uint8_t *sp_chunk_stored = NULL;
+static kmc_chunk_cache_struct_t s_chunk_cache[KMC_CHUNK_CACHE_COUNT];
+static uint64_t s_chunk_clock = 0;
+static kmc_chunk_stats_struct_t s_chunk_stats;
+static pthread_mutex_t s_chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+static kmc_io_stats_struct_t s_io_stats;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Get byte offset of sector in image
+ *
+ * @param [in] index is index-th sector
+ * @return uint64_t is byte offset
+ */
+static uint64_t kmc_sector_offset(const uint32_t index);
+
+/**
+ * @brief Get monotonic time
+ *
+ * @return uint64_t is time in nanosecond
+ */
+static uint64_t kmc_get_time(void);
+
+/**
+ * @brief Append one read operation to trace file
+ *
+ * @param [in] offset is byte offset of read
+ * @param [in] length is number of bytes read
+ * @param [in] timestamp is time of read in nanosecond
+ */
+static void kmc_trace_write(const uint64_t offset, const uint32_t length,
+                            const uint64_t timestamp);
+
+/**
+ * @brief Take aligned bounce buffer from pool
+ *
+ * @return uint8_t* is buffer of KMC_DIRECT_BUFF_SIZE bytes
+ */
+static uint8_t *kmc_direct_get_buffer(void);
+
+/**
+ * @brief Give bounce buffer back to pool
+ *
+ * @param [in] p_buff is buffer taken from pool
+ */
+static void kmc_direct_put_buffer(uint8_t *const p_buff);
+
+/**
+ * @brief Read bytes through O_DIRECT
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to read
+ * @param [inout] p_buff is where is data stored
+ * @return int32_t is number of bytes read
+ */
+static int32_t kmc_direct_read(const uint64_t offset, const uint32_t length,
+                               uint8_t *const p_buff);
+
+/**
+ * @brief Write through O_DIRECT, unaligned parts are read, patched, written
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to write
+ * @param [in] p_buff is data to write
+ * @return int32_t is number of bytes written
+ */
+static int32_t kmc_direct_write(const uint64_t offset, const uint32_t length,
+                                const uint8_t *const p_buff);
+
+/**
+ * @brief Read header and offset index of chunked image
+ *
+ * @return true if image is a valid chunked image
+ * @return false if header or index can not be read
+ */
+static bool kmc_chunk_open(void);
+
+/**
+ * @brief Get decompressed chunk from cache, decompress it on miss
+ *
+ * Caller holds s_chunk_lock while data is used.
+ *
+ * @param [in] chunk is index of chunk
+ * @return uint8_t* is data of chunk, NULL if chunk can not be decompressed
+ */
+static uint8_t *kmc_chunk_get(const uint32_t chunk);
+
+/**
+ * @brief Read bytes of chunked image
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to read
+ * @param [inout] p_buff is where is data stored
+ * @return int32_t is number of bytes read
+ */
+static int32_t kmc_chunk_read(const uint64_t offset, const uint32_t length,
+                              uint8_t *const p_buff);
+
+/**
+ * @brief Read bytes from base image with selected backend
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to read
+ * @param [inout] p_buff is where is data stored
+ * @return int32_t is number of bytes read
+ */
+static int32_t kmc_base_read(const uint64_t offset, uint32_t length,
+                             uint8_t *const p_buff);
+
+/**
+ * @brief Write bytes to base image with selected backend
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to write
+ * @param [in] p_buff is data to write
+ * @return int32_t is number of bytes written
+ */
+static int32_t kmc_base_write(const uint64_t offset, const uint32_t length,
+                              const uint8_t *const p_buff);
+
+/**
+ * @brief Find record of block in overlay index
+ *
+ * @param [in] block is block number in image
+ * @return uint32_t is record index + 1, 0 if block is not in overlay
+ */
+static uint32_t kmc_overlay_find(const uint64_t block);
+
+/**
+ * @brief Add record of block to overlay index, index grows when half full
+ *
+ * @param [in] block is block number in image
+ * @param [in] slot is record index + 1
+ * @return true if block is added
+ * @return false if index can not grow
+ */
+static bool kmc_overlay_insert(const uint64_t block, const uint32_t slot);
+
+/**
+ * @brief Make overlay header for base image as it is now
+ *
+ * @param [out] p_header is header of KMC_OVERLAY_HEADER_SIZE bytes
+ * @return true if base image can be stat'ed
+ * @return false if base image is gone
+ */
+static bool kmc_overlay_make_header(uint8_t *const p_header);
+
+/**
+ * @brief Open or create overlay file and rebuild index from its records
+ *
+ * @param [in] base_path is path to base image
+ * @return true if overlay is usable
+ * @return false if overlay belongs to another image or can not be opened
+ */
+static bool kmc_overlay_open(const uint8_t *const base_path);
+
+/**
+ * @brief Drop every record of overlay
+ *
+ * @return true if overlay is empty on disk
+ * @return false if overlay can not be truncated
+ */
+static bool kmc_overlay_reset(void);
+
+/**
+ * @brief Copy overlay blocks over data read from base image
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes in buff
+ * @param [inout] p_buff is data read from base image
+ */
+static void kmc_overlay_patch(const uint64_t offset, const uint32_t length,
+                              uint8_t *const p_buff);
+
+/**
+ * @brief Write bytes to overlay, partial blocks are completed from image
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to write
+ * @param [in] p_buff is data to write
+ * @return int32_t is number of bytes written
+ */
+static int32_t kmc_overlay_write(const uint64_t offset, const uint32_t length,
+                                 const uint8_t *const p_buff);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to get byte offset of sector */
+static uint64_t kmc_sector_offset(const uint32_t index)
+{
+    uint64_t offset = 0;
+
+    /* Sector 0 is read before sector size is known, sector N is N sectors in */
+    offset = (uint64_t)s_byte_per_sector * index;
+
+    return offset;
+}
+
+/* Function is used to get monotonic time */
+static uint64_t kmc_get_time(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Function is used to append record to trace file */
+static void kmc_trace_write(const uint64_t offset, const uint32_t length,
+                            const uint64_t timestamp)
+{
+    uint8_t record[KMC_TRACE_RECORD_SIZE];
+    uint8_t i = 0;
+
+    for (i = 0; i < 8; i++)
+    {
+        record[i] = (uint8_t)(offset >> (8 * i));
+        record[12 + i] = (uint8_t)(timestamp >> (8 * i));
+    }
+    for (i = 0; i < 4; i++)
+    {
+        record[8 + i] = (uint8_t)(length >> (8 * i));
+    }
+    fwrite(record, sizeof(uint8_t), KMC_TRACE_RECORD_SIZE, sp_trace);
+}
+
+/* Function is used to take bounce buffer */
+static uint8_t *kmc_direct_get_buffer(void)
+{
+    uint8_t *p_buff = NULL;
+    uint8_t i = 0;
+
+    pthread_mutex_lock(&s_direct_lock);
+    for (i = 0; (i < KMC_DIRECT_POOL_COUNT) && (NULL == p_buff); i++)
+    {
+        if (false == s_direct_busy[i])
+        {
+            if ((NULL == sp_direct_pool[i]) &&
+                    (posix_memalign((void **)&sp_direct_pool[i],
+                                    KMC_DIRECT_ALIGN,
+                                    KMC_DIRECT_BUFF_SIZE) != 0))
+            {
+                sp_direct_pool[i] = NULL;
+            }
+            else
+            {
+                s_direct_busy[i] = true;
+                p_buff = sp_direct_pool[i];
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    pthread_mutex_unlock(&s_direct_lock);
+    if ((NULL == p_buff) && (posix_memalign((void **)&p_buff, KMC_DIRECT_ALIGN,
+                                            KMC_DIRECT_BUFF_SIZE) != 0))
+    {
+        p_buff = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_buff;
+}
+
+/* Function is used to give back bounce buffer */
+static void kmc_direct_put_buffer(uint8_t *const p_buff)
+{
+    bool pooled = false;
+    uint8_t i = 0;
+
+    pthread_mutex_lock(&s_direct_lock);
+    for (i = 0; i < KMC_DIRECT_POOL_COUNT; i++)
+    {
+        if (p_buff == sp_direct_pool[i])
+        {
+            s_direct_busy[i] = false;
+            pooled = true;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    pthread_mutex_unlock(&s_direct_lock);
+    if (false == pooled)
+    {
+        free(p_buff);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to read through O_DIRECT */
+static int32_t kmc_direct_read(const uint64_t offset, const uint32_t length,
+                               uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    uint8_t *p_bounce = NULL;
+    uint64_t start = 0;
+    uint32_t chunk = 0;
+    uint32_t skip = 0;
+    ssize_t bytes = 0;
+
+    if ((0 == (offset % KMC_DIRECT_ALIGN)) &&
+            (0 == (length % KMC_DIRECT_ALIGN)) &&
+            (0 == ((uintptr_t)p_buff % KMC_DIRECT_ALIGN)))
+    {
+        /* Caller buffer is usable as is, no copy */
+        while ((uint32_t)retVal < length)
+        {
+            bytes = pread(s_disk_fd, p_buff + retVal, length - retVal,
+                          (off_t)(offset + retVal));
+            if (bytes > 0)
+            {
+                retVal += (int32_t)bytes;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        p_bounce = kmc_direct_get_buffer();
+        while ((p_bounce != NULL) && ((uint32_t)retVal < length))
+        {
+            start = kmc_align_down(offset + retVal);
+            skip = (uint32_t)(offset + retVal - start);
+            chunk = (uint32_t)kmc_align_up(skip + (length - retVal));
+            chunk = (chunk > KMC_DIRECT_BUFF_SIZE) ? KMC_DIRECT_BUFF_SIZE :
+                    chunk;
+            bytes = pread(s_disk_fd, p_bounce, chunk, (off_t)start);
+            if (bytes > (ssize_t)skip)
+            {
+                bytes -= skip;
+                if ((uint32_t)bytes > length - retVal)
+                {
+                    bytes = length - retVal;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+                memcpy(p_buff + retVal, p_bounce + skip, bytes);
+                retVal += (int32_t)bytes;
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (p_bounce != NULL)
+        {
+            kmc_direct_put_buffer(p_bounce);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return retVal;
+}
+
+/* Function is used to write through O_DIRECT */
+static int32_t kmc_direct_write(const uint64_t offset, const uint32_t length,
+                                const uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    uint8_t *p_bounce = NULL;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint32_t chunk = 0;
+    uint32_t span = 0;
+    uint32_t skip = 0;
+    uint32_t bytes = 0;
+    ssize_t got = 0;
+    int flags = 0;
+
+    p_bounce = kmc_direct_get_buffer();
+    /* Partial blocks are read back, writers must not overlap them */
+    pthread_mutex_lock(&s_write_lock);
+    while ((p_bounce != NULL) && ((uint32_t)retVal < length))
+    {
+        start = kmc_align_down(offset + retVal);
+        skip = (uint32_t)(offset + retVal - start);
+        chunk = (uint32_t)kmc_align_up(skip + (length - retVal));
+        chunk = (chunk > KMC_DIRECT_BUFF_SIZE) ? KMC_DIRECT_BUFF_SIZE : chunk;
+        bytes = chunk - skip;
+        bytes = (bytes > length - retVal) ? length - retVal : bytes;
+        got = ((skip > 0) || (skip + bytes < chunk)) ?
+              pread(s_disk_fd, p_bounce, chunk, (off_t)start) : (ssize_t)chunk;
+        if (got < 0)
+        {
+            break;
+        }
+        else
+        {
+            /* Block read short at end of image holds bytes of earlier use */
+            memset(p_bounce + got, 0, chunk - (uint32_t)got);
+            memcpy(p_bounce + skip, p_buff + retVal, bytes);
+        }
+        /* Last block of image is written only up to end of image */
+        end = (start + skip + bytes > s_disk_size) ? start + skip + bytes :
+              s_disk_size;
+        span = (start + chunk > end) ? (uint32_t)(end - start) : chunk;
+        if (span < chunk)
+        {
+            /* O_DIRECT takes whole blocks only, tail goes through cache */
+            flags = fcntl(s_disk_fd, F_GETFL);
+            fcntl(s_disk_fd, F_SETFL, flags & ~O_DIRECT);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        got = pwrite(s_disk_fd, p_bounce, span, (off_t)start);
+        if (span < chunk)
+        {
+            fcntl(s_disk_fd, F_SETFL, flags);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (got == (ssize_t)span)
+        {
+            retVal += (int32_t)bytes;
+            s_disk_size = end;
+        }
+        else
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_write_lock);
+    if (p_bounce != NULL)
+    {
+        kmc_direct_put_buffer(p_bounce);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to read header and index of chunked image */
+static bool kmc_chunk_open(void)
+{
+    bool retVal = true;
+    uint8_t header[KMC_CHUNK_HEADER_SIZE];
+    uint8_t *p_raw = NULL;
+    uint64_t index_bytes = 0;
+    uint32_t i = 0;
+    uint8_t j = 0;
+
+    retVal = (pread(s_disk_fd, header, KMC_CHUNK_HEADER_SIZE, 0) ==
+              KMC_CHUNK_HEADER_SIZE) &&
+             (0 == memcmp(header, KMC_CHUNK_MAGIC, KMC_CHUNK_MAGIC_BYTES)) &&
+             (KMC_CHUNK_VERSION == header[4]);
+    if (true == retVal)
+    {
+        s_disk_size = 0;
+        s_chunk_size = 0;
+        s_chunk_count = 0;
+        for (j = 0; j < 4; j++)
+        {
+            s_chunk_size |= (uint32_t)header[8 + j] << (8 * j);
+            s_chunk_count |= (uint32_t)header[12 + j] << (8 * j);
+        }
+        for (j = 0; j < 8; j++)
+        {
+            s_disk_size |= (uint64_t)header[16 + j] << (8 * j);
+        }
+        /* Exactly as many chunks as disk needs, no more */
+        retVal = (s_chunk_size > 0) && (s_chunk_size <= KMC_CHUNK_MAX_SIZE) &&
+                 ((uint64_t)s_chunk_count * s_chunk_size >= s_disk_size) &&
+                 (s_chunk_count <= s_disk_size / s_chunk_size +
+                  (0 != s_disk_size % s_chunk_size));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (true == retVal)
+    {
+        index_bytes = ((uint64_t)s_chunk_count + 1) * 8;
+        p_raw = (uint8_t *)malloc(index_bytes);
+        sp_chunk_index = (uint64_t *)malloc(((size_t)s_chunk_count + 1) *
+                                            sizeof(uint64_t));
+        sp_chunk_stored = (uint8_t *)malloc(compressBound(s_chunk_size));
+        retVal = (p_raw != NULL) && (sp_chunk_index != NULL) &&
+                 (sp_chunk_stored != NULL) &&
+                 (pread(s_disk_fd, p_raw, index_bytes,
+                        KMC_CHUNK_HEADER_SIZE) == (ssize_t)index_bytes);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (true == retVal) && (i <= s_chunk_count); i++)
+    {
+        sp_chunk_index[i] = 0;
+        for (j = 0; j < 8; j++)
+        {
+            sp_chunk_index[i] |= (uint64_t)p_raw[(size_t)i * 8 + j] <<
+                                 (8 * j);
+        }
+        /* Stored chunk must fit buffer it is read into */
+        retVal = (0 == i) ||
+                 ((sp_chunk_index[i] >= sp_chunk_index[i - 1]) &&
+                  (sp_chunk_index[i] - sp_chunk_index[i - 1] <=
+                   compressBound(s_chunk_size)));
+    }
+    free(p_raw);
+    if (false == retVal)
+    {
+        free(sp_chunk_index);
+        sp_chunk_index = NULL;
+        free(sp_chunk_stored);
+        sp_chunk_stored = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    memset(&s_chunk_stats, 0, sizeof(s_chunk_stats));
+
+    return retVal;
+}
+
+/* Function is used to get decompressed chunk */
+static uint8_t *kmc_chunk_get(const uint32_t chunk)
+{
+    uint8_t *p_data = NULL;
+    uint64_t stored = sp_chunk_index[chunk + 1] - sp_chunk_index[chunk];
+    uint64_t remain = s_disk_size - (uint64_t)chunk * s_chunk_size;
+    uint32_t expected = (remain > s_chunk_size) ? s_chunk_size :
+                        (uint32_t)remain;
+    uLongf bytes = expected;
+    uint32_t victim = 0;
+    uint32_t i = 0;
+
+    for (i = 0; (i < KMC_CHUNK_CACHE_COUNT) && (NULL == p_data); i++)
+    {
+        if ((s_chunk_cache[i].p_data != NULL) &&
+                (chunk == s_chunk_cache[i].chunk))
+        {
+            p_data = s_chunk_cache[i].p_data;
+            s_chunk_cache[i].last_use = ++s_chunk_clock;
+            s_chunk_stats.hits++;
+        }
+        else if ((s_chunk_cache[victim].p_data != NULL) &&
+                 ((NULL == s_chunk_cache[i].p_data) ||
+                  (s_chunk_cache[i].last_use <
+                   s_chunk_cache[victim].last_use)))
+        {
+            /* Empty entry or least recently used one is replaced on miss */
+            victim = i;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if (NULL == p_data)
+    {
+        if (NULL == s_chunk_cache[victim].p_data)
+        {
+            s_chunk_cache[victim].p_data = (uint8_t *)malloc(s_chunk_size);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        p_data = s_chunk_cache[victim].p_data;
+        /* Chunk is stored raw when compression does not help */
+        if ((p_data != NULL) &&
+                (pread(s_disk_fd, (stored == expected) ? p_data :
+                       sp_chunk_stored, stored,
+                       (off_t)sp_chunk_index[chunk]) == (ssize_t)stored) &&
+                ((stored == expected) ||
+                 ((Z_OK == uncompress(p_data, &bytes, sp_chunk_stored,
+                                      (uLong)stored)) &&
+                  (expected == bytes))))
+        {
+            s_chunk_cache[victim].chunk = chunk;
+            s_chunk_cache[victim].last_use = ++s_chunk_clock;
+            s_chunk_stats.misses++;
+            s_chunk_stats.stored_bytes += stored;
+        }
+        else
+        {
+            free(s_chunk_cache[victim].p_data);
+            s_chunk_cache[victim].p_data = NULL;
+            p_data = NULL;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_data;
+}
+
+/* Function is used to read bytes of chunked image */
+static int32_t kmc_chunk_read(const uint64_t offset, const uint32_t length,
+                              uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    uint8_t *p_data = NULL;
+    uint64_t end = (offset + length > s_disk_size) ? s_disk_size :
+                   offset + length;
+    uint64_t position = offset;
+    uint32_t chunk = 0;
+    uint32_t skip = 0;
+    uint32_t bytes = 0;
+    bool valid = true;
+
+    pthread_mutex_lock(&s_chunk_lock);
+    while ((true == valid) && (position < end))
+    {
+        chunk = (uint32_t)(position / s_chunk_size);
+        skip = (uint32_t)(position % s_chunk_size);
+        bytes = s_chunk_size - skip;
+        bytes = (bytes > end - position) ? (uint32_t)(end - position) : bytes;
+        if (sp_chunk_index[chunk + 1] == sp_chunk_index[chunk])
+        {
+            /* Elided chunk, nothing is stored */
+            memset(p_buff + retVal, 0, bytes);
+            retVal += (int32_t)bytes;
+            s_chunk_stats.zero_reads++;
+        }
+        else
+        {
+            p_data = kmc_chunk_get(chunk);
+            valid = (p_data != NULL);
+            if (true == valid)
+            {
+                memcpy(p_buff + retVal, p_data + skip, bytes);
+                retVal += (int32_t)bytes;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        position += bytes;
+    }
+    pthread_mutex_unlock(&s_chunk_lock);
+
+    return retVal;
+}
+
+/* Function is used to read bytes from base image */
+static int32_t kmc_base_read(const uint64_t offset, uint32_t length,
+                             uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    ssize_t bytes = 0;
+
+    switch (s_backend)
+    {
+        case KMC_BACKEND_STDIO:
+            /* Seek and read share file position, keep them together */
+            pthread_mutex_lock(&s_stdio_lock);
+            if ((sp_disk != NULL) &&
+                    (0 == fseeko(sp_disk, (off_t)offset, SEEK_SET)))
+            {
+                retVal = (int32_t)fread(p_buff, sizeof(uint8_t), length,
+                                        sp_disk);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            pthread_mutex_unlock(&s_stdio_lock);
+            break;
+        case KMC_BACKEND_PREAD:
+            while ((s_disk_fd >= 0) && ((uint32_t)retVal < length))
+            {
+                bytes = pread(s_disk_fd, p_buff + retVal, length - retVal,
+                              (off_t)(offset + retVal));
+                if (bytes > 0)
+                {
+                    retVal += (int32_t)bytes;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            break;
+        case KMC_BACKEND_DIRECT:
+            if (true == s_direct_io)
+            {
+                retVal = kmc_direct_read(offset, length, p_buff);
+            }
+            else if (s_disk_fd >= 0)
+            {
+                retVal = (int32_t)pread(s_disk_fd, p_buff, length,
+                                        (off_t)offset);
+                posix_fadvise(s_disk_fd, (off_t)offset, length,
+                              POSIX_FADV_DONTNEED);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            retVal = (retVal < 0) ? 0 : retVal;
+            break;
+        case KMC_BACKEND_MMAP:
+            if ((sp_disk_map != NULL) && (offset < s_disk_size))
+            {
+                if (length > s_disk_size - offset)
+                {
+                    length = (uint32_t)(s_disk_size - offset);
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+                memcpy(p_buff, sp_disk_map + offset, length);
+                retVal = (int32_t)length;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            break;
+        case KMC_BACKEND_CHUNKED:
+            if (sp_chunk_index != NULL)
+            {
+                retVal = kmc_chunk_read(offset, length, p_buff);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            break;
+        default:
+            break;
+    }
+
+    return retVal;
+}
+
+/* Function is used to write bytes to base image */
+static int32_t kmc_base_write(const uint64_t offset, const uint32_t length,
+                              const uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    ssize_t bytes = 0;
+
+    switch (s_backend)
+    {
+        case KMC_BACKEND_STDIO:
+            pthread_mutex_lock(&s_stdio_lock);
+            if ((sp_disk != NULL) &&
+                    (0 == fseeko(sp_disk, (off_t)offset, SEEK_SET)))
+            {
+                retVal = (int32_t)fwrite(p_buff, sizeof(uint8_t), length,
+                                         sp_disk);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            pthread_mutex_unlock(&s_stdio_lock);
+            break;
+        case KMC_BACKEND_DIRECT:
+        case KMC_BACKEND_PREAD:
+            if ((KMC_BACKEND_DIRECT == s_backend) && (true == s_direct_io))
+            {
+                retVal = kmc_direct_write(offset, length, p_buff);
+            }
+            else
+            {
+                while ((s_disk_fd >= 0) && ((uint32_t)retVal < length))
+                {
+                    bytes = pwrite(s_disk_fd, p_buff + retVal,
+                                   length - retVal,
+                                   (off_t)(offset + retVal));
+                    if (bytes > 0)
+                    {
+                        retVal += (int32_t)bytes;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+            }
+            break;
+        case KMC_BACKEND_CHUNKED:
+            /* Compressed image is read-only, writes need an overlay */
+            break;
+        case KMC_BACKEND_MMAP:
+            /* Mapping has fixed size, image can not grow */
+            if ((sp_disk_map != NULL) && (true == s_writable) &&
+                    (NULL == sp_overlay_path) &&
+                    (offset + length <= s_disk_size))
+            {
+                memcpy(sp_disk_map + offset, p_buff, length);
+                retVal = (int32_t)length;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            break;
+        default:
+            break;
+    }
+
+    return retVal;
+}
+
+/* Function is used to find block in overlay index */
+static uint32_t kmc_overlay_find(const uint64_t block)
+{
+    uint32_t slot = 0;
+    uint32_t i = 0;
+
+    if (s_overlay_capacity > 0)
+    {
+        i = (uint32_t)((block * KMC_OVERLAY_HASH_PRIME) >> 32) &
+            (s_overlay_capacity - 1);
+        while ((0 == slot) && (sp_overlay_index[i].slot != 0))
+        {
+            if (block == sp_overlay_index[i].block)
+            {
+                slot = sp_overlay_index[i].slot;
+            }
+            else
+            {
+                i = (i + 1) & (s_overlay_capacity - 1);
+            }
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return slot;
+}
+
+/* Function is used to add block to overlay index */
+static bool kmc_overlay_insert(const uint64_t block, const uint32_t slot)
+{
+    bool retVal = true;
+    kmc_overlay_entry_struct_t *p_old = sp_overlay_index;
+    uint32_t old_capacity = s_overlay_capacity;
+    uint32_t i = 0;
+
+    if (2 * (s_overlay_count + 1) > s_overlay_capacity)
+    {
+        s_overlay_capacity = (0 == old_capacity) ? KMC_OVERLAY_INDEX_SIZE :
+                             old_capacity * 2;
+        sp_overlay_index = (kmc_overlay_entry_struct_t *)calloc(
+                               s_overlay_capacity,
+                               sizeof(kmc_overlay_entry_struct_t));
+        if (NULL == sp_overlay_index)
+        {
+            sp_overlay_index = p_old;
+            s_overlay_capacity = old_capacity;
+            retVal = false;
+        }
+        else
+        {
+            for (i = 0; i < old_capacity; i++)
+            {
+                if (p_old[i].slot != 0)
+                {
+                    kmc_overlay_insert(p_old[i].block, p_old[i].slot);
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            free(p_old);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (true == retVal)
+    {
+        i = (uint32_t)((block * KMC_OVERLAY_HASH_PRIME) >> 32) &
+            (s_overlay_capacity - 1);
+        while ((sp_overlay_index[i].slot != 0) &&
+                (sp_overlay_index[i].block != block))
+        {
+            i = (i + 1) & (s_overlay_capacity - 1);
+        }
+        sp_overlay_index[i].block = block;
+        sp_overlay_index[i].slot = slot;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to make overlay header */
+static bool kmc_overlay_make_header(uint8_t *const p_header)
+{
+    bool retVal = false;
+    struct stat info;
+    uint64_t identity[4] = {0};
+    uint8_t i = 0;
+    uint8_t j = 0;
+
+    retVal = (0 == stat(sp_overlay_base_path, &info));
+    identity[0] = (uint64_t)info.st_dev;
+    identity[1] = (uint64_t)info.st_ino;
+    identity[2] = (uint64_t)info.st_mtim.tv_sec;
+    identity[3] = (uint64_t)info.st_mtim.tv_nsec;
+    memset(p_header, 0, KMC_OVERLAY_HEADER_SIZE);
+    memcpy(p_header, KMC_OVERLAY_MAGIC, KMC_OVERLAY_MAGIC_BYTES);
+    p_header[4] = (uint8_t)KMC_OVERLAY_VERSION;
+    p_header[6] = (uint8_t)KMC_OVERLAY_BLOCK_SIZE;
+    p_header[7] = (uint8_t)(KMC_OVERLAY_BLOCK_SIZE >> 8);
+    for (i = 0; i < 8; i++)
+    {
+        p_header[KMC_OVERLAY_IDENTITY_OFFSET + i] =
+            (uint8_t)(s_overlay_base_size >> (8 * i));
+        for (j = 0; j < 4; j++)
+        {
+            p_header[KMC_OVERLAY_IDENTITY_OFFSET + 8 * (j + 1) + i] =
+                (uint8_t)(identity[j] >> (8 * i));
+        }
+    }
+
+    return retVal;
+}
+
+/* Function is used to open overlay file */
+static bool kmc_overlay_open(const uint8_t *const base_path)
+{
+    bool retVal = true;
+    uint8_t header[KMC_OVERLAY_HEADER_SIZE] = {0};
+    uint8_t expected[KMC_OVERLAY_HEADER_SIZE] = {0};
+    uint32_t compared = 0;
+    uint8_t tag[8];
+    struct stat info;
+    uint64_t size = 0;
+    uint64_t block = 0;
+    uint32_t count = 0;
+    uint32_t slot = 0;
+    uint8_t i = 0;
+
+    retVal = (0 == stat(base_path, &info));
+    s_overlay_base_size = (true == retVal) ? (uint64_t)info.st_size : 0;
+    /* Compressed file is smaller than image it holds */
+    s_overlay_base_size = (KMC_BACKEND_CHUNKED == s_backend) ? s_disk_size :
+                          s_overlay_base_size;
+    sp_overlay_base_path = (true == retVal) ? (uint8_t *)strdup(base_path) :
+                           NULL;
+    s_overlay_fd = (NULL == sp_overlay_base_path) ? -1 :
+                   open(sp_overlay_path, O_RDWR | O_CREAT, 0644);
+    retVal = (s_overlay_fd >= 0) && (0 == fstat(s_overlay_fd, &info));
+    size = (true == retVal) ? (uint64_t)info.st_size : 0;
+    retVal = (true == retVal) && kmc_overlay_make_header(expected);
+    if ((true == retVal) && (size < KMC_OVERLAY_HEADER_SIZE))
+    {
+        /* New instance is only a header, no block of base is copied */
+        retVal = (0 == ftruncate(s_overlay_fd, 0)) &&
+                 (pwrite(s_overlay_fd, expected, KMC_OVERLAY_HEADER_SIZE, 0) ==
+                  KMC_OVERLAY_HEADER_SIZE);
+        size = KMC_OVERLAY_HEADER_SIZE;
+    }
+    else if (true == retVal)
+    {
+        retVal = (pread(s_overlay_fd, header, KMC_OVERLAY_HEADER_SIZE, 0) ==
+                  KMC_OVERLAY_HEADER_SIZE) &&
+                 (0 == memcmp(header, expected, KMC_OVERLAY_FLAGS_OFFSET)) &&
+                 (header[6] == expected[6]) && (header[7] == expected[7]);
+        /* Commit cut by a crash changed base time, it is only repeated */
+        compared = (header[KMC_OVERLAY_FLAGS_OFFSET] & KMC_OVERLAY_COMMITTING) ?
+                   KMC_OVERLAY_MTIME_OFFSET : KMC_OVERLAY_HEADER_SIZE;
+        /* Overlay of another base image would return wrong data */
+        retVal = (true == retVal) &&
+                 (0 == memcmp(header + KMC_OVERLAY_IDENTITY_OFFSET,
+                              expected + KMC_OVERLAY_IDENTITY_OFFSET,
+                              compared - KMC_OVERLAY_IDENTITY_OFFSET));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    count = (true == retVal) ? (uint32_t)((size - KMC_OVERLAY_HEADER_SIZE) /
+                                          KMC_OVERLAY_RECORD_SIZE) : 0;
+    for (slot = 0; (true == retVal) && (slot < count); slot++)
+    {
+        retVal = (pread(s_overlay_fd, tag, sizeof(tag),
+                        (off_t)kmc_overlay_record_offset(slot)) ==
+                  sizeof(tag));
+        for (i = 0, block = 0; i < 8; i++)
+        {
+            block |= (uint64_t)tag[i] << (8 * i);
+        }
+        retVal = (true == retVal) && kmc_overlay_insert(block, slot + 1);
+        s_overlay_count += (true == retVal);
+    }
+    if ((true == retVal) && (size != kmc_overlay_record_offset(count)))
+    {
+        /* Record cut by a crash was never added to index */
+        retVal = (0 == ftruncate(s_overlay_fd,
+                                 (off_t)kmc_overlay_record_offset(count)));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to drop every record of overlay */
+static bool kmc_overlay_reset(void)
+{
+    free(sp_overlay_index);
+    sp_overlay_index = NULL;
+    s_overlay_capacity = 0;
+    s_overlay_count = 0;
+
+    return (0 == ftruncate(s_overlay_fd, KMC_OVERLAY_HEADER_SIZE)) &&
+           (0 == fsync(s_overlay_fd));
+}
+
+/* Function is used to copy overlay blocks over base data */
+static void kmc_overlay_patch(const uint64_t offset, const uint32_t length,
+                              uint8_t *const p_buff)
+{
+    uint8_t record[KMC_OVERLAY_RECORD_SIZE];
+    uint64_t block = offset / KMC_OVERLAY_BLOCK_SIZE;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint32_t slot = 0;
+
+    pthread_rwlock_rdlock(&s_overlay_lock);
+    for (; (s_overlay_count > 0) &&
+            (block * KMC_OVERLAY_BLOCK_SIZE < offset + length); block++)
+    {
+        slot = kmc_overlay_find(block);
+        if ((slot != 0) &&
+                (pread(s_overlay_fd, record, KMC_OVERLAY_RECORD_SIZE,
+                       (off_t)kmc_overlay_record_offset(slot - 1)) ==
+                 KMC_OVERLAY_RECORD_SIZE))
+        {
+            start = block * KMC_OVERLAY_BLOCK_SIZE;
+            end = start + KMC_OVERLAY_BLOCK_SIZE;
+            start = (start < offset) ? offset : start;
+            end = (end > offset + length) ? offset + length : end;
+            memcpy(p_buff + (start - offset),
+                   record + 8 + (start - block * KMC_OVERLAY_BLOCK_SIZE),
+                   end - start);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    pthread_rwlock_unlock(&s_overlay_lock);
+}
+
+/* Function is used to write bytes to overlay */
+static int32_t kmc_overlay_write(const uint64_t offset, const uint32_t length,
+                                 const uint8_t *const p_buff)
+{
+    int32_t retVal = 0;
+    uint8_t record[KMC_OVERLAY_RECORD_SIZE];
+    uint64_t block = 0;
+    uint32_t skip = 0;
+    uint32_t bytes = 0;
+    uint32_t slot = 0;
+    bool valid = (offset + length <= s_overlay_base_size);
+    uint8_t i = 0;
+
+    /* Image keeps size of base */
+    pthread_rwlock_wrlock(&s_overlay_lock);
+    while ((true == valid) && ((uint32_t)retVal < length))
+    {
+        block = (offset + retVal) / KMC_OVERLAY_BLOCK_SIZE;
+        skip = (uint32_t)((offset + retVal) % KMC_OVERLAY_BLOCK_SIZE);
+        bytes = KMC_OVERLAY_BLOCK_SIZE - skip;
+        bytes = (bytes > length - retVal) ? length - retVal : bytes;
+        slot = kmc_overlay_find(block);
+        memset(record, 0, KMC_OVERLAY_RECORD_SIZE);
+        if ((bytes < KMC_OVERLAY_BLOCK_SIZE) && (slot != 0))
+        {
+            valid = (pread(s_overlay_fd, record, KMC_OVERLAY_RECORD_SIZE,
+                           (off_t)kmc_overlay_record_offset(slot - 1)) ==
+                     KMC_OVERLAY_RECORD_SIZE);
+        }
+        else if (bytes < KMC_OVERLAY_BLOCK_SIZE)
+        {
+            /* Last block of base can be short, rest stays zero */
+            kmc_base_read(block * KMC_OVERLAY_BLOCK_SIZE,
+                          KMC_OVERLAY_BLOCK_SIZE, record + 8);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        for (i = 0; i < 8; i++)
+        {
+            record[i] = (uint8_t)(block >> (8 * i));
+        }
+        memcpy(record + 8 + skip, p_buff + retVal, bytes);
+        /* Rewritten block keeps its record, new block is appended */
+        slot = (0 == slot) ? s_overlay_count + 1 : slot;
+        valid = (true == valid) &&
+                (pwrite(s_overlay_fd, record, KMC_OVERLAY_RECORD_SIZE,
+                        (off_t)kmc_overlay_record_offset(slot - 1)) ==
+                 KMC_OVERLAY_RECORD_SIZE);
+        if ((true == valid) && (slot > s_overlay_count))
+        {
+            valid = kmc_overlay_insert(block, slot);
+            s_overlay_count += (true == valid);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        retVal += (true == valid) ? (int32_t)bytes : 0;
+    }
+    pthread_rwlock_unlock(&s_overlay_lock);
+
+    return retVal;
+}
+
+/* Function is used to initialize HAL */
+bool kmc_init(const uint8_t *const file_path)
+{
+    return kmc_init_backend(file_path, s_default_backend);
+}
+
+/* Function is used to select backend of kmc_init */
+void kmc_set_backend(const kmc_backend_enum_t backend)
+{
+    s_default_backend = backend;
+}
+
+/* Function is used to initialize HAL with a specific backend */
+bool kmc_init_backend(const uint8_t *const file_path,
+                      const kmc_backend_enum_t backend)
+{
+    bool retVal = true;
+    /* Base stays read-only under an overlay, writes go to overlay */
+    bool writable = (true == s_writable) && (NULL == sp_overlay_path);
+    struct stat info;
+
+    s_backend = backend;
+    if (KMC_BACKEND_STDIO == backend)
+    {
+        sp_disk = fopen(file_path, (true == writable) ? "r+b" : "rb");
+        retVal = (sp_disk != NULL);
+    }
+    else
+    {
+        s_direct_io = false;
+        if (KMC_BACKEND_DIRECT == backend)
+        {
+            s_disk_fd = open(file_path, ((true == writable) ? O_RDWR :
+                                         O_RDONLY) | O_DIRECT);
+            s_direct_io = (s_disk_fd >= 0);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (s_disk_fd < 0)
+        {
+            /* File system without O_DIRECT, read normally and drop cache */
+            s_disk_fd = open(file_path, (true == writable) ? O_RDWR :
+                             O_RDONLY);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if ((s_disk_fd >= 0) && (0 == fstat(s_disk_fd, &info)))
+        {
+            s_disk_size = (uint64_t)info.st_size;
+            if (KMC_BACKEND_CHUNKED == backend)
+            {
+                /* Size of image becomes size of decompressed data */
+                retVal = kmc_chunk_open();
+            }
+            else if ((KMC_BACKEND_MMAP == backend) && (s_disk_size > 0))
+            {
+                sp_disk_map = mmap(NULL, s_disk_size, (true == writable) ?
+                                   (PROT_READ | PROT_WRITE) : PROT_READ,
+                                   MAP_SHARED, s_disk_fd, 0);
+                if (MAP_FAILED == sp_disk_map)
+                {
+                    sp_disk_map = NULL;
+                    retVal = false;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else
+        {
+            retVal = false;
+        }
+        if ((false == retVal) && (s_disk_fd >= 0))
+        {
+            close(s_disk_fd);
+            s_disk_fd = -1;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if ((true == retVal) && (sp_overlay_path != NULL) &&
+            (false == kmc_overlay_open(file_path)))
+    {
+        kmc_deinit();
+        retVal = false;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (true == retVal)
+    {
+        s_byte_per_sector = KMC_DEFAULT_SECTOR_SIZE;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to update size of sector */
+void kmc_update_sector_size(const uint16_t size)
+{
+    s_byte_per_sector = size;
+}
+
+/* Function is used to read raw bytes */
+int32_t kmc_read_bytes(uint64_t offset, uint32_t length, uint8_t *p_buff)
+{
+    int32_t retVal = 0;
+    uint64_t timestamp = 0;
+
+    if (p_buff != NULL)
+    {
+        if (sp_trace != NULL)
+        {
+            timestamp = kmc_get_time() - s_trace_start;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        retVal = kmc_base_read(offset, length, p_buff);
+        __atomic_fetch_add(&s_io_stats.reads, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s_io_stats.read_bytes, (uint64_t)retVal,
+                           __ATOMIC_RELAXED);
+        if ((s_overlay_fd >= 0) && (retVal > 0))
+        {
+            kmc_overlay_patch(offset, (uint32_t)retVal, p_buff);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (sp_trace != NULL)
+        {
+            kmc_trace_write(offset, length, timestamp);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to read sector */
+int32_t kmc_read_sector(uint32_t index, uint8_t *p_buff)
+{
+    return kmc_read_bytes(kmc_sector_offset(index), s_byte_per_sector,
+                          p_buff);
+}
+
+/* Function is used to read multi sector */
+int32_t kmc_read_multi_sector(uint32_t index, uint32_t num,
+                              uint8_t *p_buff)
+{
+    int32_t retVal = 0;
+
+    if ((p_buff != NULL) && (num > 0))
+    {
+        retVal = kmc_read_bytes(kmc_sector_offset(index),
+                                num * s_byte_per_sector, p_buff);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to open next image writable */
+void kmc_set_writable(const bool writable)
+{
+    s_writable = writable;
+}
+
+/* Function is used to write raw bytes */
+int32_t kmc_write_bytes(uint64_t offset, uint32_t length,
+                        const uint8_t *p_buff)
+{
+    int32_t retVal = 0;
+
+    if (p_buff != NULL)
+    {
+        if (s_overlay_fd >= 0)
+        {
+            retVal = kmc_overlay_write(offset, length, p_buff);
+        }
+        else
+        {
+            retVal = kmc_base_write(offset, length, p_buff);
+        }
+        __atomic_fetch_add(&s_io_stats.writes, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s_io_stats.written_bytes, (uint64_t)retVal,
+                           __ATOMIC_RELAXED);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to write multi sector */
+int32_t kmc_write_multi_sector(uint32_t index, uint32_t num,
+                               const uint8_t *p_buff)
+{
+    return kmc_write_bytes(kmc_sector_offset(index),
+                           num * s_byte_per_sector, p_buff);
+}
+
+/* Function is used to make writes durable */
+bool kmc_flush(void)
+{
+    bool retVal = true;
+
+    if (s_overlay_fd >= 0)
+    {
+        retVal = (0 == fsync(s_overlay_fd));
+    }
+    else if (sp_disk != NULL)
+    {
+        pthread_mutex_lock(&s_stdio_lock);
+        retVal = (0 == fflush(sp_disk)) && (0 == fsync(fileno(sp_disk)));
+        pthread_mutex_unlock(&s_stdio_lock);
+    }
+    else if (sp_disk_map != NULL)
+    {
+        retVal = (0 == msync(sp_disk_map, s_disk_size, MS_SYNC));
+    }
+    else if (s_disk_fd >= 0)
+    {
+        retVal = (0 == fsync(s_disk_fd));
+    }
+    else
+    {
+        retVal = false;
+    }
+
+    return retVal;
+}
+
+/* Function is used to put next image under an overlay */
+void kmc_set_overlay(const uint8_t *const overlay_path)
+{
+    sp_overlay_path = overlay_path;
+}
+
+/* Function is used to copy overlay blocks into base image */
+bool kmc_overlay_commit(void)
+{
+    /* Blocks can not be patched into a compressed image */
+    bool retVal = (s_overlay_fd >= 0) && (s_backend != KMC_BACKEND_CHUNKED);
+    uint8_t record[KMC_OVERLAY_RECORD_SIZE];
+    uint8_t header[KMC_OVERLAY_HEADER_SIZE];
+    uint8_t flags = KMC_OVERLAY_COMMITTING;
+    uint64_t block = 0;
+    uint32_t bytes = 0;
+    uint32_t slot = 0;
+    uint8_t i = 0;
+    int fd = -1;
+
+    pthread_rwlock_wrlock(&s_overlay_lock);
+    /* Mark commit durable first, base time changes on first write */
+    retVal = (true == retVal) &&
+             (1 == pwrite(s_overlay_fd, &flags, 1, KMC_OVERLAY_FLAGS_OFFSET)) &&
+             (0 == fsync(s_overlay_fd));
+    fd = (true == retVal) ? open(sp_overlay_base_path, O_RDWR) : -1;
+    retVal = (fd >= 0);
+    for (slot = 0; (true == retVal) && (slot < s_overlay_count); slot++)
+    {
+        retVal = (pread(s_overlay_fd, record, KMC_OVERLAY_RECORD_SIZE,
+                        (off_t)kmc_overlay_record_offset(slot)) ==
+                  KMC_OVERLAY_RECORD_SIZE);
+        for (i = 0, block = 0; i < 8; i++)
+        {
+            block |= (uint64_t)record[i] << (8 * i);
+        }
+        bytes = (uint32_t)(s_overlay_base_size - block *
+                           KMC_OVERLAY_BLOCK_SIZE);
+        bytes = (bytes > KMC_OVERLAY_BLOCK_SIZE) ? KMC_OVERLAY_BLOCK_SIZE :
+                bytes;
+        retVal = (true == retVal) &&
+                 (pwrite(fd, record + 8, bytes,
+                         (off_t)(block * KMC_OVERLAY_BLOCK_SIZE)) ==
+                  (ssize_t)bytes);
+    }
+    /* Base is durable before overlay is dropped, crash only repeats commit */
+    retVal = (true == retVal) && (0 == fsync(fd));
+    /* Overlay now belongs to base as commit left it */
+    retVal = (true == retVal) && kmc_overlay_make_header(header) &&
+             (pwrite(s_overlay_fd, header, KMC_OVERLAY_HEADER_SIZE, 0) ==
+              KMC_OVERLAY_HEADER_SIZE);
+    retVal = (true == retVal) && kmc_overlay_reset();
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    pthread_rwlock_unlock(&s_overlay_lock);
+    if (sp_disk != NULL)
+    {
+        /* Drop data stdio buffered before commit */
+        pthread_mutex_lock(&s_stdio_lock);
+        fflush(sp_disk);
+        pthread_mutex_unlock(&s_stdio_lock);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to drop every write kept in overlay */
+bool kmc_overlay_discard(void)
+{
+    bool retVal = (s_overlay_fd >= 0);
+
+    pthread_rwlock_wrlock(&s_overlay_lock);
+    retVal = (true == retVal) && kmc_overlay_reset();
+    pthread_rwlock_unlock(&s_overlay_lock);
+
+    return retVal;
+}
+
+/* Function is used to get number of blocks in overlay */
+uint32_t kmc_overlay_get_count(void)
+{
+    return s_overlay_count;
+}
+
+/* Function is used to get number of reads and writes */
+void kmc_get_io_stats(kmc_io_stats_struct_t *const p_stats)
+{
+    p_stats->reads = __atomic_load_n(&s_io_stats.reads, __ATOMIC_RELAXED);
+    p_stats->read_bytes = __atomic_load_n(&s_io_stats.read_bytes,
+                                          __ATOMIC_RELAXED);
+    p_stats->writes = __atomic_load_n(&s_io_stats.writes, __ATOMIC_RELAXED);
+    p_stats->written_bytes = __atomic_load_n(&s_io_stats.written_bytes,
+                             __ATOMIC_RELAXED);
+}
+
+/* Function is used to get cache statistics of chunked backend */
+void kmc_get_chunk_stats(kmc_chunk_stats_struct_t *const p_stats)
+{
+    pthread_mutex_lock(&s_chunk_lock);
+    *p_stats = s_chunk_stats;
+    pthread_mutex_unlock(&s_chunk_lock);
+}
+
+/* Function is used to get byte offset of sector */
+uint64_t kmc_get_sector_offset(const uint32_t index)
+{
+    return kmc_sector_offset(index);
+}
+
+/* Function is used to get file descriptor of image */
+int kmc_get_fd(void)
+{
+    int fd = s_disk_fd;
+
+    if ((s_overlay_fd >= 0) || (KMC_BACKEND_CHUNKED == s_backend))
+    {
+        /* Kernel copy would skip overlay blocks or copy compressed data */
+        fd = -1;
+    }
+    else if (sp_disk != NULL)
+    {
+        fd = fileno(sp_disk);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return fd;
+}
+
+/* Function is used to start recording trace */
+bool kmc_trace_start(const uint8_t *const trace_path)
+{
+    bool retVal = false;
+    uint8_t header[KMC_TRACE_HEADER_SIZE] = {0};
+
+    kmc_trace_stop();
+    sp_trace = fopen(trace_path, "wb");
+    if (sp_trace != NULL)
+    {
+        memcpy(header, KMC_TRACE_MAGIC, KMC_TRACE_MAGIC_BYTES);
+        header[4] = (uint8_t)KMC_TRACE_VERSION;
+        header[6] = (uint8_t)KMC_TRACE_RECORD_SIZE;
+        fwrite(header, sizeof(uint8_t), KMC_TRACE_HEADER_SIZE, sp_trace);
+        s_trace_start = kmc_get_time();
+        retVal = true;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to stop recording trace */
+void kmc_trace_stop(void)
+{
+    if (sp_trace != NULL)
+    {
+        fclose(sp_trace);
+        sp_trace = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to de-initialize HAL */
+void kmc_deinit(void)
+{
+    uint8_t i = 0;
+
+    if (sp_disk != NULL)
+    {
+        fclose(sp_disk);
+        sp_disk = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (sp_disk_map != NULL)
+    {
+        munmap(sp_disk_map, s_disk_size);
+        sp_disk_map = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (s_disk_fd >= 0)
+    {
+        close(s_disk_fd);
+        s_disk_fd = -1;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    pthread_mutex_lock(&s_direct_lock);
+    for (i = 0; i < KMC_DIRECT_POOL_COUNT; i++)
+    {
+        free(sp_direct_pool[i]);
+        sp_direct_pool[i] = NULL;
+        s_direct_busy[i] = false;
+    }
+    pthread_mutex_unlock(&s_direct_lock);
+    if (s_overlay_fd >= 0)
+    {
+        close(s_overlay_fd);
+        s_overlay_fd = -1;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(sp_overlay_index);
+    sp_overlay_index = NULL;
+    s_overlay_capacity = 0;
+    s_overlay_count = 0;
+    pthread_mutex_lock(&s_chunk_lock);
+    for (i = 0; i < KMC_CHUNK_CACHE_COUNT; i++)
+    {
+        free(s_chunk_cache[i].p_data);
+        s_chunk_cache[i].p_data = NULL;
+    }
+    free(sp_chunk_index);
+    sp_chunk_index = NULL;
+    free(sp_chunk_stored);
+    sp_chunk_stored = NULL;
+    s_chunk_size = 0;
+    s_chunk_count = 0;
+    pthread_mutex_unlock(&s_chunk_lock);
+    free(sp_overlay_base_path);
+    sp_overlay_base_path = NULL;
+    s_overlay_base_size = 0;
+    s_direct_io = false;
+    s_disk_size = 0;
+    s_byte_per_sector = 0;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -1,53 +1,270 @@
-#ifndef _HAL_H_
-#define _HAL_H_
-
-/*******************************************************************************
- * API
- ******************************************************************************/
-/**
- * @brief Initialize for HAL
- *
- * @param [in] file_path is path to file
- * @return true if initialize success
- * @return false if initialize fail
- */
-bool kmc_init(const uint8_t *const file_path);
-
-/**
- * @brief Update size of sector
- *
- * @param [in] size is size to update
- */
-void kmc_update_sector_size(const uint16_t size);
-
-/**
- * @brief Read sector to buff
- *
- * @param [in] index is index-th sector
- * @param [inout] buff is where is sector stored
- * @return int32_t is number of bytes read
- */
-int32_t kmc_read_sector(uint32_t index, uint8_t *p_buff);
-
-/**
- * @brief Read multi sector to buff
- *
- * @param [in] index is index-th sector
- * @param [in] num is number of sector want to read
- * @param [inout] buff is where is sector stored
- * @return int32_t is number of bytes read
- */
-int32_t kmc_read_multi_sector(uint32_t index, uint32_t num,
-                              uint8_t *p_buff);
-
-/**
- * @brief De-initialize HAL
- *
- */
-void kmc_deinit(void);
-
-#endif /* _HAL_H_ */
-
-/*******************************************************************************
- * EOF
- ******************************************************************************/
+#ifndef _HAL_H_
+#define _HAL_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+/* Trace file layout: header followed by fixed-size little-endian records */
+#define KMC_TRACE_MAGIC "KMCT"
+#define KMC_TRACE_MAGIC_BYTES 4U
+#define KMC_TRACE_VERSION 1U
+#define KMC_TRACE_HEADER_SIZE 8U
+#define KMC_TRACE_RECORD_SIZE 20U
+
+/*
+ * Overlay file layout: header followed by block number and block records.
+ * Header holds size, device, inode and modification time of base image.
+ */
+#define KMC_OVERLAY_MAGIC "KMCO"
+#define KMC_OVERLAY_MAGIC_BYTES 4U
+#define KMC_OVERLAY_VERSION 2U
+#define KMC_OVERLAY_HEADER_SIZE 48U
+#define KMC_OVERLAY_BLOCK_SIZE 512U
+
+/*
+ * Chunked image layout: header, chunk count + 1 file offsets, then chunks.
+ * Chunk of zero length is all zero, chunk as long as its data is stored
+ * raw, any other chunk is a zlib stream.
+ */
+#define KMC_CHUNK_MAGIC "KMCZ"
+#define KMC_CHUNK_MAGIC_BYTES 4U
+#define KMC_CHUNK_VERSION 1U
+#define KMC_CHUNK_HEADER_SIZE 32U
+#define KMC_CHUNK_DEFAULT_SIZE (64U * 1024U)
+/* Largest chunk, KMC_CHUNK_CACHE_COUNT of them are kept decompressed */
+#define KMC_CHUNK_MAX_SIZE (4U * 1024U * 1024U)
+
+typedef enum
+{
+    KMC_BACKEND_STDIO,
+    KMC_BACKEND_PREAD,
+    KMC_BACKEND_MMAP,
+    KMC_BACKEND_DIRECT,
+    KMC_BACKEND_CHUNKED
+} kmc_backend_enum_t;
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t length;
+    uint64_t timestamp;
+} kmc_trace_record_struct_t;
+
+typedef struct
+{
+    uint64_t reads;
+    uint64_t read_bytes;
+    uint64_t writes;
+    uint64_t written_bytes;
+} kmc_io_stats_struct_t;
+
+typedef struct
+{
+    uint64_t hits;          /* Reads served from decompressed chunks */
+    uint64_t misses;        /* Chunks read and decompressed */
+    uint64_t zero_reads;    /* Reads of elided zero chunks */
+    uint64_t stored_bytes;  /* Compressed bytes read from image */
+} kmc_chunk_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Initialize for HAL
+ *
+ * @param [in] file_path is path to file
+ * @return true if initialize success
+ * @return false if initialize fail
+ */
+bool kmc_init(const uint8_t *const file_path);
+
+/**
+ * @brief Select backend used by kmc_init, stdio by default
+ *
+ * @param [in] backend is backend used to access file
+ */
+void kmc_set_backend(const kmc_backend_enum_t backend);
+
+/**
+ * @brief Initialize for HAL with a specific backend
+ *
+ * KMC_BACKEND_DIRECT bypasses the page cache with O_DIRECT and aligned
+ * bounce buffers, it falls back to uncached pread where O_DIRECT is not
+ * supported. KMC_BACKEND_CHUNKED reads images made by kmc_chunk_convert,
+ * it is read-only unless an overlay is set.
+ *
+ * @param [in] file_path is path to file
+ * @param [in] backend is backend used to access file
+ * @return true if initialize success
+ * @return false if initialize fail
+ */
+bool kmc_init_backend(const uint8_t *const file_path,
+                      const kmc_backend_enum_t backend);
+
+/**
+ * @brief Update size of sector, 512 to 4096 bytes
+ *
+ * @param [in] size is size to update
+ */
+void kmc_update_sector_size(const uint16_t size);
+
+/**
+ * @brief Read sector to buff
+ *
+ * @param [in] index is index-th sector
+ * @param [inout] buff is where is sector stored
+ * @return int32_t is number of bytes read
+ */
+int32_t kmc_read_sector(uint32_t index, uint8_t *p_buff);
+
+/**
+ * @brief Read multi sector to buff
+ *
+ * @param [in] index is index-th sector
+ * @param [in] num is number of sector want to read
+ * @param [inout] buff is where is sector stored
+ * @return int32_t is number of bytes read
+ */
+int32_t kmc_read_multi_sector(uint32_t index, uint32_t num,
+                              uint8_t *p_buff);
+
+/**
+ * @brief Read raw bytes of image to buff
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to read
+ * @param [inout] p_buff is where is data stored
+ * @return int32_t is number of bytes read
+ */
+int32_t kmc_read_bytes(uint64_t offset, uint32_t length, uint8_t *p_buff);
+
+/**
+ * @brief Open images writable from next kmc_init, read-only by default
+ *
+ * @param [in] writable is true to allow kmc_write_bytes
+ */
+void kmc_set_writable(const bool writable);
+
+/**
+ * @brief Write raw bytes from buff to image
+ *
+ * @param [in] offset is byte offset in image
+ * @param [in] length is number of bytes want to write
+ * @param [in] p_buff is data to write
+ * @return int32_t is number of bytes written
+ */
+int32_t kmc_write_bytes(uint64_t offset, uint32_t length,
+                        const uint8_t *p_buff);
+
+/**
+ * @brief Write multi sector from buff
+ *
+ * @param [in] index is index-th sector
+ * @param [in] num is number of sector want to write
+ * @param [in] p_buff is data to write
+ * @return int32_t is number of bytes written
+ */
+int32_t kmc_write_multi_sector(uint32_t index, uint32_t num,
+                               const uint8_t *p_buff);
+
+/**
+ * @brief Make every write reach the disk
+ *
+ * @return true if data is on disk
+ * @return false if flush fail
+ */
+bool kmc_flush(void);
+
+/**
+ * @brief Put image of next kmc_init under a copy-on-write overlay
+ *
+ * Base image is opened read-only, every write goes to overlay file as
+ * KMC_OVERLAY_BLOCK_SIZE blocks and reads see those blocks over base.
+ * Overlay file is created if missing and reused if it belongs to the
+ * same base file, unchanged since overlay was made or last committed.
+ * NULL turns overlay off.
+ *
+ * @param [in] overlay_path is path to overlay file, kept until kmc_init
+ */
+void kmc_set_overlay(const uint8_t *const overlay_path);
+
+/**
+ * @brief Copy every overlay block into base image, then empty overlay
+ *
+ * @return true if base image holds every write
+ * @return false if commit fail, overlay is kept and commit can be repeated
+ */
+bool kmc_overlay_commit(void);
+
+/**
+ * @brief Drop every write kept in overlay, image reads as base again
+ *
+ * Data cached above HAL, such as FAT, is stale after discard.
+ *
+ * @return true if overlay is empty
+ * @return false if overlay is not opened or can not be truncated
+ */
+bool kmc_overlay_discard(void);
+
+/**
+ * @brief Get number of blocks kept in overlay
+ *
+ * @return uint32_t is number of blocks
+ */
+uint32_t kmc_overlay_get_count(void);
+
+/**
+ * @brief Get number of reads and writes made through HAL since start
+ *
+ * @param [out] p_stats is statistics, counters only grow
+ */
+void kmc_get_io_stats(kmc_io_stats_struct_t *const p_stats);
+
+/**
+ * @brief Get cache statistics of chunked backend since kmc_init
+ *
+ * @param [out] p_stats is statistics
+ */
+void kmc_get_chunk_stats(kmc_chunk_stats_struct_t *const p_stats);
+
+/**
+ * @brief Get byte offset of sector in image
+ *
+ * @param [in] index is index-th sector
+ * @return uint64_t is byte offset
+ */
+uint64_t kmc_get_sector_offset(const uint32_t index);
+
+/**
+ * @brief Get file descriptor of image for kernel-side copies
+ *
+ * @return int is file descriptor, -1 if image is not opened
+ */
+int kmc_get_fd(void);
+
+/**
+ * @brief Start recording every read into a trace file
+ *
+ * @param [in] trace_path is path to trace file
+ * @return true if trace file is created
+ * @return false if trace file can not be created
+ */
+bool kmc_trace_start(const uint8_t *const trace_path);
+
+/**
+ * @brief Stop recording and close trace file
+ *
+ */
+void kmc_trace_stop(void);
+
+/**
+ * @brief De-initialize HAL
+ *
+ */
+void kmc_deinit(void);
+
+#endif /* _HAL_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,312 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "hash.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_CRC32C_POLY 0x82F63B78U
+#define FATFS_HASH64_PRIME1 0x9E3779B185EBCA87ULL
+#define FATFS_HASH64_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define FATFS_HASH64_PRIME3 0x165667B19E3779F9ULL
+#define FATFS_HASH64_PRIME4 0x85EBCA77C2B2AE63ULL
+#define FATFS_HASH64_PRIME5 0x27D4EB2F165667C5ULL
+#define FATFS_HASH64_STRIPE 32U
+
+#define rotate_left(value, bits) \
+    (((value) << (bits)) | ((value) >> (64 - (bits))))
+
+static uint32_t s_crc32c_table[256];
+static bool s_crc32c_hardware = false;
+static pthread_once_t s_crc32c_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Build CRC table and detect SSE4.2, run once
+ *
+ */
+static void fatfs_crc32c_setup(void);
+
+#if defined(__x86_64__)
+/**
+ * @brief Continue CRC32C with SSE4.2 instructions
+ *
+ * @param [in] crc is inverted CRC of data before
+ * @param [in] p_data is data to add
+ * @param [in] length is number of bytes of data
+ * @return uint32_t is inverted CRC of all data
+ */
+static uint32_t fatfs_crc32c_hardware(uint32_t crc, const uint8_t *p_data,
+                                      uint32_t length);
+#endif
+
+/**
+ * @brief Mix one 8-byte lane into accumulator
+ *
+ * @param [in] acc is accumulator
+ * @param [in] lane is input lane
+ * @return uint64_t is new accumulator
+ */
+static uint64_t fatfs_hash64_round(uint64_t acc, const uint64_t lane);
+
+/**
+ * @brief Read 8 bytes in little-endian order
+ *
+ * @param [in] p_data is data to read
+ * @return uint64_t is value
+ */
+static uint64_t fatfs_hash64_read(const uint8_t *const p_data);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to set up CRC32C */
+static void fatfs_crc32c_setup(void)
+{
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t crc = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = i;
+        for (j = 0; j < 8; j++)
+        {
+            crc = (crc >> 1) ^ ((0 - (crc & 1)) & FATFS_CRC32C_POLY);
+        }
+        s_crc32c_table[i] = crc;
+    }
+#if defined(__x86_64__)
+    s_crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#if defined(__x86_64__)
+/* Function is used to continue CRC32C with SSE4.2 */
+__attribute__((target("sse4.2")))
+static uint32_t fatfs_crc32c_hardware(uint32_t crc, const uint8_t *p_data,
+                                      uint32_t length)
+{
+    uint64_t crc64 = crc;
+    uint64_t lane = 0;
+
+    while (length >= 8)
+    {
+        memcpy(&lane, p_data, sizeof(lane));
+        crc64 = _mm_crc32_u64(crc64, lane);
+        p_data += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (length > 0)
+    {
+        crc = _mm_crc32_u8(crc, *p_data++);
+        length--;
+    }
+
+    return crc;
+}
+#endif
+
+/* Function is used to continue CRC32C */
+uint32_t fatfs_crc32c(uint32_t crc, const uint8_t *p_data, uint32_t length)
+{
+    pthread_once(&s_crc32c_once, fatfs_crc32c_setup);
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (true == s_crc32c_hardware)
+    {
+        crc = fatfs_crc32c_hardware(crc, p_data, length);
+        length = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+#endif
+    while (length > 0)
+    {
+        crc = (crc >> 8) ^ s_crc32c_table[(crc ^ *p_data++) & 0xFF];
+        length--;
+    }
+
+    return ~crc;
+}
+
+/* Function is used to mix lane into accumulator */
+static uint64_t fatfs_hash64_round(uint64_t acc, const uint64_t lane)
+{
+    acc += lane * FATFS_HASH64_PRIME2;
+    acc = rotate_left(acc, 31);
+
+    return acc * FATFS_HASH64_PRIME1;
+}
+
+/* Function is used to read little-endian 8 bytes */
+static uint64_t fatfs_hash64_read(const uint8_t *const p_data)
+{
+    uint64_t value = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < 8; i++)
+    {
+        value |= (uint64_t)p_data[i] << (8 * i);
+    }
+
+    return value;
+}
+
+/* Function is used to start 64-bit hash */
+void fatfs_hash64_init(fatfs_hash64_struct_t *const p_state)
+{
+    memset(p_state, 0, sizeof(fatfs_hash64_struct_t));
+    p_state->acc[0] = FATFS_HASH64_PRIME1 + FATFS_HASH64_PRIME2;
+    p_state->acc[1] = FATFS_HASH64_PRIME2;
+    p_state->acc[2] = 0;
+    p_state->acc[3] = 0 - FATFS_HASH64_PRIME1;
+}
+
+/* Function is used to add data to 64-bit hash */
+void fatfs_hash64_update(fatfs_hash64_struct_t *const p_state,
+                         const uint8_t *p_data, uint32_t length)
+{
+    uint32_t bytes = 0;
+    uint8_t i = 0;
+
+    p_state->total += length;
+    if (p_state->tail_bytes > 0)
+    {
+        bytes = FATFS_HASH64_STRIPE - p_state->tail_bytes;
+        bytes = (bytes > length) ? length : bytes;
+        memcpy(p_state->tail + p_state->tail_bytes, p_data, bytes);
+        p_state->tail_bytes += bytes;
+        p_data += bytes;
+        length -= bytes;
+        if (FATFS_HASH64_STRIPE == p_state->tail_bytes)
+        {
+            for (i = 0; i < 4; i++)
+            {
+                p_state->acc[i] =
+                    fatfs_hash64_round(p_state->acc[i],
+                                       fatfs_hash64_read(p_state->tail + 8 * i));
+            }
+            p_state->tail_bytes = 0;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    while (length >= FATFS_HASH64_STRIPE)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            p_state->acc[i] =
+                fatfs_hash64_round(p_state->acc[i],
+                                   fatfs_hash64_read(p_data + 8 * i));
+        }
+        p_data += FATFS_HASH64_STRIPE;
+        length -= FATFS_HASH64_STRIPE;
+    }
+    if (length > 0)
+    {
+        memcpy(p_state->tail + p_state->tail_bytes, p_data, length);
+        p_state->tail_bytes += length;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to get 64-bit hash */
+uint64_t fatfs_hash64_final(const fatfs_hash64_struct_t *const p_state)
+{
+    uint64_t hash = 0;
+    uint64_t value = 0;
+    uint32_t position = 0;
+    uint8_t i = 0;
+
+    if (p_state->total >= FATFS_HASH64_STRIPE)
+    {
+        hash = rotate_left(p_state->acc[0], 1) +
+               rotate_left(p_state->acc[1], 7) +
+               rotate_left(p_state->acc[2], 12) +
+               rotate_left(p_state->acc[3], 18);
+        for (i = 0; i < 4; i++)
+        {
+            hash ^= fatfs_hash64_round(0, p_state->acc[i]);
+            hash = hash * FATFS_HASH64_PRIME1 + FATFS_HASH64_PRIME4;
+        }
+    }
+    else
+    {
+        hash = FATFS_HASH64_PRIME5;
+    }
+    hash += p_state->total;
+    while (position + 8 <= p_state->tail_bytes)
+    {
+        hash ^= fatfs_hash64_round(0, fatfs_hash64_read(p_state->tail +
+                                   position));
+        hash = rotate_left(hash, 27) * FATFS_HASH64_PRIME1 +
+               FATFS_HASH64_PRIME4;
+        position += 8;
+    }
+    if (position + 4 <= p_state->tail_bytes)
+    {
+        value = (uint64_t)p_state->tail[position] |
+                ((uint64_t)p_state->tail[position + 1] << 8) |
+                ((uint64_t)p_state->tail[position + 2] << 16) |
+                ((uint64_t)p_state->tail[position + 3] << 24);
+        hash ^= value * FATFS_HASH64_PRIME1;
+        hash = rotate_left(hash, 23) * FATFS_HASH64_PRIME2 +
+               FATFS_HASH64_PRIME3;
+        position += 4;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    while (position < p_state->tail_bytes)
+    {
+        hash ^= p_state->tail[position++] * FATFS_HASH64_PRIME5;
+        hash = rotate_left(hash, 11) * FATFS_HASH64_PRIME1;
+    }
+    hash ^= hash >> 33;
+    hash *= FATFS_HASH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= FATFS_HASH64_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/* Function is used to hash data */
+uint64_t fatfs_hash64(const uint8_t *const p_data, const uint32_t length)
+{
+    fatfs_hash64_struct_t state;
+
+    fatfs_hash64_init(&state);
+    fatfs_hash64_update(&state, p_data, length);
+
+    return fatfs_hash64_final(&state);
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,66 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint64_t acc[4];
+    uint64_t total;
+    uint8_t tail[32];
+    uint32_t tail_bytes;
+} fatfs_hash64_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Continue CRC32C (Castagnoli) over data, uses SSE4.2 when present
+ *
+ * @param [in] crc is CRC of data before, 0 to start
+ * @param [in] p_data is data to add
+ * @param [in] length is number of bytes of data
+ * @return uint32_t is CRC of all data
+ */
+uint32_t fatfs_crc32c(uint32_t crc, const uint8_t *p_data, uint32_t length);
+
+/**
+ * @brief Start 64-bit hash, same values as XXH64 with seed 0
+ *
+ * @param [out] p_state is hash state
+ */
+void fatfs_hash64_init(fatfs_hash64_struct_t *const p_state);
+
+/**
+ * @brief Add data to 64-bit hash
+ *
+ * @param [inout] p_state is hash state
+ * @param [in] p_data is data to add
+ * @param [in] length is number of bytes of data
+ */
+void fatfs_hash64_update(fatfs_hash64_struct_t *const p_state,
+                         const uint8_t *p_data, uint32_t length);
+
+/**
+ * @brief Get 64-bit hash of all data added
+ *
+ * @param [in] p_state is hash state
+ * @return uint64_t is hash
+ */
+uint64_t fatfs_hash64_final(const fatfs_hash64_struct_t *const p_state);
+
+/**
+ * @brief Get 64-bit hash of data
+ *
+ * @param [in] p_data is data to hash
+ * @param [in] length is number of bytes of data
+ * @return uint64_t is hash
+ */
+uint64_t fatfs_hash64(const uint8_t *const p_data, const uint32_t length);
+
+#endif /* _HASH_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -1,143 +1,1036 @@
-/*******************************************************************************
- * Includes
- ******************************************************************************/
-#include <stdio.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "fat.h"
-
-/*******************************************************************************
- * Definition
- ******************************************************************************/
-#define FILE_PATH "floppy.img"
-
-/*******************************************************************************
- * Prototypes
- ******************************************************************************/
-/**
- * @brief Make option for user choose
- *
- * @param [inout] p_directory_list is directory entry list
- */
-static void utility_make_option(fatfs_entry_info_struct_t
-                                *p_directory_list);
-
-/**
- * @brief Make content of file
- *
- * @param [in] buff is data of file
- * @param [in] file_size is size of file
- */
-static void make_content_file(const uint8_t *const buff,
-                              const uint32_t file_size);
-
-/*******************************************************************************
- * Code
- ******************************************************************************/
-/* Function is used to make content of directory */
-static void utility_make_option(fatfs_entry_info_struct_t
-                                *p_directory_list)
-{
-    uint8_t i = 0;
-
-    printf("%-5s%-30s%-20s%-10s%s", "No", "Name", "Type", "Size",
-           "Date modified");
-    while (p_directory_list != NULL)
-    {
-        printf("\n%-5d%-30s", i++, p_directory_list->file_name);
-        if (strcmp(p_directory_list->file_name, "..      ") != 0)
-        {
-            if (0 == strcmp(p_directory_list->file_extension, "   "))
-            {
-                printf("%-20s", "File Folder");
-                printf("%-10s", "");
-            }
-            else
-            {
-                printf("%s %-16s", p_directory_list->file_extension, "File");
-                printf("%-10d", p_directory_list->file_size);
-            }
-            printf("%d/%d/%d", p_directory_list->modified_date.day,
-                   p_directory_list->modified_date.month,
-                   p_directory_list->modified_date.year);
-            printf(" %d:%d:%d", p_directory_list->modified_time.hour,
-                   p_directory_list->modified_time.minute,
-                   p_directory_list->modified_time.second);
-        }
-        else
-        {
-            /* Do nothing */
-        }
-        p_directory_list = p_directory_list->p_next;
-    }
-}
-
-/* Function is used to make content of file */
-static void make_content_file(const uint8_t *const buff,
-                              const uint32_t file_size)
-{
-    uint32_t i = 0;
-
-    for (i = 0; i < file_size; i++)
-    {
-        printf("%c", buff[i]);
-    }
-    printf("\n");
-}
-
-/* Main function */
-int main()
-{
-    fatfs_entry_info_struct_t *p_directory_list = NULL;
-    fatfs_boot_sector_struct_t *p_boot;
-    uint8_t *buff = NULL;
-    uint32_t select = 0;
-    uint32_t i = 0;
-    fatfs_error_enum_t error = SUCCESS;
-    fatfs_entry_info_struct_t *temp = NULL;
-
-    if (SUCCESS == fatfs_init(FILE_PATH, &p_boot))
-    {
-        fatfs_read_directory(0, &p_directory_list);
-        utility_make_option(p_directory_list);
-        while (true)
-        {
-            printf("\nSelect: ");
-            scanf("%d", &select);
-            system("cls");
-            temp = p_directory_list;
-            for (i = 0; i < select; i++)
-            {
-                p_directory_list = p_directory_list->p_next;
-            }
-            if (0 == strcmp(p_directory_list->file_extension, "   "))
-            {
-                fatfs_read_directory(p_directory_list->first_cluster,
-                                     &p_directory_list);
-                utility_make_option(p_directory_list);
-            }
-            else
-            {
-                buff = (uint8_t *)malloc(p_directory_list->file_round_up_size);
-                fatfs_read_file(p_directory_list->first_cluster, buff);
-                make_content_file(buff, p_directory_list->file_size);
-                fflush(stdin);
-                getchar();
-                system("cls");
-                p_directory_list = temp;
-                utility_make_option(p_directory_list);
-                free(buff);
-            }
-        }
-    }
-    fatfs_deinit();
-
-    return 0;
-}
-
-/*******************************************************************************
- * EOF
- ******************************************************************************/
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "dirindex.h"
+#include "export.h"
+#include "check.h"
+#include "chunk.h"
+
+/*******************************************************************************
+ * Definition
+ ******************************************************************************/
+#define CLI_DIRECTORY_ATTRIBUTE 0x10U
+#define CLI_BENCH_ITERATIONS 3U
+#define CLI_NANOSECOND_PER_SECOND 1000000000ULL
+
+#define CLI_EXIT_SUCCESS 0
+#define CLI_EXIT_FAILED 1
+#define CLI_EXIT_USAGE 2
+
+typedef struct
+{
+    bool json;
+    bool stats;
+    kmc_backend_enum_t backend;
+    uint32_t threads;
+} cli_option_struct_t;
+
+typedef struct
+{
+    uint64_t time;
+    kmc_io_stats_struct_t io;
+    kmc_chunk_stats_struct_t chunk;
+    fatfs_index_stats_struct_t index;
+} cli_snapshot_struct_t;
+
+typedef struct
+{
+    uint32_t files;
+    uint32_t directories;
+    uint64_t bytes;
+    bool recursive;
+    bool json;
+    uint8_t *p_buff;            /* Read buffer, grown as needed */
+    uint32_t size;
+} cli_walk_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Print usage of command line
+ *
+ */
+static void cli_usage(void);
+
+/**
+ * @brief Get monotonic time
+ *
+ * @return uint64_t is time in nanosecond
+ */
+static uint64_t cli_get_time(void);
+
+/**
+ * @brief Record time and counters before a step
+ *
+ * @param [out] p_snapshot is time and counters
+ */
+static void cli_snapshot(cli_snapshot_struct_t *const p_snapshot);
+
+/**
+ * @brief Print string as JSON string with quotes
+ *
+ * @param [in] p_out is stream to print to
+ * @param [in] p_string is string to print
+ */
+static void cli_json_string(FILE *const p_out, const uint8_t *const p_string);
+
+/**
+ * @brief Print time and counters spent since snapshots
+ *
+ * @param [in] p_out is stream to print to
+ * @param [in] p_start is snapshot before mount
+ * @param [in] p_command is snapshot after mount
+ * @param [in] json is true to print JSON object
+ */
+static void cli_print_stats(FILE *const p_out,
+                            const cli_snapshot_struct_t *const p_start,
+                            const cli_snapshot_struct_t *const p_command,
+                            const bool json);
+
+/**
+ * @brief Find entry of an absolute path, "/" is root directory
+ *
+ * @param [in] p_path is path inside image
+ * @param [out] p_info is entry found, first cluster 0 for root
+ * @return fatfs_error_enum_t is FATFS_ENTRY_NOT_FOUND if path is not found
+ */
+static fatfs_error_enum_t cli_resolve(const uint8_t *const p_path,
+                                      fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Print one entry of a listing
+ *
+ * @param [in] p_path is path of entry
+ * @param [in] p_info is entry
+ * @param [in] json is true to print JSON object
+ * @param [in] first is true for first entry of JSON array
+ */
+static void cli_print_entry(const uint8_t *const p_path,
+                            const fatfs_entry_info_struct_t *const p_info,
+                            const bool json, const bool first);
+
+/**
+ * @brief Print one entry reached by tree walk
+ *
+ * @param [in] p_entry is entry walked
+ * @param [inout] p_context is walk, counts entries printed
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_list_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/**
+ * @brief Print details of one entry
+ *
+ * @param [in] p_path is path inside image
+ * @param [in] json is true to print JSON object
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_stat(const uint8_t *const p_path,
+                                   const bool json);
+
+/**
+ * @brief Write content of file to a file descriptor
+ *
+ * @param [in] p_path is path inside image
+ * @param [in] out_fd is destination file descriptor
+ * @param [out] p_bytes is number of bytes written
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_export(const uint8_t *const p_path,
+                                     const int out_fd,
+                                     uint32_t *const p_bytes);
+
+/**
+ * @brief Check consistency of volume and print problems
+ *
+ * @param [in] threads is number of directory walkers, 0 for default
+ * @param [in] json is true to print JSON object
+ * @param [out] p_clean is true if no problem is found
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_check(const uint32_t threads, const bool json,
+                                    bool *const p_clean);
+
+/**
+ * @brief Read one file reached by tree walk
+ *
+ * @param [in] p_entry is entry walked
+ * @param [inout] p_context is walk, counts files and bytes read
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_read_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/**
+ * @brief Walk and read whole volume several times and print timing
+ *
+ * @param [in] iterations is number of passes
+ * @param [in] json is true to print JSON object
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_bench(const uint32_t iterations,
+                                    const bool json);
+
+/**
+ * @brief Convert raw image to chunked image and print sizes
+ *
+ * @param [in] p_image is path to raw image
+ * @param [in] p_output is path to chunked image
+ * @param [in] chunk_size is bytes per chunk, 0 for default
+ * @param [in] json is true to print JSON object
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t cli_convert(const uint8_t *const p_image,
+                                      const uint8_t *const p_output,
+                                      const uint32_t chunk_size,
+                                      const bool json);
+
+/*******************************************************************************
+ * Code
+ ******************************************************************************/
+/* Function is used to print usage */
+static void cli_usage(void)
+{
+    fprintf(stderr,
+            "Usage: fatfs [options] IMAGE COMMAND [ARGS]\n"
+            "\n"
+            "Commands:\n"
+            "  ls [-R] [PATH]        list directory, -R for subdirectories\n"
+            "  stat PATH             show entry details and extents\n"
+            "  cat PATH              write file to stdout\n"
+            "  extract PATH OUTPUT   write file to OUTPUT\n"
+            "  check                 check consistency of volume\n"
+            "  bench [ITERATIONS]    read every file, ITERATIONS passes\n"
+            "  convert OUTPUT [SIZE] write chunked copy of raw image,\n"
+            "                        SIZE bytes per chunk\n"
+            "\n"
+            "Options:\n"
+            "  --json                print result and statistics as JSON,\n"
+            "                        on stderr for cat\n"
+            "  --stats               print time, I/O and cache statistics\n"
+            "                        to stderr\n"
+            "  --backend NAME        stdio, pread, mmap, direct or chunked\n"
+            "  --threads N           threads used by check\n");
+}
+
+/* Function is used to get monotonic time */
+static uint64_t cli_get_time(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * CLI_NANOSECOND_PER_SECOND +
+           (uint64_t)now.tv_nsec;
+}
+
+/* Function is used to record time and counters */
+static void cli_snapshot(cli_snapshot_struct_t *const p_snapshot)
+{
+    p_snapshot->time = cli_get_time();
+    kmc_get_io_stats(&p_snapshot->io);
+    kmc_get_chunk_stats(&p_snapshot->chunk);
+    fatfs_index_get_stats(&p_snapshot->index);
+}
+
+/* Function is used to print JSON string */
+static void cli_json_string(FILE *const p_out, const uint8_t *const p_string)
+{
+    uint32_t i = 0;
+
+    fputc('"', p_out);
+    for (i = 0; p_string[i] != '\0'; i++)
+    {
+        if (('"' == p_string[i]) || ('\\' == p_string[i]))
+        {
+            fprintf(p_out, "\\%c", p_string[i]);
+        }
+        else if (p_string[i] < 0x20)
+        {
+            fprintf(p_out, "\\u%04x", p_string[i]);
+        }
+        else
+        {
+            fputc(p_string[i], p_out);
+        }
+    }
+    fputc('"', p_out);
+}
+
+/* Function is used to print statistics */
+static void cli_print_stats(FILE *const p_out,
+                            const cli_snapshot_struct_t *const p_start,
+                            const cli_snapshot_struct_t *const p_command,
+                            const bool json)
+{
+    cli_snapshot_struct_t end;
+
+    cli_snapshot(&end);
+    /* Chunk counters restart with each mount, mount is inside the window */
+    if (true == json)
+    {
+        fprintf(p_out, "{\"mount_ns\":%llu,\"command_ns\":%llu,"
+                "\"reads\":%llu,\"read_bytes\":%llu,"
+                "\"writes\":%llu,\"written_bytes\":%llu,"
+                "\"index_lookups\":%llu,\"index_hits\":%llu,"
+                "\"chunk_hits\":%llu,\"chunk_misses\":%llu,"
+                "\"chunk_zero_reads\":%llu,\"chunk_stored_bytes\":%llu}",
+                (unsigned long long)(p_command->time - p_start->time),
+                (unsigned long long)(end.time - p_command->time),
+                (unsigned long long)(end.io.reads - p_start->io.reads),
+                (unsigned long long)(end.io.read_bytes -
+                                     p_start->io.read_bytes),
+                (unsigned long long)(end.io.writes - p_start->io.writes),
+                (unsigned long long)(end.io.written_bytes -
+                                     p_start->io.written_bytes),
+                (unsigned long long)(end.index.lookups -
+                                     p_start->index.lookups),
+                (unsigned long long)(end.index.hits - p_start->index.hits),
+                (unsigned long long)end.chunk.hits,
+                (unsigned long long)end.chunk.misses,
+                (unsigned long long)end.chunk.zero_reads,
+                (unsigned long long)end.chunk.stored_bytes);
+    }
+    else
+    {
+        fprintf(p_out, "mount %.3f ms, command %.3f ms, "
+                "%llu reads (%llu bytes), %llu writes (%llu bytes), "
+                "index %llu/%llu hits, chunk %llu hits %llu misses\n",
+                (double)(p_command->time - p_start->time) / 1e6,
+                (double)(end.time - p_command->time) / 1e6,
+                (unsigned long long)(end.io.reads - p_start->io.reads),
+                (unsigned long long)(end.io.read_bytes -
+                                     p_start->io.read_bytes),
+                (unsigned long long)(end.io.writes - p_start->io.writes),
+                (unsigned long long)(end.io.written_bytes -
+                                     p_start->io.written_bytes),
+                (unsigned long long)(end.index.hits - p_start->index.hits),
+                (unsigned long long)(end.index.lookups -
+                                     p_start->index.lookups),
+                (unsigned long long)end.chunk.hits,
+                (unsigned long long)end.chunk.misses);
+    }
+}
+
+/* Function is used to find entry of path */
+static fatfs_error_enum_t cli_resolve(const uint8_t *const p_path,
+                                      fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    uint8_t name[FATFS_FILE_NAME_SIZE];
+    const uint8_t *p_start = p_path;
+    uint32_t length = 0;
+
+    memset(p_info, 0, sizeof(fatfs_entry_info_struct_t));
+    strcpy(p_info->file_name, "/");
+    p_info->file_attribute = CLI_DIRECTORY_ATTRIBUTE;
+    while ((SUCCESS == error) && (*p_start != '\0'))
+    {
+        length = (uint32_t)strcspn(p_start, "/");
+        if ((length > 0) &&
+                (0 == (p_info->file_attribute & CLI_DIRECTORY_ATTRIBUTE)))
+        {
+            /* Only directories have children */
+            error = FATFS_ENTRY_NOT_FOUND;
+        }
+        else if ((length > 0) && (length < FATFS_FILE_NAME_SIZE))
+        {
+            memcpy(name, p_start, length);
+            name[length] = '\0';
+            error = fatfs_lookup(p_info->first_cluster, name, p_info);
+        }
+        else if (length > 0)
+        {
+            error = FATFS_ENTRY_NOT_FOUND;
+        }
+        else
+        {
+            /* Empty component, repeated or trailing slash */
+        }
+        p_start += length + (('/' == p_start[length]) ? 1 : 0);
+    }
+
+    return error;
+}
+
+/* Function is used to print one entry */
+static void cli_print_entry(const uint8_t *const p_path,
+                            const fatfs_entry_info_struct_t *const p_info,
+                            const bool json, const bool first)
+{
+    bool directory = (0 != (p_info->file_attribute &
+                            CLI_DIRECTORY_ATTRIBUTE));
+
+    if (true == json)
+    {
+        printf("%s{\"path\":", (true == first) ? "" : ",");
+        cli_json_string(stdout, p_path);
+        printf(",\"name\":");
+        cli_json_string(stdout, fatfs_get_entry_name(p_info));
+        printf(",\"type\":\"%s\",\"size\":%u,\"attributes\":%u,"
+               "\"first_cluster\":%u,"
+               "\"modified\":\"%04u-%02u-%02uT%02u:%02u:%02u\"}",
+               (true == directory) ? "directory" : "file",
+               p_info->file_size, p_info->file_attribute,
+               p_info->first_cluster, p_info->modified_date.year,
+               p_info->modified_date.month, p_info->modified_date.day,
+               p_info->modified_time.hour, p_info->modified_time.minute,
+               p_info->modified_time.second);
+    }
+    else
+    {
+        printf("%-40s %-5s %10u  %04u-%02u-%02u %02u:%02u:%02u\n", p_path,
+               (true == directory) ? "DIR" : "FILE", p_info->file_size,
+               p_info->modified_date.year, p_info->modified_date.month,
+               p_info->modified_date.day, p_info->modified_time.hour,
+               p_info->modified_time.minute, p_info->modified_time.second);
+    }
+}
+
+/* Function is used to print walked entry */
+static fatfs_error_enum_t cli_list_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    cli_walk_struct_t *p_walk = (cli_walk_struct_t *)p_context;
+    bool directory = (0 != (p_entry->info.file_attribute &
+                            CLI_DIRECTORY_ATTRIBUTE));
+
+    cli_print_entry(((true == p_walk->recursive) ||
+                     (true == p_walk->json)) ? p_entry->p_path :
+                    fatfs_get_entry_name(&p_entry->info), &p_entry->info,
+                    p_walk->json, (0 == p_walk->files + p_walk->directories));
+    p_walk->files += (true == directory) ? 0 : 1;
+    p_walk->directories += (true == directory) ? 1 : 0;
+
+    return SUCCESS;
+}
+
+/* Function is used to print details of entry */
+static fatfs_error_enum_t cli_stat(const uint8_t *const p_path,
+                                   const bool json)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_entry_info_struct_t info;
+    fatfs_extent_struct_t *p_extents = NULL;
+    uint32_t extent_count = 0;
+    uint32_t cluster_count = 0;
+    uint32_t i = 0;
+
+    error = cli_resolve(p_path, &info);
+    if ((SUCCESS == error) && (info.first_cluster >= 2))
+    {
+        error = fatfs_get_extents(info.first_cluster, &p_extents,
+                                  &extent_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < extent_count); i++)
+    {
+        cluster_count += p_extents[i].cluster_count;
+    }
+    if ((SUCCESS == error) && (true == json))
+    {
+        printf("{\"path\":");
+        cli_json_string(stdout, p_path);
+        printf(",\"name\":");
+        cli_json_string(stdout, fatfs_get_entry_name(&info));
+        printf(",\"short_name\":");
+        cli_json_string(stdout, info.short_name);
+        printf(",\"type\":\"%s\",\"size\":%u,\"attributes\":%u,"
+               "\"first_cluster\":%u,\"clusters\":%u,"
+               "\"modified\":\"%04u-%02u-%02uT%02u:%02u:%02u\",\"extents\":[",
+               (info.file_attribute & CLI_DIRECTORY_ATTRIBUTE) ?
+               "directory" : "file", info.file_size, info.file_attribute,
+               info.first_cluster, cluster_count, info.modified_date.year,
+               info.modified_date.month, info.modified_date.day,
+               info.modified_time.hour, info.modified_time.minute,
+               info.modified_time.second);
+        for (i = 0; i < extent_count; i++)
+        {
+            printf("%s{\"first_cluster\":%u,\"clusters\":%u}",
+                   (0 == i) ? "" : ",", p_extents[i].first_cluster,
+                   p_extents[i].cluster_count);
+        }
+        printf("]}");
+    }
+    else if (SUCCESS == error)
+    {
+        printf("Path:          %s\n", p_path);
+        printf("Name:          %s\n", fatfs_get_entry_name(&info));
+        printf("Short name:    %s\n", info.short_name);
+        printf("Type:          %s\n",
+               (info.file_attribute & CLI_DIRECTORY_ATTRIBUTE) ?
+               "directory" : "file");
+        printf("Size:          %u\n", info.file_size);
+        printf("Attributes:    0x%02x\n", info.file_attribute);
+        printf("First cluster: %u\n", info.first_cluster);
+        printf("Clusters:      %u\n", cluster_count);
+        printf("Modified:      %04u-%02u-%02u %02u:%02u:%02u\n",
+               info.modified_date.year, info.modified_date.month,
+               info.modified_date.day, info.modified_time.hour,
+               info.modified_time.minute, info.modified_time.second);
+        printf("Extents:       %u\n", extent_count);
+        for (i = 0; i < extent_count; i++)
+        {
+            printf("  %u-%u\n", p_extents[i].first_cluster,
+                   p_extents[i].first_cluster + p_extents[i].cluster_count -
+                   1);
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_extents);
+
+    return error;
+}
+
+/* Function is used to write content of file */
+static fatfs_error_enum_t cli_export(const uint8_t *const p_path,
+                                     const int out_fd,
+                                     uint32_t *const p_bytes)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_entry_info_struct_t info;
+
+    *p_bytes = 0;
+    error = cli_resolve(p_path, &info);
+    if ((SUCCESS == error) &&
+            (info.file_attribute & CLI_DIRECTORY_ATTRIBUTE))
+    {
+        error = FATFS_ENTRY_NOT_FOUND;
+    }
+    else if (SUCCESS == error)
+    {
+        error = fatfs_export(&info, out_fd);
+        *p_bytes = (SUCCESS == error) ? info.file_size : 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to check volume */
+static fatfs_error_enum_t cli_check(const uint32_t threads, const bool json,
+                                    bool *const p_clean)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_check_report_struct_t report;
+    const fatfs_check_problem_struct_t *p_problem = NULL;
+    static const char *const problem_name[] =
+    {
+        "cross_link",
+        "loop",
+        "bad_chain",
+        "size_mismatch",
+        "lost_cluster"
+    };
+    uint32_t i = 0;
+
+    error = fatfs_check(threads, &report);
+    *p_clean = (SUCCESS == error) && (0 == report.problem_count);
+    if ((SUCCESS == error) && (true == json))
+    {
+        printf("{\"files\":%u,\"directories\":%u,\"used_clusters\":%u,"
+               "\"problems\":[", report.files, report.directories,
+               report.used_clusters);
+    }
+    else if (SUCCESS == error)
+    {
+        printf("%u files, %u directories, %u clusters used, %u problems\n",
+               report.files, report.directories, report.used_clusters,
+               report.problem_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < report.problem_count); i++)
+    {
+        p_problem = &report.p_problems[i];
+        if (true == json)
+        {
+            printf("%s{\"problem\":\"%s\",\"cluster\":%u,"
+                   "\"first_cluster\":%u,\"directory_cluster\":%u,"
+                   "\"expected\":%u,\"actual\":%u,\"short_name\":",
+                   (0 == i) ? "" : ",", problem_name[p_problem->problem],
+                   p_problem->cluster, p_problem->first_cluster,
+                   p_problem->directory_cluster, p_problem->expected,
+                   p_problem->actual);
+            cli_json_string(stdout, p_problem->short_name);
+            printf("}");
+        }
+        else
+        {
+            printf("%-14s cluster %u, chain %u, directory %u, "
+                   "expected %u, actual %u %s\n",
+                   problem_name[p_problem->problem], p_problem->cluster,
+                   p_problem->first_cluster, p_problem->directory_cluster,
+                   p_problem->expected, p_problem->actual,
+                   p_problem->short_name);
+        }
+    }
+    if ((SUCCESS == error) && (true == json))
+    {
+        printf("]}");
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        fatfs_check_free(&report);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to read walked file */
+static fatfs_error_enum_t cli_read_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    cli_walk_struct_t *p_walk = (cli_walk_struct_t *)p_context;
+    const fatfs_entry_info_struct_t *p_info = &p_entry->info;
+    uint8_t *p_temp = NULL;
+
+    if (p_info->first_cluster < 2)
+    {
+        /* Do nothing */
+    }
+    else if (p_info->file_attribute & CLI_DIRECTORY_ATTRIBUTE)
+    {
+        p_walk->directories++;
+    }
+    else
+    {
+        if (p_info->file_round_up_size > p_walk->size)
+        {
+            p_temp = (uint8_t *)realloc(p_walk->p_buff,
+                                        p_info->file_round_up_size);
+            error = (NULL == p_temp) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+            p_walk->p_buff = (NULL == p_temp) ? p_walk->p_buff : p_temp;
+            p_walk->size = (NULL == p_temp) ? p_walk->size :
+                           p_info->file_round_up_size;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (SUCCESS == error)
+        {
+            error = fatfs_read_file(p_info->first_cluster, p_walk->p_buff,
+                                    p_info->file_round_up_size);
+            p_walk->files++;
+            p_walk->bytes += p_info->file_size;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to benchmark reading whole volume */
+static fatfs_error_enum_t cli_bench(const uint32_t iterations,
+                                    const bool json)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    cli_walk_struct_t walk;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    uint64_t first = 0;
+    uint64_t best = 0;
+    uint64_t total = 0;
+    uint32_t i = 0;
+
+    memset(&walk, 0, sizeof(walk));
+    for (i = 0; (SUCCESS == error) && (i < iterations); i++)
+    {
+        walk.files = 0;
+        walk.directories = 0;
+        walk.bytes = 0;
+        start = cli_get_time();
+        error = fatfs_walk(0, "", true, cli_read_entry, &walk);
+        elapsed = cli_get_time() - start;
+        first = (0 == i) ? elapsed : first;
+        best = ((0 == i) || (elapsed < best)) ? elapsed : best;
+        total += elapsed;
+    }
+    free(walk.p_buff);
+    /* First pass is cold for index and chunk caches, best pass is warm */
+    if ((SUCCESS == error) && (iterations > 0) && (true == json))
+    {
+        printf("{\"iterations\":%u,\"files\":%u,\"directories\":%u,"
+               "\"bytes\":%llu,\"first_ns\":%llu,\"best_ns\":%llu,"
+               "\"average_ns\":%llu,\"best_bytes_per_second\":%llu}",
+               iterations, walk.files, walk.directories,
+               (unsigned long long)walk.bytes, (unsigned long long)first,
+               (unsigned long long)best,
+               (unsigned long long)(total / iterations),
+               (unsigned long long)((0 == best) ? 0 : walk.bytes *
+                                    CLI_NANOSECOND_PER_SECOND / best));
+    }
+    else if ((SUCCESS == error) && (iterations > 0))
+    {
+        printf("%u passes, %u files, %u directories, %llu bytes\n",
+               iterations, walk.files, walk.directories,
+               (unsigned long long)walk.bytes);
+        printf("first %.3f ms, best %.3f ms, average %.3f ms, "
+               "best %.1f MB/s\n", (double)first / 1e6, (double)best / 1e6,
+               (double)total / iterations / 1e6,
+               (0 == best) ? 0.0 : (double)walk.bytes * 1e3 / best);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to convert image */
+static fatfs_error_enum_t cli_convert(const uint8_t *const p_image,
+                                      const uint8_t *const p_output,
+                                      const uint32_t chunk_size,
+                                      const bool json)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    kmc_chunk_convert_stats_struct_t stats;
+
+    if (false == kmc_chunk_convert(p_image, p_output, chunk_size, &stats))
+    {
+        error = FATFS_WRITE_FAILED;
+    }
+    else if (true == json)
+    {
+        printf("{\"chunks\":%u,\"zero_chunks\":%u,\"raw_chunks\":%u,"
+               "\"image_bytes\":%llu,\"stored_bytes\":%llu}",
+               stats.chunks, stats.zero_chunks, stats.raw_chunks,
+               (unsigned long long)stats.image_bytes,
+               (unsigned long long)stats.stored_bytes);
+    }
+    else
+    {
+        printf("%u chunks, %u zero, %u raw, %llu bytes stored in %llu\n",
+               stats.chunks, stats.zero_chunks, stats.raw_chunks,
+               (unsigned long long)stats.image_bytes,
+               (unsigned long long)stats.stored_bytes);
+    }
+
+    return error;
+}
+
+/* Main function */
+int main(int argc, char **argv)
+{
+    cli_option_struct_t option = {false, false, KMC_BACKEND_STDIO, 0};
+    cli_snapshot_struct_t start;
+    cli_snapshot_struct_t command;
+    cli_walk_struct_t walk;
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+    fatfs_error_enum_t error = SUCCESS;
+    const uint8_t *p_image = NULL;
+    const uint8_t *p_command = NULL;
+    const uint8_t *p_path = "/";
+    fatfs_entry_info_struct_t info;
+    FILE *p_out = stdout;
+    uint32_t iterations = CLI_BENCH_ITERATIONS;
+    uint32_t chunk_size = 0;
+    uint32_t bytes = 0;
+    bool clean = true;
+    bool recursive = false;
+    bool printed = false;
+    bool mounted = false;
+    int retVal = CLI_EXIT_SUCCESS;
+    int out_fd = -1;
+    int i = 1;
+
+    for (; (i < argc) && (0 == strncmp(argv[i], "--", 2)) &&
+            (CLI_EXIT_SUCCESS == retVal); i++)
+    {
+        if (0 == strcmp(argv[i], "--json"))
+        {
+            option.json = true;
+        }
+        else if (0 == strcmp(argv[i], "--stats"))
+        {
+            option.stats = true;
+        }
+        else if ((0 == strcmp(argv[i], "--threads")) && (i + 1 < argc))
+        {
+            option.threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if ((0 == strcmp(argv[i], "--backend")) && (i + 1 < argc))
+        {
+            i++;
+            if (0 == strcmp(argv[i], "stdio"))
+            {
+                option.backend = KMC_BACKEND_STDIO;
+            }
+            else if (0 == strcmp(argv[i], "pread"))
+            {
+                option.backend = KMC_BACKEND_PREAD;
+            }
+            else if (0 == strcmp(argv[i], "mmap"))
+            {
+                option.backend = KMC_BACKEND_MMAP;
+            }
+            else if (0 == strcmp(argv[i], "direct"))
+            {
+                option.backend = KMC_BACKEND_DIRECT;
+            }
+            else if (0 == strcmp(argv[i], "chunked"))
+            {
+                option.backend = KMC_BACKEND_CHUNKED;
+            }
+            else
+            {
+                retVal = CLI_EXIT_USAGE;
+            }
+        }
+        else
+        {
+            retVal = CLI_EXIT_USAGE;
+        }
+    }
+    if ((CLI_EXIT_SUCCESS == retVal) && (i + 2 <= argc))
+    {
+        p_image = argv[i++];
+        p_command = argv[i++];
+    }
+    else
+    {
+        retVal = CLI_EXIT_USAGE;
+    }
+    /* Arguments are checked before image is opened */
+    if (CLI_EXIT_SUCCESS != retVal)
+    {
+        /* Do nothing */
+    }
+    else if (0 == strcmp(p_command, "ls"))
+    {
+        recursive = (i < argc) && (0 == strcmp(argv[i], "-R"));
+        i += (true == recursive) ? 1 : 0;
+        p_path = (i < argc) ? (const uint8_t *)argv[i++] : p_path;
+    }
+    else if (((0 == strcmp(p_command, "stat")) ||
+              (0 == strcmp(p_command, "cat"))) && (i < argc))
+    {
+        p_path = argv[i++];
+    }
+    else if ((0 == strcmp(p_command, "extract")) && (i + 1 < argc))
+    {
+        p_path = argv[i++];
+        out_fd = open(argv[i++], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        retVal = (out_fd < 0) ? CLI_EXIT_FAILED : retVal;
+    }
+    else if (0 == strcmp(p_command, "bench"))
+    {
+        iterations = (i < argc) ? (uint32_t)strtoul(argv[i++], NULL, 10) :
+                     iterations;
+        retVal = (0 == iterations) ? CLI_EXIT_USAGE : retVal;
+    }
+    else if (0 == strcmp(p_command, "check"))
+    {
+        /* Do nothing */
+    }
+    else if ((0 == strcmp(p_command, "convert")) && (i < argc) &&
+             (option.backend != KMC_BACKEND_CHUNKED))
+    {
+        /* Image is mounted first, only a FAT volume is converted */
+        p_path = argv[i++];
+        chunk_size = (i < argc) ? (uint32_t)strtoul(argv[i++], NULL, 10) :
+                     chunk_size;
+    }
+    else
+    {
+        retVal = CLI_EXIT_USAGE;
+    }
+    if ((CLI_EXIT_SUCCESS == retVal) && (i != argc))
+    {
+        retVal = CLI_EXIT_USAGE;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    if (CLI_EXIT_USAGE == retVal)
+    {
+        cli_usage();
+    }
+    else if (CLI_EXIT_FAILED == retVal)
+    {
+        fprintf(stderr, "fatfs: can not create %s\n", argv[argc - 1]);
+    }
+    else
+    {
+        kmc_set_backend(option.backend);
+        cli_snapshot(&start);
+        error = fatfs_init(p_image, &p_boot);
+        mounted = (SUCCESS == error);
+        cli_snapshot(&command);
+        /* Data of cat owns stdout, JSON goes to stderr with statistics */
+        p_out = (0 == strcmp(p_command, "cat")) ? stderr : stdout;
+        if (true == option.json)
+        {
+            fprintf(p_out, "{\"command\":");
+            cli_json_string(p_out, p_command);
+            fprintf(p_out, ",\"image\":");
+            cli_json_string(p_out, p_image);
+            fprintf(p_out, ",\"result\":");
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (error != SUCCESS)
+        {
+            /* Do nothing */
+        }
+        else if (0 == strcmp(p_command, "ls"))
+        {
+            memset(&walk, 0, sizeof(walk));
+            error = cli_resolve(p_path, &info);
+            printed = (SUCCESS == error) && (true == option.json);
+            printf("%s", (true == printed) ? "[" : "");
+            if ((SUCCESS == error) &&
+                    (info.file_attribute & CLI_DIRECTORY_ATTRIBUTE))
+            {
+                walk.recursive = recursive;
+                walk.json = option.json;
+                error = fatfs_walk(info.first_cluster, p_path, recursive,
+                                   cli_list_entry, &walk);
+            }
+            else if (SUCCESS == error)
+            {
+                cli_print_entry(p_path, &info, option.json, true);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            printf("%s", (true == printed) ? "]" : "");
+        }
+        else if (0 == strcmp(p_command, "stat"))
+        {
+            error = cli_stat(p_path, option.json);
+            printed = (SUCCESS == error);
+        }
+        else if ((0 == strcmp(p_command, "cat")) ||
+                 (0 == strcmp(p_command, "extract")))
+        {
+            fflush(stdout);
+            error = cli_export(p_path, (out_fd >= 0) ? out_fd :
+                               STDOUT_FILENO, &bytes);
+            printed = (SUCCESS == error) && (true == option.json);
+            if (true == printed)
+            {
+                fprintf(p_out, "{\"path\":");
+                cli_json_string(p_out, p_path);
+                fprintf(p_out, ",\"bytes\":%u}", bytes);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        else if (0 == strcmp(p_command, "check"))
+        {
+            error = cli_check(option.threads, option.json, &clean);
+            printed = (SUCCESS == error);
+        }
+        else if (0 == strcmp(p_command, "convert"))
+        {
+            error = cli_convert(p_image, p_path, chunk_size, option.json);
+            printed = (SUCCESS == error);
+        }
+        else
+        {
+            error = cli_bench(iterations, option.json);
+            printed = (SUCCESS == error);
+        }
+        fflush(stdout);
+        if (true == option.json)
+        {
+            fprintf(p_out, "%s", (true == printed) ? "" : "null");
+            if (error != SUCCESS)
+            {
+                fprintf(p_out, ",\"error\":");
+                cli_json_string(p_out, getErrorMessage(error));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            fprintf(p_out, ",\"stats\":");
+            cli_print_stats(p_out, &start, &command, true);
+            fprintf(p_out, "}\n");
+        }
+        else
+        {
+            if (error != SUCCESS)
+            {
+                fprintf(stderr, "fatfs: %s: %s\n",
+                        (true == mounted) ? p_path : p_image,
+                        getErrorMessage(error));
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            if (true == option.stats)
+            {
+                cli_print_stats(stderr, &start, &command, false);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        retVal = ((SUCCESS == error) && (true == clean)) ? CLI_EXIT_SUCCESS :
+                 CLI_EXIT_FAILED;
+        fatfs_deinit();
+    }
+    if (out_fd >= 0)
+    {
+        close(out_fd);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
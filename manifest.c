@@ -0,0 +1,610 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "hash.h"
+#include "manifest.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_MANIFEST_DEFAULT_THREADS 4U
+#define FATFS_MANIFEST_MAX_THREADS 64U
+#define FATFS_MANIFEST_CHUNK_SIZE (1024U * 1024U)
+#define FATFS_MANIFEST_DIRECTORY_ATTRIBUTE 0x10U
+
+typedef struct
+{
+    fatfs_manifest_entry_struct_t *p_files;
+    uint32_t count;
+    uint32_t capacity;
+} fatfs_manifest_list_struct_t;
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t index;
+} fatfs_manifest_order_struct_t;
+
+typedef struct
+{
+    fatfs_manifest_entry_struct_t *p_entries;
+    fatfs_manifest_order_struct_t *p_order; /* Entries by first cluster */
+    uint32_t count;
+    uint32_t next;              /* Next position in order to hash */
+    bool failed;
+} fatfs_manifest_job_struct_t;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Hash one file, chunk by chunk along its extents
+ *
+ * @param [inout] p_entry is file to hash
+ * @param [in] p_buff is chunk buffer
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_manifest_hash_file(fatfs_manifest_entry_struct_t
+        *const p_entry, uint8_t *const p_buff);
+
+/**
+ * @brief Hasher thread, takes files in disk order
+ *
+ * @param [inout] p_arg is job
+ * @return void* is not used
+ */
+static void *fatfs_manifest_worker(void *p_arg);
+
+/**
+ * @brief Compare two entries by path
+ *
+ * @param [in] p_first is first entry
+ * @param [in] p_second is second entry
+ * @return int is order of entries
+ */
+static int fatfs_manifest_compare_path(const void *p_first,
+                                       const void *p_second);
+
+/**
+ * @brief Compare two entries by first cluster
+ *
+ * @param [in] p_first is first order item
+ * @param [in] p_second is second order item
+ * @return int is order of items
+ */
+static int fatfs_manifest_compare_cluster(const void *p_first,
+        const void *p_second);
+
+/**
+ * @brief Add file reached by tree walk to list
+ *
+ * @param [in] p_entry is entry walked
+ * @param [inout] p_context is list
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_manifest_add(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to list files */
+fatfs_error_enum_t fatfs_manifest_list(fatfs_manifest_entry_struct_t
+                                       **const p_entries,
+                                       uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_manifest_list_struct_t list;
+
+    memset(&list, 0, sizeof(list));
+    error = fatfs_walk(0, "", true, fatfs_manifest_add, &list);
+    if (error != SUCCESS)
+    {
+        free(list.p_files);
+        list.p_files = NULL;
+        list.count = 0;
+    }
+    else if (list.count > 0)
+    {
+        qsort(list.p_files, list.count, sizeof(fatfs_manifest_entry_struct_t),
+              fatfs_manifest_compare_path);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_entries = list.p_files;
+    *p_count = list.count;
+
+    return error;
+}
+
+/* Function is used to hash one file */
+static fatfs_error_enum_t fatfs_manifest_hash_file(fatfs_manifest_entry_struct_t
+        *const p_entry, uint8_t *const p_buff)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_hash64_struct_t state;
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+    uint32_t chunk_clusters = FATFS_MANIFEST_CHUNK_SIZE / cluster_bytes;
+    uint32_t extent_count = 0;
+    uint32_t remain = p_entry->size;
+    uint32_t clusters = 0;
+    uint32_t done = 0;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+
+    chunk_clusters = (0 == chunk_clusters) ? 1 : chunk_clusters;
+    fatfs_hash64_init(&state);
+    p_entry->crc32c = 0;
+    if (remain > 0)
+    {
+        error = fatfs_get_extents(p_entry->first_cluster, &p_extents,
+                                  &extent_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < extent_count) && (remain > 0); i++)
+    {
+        for (done = 0; (done < p_extents[i].cluster_count) && (remain > 0);
+                done += clusters)
+        {
+            clusters = p_extents[i].cluster_count - done;
+            clusters = (clusters > chunk_clusters) ? chunk_clusters : clusters;
+            bytes = clusters * cluster_bytes;
+            if (kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                          p_extents[i].first_cluster + done),
+                                      clusters * p_boot->sector_per_cluster,
+                                      p_buff) != (int32_t)bytes)
+            {
+                error = FATFS_READ_SECTOR_FAILED;
+                break;
+            }
+            else
+            {
+                bytes = (bytes > remain) ? remain : bytes;
+                p_entry->crc32c = fatfs_crc32c(p_entry->crc32c, p_buff, bytes);
+                fatfs_hash64_update(&state, p_buff, bytes);
+                remain -= bytes;
+            }
+        }
+    }
+    if ((SUCCESS == error) && (remain > 0))
+    {
+        /* Chain is shorter than file size */
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    p_entry->hash = fatfs_hash64_final(&state);
+    free(p_extents);
+
+    return error;
+}
+
+/* Function is used to run hasher */
+static void *fatfs_manifest_worker(void *p_arg)
+{
+    fatfs_manifest_job_struct_t *p_job = (fatfs_manifest_job_struct_t *)p_arg;
+    uint8_t *p_buff = NULL;
+    uint32_t position = 0;
+    uint32_t index = 0;
+
+    p_buff = (uint8_t *)malloc(FATFS_MANIFEST_CHUNK_SIZE +
+                               fatfs_get_boot_sector()->byte_per_sector *
+                               fatfs_get_boot_sector()->sector_per_cluster);
+    if (NULL == p_buff)
+    {
+        p_job->failed = true;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    while (p_buff != NULL)
+    {
+        position = __atomic_fetch_add(&p_job->next, 1, __ATOMIC_RELAXED);
+        if (position >= p_job->count)
+        {
+            break;
+        }
+        else
+        {
+            index = p_job->p_order[position].index;
+        }
+        if (fatfs_manifest_hash_file(&p_job->p_entries[index], p_buff) !=
+                SUCCESS)
+        {
+            p_job->p_entries[index].status = FATFS_MANIFEST_READ_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    free(p_buff);
+
+    return NULL;
+}
+
+/* Function is used to compare entries by path */
+static int fatfs_manifest_compare_path(const void *p_first,
+                                       const void *p_second)
+{
+    return strcmp(((const fatfs_manifest_entry_struct_t *)p_first)->path,
+                  ((const fatfs_manifest_entry_struct_t *)p_second)->path);
+}
+
+/* Function is used to compare entries by first cluster */
+static int fatfs_manifest_compare_cluster(const void *p_first,
+        const void *p_second)
+{
+    uint32_t first =
+        ((const fatfs_manifest_order_struct_t *)p_first)->first_cluster;
+    uint32_t second =
+        ((const fatfs_manifest_order_struct_t *)p_second)->first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to add walked file to list */
+static fatfs_error_enum_t fatfs_manifest_add(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_manifest_list_struct_t *p_list =
+        (fatfs_manifest_list_struct_t *)p_context;
+    fatfs_manifest_entry_struct_t *p_file = NULL;
+    void *p_temp = NULL;
+
+    if (p_entry->info.file_attribute & FATFS_MANIFEST_DIRECTORY_ATTRIBUTE)
+    {
+        /* Do nothing */
+    }
+    else
+    {
+        if (p_list->count == p_list->capacity)
+        {
+            p_temp = realloc(p_list->p_files, (p_list->capacity + 64) * 2 *
+                             sizeof(fatfs_manifest_entry_struct_t));
+            p_list->p_files = (NULL == p_temp) ? p_list->p_files : p_temp;
+            p_list->capacity = (NULL == p_temp) ? p_list->capacity :
+                               (p_list->capacity + 64) * 2;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (p_list->count < p_list->capacity)
+        {
+            p_file = &p_list->p_files[p_list->count++];
+            memset(p_file, 0, sizeof(fatfs_manifest_entry_struct_t));
+            p_file->size = p_entry->info.file_size;
+            p_file->first_cluster = p_entry->info.first_cluster;
+            p_file->modified_date = p_entry->info.modified_date;
+            p_file->modified_time = p_entry->info.modified_time;
+            snprintf(p_file->path, FATFS_MANIFEST_PATH_SIZE, "%s",
+                     p_entry->p_path);
+        }
+        else
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to hash every file */
+fatfs_error_enum_t fatfs_manifest_build(const uint32_t threads,
+        fatfs_manifest_entry_struct_t **const p_entries,
+        uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_manifest_job_struct_t job;
+    pthread_t workers[FATFS_MANIFEST_MAX_THREADS];
+    uint32_t worker_count = (0 == threads) ? FATFS_MANIFEST_DEFAULT_THREADS :
+                            threads;
+    uint32_t started = 0;
+    uint32_t i = 0;
+
+    memset(&job, 0, sizeof(job));
+    worker_count = (worker_count > FATFS_MANIFEST_MAX_THREADS) ?
+                   FATFS_MANIFEST_MAX_THREADS : worker_count;
+    error = fatfs_manifest_list(&job.p_entries, &job.count);
+    if ((SUCCESS == error) && (job.count > 0))
+    {
+        job.p_order = (fatfs_manifest_order_struct_t *)malloc(job.count *
+                      sizeof(fatfs_manifest_order_struct_t));
+        if (NULL == job.p_order)
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+        else
+        {
+            /* Hash in disk order so reads move forward over the image */
+            for (i = 0; i < job.count; i++)
+            {
+                job.p_order[i].first_cluster = job.p_entries[i].first_cluster;
+                job.p_order[i].index = i;
+            }
+            qsort(job.p_order, job.count, sizeof(fatfs_manifest_order_struct_t),
+                  fatfs_manifest_compare_cluster);
+            for (started = 0; started < worker_count; started++)
+            {
+                if (pthread_create(&workers[started], NULL,
+                                   fatfs_manifest_worker, &job) != 0)
+                {
+                    break;
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            if (0 == started)
+            {
+                fatfs_manifest_worker(&job);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            while (started > 0)
+            {
+                pthread_join(workers[--started], NULL);
+            }
+            error = (true == job.failed) ? FATFS_READ_SECTOR_FAILED : SUCCESS;
+        }
+        free(job.p_order);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (error != SUCCESS)
+    {
+        free(job.p_entries);
+        job.p_entries = NULL;
+        job.count = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_entries = job.p_entries;
+    *p_count = job.count;
+
+    return error;
+}
+
+/* Function is used to write manifest file */
+fatfs_error_enum_t fatfs_manifest_write(const uint8_t *const manifest_path,
+        const fatfs_manifest_entry_struct_t *const p_entries,
+        const uint32_t count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    FILE *p_file = NULL;
+    uint32_t i = 0;
+
+    /* Partial hash of unreadable file would pass for a good one */
+    for (i = 0; (i < count) && (SUCCESS == error); i++)
+    {
+        error = (FATFS_MANIFEST_READ_FAILED == p_entries[i].status) ?
+                FATFS_READ_SECTOR_FAILED : SUCCESS;
+    }
+    p_file = (SUCCESS == error) ? fopen(manifest_path, "w") : NULL;
+    if (p_file != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            fprintf(p_file, "%08x %016llx %u %s\n", p_entries[i].crc32c,
+                    (unsigned long long)p_entries[i].hash, p_entries[i].size,
+                    p_entries[i].path);
+        }
+        if (fclose(p_file) != 0)
+        {
+            error = FATFS_WRITE_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else if (SUCCESS == error)
+    {
+        error = FATFS_WRITE_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to compare volume against manifest */
+fatfs_error_enum_t fatfs_manifest_verify(const uint8_t *const manifest_path,
+        const uint32_t threads,
+        fatfs_manifest_entry_struct_t **const p_differences,
+        uint32_t *const p_count)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_manifest_entry_struct_t *p_image = NULL;
+    fatfs_manifest_entry_struct_t *p_expected = NULL;
+    fatfs_manifest_entry_struct_t *p_result = NULL;
+    fatfs_manifest_entry_struct_t entry;
+    FILE *p_file = NULL;
+    void *p_temp = NULL;
+    unsigned long long hash = 0;
+    uint32_t image_count = 0;
+    uint32_t expected_count = 0;
+    uint32_t capacity = 0;
+    uint32_t result_count = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    int order = 0;
+
+    p_file = fopen(manifest_path, "r");
+    if (NULL == p_file)
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+    else
+    {
+        memset(&entry, 0, sizeof(entry));
+        while (4 == fscanf(p_file, "%8x %16llx %u %1023[^\n]", &entry.crc32c,
+                           &hash, &entry.size, entry.path))
+        {
+            entry.hash = (uint64_t)hash;
+            if (expected_count == capacity)
+            {
+                capacity = (0 == capacity) ? 64 : capacity * 2;
+                p_temp = realloc(p_expected, capacity *
+                                 sizeof(fatfs_manifest_entry_struct_t));
+                if (NULL == p_temp)
+                {
+                    error = FATFS_READ_SECTOR_FAILED;
+                    break;
+                }
+                else
+                {
+                    p_expected = p_temp;
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            p_expected[expected_count++] = entry;
+        }
+        if ((SUCCESS == error) && (0 == feof(p_file)))
+        {
+            /* Malformed line, files after it would all show as added */
+            error = FATFS_INITIALIZE_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        fclose(p_file);
+    }
+    if (SUCCESS == error)
+    {
+        error = fatfs_manifest_build(threads, &p_image, &image_count);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        qsort(p_expected, expected_count, sizeof(fatfs_manifest_entry_struct_t),
+              fatfs_manifest_compare_path);
+        p_result = (fatfs_manifest_entry_struct_t *)malloc((image_count +
+                   expected_count + 1) * sizeof(fatfs_manifest_entry_struct_t));
+        if (NULL == p_result)
+        {
+            error = FATFS_READ_SECTOR_FAILED;
+        }
+        else
+        {
+            /* Both lists are sorted by path, merge them */
+            while ((i < image_count) || (j < expected_count))
+            {
+                if (i >= image_count)
+                {
+                    order = 1;
+                }
+                else if (j >= expected_count)
+                {
+                    order = -1;
+                }
+                else
+                {
+                    order = strcmp(p_image[i].path, p_expected[j].path);
+                }
+                if (order < 0)
+                {
+                    p_result[result_count] = p_image[i++];
+                    if (p_result[result_count].status !=
+                            FATFS_MANIFEST_READ_FAILED)
+                    {
+                        p_result[result_count].status = FATFS_MANIFEST_ADDED;
+                    }
+                    else
+                    {
+                        /* Do nothing */
+                    }
+                    result_count++;
+                }
+                else if (order > 0)
+                {
+                    p_result[result_count] = p_expected[j++];
+                    p_result[result_count++].status = FATFS_MANIFEST_MISSING;
+                }
+                else
+                {
+                    if (p_image[i].status != FATFS_MANIFEST_MATCH)
+                    {
+                        p_result[result_count++] = p_image[i];
+                    }
+                    else if ((p_image[i].size != p_expected[j].size) ||
+                             (p_image[i].crc32c != p_expected[j].crc32c) ||
+                             (p_image[i].hash != p_expected[j].hash))
+                    {
+                        p_result[result_count] = p_image[i];
+                        p_result[result_count++].status =
+                            FATFS_MANIFEST_MODIFIED;
+                    }
+                    else
+                    {
+                        /* Do nothing */
+                    }
+                    i++;
+                    j++;
+                }
+            }
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_image);
+    free(p_expected);
+    if (error != SUCCESS)
+    {
+        free(p_result);
+        p_result = NULL;
+        result_count = 0;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_differences = p_result;
+    *p_count = result_count;
+
+    return error;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,90 @@
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_MANIFEST_PATH_SIZE 1024U
+
+typedef enum
+{
+    FATFS_MANIFEST_MATCH,
+    FATFS_MANIFEST_MODIFIED,    /* Size or hash differs from manifest */
+    FATFS_MANIFEST_MISSING,     /* In manifest, not in image */
+    FATFS_MANIFEST_ADDED,       /* In image, not in manifest */
+    FATFS_MANIFEST_READ_FAILED  /* File could not be read from image */
+} fatfs_manifest_status_enum_t;
+
+typedef struct
+{
+    uint8_t path[FATFS_MANIFEST_PATH_SIZE];
+    uint32_t size;
+    uint32_t crc32c;
+    uint64_t hash;
+    uint32_t first_cluster;
+    fatfs_modified_date_struct_t modified_date;
+    fatfs_modified_time_struct_t modified_time;
+    fatfs_manifest_status_enum_t status;
+} fatfs_manifest_entry_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief List every file of volume opened by fatfs_init, without hashing
+ *
+ * @param [out] p_entries is array of files sorted by path, freed by caller
+ * @param [out] p_count is number of files
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_manifest_list(fatfs_manifest_entry_struct_t
+                                       **const p_entries,
+                                       uint32_t *const p_count);
+
+/**
+ * @brief Hash every file of volume opened by fatfs_init
+ *
+ * Files are hashed by parallel workers in order of their position on disk.
+ *
+ * @param [in] threads is number of hashers, 0 for default
+ * @param [out] p_entries is array of files sorted by path, freed by caller
+ * @param [out] p_count is number of files
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_manifest_build(const uint32_t threads,
+        fatfs_manifest_entry_struct_t **const p_entries,
+        uint32_t *const p_count);
+
+/**
+ * @brief Write manifest file, one "crc32c hash64 size path" line per file
+ *
+ * @param [in] manifest_path is path to manifest file
+ * @param [in] p_entries is array of files
+ * @param [in] count is number of files
+ * @return fatfs_error_enum_t is error code, FATFS_READ_SECTOR_FAILED if a
+ * file could not be read and nothing is written
+ */
+fatfs_error_enum_t fatfs_manifest_write(const uint8_t *const manifest_path,
+        const fatfs_manifest_entry_struct_t *const p_entries,
+        const uint32_t count);
+
+/**
+ * @brief Compare volume opened by fatfs_init against a manifest file
+ *
+ * @param [in] manifest_path is path to manifest file
+ * @param [in] threads is number of hashers, 0 for default
+ * @param [out] p_differences is array of files not matching, freed by caller
+ * @param [out] p_count is number of files not matching
+ * @return fatfs_error_enum_t is error code, FATFS_INITIALIZE_FAILED if
+ * manifest can not be opened or has a malformed line
+ */
+fatfs_error_enum_t fatfs_manifest_verify(const uint8_t *const manifest_path,
+        const uint32_t threads,
+        fatfs_manifest_entry_struct_t **const p_differences,
+        uint32_t *const p_count);
+
+#endif /* _MANIFEST_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
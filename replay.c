@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "trace.h"
+
+/*******************************************************************************
+ * Code
+ ******************************************************************************/
+/* Main function */
+int main(int argc, char *argv[])
+{
+    kmc_replay_stats_struct_t stats;
+    kmc_backend_enum_t backend = KMC_BACKEND_STDIO;
+    bool recorded_speed = false;
+    int retVal = 0;
+    int i = 0;
+
+    if (argc < 3)
+    {
+        printf("Usage: %s <trace> <image> [stdio|pread|mmap|direct] [--recorded]\n",
+               argv[0]);
+        retVal = 1;
+    }
+    else
+    {
+        for (i = 3; i < argc; i++)
+        {
+            if (0 == strcmp(argv[i], "pread"))
+            {
+                backend = KMC_BACKEND_PREAD;
+            }
+            else if (0 == strcmp(argv[i], "mmap"))
+            {
+                backend = KMC_BACKEND_MMAP;
+            }
+            else if (0 == strcmp(argv[i], "direct"))
+            {
+                backend = KMC_BACKEND_DIRECT;
+            }
+            else if (0 == strcmp(argv[i], "--recorded"))
+            {
+                recorded_speed = true;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        if (true == kmc_trace_replay(argv[1], argv[2], backend,
+                                     recorded_speed, &stats))
+        {
+            printf("Operations: %u (%u failed)\n", stats.operations,
+                   stats.failed_operations);
+            printf("Bytes: %llu\n", (unsigned long long)stats.bytes);
+            printf("Elapsed: %.3f ms\n", stats.elapsed / 1e6);
+            printf("Throughput: %.2f MiB/s\n",
+                   stats.throughput / (1024.0 * 1024.0));
+            printf("Latency p50/p90/p99/max: %.1f/%.1f/%.1f/%.1f us\n",
+                   stats.latency_p50 / 1e3, stats.latency_p90 / 1e3,
+                   stats.latency_p99 / 1e3, stats.latency_max / 1e3);
+        }
+        else
+        {
+            printf("Replay failed\n");
+            retVal = 1;
+        }
+    }
+
+    return retVal;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,378 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "revmap.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_REVMAP_DIRECTORY_ATTRIBUTE 0x10U
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t cluster_count;
+    uint32_t owner;
+    uint32_t file_cluster;      /* Index of first_cluster within owner */
+} fatfs_revmap_range_struct_t;
+
+typedef struct
+{
+    uint32_t path;              /* Offset of path in name pool */
+    uint32_t size;
+    bool directory;
+} fatfs_revmap_owner_struct_t;
+
+static fatfs_revmap_range_struct_t *sp_ranges = NULL;
+static uint32_t s_range_count = 0;
+static uint32_t s_range_capacity = 0;
+static fatfs_revmap_owner_struct_t *sp_owners = NULL;
+static uint32_t s_owner_count = 0;
+static uint32_t s_owner_capacity = 0;
+static uint8_t *sp_names = NULL;
+static uint32_t s_names_bytes = 0;
+static uint32_t s_names_capacity = 0;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Grow an array to hold one more item
+ *
+ * @param [inout] p_array is array
+ * @param [inout] p_capacity is number of items array can hold
+ * @param [in] count is number of items in array
+ * @param [in] item_size is size of one item
+ * @param [in] need is number of items to add
+ * @return true if array can hold items
+ * @return false if memory is not enough
+ */
+static bool fatfs_revmap_reserve(void **const p_array,
+                                 uint32_t *const p_capacity,
+                                 const uint32_t count,
+                                 const uint32_t item_size,
+                                 const uint32_t need);
+
+/**
+ * @brief Add owner and ranges of its chain
+ *
+ * @param [in] p_path is path of entry, "" for root directory
+ * @param [in] p_info is entry, NULL for root directory
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_revmap_add(const uint8_t *const p_path,
+        const fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Add entry reached by tree walk
+ *
+ * @param [in] p_entry is entry walked
+ * @param [in] p_context is not used
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_revmap_visit(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/**
+ * @brief Compare two ranges by first cluster
+ *
+ * @param [in] p_first is first range
+ * @param [in] p_second is second range
+ * @return int is order of ranges
+ */
+static int fatfs_revmap_compare(const void *p_first, const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to grow array */
+static bool fatfs_revmap_reserve(void **const p_array,
+                                 uint32_t *const p_capacity,
+                                 const uint32_t count,
+                                 const uint32_t item_size,
+                                 const uint32_t need)
+{
+    bool retVal = true;
+    void *p_temp = NULL;
+    uint32_t capacity = *p_capacity;
+
+    if (count + need > capacity)
+    {
+        while (count + need > capacity)
+        {
+            capacity = (0 == capacity) ? 64 : capacity * 2;
+        }
+        p_temp = realloc(*p_array, (size_t)capacity * item_size);
+        if (p_temp != NULL)
+        {
+            *p_array = p_temp;
+            *p_capacity = capacity;
+        }
+        else
+        {
+            retVal = false;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to add owner and its ranges */
+static fatfs_error_enum_t fatfs_revmap_add(const uint8_t *const p_path,
+        const fatfs_entry_info_struct_t *const p_info)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_extent_struct_t *p_extents = NULL;
+    fatfs_revmap_owner_struct_t *p_owner_item = NULL;
+    uint32_t extent_count = 0;
+    uint32_t file_cluster = 0;
+    uint32_t length = strlen(p_path) + 1;
+    uint32_t owner = 0;
+    uint32_t i = 0;
+
+    if ((false == fatfs_revmap_reserve((void **)&sp_owners, &s_owner_capacity,
+                                       s_owner_count,
+                                       sizeof(fatfs_revmap_owner_struct_t), 1)) ||
+            (false == fatfs_revmap_reserve((void **)&sp_names,
+                                           &s_names_capacity, s_names_bytes,
+                                           1, length)))
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        p_owner_item = &sp_owners[s_owner_count];
+        p_owner_item->path = s_names_bytes;
+        p_owner_item->size = (NULL == p_info) ? 0 : p_info->file_size;
+        p_owner_item->directory = (NULL == p_info) ||
+                                  (0 != (p_info->file_attribute &
+                                         FATFS_REVMAP_DIRECTORY_ATTRIBUTE));
+        p_owner_item->size = (true == p_owner_item->directory) ? 0 :
+                             p_owner_item->size;
+        memcpy(sp_names + s_names_bytes, p_path, length);
+        s_names_bytes += length;
+        owner = s_owner_count++;
+        if ((p_info != NULL) && (p_info->first_cluster >= 2))
+        {
+            error = fatfs_get_extents(p_info->first_cluster, &p_extents,
+                                      &extent_count);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if ((SUCCESS == error) &&
+            (false == fatfs_revmap_reserve((void **)&sp_ranges,
+                                           &s_range_capacity, s_range_count,
+                                           sizeof(fatfs_revmap_range_struct_t),
+                                           extent_count)))
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (SUCCESS == error) && (i < extent_count); i++)
+    {
+        sp_ranges[s_range_count].first_cluster = p_extents[i].first_cluster;
+        sp_ranges[s_range_count].cluster_count = p_extents[i].cluster_count;
+        sp_ranges[s_range_count].owner = owner;
+        sp_ranges[s_range_count].file_cluster = file_cluster;
+        file_cluster += p_extents[i].cluster_count;
+        s_range_count++;
+    }
+    free(p_extents);
+
+    return error;
+}
+
+/* Function is used to compare ranges */
+static int fatfs_revmap_compare(const void *p_first, const void *p_second)
+{
+    uint32_t first = ((const fatfs_revmap_range_struct_t *)
+                      p_first)->first_cluster;
+    uint32_t second = ((const fatfs_revmap_range_struct_t *)
+                       p_second)->first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to add walked entry */
+static fatfs_error_enum_t fatfs_revmap_visit(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    fatfs_error_enum_t error = SUCCESS;
+
+    (void)p_context;
+    if ((p_entry->info.file_attribute & FATFS_REVMAP_DIRECTORY_ATTRIBUTE) &&
+            (false == p_entry->descended))
+    {
+        /* Directory reached twice is a loop in a damaged image */
+    }
+    else
+    {
+        error = fatfs_revmap_add(p_entry->p_path, &p_entry->info);
+    }
+
+    return error;
+}
+
+/* Function is used to build reverse map */
+fatfs_error_enum_t fatfs_revmap_build(void)
+{
+    fatfs_error_enum_t error = SUCCESS;
+
+    fatfs_revmap_free();
+    error = fatfs_revmap_add("", NULL);
+    if (SUCCESS == error)
+    {
+        error = fatfs_walk(0, "", true, fatfs_revmap_visit, NULL);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        qsort(sp_ranges, s_range_count, sizeof(fatfs_revmap_range_struct_t),
+              fatfs_revmap_compare);
+    }
+    else
+    {
+        fatfs_revmap_free();
+    }
+
+    return error;
+}
+
+/* Function is used to find owner of cluster */
+fatfs_error_enum_t fatfs_revmap_lookup_cluster(const uint32_t cluster,
+        fatfs_revmap_result_struct_t *const p_result)
+{
+    fatfs_error_enum_t error = FATFS_ENTRY_NOT_FOUND;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_revmap_range_struct_t *p_range = NULL;
+    uint32_t low = 0;
+    uint32_t high = s_range_count;
+    uint32_t middle = 0;
+
+    /* Last range starting at or before cluster */
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (sp_ranges[middle].first_cluster <= cluster)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if (low > 0)
+    {
+        p_range = &sp_ranges[low - 1];
+        if (cluster - p_range->first_cluster < p_range->cluster_count)
+        {
+            p_result->p_path = sp_names + sp_owners[p_range->owner].path;
+            p_result->size = sp_owners[p_range->owner].size;
+            p_result->directory = sp_owners[p_range->owner].directory;
+            p_result->offset = (uint64_t)(p_range->file_cluster + cluster -
+                                          p_range->first_cluster) *
+                               p_boot->byte_per_sector *
+                               p_boot->sector_per_cluster;
+            error = SUCCESS;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to find owner of sector */
+fatfs_error_enum_t fatfs_revmap_lookup_sector(const uint32_t sector,
+        fatfs_revmap_result_struct_t *const p_result)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    uint32_t first_sector = 0;
+
+    memset(p_result, 0, sizeof(fatfs_revmap_result_struct_t));
+    if (sector < p_boot->sector_before_fat)
+    {
+        p_result->p_path = "<boot>";
+        p_result->offset = (uint64_t)sector * p_boot->byte_per_sector;
+    }
+    else if (sector < p_boot->root_directory_index)
+    {
+        p_result->p_path = "<fat>";
+        p_result->offset = (uint64_t)(sector - p_boot->sector_before_fat) *
+                           p_boot->byte_per_sector;
+    }
+    else if (sector < p_boot->data_index)
+    {
+        p_result->p_path = "<root>";
+        p_result->directory = true;
+        p_result->offset = (uint64_t)(sector - p_boot->root_directory_index) *
+                           p_boot->byte_per_sector;
+    }
+    else
+    {
+        first_sector = (sector - p_boot->data_index) /
+                       p_boot->sector_per_cluster;
+        error = fatfs_revmap_lookup_cluster(first_sector + 2, p_result);
+        if (SUCCESS == error)
+        {
+            p_result->offset += (uint64_t)((sector - p_boot->data_index) %
+                                           p_boot->sector_per_cluster) *
+                                p_boot->byte_per_sector;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    return error;
+}
+
+/* Function is used to free reverse map */
+void fatfs_revmap_free(void)
+{
+    free(sp_ranges);
+    sp_ranges = NULL;
+    s_range_count = 0;
+    s_range_capacity = 0;
+    free(sp_owners);
+    sp_owners = NULL;
+    s_owner_count = 0;
+    s_owner_capacity = 0;
+    free(sp_names);
+    sp_names = NULL;
+    s_names_bytes = 0;
+    s_names_capacity = 0;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
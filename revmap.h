@@ -0,0 +1,58 @@
+#ifndef _REVMAP_H_
+#define _REVMAP_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    const uint8_t *p_path;  /* Owner path, or "<boot>", "<fat>", "<root>" */
+    uint64_t offset;        /* Byte offset of cluster or sector in owner */
+    uint32_t size;          /* File size, 0 for directories and metadata */
+    bool directory;
+} fatfs_revmap_result_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Build reverse map of volume opened by fatfs_init
+ *
+ * Map is a table of cluster ranges sorted by cluster, one per extent of
+ * every file and directory. It is dropped by fatfs_init and fatfs_deinit.
+ *
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_revmap_build(void);
+
+/**
+ * @brief Find owner of a data cluster
+ *
+ * @param [in] cluster is cluster index
+ * @param [out] p_result is owner, path valid until map is freed
+ * @return fatfs_error_enum_t is error code, FATFS_ENTRY_NOT_FOUND if free
+ */
+fatfs_error_enum_t fatfs_revmap_lookup_cluster(const uint32_t cluster,
+        fatfs_revmap_result_struct_t *const p_result);
+
+/**
+ * @brief Find owner of a sector, metadata regions included
+ *
+ * @param [in] sector is sector index
+ * @param [out] p_result is owner, path valid until map is freed
+ * @return fatfs_error_enum_t is error code, FATFS_ENTRY_NOT_FOUND if free
+ */
+fatfs_error_enum_t fatfs_revmap_lookup_sector(const uint32_t sector,
+        fatfs_revmap_result_struct_t *const p_result);
+
+/**
+ * @brief Free reverse map
+ *
+ */
+void fatfs_revmap_free(void);
+
+#endif /* _REVMAP_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,701 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "check.h"
+#include "compact.h"
+#include "manifest.h"
+#include "defrag.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+/* FAT12 image of a 1.44 MB floppy, one sector per cluster */
+#define SELFTEST_SECTOR_SIZE 512U
+#define SELFTEST_TOTAL_SECTORS 2880U
+#define SELFTEST_IMAGE_SIZE (SELFTEST_SECTOR_SIZE * SELFTEST_TOTAL_SECTORS)
+#define SELFTEST_FAT_COUNT 2U
+#define SELFTEST_FAT_SECTORS 9U
+#define SELFTEST_FAT_SECTOR 1U
+#define SELFTEST_ROOT_ENTRIES 224U
+#define SELFTEST_ROOT_SECTOR (SELFTEST_FAT_SECTOR + SELFTEST_FAT_COUNT * \
+                              SELFTEST_FAT_SECTORS)
+#define SELFTEST_DATA_SECTOR (SELFTEST_ROOT_SECTOR + SELFTEST_ROOT_ENTRIES * \
+                              SELFTEST_ENTRY_SIZE / SELFTEST_SECTOR_SIZE)
+#define SELFTEST_ENTRY_SIZE 32U
+#define SELFTEST_END_CLUSTER 0xFFFU
+#define SELFTEST_DIRECTORY_ATTRIBUTE 0x10U
+#define SELFTEST_ARCHIVE_ATTRIBUTE 0x20U
+#define SELFTEST_DELETED_ENTRY 0xE5U
+#define SELFTEST_CHAIN_MAX 6U
+#define SELFTEST_PATH_SIZE 1024U
+
+/* Subdirectory fills both its clusters, deleted slots between files */
+#define SELFTEST_SUBDIR_FIRST_CLUSTER 14U
+#define SELFTEST_SUBDIR_LAST_CLUSTER 15U
+#define SELFTEST_SUBDIR_DELETED_SLOTS 4U
+
+typedef struct
+{
+    const uint8_t *p_path;
+    const uint8_t *p_name;      /* 8.3 name as stored, 11 characters */
+    bool in_subdir;
+    uint32_t size;
+    uint32_t chain[SELFTEST_CHAIN_MAX];     /* 0 ends chain */
+} selftest_file_struct_t;
+
+typedef struct
+{
+    uint32_t seen;
+    uint32_t matched;
+} selftest_verify_struct_t;
+
+/* Files of both directories are fragmented and interleaved */
+static const selftest_file_struct_t s_files[] =
+{
+    {"/FRAG1.BIN", "FRAG1   BIN", false, 3000, {2, 4, 6, 8, 10, 12}},
+    {"/FRAG2.BIN", "FRAG2   BIN", false, 2500, {3, 5, 7, 9, 11}},
+    {"/SMALL.TXT", "SMALL   TXT", false, 100, {13}},
+    {"/SUBDIR/S0.DAT", "S0      DAT", true, 600, {16, 18}},
+    {"/SUBDIR/S1.DAT", "S1      DAT", true, 300, {17}},
+    {"/SUBDIR/S2.DAT", "S2      DAT", true, 1000, {19, 21}},
+    {"/SUBDIR/S3.DAT", "S3      DAT", true, 512, {20}},
+    {"/SUBDIR/S4.DAT", "S4      DAT", true, 0, {0}},
+    {"/SUBDIR/S5.DAT", "S5      DAT", true, 1500, {23, 25, 24}}
+};
+
+#define SELFTEST_FILE_COUNT (sizeof(s_files) / sizeof(s_files[0]))
+
+static uint8_t s_image_path[SELFTEST_PATH_SIZE];
+static uint8_t s_overlay_path[SELFTEST_PATH_SIZE];
+static uint32_t s_failures = 0;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Set FAT entry in every FAT copy of image
+ *
+ * @param [inout] p_image is image
+ * @param [in] cluster is cluster index
+ * @param [in] value is next cluster
+ */
+static void selftest_set_fat(uint8_t *const p_image, const uint32_t cluster,
+                             const uint32_t value);
+
+/**
+ * @brief Write 32-byte directory entry
+ *
+ * @param [out] p_entry is entry
+ * @param [in] p_name is 8.3 name as stored
+ * @param [in] attribute is attribute byte
+ * @param [in] first_cluster is first cluster
+ * @param [in] size is file size
+ */
+static void selftest_set_entry(uint8_t *const p_entry,
+                               const uint8_t *const p_name,
+                               const uint8_t attribute,
+                               const uint32_t first_cluster,
+                               const uint32_t size);
+
+/**
+ * @brief Get expected byte of a file
+ *
+ * @param [in] index is index of file in s_files
+ * @param [in] offset is byte offset in file
+ * @return uint8_t is expected byte
+ */
+static uint8_t selftest_pattern(const uint32_t index, const uint32_t offset);
+
+/**
+ * @brief Build whole image in memory
+ *
+ * @param [out] p_image is image of SELFTEST_IMAGE_SIZE bytes
+ */
+static void selftest_build(uint8_t *const p_image);
+
+/**
+ * @brief Write image file, drop overlay file
+ *
+ * @param [in] p_image is image of SELFTEST_IMAGE_SIZE bytes
+ * @return true if image is written
+ */
+static bool selftest_write_image(const uint8_t *const p_image);
+
+/**
+ * @brief Compare image file with image in memory
+ *
+ * @param [in] p_image is image of SELFTEST_IMAGE_SIZE bytes
+ * @return true if image file holds same bytes
+ */
+static bool selftest_same_image(const uint8_t *const p_image);
+
+/**
+ * @brief Report result of one expectation
+ *
+ * @param [in] condition is expectation
+ * @param [in] p_what is what is expected
+ * @return bool is condition
+ */
+static bool selftest_expect(const bool condition, const uint8_t *const p_what);
+
+/**
+ * @brief Compare one file reached by tree walk with its pattern
+ *
+ * @param [in] p_entry is entry walked
+ * @param [inout] p_context is number of files seen and matched
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t selftest_verify_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context);
+
+/**
+ * @brief Expect every file once with its contents
+ *
+ * @param [in] p_label is case name
+ */
+static void selftest_verify_files(const uint8_t *const p_label);
+
+/**
+ * @brief Expect fatfs_check to find a problem, or none
+ *
+ * @param [in] p_label is case name
+ * @param [in] clean is true if no problem is expected
+ * @param [in] problem is problem expected if not clean
+ */
+static void selftest_verify_check(const uint8_t *const p_label,
+                                  const bool clean,
+                                  const fatfs_check_problem_enum_t problem);
+
+/**
+ * @brief Defragment clean image, then compact its directories
+ *
+ */
+static void selftest_defrag_compact(void);
+
+/**
+ * @brief Defragment and compact under overlay, then commit overlay
+ *
+ */
+static void selftest_overlay_commit(void);
+
+/**
+ * @brief Damage one FAT entry of clean image and expect it refused
+ *
+ * @param [in] p_label is case name
+ * @param [in] cluster is cluster whose FAT entry is damaged
+ * @param [in] value is damaged next cluster
+ * @param [in] problem is problem fatfs_check must find
+ * @param [in] read_error is result of reading first file whole
+ */
+static void selftest_damaged(const uint8_t *const p_label,
+                             const uint32_t cluster, const uint32_t value,
+                             const fatfs_check_problem_enum_t problem,
+                             const fatfs_error_enum_t read_error);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to set FAT entry */
+static void selftest_set_fat(uint8_t *const p_image, const uint32_t cluster,
+                             const uint32_t value)
+{
+    uint8_t *p_fat = NULL;
+    uint32_t offset = cluster * 3 / 2;
+    uint32_t i = 0;
+
+    for (i = 0; i < SELFTEST_FAT_COUNT; i++)
+    {
+        p_fat = p_image + (SELFTEST_FAT_SECTOR + i * SELFTEST_FAT_SECTORS) *
+                SELFTEST_SECTOR_SIZE;
+        if (0 == (cluster & 1))
+        {
+            p_fat[offset] = (uint8_t)value;
+            p_fat[offset + 1] = (uint8_t)((p_fat[offset + 1] & 0xF0) |
+                                          ((value >> 8) & 0x0F));
+        }
+        else
+        {
+            p_fat[offset] = (uint8_t)((p_fat[offset] & 0x0F) |
+                                      ((value & 0x0F) << 4));
+            p_fat[offset + 1] = (uint8_t)(value >> 4);
+        }
+    }
+}
+
+/* Function is used to write directory entry */
+static void selftest_set_entry(uint8_t *const p_entry,
+                               const uint8_t *const p_name,
+                               const uint8_t attribute,
+                               const uint32_t first_cluster,
+                               const uint32_t size)
+{
+    memset(p_entry, 0, SELFTEST_ENTRY_SIZE);
+    memcpy(p_entry, p_name, 11);
+    p_entry[11] = attribute;
+    /* 2023-06-15 10:30:10 */
+    p_entry[22] = 0xC5;
+    p_entry[23] = 0x53;
+    p_entry[24] = 0xCF;
+    p_entry[25] = 0x56;
+    p_entry[26] = (uint8_t)first_cluster;
+    p_entry[27] = (uint8_t)(first_cluster >> 8);
+    p_entry[28] = (uint8_t)size;
+    p_entry[29] = (uint8_t)(size >> 8);
+    p_entry[30] = (uint8_t)(size >> 16);
+    p_entry[31] = (uint8_t)(size >> 24);
+}
+
+/* Function is used to get expected byte of file */
+static uint8_t selftest_pattern(const uint32_t index, const uint32_t offset)
+{
+    return (uint8_t)(index * 37U + offset * 7U + (offset >> 8));
+}
+
+/* Function is used to build image */
+static void selftest_build(uint8_t *const p_image)
+{
+    uint8_t *p_root = p_image + SELFTEST_ROOT_SECTOR * SELFTEST_SECTOR_SIZE;
+    uint8_t *p_subdir = p_image + (SELFTEST_DATA_SECTOR +
+                                   SELFTEST_SUBDIR_FIRST_CLUSTER - 2) *
+                        SELFTEST_SECTOR_SIZE;
+    uint8_t *p_data = NULL;
+    uint32_t root_slot = 0;
+    uint32_t subdir_slot = 2;
+    uint32_t cluster = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t k = 0;
+
+    memset(p_image, 0, SELFTEST_IMAGE_SIZE);
+    p_image[0] = 0xEB;
+    p_image[1] = 0x3C;
+    p_image[2] = 0x90;
+    memcpy(p_image + 3, "MSWIN4.1", 8);
+    p_image[11] = (uint8_t)SELFTEST_SECTOR_SIZE;
+    p_image[12] = (uint8_t)(SELFTEST_SECTOR_SIZE >> 8);
+    p_image[13] = 1;
+    p_image[14] = SELFTEST_FAT_SECTOR;
+    p_image[16] = SELFTEST_FAT_COUNT;
+    p_image[17] = (uint8_t)SELFTEST_ROOT_ENTRIES;
+    p_image[18] = (uint8_t)(SELFTEST_ROOT_ENTRIES >> 8);
+    p_image[19] = (uint8_t)SELFTEST_TOTAL_SECTORS;
+    p_image[20] = (uint8_t)(SELFTEST_TOTAL_SECTORS >> 8);
+    p_image[21] = 0xF0;
+    p_image[22] = SELFTEST_FAT_SECTORS;
+    p_image[38] = 0x29;
+    memcpy(p_image + 43, "SELFTEST   ", 11);
+    memcpy(p_image + 54, "FAT12   ", 8);
+    p_image[510] = 0x55;
+    p_image[511] = 0xAA;
+    selftest_set_fat(p_image, 0, 0xFF0);
+    selftest_set_fat(p_image, 1, SELFTEST_END_CLUSTER);
+
+    selftest_set_entry(p_subdir, ".          ", SELFTEST_DIRECTORY_ATTRIBUTE,
+                       SELFTEST_SUBDIR_FIRST_CLUSTER, 0);
+    selftest_set_entry(p_subdir + SELFTEST_ENTRY_SIZE, "..         ",
+                       SELFTEST_DIRECTORY_ATTRIBUTE, 0, 0);
+    selftest_set_fat(p_image, SELFTEST_SUBDIR_FIRST_CLUSTER,
+                     SELFTEST_SUBDIR_LAST_CLUSTER);
+    selftest_set_fat(p_image, SELFTEST_SUBDIR_LAST_CLUSTER,
+                     SELFTEST_END_CLUSTER);
+    for (i = 0; i < SELFTEST_FILE_COUNT; i++)
+    {
+        if (true == s_files[i].in_subdir)
+        {
+            /* Deleted slots in front of each file, compaction drops them */
+            for (j = 0; j < SELFTEST_SUBDIR_DELETED_SLOTS; j++)
+            {
+                selftest_set_entry(p_subdir + subdir_slot * SELFTEST_ENTRY_SIZE,
+                                   "GONE    TMP", SELFTEST_ARCHIVE_ATTRIBUTE,
+                                   0, 0);
+                p_subdir[subdir_slot++ * SELFTEST_ENTRY_SIZE] =
+                    SELFTEST_DELETED_ENTRY;
+            }
+            selftest_set_entry(p_subdir + subdir_slot++ * SELFTEST_ENTRY_SIZE,
+                               s_files[i].p_name, SELFTEST_ARCHIVE_ATTRIBUTE,
+                               s_files[i].chain[0], s_files[i].size);
+        }
+        else
+        {
+            selftest_set_entry(p_root + root_slot++ * SELFTEST_ENTRY_SIZE,
+                               s_files[i].p_name, SELFTEST_ARCHIVE_ATTRIBUTE,
+                               s_files[i].chain[0], s_files[i].size);
+        }
+        for (j = 0, k = 0; (j < SELFTEST_CHAIN_MAX) &&
+                (s_files[i].chain[j] != 0); j++)
+        {
+            cluster = s_files[i].chain[j];
+            p_data = p_image + (SELFTEST_DATA_SECTOR + cluster - 2) *
+                     SELFTEST_SECTOR_SIZE;
+            for (; (k < s_files[i].size) &&
+                    (k < (j + 1) * SELFTEST_SECTOR_SIZE); k++)
+            {
+                p_data[k % SELFTEST_SECTOR_SIZE] = selftest_pattern(i, k);
+            }
+            selftest_set_fat(p_image, cluster,
+                             ((j + 1 < SELFTEST_CHAIN_MAX) &&
+                              (s_files[i].chain[j + 1] != 0)) ?
+                             s_files[i].chain[j + 1] : SELFTEST_END_CLUSTER);
+        }
+    }
+    selftest_set_entry(p_root + root_slot * SELFTEST_ENTRY_SIZE,
+                       "SUBDIR     ", SELFTEST_DIRECTORY_ATTRIBUTE,
+                       SELFTEST_SUBDIR_FIRST_CLUSTER, 0);
+}
+
+/* Function is used to write image file */
+static bool selftest_write_image(const uint8_t *const p_image)
+{
+    bool retVal = false;
+    FILE *p_file = fopen(s_image_path, "wb");
+
+    if (p_file != NULL)
+    {
+        retVal = (fwrite(p_image, 1, SELFTEST_IMAGE_SIZE, p_file) ==
+                  SELFTEST_IMAGE_SIZE);
+        retVal = (0 == fclose(p_file)) && (true == retVal);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    remove(s_overlay_path);
+
+    return retVal;
+}
+
+/* Function is used to compare image file */
+static bool selftest_same_image(const uint8_t *const p_image)
+{
+    bool retVal = false;
+    uint8_t *p_buff = (uint8_t *)malloc(SELFTEST_IMAGE_SIZE + 1);
+    FILE *p_file = fopen(s_image_path, "rb");
+
+    if ((p_buff != NULL) && (p_file != NULL))
+    {
+        retVal = (fread(p_buff, 1, SELFTEST_IMAGE_SIZE + 1, p_file) ==
+                  SELFTEST_IMAGE_SIZE) &&
+                 (0 == memcmp(p_buff, p_image, SELFTEST_IMAGE_SIZE));
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_file != NULL)
+    {
+        fclose(p_file);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_buff);
+
+    return retVal;
+}
+
+/* Function is used to report expectation */
+static bool selftest_expect(const bool condition, const uint8_t *const p_what)
+{
+    printf("%s %s\n", (true == condition) ? "PASS" : "FAIL", p_what);
+    s_failures += (true == condition) ? 0 : 1;
+
+    return condition;
+}
+
+/* Function is used to compare walked file with its pattern */
+static fatfs_error_enum_t selftest_verify_entry(const fatfs_walk_entry_struct_t
+        *const p_entry, void *p_context)
+{
+    selftest_verify_struct_t *p_verify = (selftest_verify_struct_t *)p_context;
+    const fatfs_entry_info_struct_t *p_info = &p_entry->info;
+    uint8_t *p_buff = NULL;
+    bool same = false;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    for (i = 0; (i < SELFTEST_FILE_COUNT) &&
+            (strcmp(s_files[i].p_path, p_entry->p_path) != 0); i++)
+    {
+    }
+    if (p_info->file_attribute & SELFTEST_DIRECTORY_ATTRIBUTE)
+    {
+        /* Do nothing */
+    }
+    else if ((i < SELFTEST_FILE_COUNT) &&
+             (p_info->file_size == s_files[i].size))
+    {
+        p_verify->seen++;
+        same = (0 == p_info->file_size);
+        p_buff = (true == same) ? NULL :
+                 (uint8_t *)malloc(p_info->file_round_up_size);
+        if ((p_buff != NULL) &&
+                (SUCCESS == fatfs_read_file(p_info->first_cluster, p_buff,
+                                            p_info->file_round_up_size)))
+        {
+            for (j = 0, same = true; (j < p_info->file_size) &&
+                    (true == same); j++)
+            {
+                same = (p_buff[j] == selftest_pattern(i, j));
+            }
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        free(p_buff);
+        p_verify->matched += (true == same) ? 1 : 0;
+    }
+    else
+    {
+        p_verify->seen++;
+    }
+
+    return SUCCESS;
+}
+
+/* Function is used to expect every file with its contents */
+static void selftest_verify_files(const uint8_t *const p_label)
+{
+    selftest_verify_struct_t verify;
+    uint8_t what[SELFTEST_PATH_SIZE];
+    fatfs_error_enum_t error = SUCCESS;
+
+    memset(&verify, 0, sizeof(verify));
+    error = fatfs_walk(0, "", true, selftest_verify_entry, &verify);
+    snprintf(what, sizeof(what), "%s: %u of %u files seen, %u unchanged",
+             p_label, verify.seen, (uint32_t)SELFTEST_FILE_COUNT,
+             verify.matched);
+    selftest_expect((SUCCESS == error) &&
+                    (SELFTEST_FILE_COUNT == verify.seen) &&
+                    (SELFTEST_FILE_COUNT == verify.matched), what);
+}
+
+/* Function is used to expect check result */
+static void selftest_verify_check(const uint8_t *const p_label,
+                                  const bool clean,
+                                  const fatfs_check_problem_enum_t problem)
+{
+    fatfs_check_report_struct_t report;
+    uint8_t what[SELFTEST_PATH_SIZE];
+    fatfs_error_enum_t error = SUCCESS;
+    bool found = false;
+    uint32_t i = 0;
+
+    memset(&report, 0, sizeof(report));
+    error = fatfs_check(0, &report);
+    for (i = 0; (SUCCESS == error) && (i < report.problem_count); i++)
+    {
+        found = (report.p_problems[i].problem == problem) || (true == found);
+    }
+    snprintf(what, sizeof(what), "%s: check finds %u problems%s", p_label,
+             report.problem_count, (true == clean) ? "" :
+             ", expected one found");
+    selftest_expect((SUCCESS == error) && ((true == clean) ?
+                                           (0 == report.problem_count) :
+                                           (true == found)), what);
+    fatfs_check_free(&report);
+}
+
+/* Function is used to defragment and compact clean image */
+static void selftest_defrag_compact(void)
+{
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+    fatfs_defrag_result_struct_t defrag;
+    fatfs_compact_result_struct_t compact;
+    fatfs_frag_report_struct_t report;
+    uint8_t *p_image = (uint8_t *)malloc(SELFTEST_IMAGE_SIZE);
+
+    if (true == selftest_expect((p_image != NULL), "defrag: image built"))
+    {
+        selftest_build(p_image);
+        selftest_write_image(p_image);
+        kmc_set_writable(true);
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot),
+                        "defrag: mount");
+        selftest_verify_check("defrag: before", true, FATFS_CHECK_LOOP);
+        selftest_verify_files("defrag: before");
+        selftest_expect((SUCCESS == fatfs_defrag(&defrag)) &&
+                        (defrag.moved_files > 0), "defrag: files moved");
+        selftest_expect((SUCCESS == fatfs_compact_directory(
+                             SELFTEST_SUBDIR_FIRST_CLUSTER, false, &compact)) &&
+                        (1 == compact.freed_clusters),
+                        "compact: subdirectory cluster freed");
+        selftest_expect(SUCCESS == fatfs_compact_directory(0, true, &compact),
+                        "compact: root sorted");
+        fatfs_deinit();
+
+        /* Read back from disk, nothing cached from writes */
+        kmc_set_writable(false);
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot),
+                        "defrag: remount");
+        selftest_verify_check("defrag: after", true, FATFS_CHECK_LOOP);
+        selftest_verify_files("defrag: after");
+        selftest_expect((SUCCESS == fatfs_frag_report(&report)) &&
+                        (0 == report.fragmented_files),
+                        "defrag: no fragmented file");
+        fatfs_frag_free(&report);
+        fatfs_deinit();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_image);
+}
+
+/* Function is used to commit overlay */
+static void selftest_overlay_commit(void)
+{
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+    fatfs_defrag_result_struct_t defrag;
+    fatfs_compact_result_struct_t compact;
+    uint8_t *p_image = (uint8_t *)malloc(SELFTEST_IMAGE_SIZE);
+
+    if (true == selftest_expect((p_image != NULL), "overlay: image built"))
+    {
+        selftest_build(p_image);
+        selftest_write_image(p_image);
+        kmc_set_overlay(s_overlay_path);
+        kmc_set_writable(true);
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot),
+                        "overlay: mount");
+        selftest_expect(SUCCESS == fatfs_defrag(&defrag), "overlay: defrag");
+        selftest_expect(SUCCESS == fatfs_compact_directory(
+                            SELFTEST_SUBDIR_FIRST_CLUSTER, true, &compact),
+                        "overlay: compact");
+        selftest_verify_check("overlay: before commit", true,
+                              FATFS_CHECK_LOOP);
+        selftest_verify_files("overlay: before commit");
+        fatfs_deinit();
+        selftest_expect(true == selftest_same_image(p_image),
+                        "overlay: base untouched before commit");
+
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot),
+                        "overlay: remount");
+        selftest_expect((kmc_overlay_get_count() > 0) &&
+                        (true == kmc_overlay_commit()) &&
+                        (0 == kmc_overlay_get_count()), "overlay: commit");
+        fatfs_deinit();
+        selftest_expect(false == selftest_same_image(p_image),
+                        "overlay: base written by commit");
+
+        kmc_set_overlay(NULL);
+        kmc_set_writable(false);
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot),
+                        "overlay: mount base");
+        selftest_verify_check("overlay: after commit", true,
+                              FATFS_CHECK_LOOP);
+        selftest_verify_files("overlay: after commit");
+        fatfs_deinit();
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    remove(s_overlay_path);
+    free(p_image);
+}
+
+/* Function is used to expect damaged image refused */
+static void selftest_damaged(const uint8_t *const p_label,
+                             const uint32_t cluster, const uint32_t value,
+                             const fatfs_check_problem_enum_t problem,
+                             const fatfs_error_enum_t read_error)
+{
+    fatfs_boot_sector_struct_t *p_boot = NULL;
+    fatfs_defrag_result_struct_t defrag;
+    fatfs_manifest_entry_struct_t *p_entries = NULL;
+    uint8_t *p_image = (uint8_t *)malloc(SELFTEST_IMAGE_SIZE);
+    uint8_t *p_buff = NULL;
+    uint8_t what[SELFTEST_PATH_SIZE];
+    uint32_t count = 0;
+
+    snprintf(what, sizeof(what), "%s: image built", p_label);
+    if (true == selftest_expect((p_image != NULL), what))
+    {
+        selftest_build(p_image);
+        selftest_set_fat(p_image, cluster, value);
+        selftest_write_image(p_image);
+        kmc_set_writable(true);
+        snprintf(what, sizeof(what), "%s: mount", p_label);
+        selftest_expect(SUCCESS == fatfs_init(s_image_path, &p_boot), what);
+        selftest_verify_check(p_label, false, problem);
+
+        /* Walks end, a damaged chain is read no further than its buffer */
+        snprintf(what, sizeof(what), "%s: manifest lists every file",
+                 p_label);
+        selftest_expect((SUCCESS == fatfs_manifest_list(&p_entries, &count)) &&
+                        (SELFTEST_FILE_COUNT == count), what);
+        free(p_entries);
+        p_buff = (uint8_t *)malloc(SELFTEST_CHAIN_MAX * SELFTEST_SECTOR_SIZE);
+        snprintf(what, sizeof(what), "%s: chain read bounded", p_label);
+        selftest_expect((p_buff != NULL) &&
+                        (fatfs_read_file(s_files[0].chain[0], p_buff,
+                                         SELFTEST_CHAIN_MAX *
+                                         SELFTEST_SECTOR_SIZE) ==
+                         read_error), what);
+        free(p_buff);
+
+        snprintf(what, sizeof(what), "%s: defrag refused", p_label);
+        selftest_expect(FATFS_VOLUME_DAMAGED == fatfs_defrag(&defrag), what);
+        fatfs_deinit();
+        kmc_set_writable(false);
+        snprintf(what, sizeof(what), "%s: image untouched", p_label);
+        selftest_expect(true == selftest_same_image(p_image), what);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_image);
+}
+
+/* Main function */
+int main(int argc, char *argv[])
+{
+    const char *p_directory = (argc > 1) ? argv[1] : ".";
+    int retVal = 0;
+
+    if (argc > 2)
+    {
+        printf("Usage: %s [WORK_DIRECTORY]\n", argv[0]);
+        retVal = 2;
+    }
+    else
+    {
+        snprintf(s_image_path, SELFTEST_PATH_SIZE, "%s/selftest.img",
+                 p_directory);
+        snprintf(s_overlay_path, SELFTEST_PATH_SIZE, "%s/selftest.ovl",
+                 p_directory);
+        selftest_defrag_compact();
+        selftest_overlay_commit();
+        /* FRAG1 ends back at its first cluster */
+        selftest_damaged("loop", 12, 2, FATFS_CHECK_LOOP,
+                         FATFS_READ_SECTOR_FAILED);
+        /* FRAG2 runs into tail of FRAG1 */
+        selftest_damaged("cross-link", 11, 12, FATFS_CHECK_CROSS_LINK,
+                         SUCCESS);
+        /* Both full subdirectory clusters point at each other */
+        selftest_damaged("directory loop", SELFTEST_SUBDIR_LAST_CLUSTER,
+                         SELFTEST_SUBDIR_FIRST_CLUSTER, FATFS_CHECK_LOOP,
+                         SUCCESS);
+        remove(s_image_path);
+        printf("%u failed\n", s_failures);
+        retVal = (0 == s_failures) ? 0 : 1;
+    }
+
+    return retVal;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,1061 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fat.h"
+#include "hal.h"
+#include "sidecar.h"
+#include "dirindex.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_SIDECAR_MAGIC "FATSIDE1"
+#define FATFS_SIDECAR_MAGIC_BYTES 8U
+#define FATFS_SIDECAR_VERSION 1U
+#define FATFS_SIDECAR_ALIGN 8U
+#define FATFS_SIDECAR_FNV_OFFSET 0xCBF29CE484222325ULL
+#define FATFS_SIDECAR_FNV_PRIME 0x00000100000001B3ULL
+
+#define fatfs_sidecar_align(size) \
+    (((size) + FATFS_SIDECAR_ALIGN - 1) & ~(uint64_t)(FATFS_SIDECAR_ALIGN - 1))
+
+/* Sidecar is written in host byte order so it can be used in place */
+typedef struct
+{
+    uint8_t magic[FATFS_SIDECAR_MAGIC_BYTES];
+    uint32_t version;
+    uint16_t byte_per_sector;
+    uint8_t sector_per_cluster;
+    uint8_t fat_type;
+    uint32_t data_index;
+    uint32_t cluster_count;
+    uint64_t fat_hash;
+    uint64_t directory_hash;
+    uint32_t directory_count;
+    uint32_t entry_count;
+    uint32_t chain_count;
+    uint32_t extent_count;
+    uint32_t name_bytes;
+    uint32_t bitmap_bytes;
+    uint64_t directory_offset;
+    uint64_t entry_offset;
+    uint64_t chain_offset;
+    uint64_t extent_offset;
+    uint64_t name_offset;
+    uint64_t bitmap_offset;
+    uint64_t file_size;
+} fatfs_sidecar_header_struct_t;
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t first_entry;
+    uint32_t entry_count;
+} fatfs_sidecar_directory_struct_t;
+
+typedef struct
+{
+    uint32_t name_offset;
+    uint32_t short_offset;
+    uint32_t file_size;
+    uint32_t first_cluster;
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t file_attribute;
+    uint8_t file_extension[4];
+} fatfs_sidecar_entry_struct_t;
+
+typedef struct
+{
+    uint32_t first_cluster;
+    uint32_t first_extent;
+    uint32_t extent_count;
+} fatfs_sidecar_chain_struct_t;
+
+typedef struct
+{
+    fatfs_sidecar_header_struct_t header;
+    fatfs_sidecar_directory_struct_t *p_directories;
+    fatfs_sidecar_entry_struct_t *p_entries;
+    fatfs_sidecar_chain_struct_t *p_chains;
+    fatfs_extent_struct_t *p_extents;
+    uint8_t *p_names;
+    uint8_t *p_bitmap;
+    uint32_t directory_capacity;
+    uint32_t entry_capacity;
+    uint32_t chain_capacity;
+    uint32_t extent_capacity;
+    uint32_t name_capacity;
+} fatfs_sidecar_build_struct_t;
+
+static uint8_t *sp_sidecar_map = NULL;
+static uint64_t s_sidecar_size = 0;
+static const fatfs_sidecar_header_struct_t *sp_sidecar_header = NULL;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Continue 64-bit FNV-1a hash over data
+ *
+ * @param [in] hash is hash so far
+ * @param [in] p_data is data to hash
+ * @param [in] size is number of bytes
+ * @return uint64_t is new hash
+ */
+static uint64_t fatfs_sidecar_hash(uint64_t hash, const uint8_t *const p_data,
+                                   const uint32_t size);
+
+/**
+ * @brief Grow array so that it holds one more element
+ *
+ * @param [inout] pp_array is array to grow
+ * @param [inout] p_capacity is capacity of array in elements
+ * @param [in] count is number of used elements
+ * @param [in] size is size of one element
+ */
+static void fatfs_sidecar_reserve(void **const pp_array,
+                                  uint32_t *const p_capacity,
+                                  const uint32_t count, const size_t size);
+
+/**
+ * @brief Hash root directory region and clusters of every directory
+ *
+ * @param [in] p_directories is directory table
+ * @param [in] directory_count is number of directories
+ * @param [in] p_chains is chain table, sorted by first cluster
+ * @param [in] chain_count is number of chains
+ * @param [in] p_extents is extent table
+ * @param [out] p_hash is hash of directories
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_sidecar_hash_directories(
+    const fatfs_sidecar_directory_struct_t *const p_directories,
+    const uint32_t directory_count,
+    const fatfs_sidecar_chain_struct_t *const p_chains,
+    const uint32_t chain_count,
+    const fatfs_extent_struct_t *const p_extents, uint64_t *const p_hash);
+
+/**
+ * @brief Find chain in sorted chain table
+ *
+ * @param [in] p_chains is chain table
+ * @param [in] chain_count is number of chains
+ * @param [in] first_cluster is first cluster of chain
+ * @return const fatfs_sidecar_chain_struct_t* is chain, NULL if not found
+ */
+static const fatfs_sidecar_chain_struct_t *fatfs_sidecar_find_chain(
+    const fatfs_sidecar_chain_struct_t *const p_chains,
+    const uint32_t chain_count, const uint32_t first_cluster);
+
+/**
+ * @brief Add chain of a file or directory to build
+ *
+ * @param [inout] p_build is sidecar being built
+ * @param [in] first_cluster is first cluster of chain
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_sidecar_add_chain(
+    fatfs_sidecar_build_struct_t *const p_build,
+    const uint32_t first_cluster);
+
+/**
+ * @brief Walk directory tree and build sidecar tables in memory
+ *
+ * @param [out] p_build is sidecar being built
+ * @return fatfs_error_enum_t is error code
+ */
+static fatfs_error_enum_t fatfs_sidecar_build(
+    fatfs_sidecar_build_struct_t *const p_build);
+
+/**
+ * @brief Write built tables to sidecar file
+ *
+ * @param [in] sidecar_path is path to sidecar file
+ * @param [inout] p_build is sidecar built
+ * @return true if sidecar is written
+ * @return false if sidecar can not be written
+ */
+static bool fatfs_sidecar_write(const uint8_t *const sidecar_path,
+                                fatfs_sidecar_build_struct_t *const p_build);
+
+/**
+ * @brief Check that a table lies inside mapped sidecar
+ *
+ * @param [in] offset is offset of table in sidecar
+ * @param [in] count is number of elements
+ * @param [in] size is size of one element
+ * @return true if table is aligned and inside sidecar
+ * @return false if table is outside sidecar
+ */
+static bool fatfs_sidecar_section_fits(const uint64_t offset,
+                                       const uint32_t count,
+                                       const size_t size);
+
+/**
+ * @brief Check every table and cross reference of mapped sidecar
+ *
+ * @param [in] p_header is header of mapped sidecar
+ * @return true if every reference stays inside its table
+ * @return false if sidecar is corrupt
+ */
+static bool fatfs_sidecar_check_tables(const fatfs_sidecar_header_struct_t
+                                       *const p_header);
+
+/**
+ * @brief Map sidecar file and check it against the image
+ *
+ * @param [in] sidecar_path is path to sidecar file
+ * @return true if sidecar is mapped and valid
+ * @return false if sidecar is missing or stale
+ */
+static bool fatfs_sidecar_map(const uint8_t *const sidecar_path);
+
+/**
+ * @brief Compare two chains by first cluster for qsort
+ *
+ * @param [in] p_first is first chain
+ * @param [in] p_second is second chain
+ * @return int is order of chains
+ */
+static int fatfs_sidecar_compare_chain(const void *p_first,
+                                       const void *p_second);
+
+/**
+ * @brief Compare two directories by first cluster for qsort
+ *
+ * @param [in] p_first is first directory
+ * @param [in] p_second is second directory
+ * @return int is order of directories
+ */
+static int fatfs_sidecar_compare_directory(const void *p_first,
+        const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to hash data */
+static uint64_t fatfs_sidecar_hash(uint64_t hash, const uint8_t *const p_data,
+                                   const uint32_t size)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < size; i++)
+    {
+        hash = (hash ^ p_data[i]) * FATFS_SIDECAR_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/* Function is used to grow array */
+static void fatfs_sidecar_reserve(void **const pp_array,
+                                  uint32_t *const p_capacity,
+                                  const uint32_t count, const size_t size)
+{
+    if (count + 1 > *p_capacity)
+    {
+        *p_capacity = (0 == *p_capacity) ? 64 : *p_capacity * 2;
+        *pp_array = realloc(*pp_array, (size_t)*p_capacity * size);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to compare chains */
+static int fatfs_sidecar_compare_chain(const void *p_first,
+                                       const void *p_second)
+{
+    uint32_t first = ((const fatfs_sidecar_chain_struct_t *)p_first)->
+                     first_cluster;
+    uint32_t second = ((const fatfs_sidecar_chain_struct_t *)p_second)->
+                      first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to compare directories */
+static int fatfs_sidecar_compare_directory(const void *p_first,
+        const void *p_second)
+{
+    uint32_t first = ((const fatfs_sidecar_directory_struct_t *)p_first)->
+                     first_cluster;
+    uint32_t second = ((const fatfs_sidecar_directory_struct_t *)p_second)->
+                      first_cluster;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to find chain */
+static const fatfs_sidecar_chain_struct_t *fatfs_sidecar_find_chain(
+    const fatfs_sidecar_chain_struct_t *const p_chains,
+    const uint32_t chain_count, const uint32_t first_cluster)
+{
+    fatfs_sidecar_chain_struct_t key;
+
+    key.first_cluster = first_cluster;
+
+    return (const fatfs_sidecar_chain_struct_t *)bsearch(&key, p_chains,
+            chain_count, sizeof(fatfs_sidecar_chain_struct_t),
+            fatfs_sidecar_compare_chain);
+}
+
+/* Function is used to hash directories */
+static fatfs_error_enum_t fatfs_sidecar_hash_directories(
+    const fatfs_sidecar_directory_struct_t *const p_directories,
+    const uint32_t directory_count,
+    const fatfs_sidecar_chain_struct_t *const p_chains,
+    const uint32_t chain_count,
+    const fatfs_extent_struct_t *const p_extents, uint64_t *const p_hash)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_sidecar_chain_struct_t *p_chain = NULL;
+    uint64_t hash = FATFS_SIDECAR_FNV_OFFSET;
+    uint32_t num = p_boot->data_index - p_boot->root_directory_index;
+    uint8_t *p_buff = NULL;
+    uint32_t capacity = num;
+    uint32_t bytes = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    p_buff = (uint8_t *)malloc(capacity * p_boot->byte_per_sector);
+    bytes = kmc_read_multi_sector(p_boot->root_directory_index, num, p_buff);
+    if (bytes == num * p_boot->byte_per_sector)
+    {
+        hash = fatfs_sidecar_hash(hash, p_buff, bytes);
+    }
+    else
+    {
+        error = FATFS_READ_SECTOR_FAILED;
+    }
+    for (i = 0; (i < directory_count) && (SUCCESS == error); i++)
+    {
+        p_chain = fatfs_sidecar_find_chain(p_chains, chain_count,
+                                           p_directories[i].first_cluster);
+        for (j = 0; (p_chain != NULL) && (j < p_chain->extent_count) &&
+                (SUCCESS == error); j++)
+        {
+            num = p_extents[p_chain->first_extent + j].cluster_count *
+                  p_boot->sector_per_cluster;
+            if (num > capacity)
+            {
+                capacity = num;
+                p_buff = (uint8_t *)realloc(p_buff, capacity *
+                                            p_boot->byte_per_sector);
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            bytes = kmc_read_multi_sector(fatfs_cluster_to_sector(
+                                              p_extents[p_chain->first_extent +
+                                                      j].first_cluster),
+                                          num, p_buff);
+            if (bytes == num * p_boot->byte_per_sector)
+            {
+                hash = fatfs_sidecar_hash(hash, p_buff, bytes);
+            }
+            else
+            {
+                error = FATFS_READ_SECTOR_FAILED;
+            }
+        }
+    }
+    free(p_buff);
+    *p_hash = hash;
+
+    return error;
+}
+
+/* Function is used to add chain to build */
+static fatfs_error_enum_t fatfs_sidecar_add_chain(
+    fatfs_sidecar_build_struct_t *const p_build,
+    const uint32_t first_cluster)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_sidecar_chain_struct_t *p_chain = NULL;
+    fatfs_extent_struct_t *p_list = NULL;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    error = fatfs_get_extents(first_cluster, &p_list, &count);
+    if (SUCCESS == error)
+    {
+        fatfs_sidecar_reserve((void **)&p_build->p_chains,
+                              &p_build->chain_capacity,
+                              p_build->header.chain_count,
+                              sizeof(fatfs_sidecar_chain_struct_t));
+        p_chain = &p_build->p_chains[p_build->header.chain_count++];
+        p_chain->first_cluster = first_cluster;
+        p_chain->first_extent = p_build->header.extent_count;
+        p_chain->extent_count = count;
+        for (i = 0; i < count; i++)
+        {
+            fatfs_sidecar_reserve((void **)&p_build->p_extents,
+                                  &p_build->extent_capacity,
+                                  p_build->header.extent_count,
+                                  sizeof(fatfs_extent_struct_t));
+            p_build->p_extents[p_build->header.extent_count++] = p_list[i];
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_list);
+
+    return error;
+}
+
+/* Function is used to build sidecar tables */
+static fatfs_error_enum_t fatfs_sidecar_build(
+    fatfs_sidecar_build_struct_t *const p_build)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    fatfs_sidecar_directory_struct_t *p_directory = NULL;
+    fatfs_sidecar_entry_struct_t *p_entry = NULL;
+    fatfs_entry_info_struct_t info;
+    fatfs_dir_struct_t *p_dir = NULL;
+    uint32_t *p_queue = NULL;
+    uint32_t queue_capacity = 0;
+    uint32_t queue_count = 1;
+    uint32_t current = 0;
+    uint32_t cluster = 0;
+    uint32_t length = 0;
+    uint32_t i = 0;
+
+    memset(p_build, 0, sizeof(*p_build));
+    fatfs_sidecar_reserve((void **)&p_queue, &queue_capacity, 0,
+                          sizeof(uint32_t));
+    p_queue[0] = 0;
+    /* Breadth-first walk, bounded by volume size in case of directory loop */
+    while ((SUCCESS == error) && (current < queue_count) &&
+            (current <= p_boot->cluster_count))
+    {
+        fatfs_sidecar_reserve((void **)&p_build->p_directories,
+                              &p_build->directory_capacity,
+                              p_build->header.directory_count,
+                              sizeof(fatfs_sidecar_directory_struct_t));
+        p_directory =
+            &p_build->p_directories[p_build->header.directory_count++];
+        p_directory->first_cluster = p_queue[current];
+        p_directory->first_entry = p_build->header.entry_count;
+        p_directory->entry_count = 0;
+        error = fatfs_dir_open(p_queue[current], &p_dir);
+        while (SUCCESS == error)
+        {
+            error = fatfs_dir_next(p_dir, &info);
+            if (SUCCESS == error)
+            {
+                fatfs_sidecar_reserve((void **)&p_build->p_entries,
+                                      &p_build->entry_capacity,
+                                      p_build->header.entry_count,
+                                      sizeof(fatfs_sidecar_entry_struct_t));
+                p_entry = &p_build->p_entries[p_build->header.entry_count++];
+                p_directory->entry_count++;
+                length = strlen(info.file_name) + strlen(info.short_name) + 2;
+                while (p_build->header.name_bytes + length >
+                        p_build->name_capacity)
+                {
+                    p_build->name_capacity = (0 == p_build->name_capacity) ?
+                                             4096 :
+                                             p_build->name_capacity * 2;
+                    p_build->p_names = (uint8_t *)realloc(p_build->p_names,
+                                                          p_build->name_capacity);
+                }
+                p_entry->name_offset = p_build->header.name_bytes;
+                strcpy(p_build->p_names + p_entry->name_offset,
+                       info.file_name);
+                p_entry->short_offset = p_entry->name_offset +
+                                        strlen(info.file_name) + 1;
+                strcpy(p_build->p_names + p_entry->short_offset,
+                       info.short_name);
+                p_build->header.name_bytes += length;
+                p_entry->file_size = info.file_size;
+                p_entry->first_cluster = info.first_cluster;
+                p_entry->year = info.modified_date.year;
+                p_entry->month = info.modified_date.month;
+                p_entry->day = info.modified_date.day;
+                p_entry->hour = info.modified_time.hour;
+                p_entry->minute = info.modified_time.minute;
+                p_entry->second = info.modified_time.second;
+                p_entry->file_attribute = info.file_attribute;
+                memcpy(p_entry->file_extension, info.file_extension,
+                       sizeof(p_entry->file_extension));
+                if ((info.first_cluster >= 2) &&
+                        (strcmp(info.file_name, "..      ") != 0))
+                {
+                    error = fatfs_sidecar_add_chain(p_build,
+                                                    info.first_cluster);
+                    if (info.file_attribute & 0x10)
+                    {
+                        fatfs_sidecar_reserve((void **)&p_queue,
+                                              &queue_capacity, queue_count,
+                                              sizeof(uint32_t));
+                        p_queue[queue_count++] = info.first_cluster;
+                    }
+                    else
+                    {
+                        /* Do nothing */
+                    }
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        if (FATFS_END_OF_DIRECTORY == error)
+        {
+            error = SUCCESS;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        fatfs_dir_close(p_dir);
+        p_dir = NULL;
+        current++;
+    }
+    free(p_queue);
+
+    /* Chains shared by two entries keep only the first copy */
+    qsort(p_build->p_chains, p_build->header.chain_count,
+          sizeof(fatfs_sidecar_chain_struct_t), fatfs_sidecar_compare_chain);
+    current = 0;
+    for (i = 0; i < p_build->header.chain_count; i++)
+    {
+        if ((0 == current) || (p_build->p_chains[i].first_cluster !=
+                               p_build->p_chains[current - 1].first_cluster))
+        {
+            p_build->p_chains[current++] = p_build->p_chains[i];
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    p_build->header.chain_count = current;
+    qsort(p_build->p_directories, p_build->header.directory_count,
+          sizeof(fatfs_sidecar_directory_struct_t),
+          fatfs_sidecar_compare_directory);
+
+    /* Bit n is set when cluster n is in use */
+    p_build->header.bitmap_bytes = (p_boot->cluster_count + 2 + 7) / 8;
+    p_build->p_bitmap = (uint8_t *)calloc(p_build->header.bitmap_bytes + 1,
+                                          sizeof(uint8_t));
+    for (i = 2; (i < p_boot->cluster_count + 2) && (SUCCESS == error); i++)
+    {
+        cluster = i;
+        error = fatfs_get_next_cluster(&cluster);
+        if (cluster != 0)
+        {
+            p_build->p_bitmap[i / 8] |= (uint8_t)(1U << (i % 8));
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    if (SUCCESS == error)
+    {
+        error = fatfs_sidecar_hash_directories(p_build->p_directories,
+                                               p_build->header.directory_count,
+                                               p_build->p_chains,
+                                               p_build->header.chain_count,
+                                               p_build->p_extents,
+                                               &p_build->header.directory_hash);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to write sidecar file */
+static bool fatfs_sidecar_write(const uint8_t *const sidecar_path,
+                                fatfs_sidecar_build_struct_t *const p_build)
+{
+    bool retVal = false;
+    fatfs_sidecar_header_struct_t *p_header = &p_build->header;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const uint8_t *p_fat = NULL;
+    uint8_t *p_temp_path = NULL;
+    size_t temp_size = strlen(sidecar_path) + sizeof(".tmp");
+    uint8_t padding[FATFS_SIDECAR_ALIGN] = {0};
+    FILE *p_file = NULL;
+    uint64_t offset = 0;
+    uint32_t fat_bytes = 0;
+
+    p_fat = fatfs_get_fat(&fat_bytes);
+    memcpy(p_header->magic, FATFS_SIDECAR_MAGIC, FATFS_SIDECAR_MAGIC_BYTES);
+    p_header->version = FATFS_SIDECAR_VERSION;
+    p_header->byte_per_sector = p_boot->byte_per_sector;
+    p_header->sector_per_cluster = p_boot->sector_per_cluster;
+    p_header->fat_type = p_boot->fat_type;
+    p_header->data_index = p_boot->data_index;
+    p_header->cluster_count = p_boot->cluster_count;
+    p_header->fat_hash = fatfs_sidecar_hash(FATFS_SIDECAR_FNV_OFFSET, p_fat,
+                                            fat_bytes);
+    offset = fatfs_sidecar_align(sizeof(fatfs_sidecar_header_struct_t));
+    p_header->directory_offset = offset;
+    offset = fatfs_sidecar_align(offset + (uint64_t)p_header->directory_count *
+                                 sizeof(fatfs_sidecar_directory_struct_t));
+    p_header->entry_offset = offset;
+    offset = fatfs_sidecar_align(offset + (uint64_t)p_header->entry_count *
+                                 sizeof(fatfs_sidecar_entry_struct_t));
+    p_header->chain_offset = offset;
+    offset = fatfs_sidecar_align(offset + (uint64_t)p_header->chain_count *
+                                 sizeof(fatfs_sidecar_chain_struct_t));
+    p_header->extent_offset = offset;
+    offset = fatfs_sidecar_align(offset + (uint64_t)p_header->extent_count *
+                                 sizeof(fatfs_extent_struct_t));
+    p_header->name_offset = offset;
+    offset = fatfs_sidecar_align(offset + p_header->name_bytes);
+    p_header->bitmap_offset = offset;
+    offset = fatfs_sidecar_align(offset + p_header->bitmap_bytes);
+    p_header->file_size = offset;
+
+    /* Write to a temporary file and rename, a reader never sees half */
+    p_temp_path = (uint8_t *)malloc(temp_size);
+    if (p_temp_path != NULL)
+    {
+        snprintf(p_temp_path, temp_size, "%s.tmp", sidecar_path);
+        p_file = fopen(p_temp_path, "wb");
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if ((p_file != NULL) && (p_fat != NULL))
+    {
+        fwrite(p_header, sizeof(*p_header), 1, p_file);
+        fwrite(padding, 1, p_header->directory_offset - sizeof(*p_header),
+               p_file);
+        fwrite(p_build->p_directories,
+               sizeof(fatfs_sidecar_directory_struct_t),
+               p_header->directory_count, p_file);
+        fwrite(padding, 1, p_header->entry_offset - ftello(p_file), p_file);
+        fwrite(p_build->p_entries, sizeof(fatfs_sidecar_entry_struct_t),
+               p_header->entry_count, p_file);
+        fwrite(padding, 1, p_header->chain_offset - ftello(p_file), p_file);
+        fwrite(p_build->p_chains, sizeof(fatfs_sidecar_chain_struct_t),
+               p_header->chain_count, p_file);
+        fwrite(padding, 1, p_header->extent_offset - ftello(p_file), p_file);
+        fwrite(p_build->p_extents, sizeof(fatfs_extent_struct_t),
+               p_header->extent_count, p_file);
+        fwrite(padding, 1, p_header->name_offset - ftello(p_file), p_file);
+        fwrite(p_build->p_names, 1, p_header->name_bytes, p_file);
+        fwrite(padding, 1, p_header->bitmap_offset - ftello(p_file), p_file);
+        fwrite(p_build->p_bitmap, 1, p_header->bitmap_bytes, p_file);
+        fwrite(padding, 1, p_header->file_size - ftello(p_file), p_file);
+        retVal = (0 == ferror(p_file));
+        retVal = (0 == fclose(p_file)) && retVal;
+        if (true == retVal)
+        {
+            retVal = (0 == rename(p_temp_path, sidecar_path));
+        }
+        else
+        {
+            remove(p_temp_path);
+        }
+    }
+    else if (p_file != NULL)
+    {
+        fclose(p_file);
+        remove(p_temp_path);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_temp_path);
+
+    return retVal;
+}
+
+/* Function is used to check table bounds */
+static bool fatfs_sidecar_section_fits(const uint64_t offset,
+                                       const uint32_t count,
+                                       const size_t size)
+{
+    return (0 == (offset % FATFS_SIDECAR_ALIGN)) &&
+           (offset <= s_sidecar_size) &&
+           ((uint64_t)count * size <= s_sidecar_size - offset);
+}
+
+/* Function is used to check tables of sidecar */
+static bool fatfs_sidecar_check_tables(const fatfs_sidecar_header_struct_t
+                                       *const p_header)
+{
+    bool retVal = false;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_sidecar_directory_struct_t *p_directories = NULL;
+    const fatfs_sidecar_entry_struct_t *p_entries = NULL;
+    const fatfs_sidecar_chain_struct_t *p_chains = NULL;
+    const fatfs_extent_struct_t *p_extents = NULL;
+    const uint8_t *p_names = NULL;
+    uint32_t i = 0;
+
+    retVal = (true == fatfs_sidecar_section_fits(p_header->directory_offset,
+              p_header->directory_count,
+              sizeof(fatfs_sidecar_directory_struct_t))) &&
+             (true == fatfs_sidecar_section_fits(p_header->entry_offset,
+                     p_header->entry_count,
+                     sizeof(fatfs_sidecar_entry_struct_t))) &&
+             (true == fatfs_sidecar_section_fits(p_header->chain_offset,
+                     p_header->chain_count,
+                     sizeof(fatfs_sidecar_chain_struct_t))) &&
+             (true == fatfs_sidecar_section_fits(p_header->extent_offset,
+                     p_header->extent_count,
+                     sizeof(fatfs_extent_struct_t))) &&
+             (true == fatfs_sidecar_section_fits(p_header->name_offset,
+                     p_header->name_bytes, 1)) &&
+             (true == fatfs_sidecar_section_fits(p_header->bitmap_offset,
+                     p_header->bitmap_bytes, 1));
+    if (true == retVal)
+    {
+        p_directories = (const fatfs_sidecar_directory_struct_t *)
+                        (sp_sidecar_map + p_header->directory_offset);
+        p_entries = (const fatfs_sidecar_entry_struct_t *)
+                    (sp_sidecar_map + p_header->entry_offset);
+        p_chains = (const fatfs_sidecar_chain_struct_t *)
+                   (sp_sidecar_map + p_header->chain_offset);
+        p_extents = (const fatfs_extent_struct_t *)
+                    (sp_sidecar_map + p_header->extent_offset);
+        p_names = sp_sidecar_map + p_header->name_offset;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    for (i = 0; (true == retVal) && (i < p_header->directory_count); i++)
+    {
+        retVal = ((uint64_t)p_directories[i].first_entry +
+                  p_directories[i].entry_count <= p_header->entry_count);
+    }
+    for (i = 0; (true == retVal) && (i < p_header->chain_count); i++)
+    {
+        retVal = ((uint64_t)p_chains[i].first_extent +
+                  p_chains[i].extent_count <= p_header->extent_count);
+    }
+    for (i = 0; (true == retVal) && (i < p_header->extent_count); i++)
+    {
+        retVal = (p_extents[i].first_cluster >= 2) &&
+                 ((uint64_t)p_extents[i].first_cluster +
+                  p_extents[i].cluster_count <=
+                  (uint64_t)p_boot->cluster_count + 2);
+    }
+    /* Names are copied with strcpy, each must end inside its buffer */
+    for (i = 0; (true == retVal) && (i < p_header->entry_count); i++)
+    {
+        retVal = (p_entries[i].name_offset < p_header->name_bytes) &&
+                 (p_entries[i].short_offset < p_header->name_bytes) &&
+                 (memchr(p_names + p_entries[i].name_offset, '\0',
+                         p_header->name_bytes - p_entries[i].name_offset) !=
+                  NULL) &&
+                 (strlen(p_names + p_entries[i].name_offset) <
+                  FATFS_FILE_NAME_SIZE) &&
+                 (memchr(p_names + p_entries[i].short_offset, '\0',
+                         p_header->name_bytes - p_entries[i].short_offset) !=
+                  NULL) &&
+                 (strlen(p_names + p_entries[i].short_offset) <
+                  FATFS_SHORT_NAME_SIZE);
+    }
+
+    return retVal;
+}
+
+/* Function is used to map and validate sidecar */
+static bool fatfs_sidecar_map(const uint8_t *const sidecar_path)
+{
+    bool retVal = false;
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_sidecar_header_struct_t *p_header = NULL;
+    const uint8_t *p_fat = NULL;
+    uint32_t fat_bytes = 0;
+    uint64_t hash = 0;
+    struct stat info;
+    int fd = -1;
+
+    fd = open(sidecar_path, O_RDONLY);
+    if ((fd >= 0) && (0 == fstat(fd, &info)) &&
+            ((uint64_t)info.st_size >= sizeof(fatfs_sidecar_header_struct_t)))
+    {
+        sp_sidecar_map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                              0);
+        if (MAP_FAILED == sp_sidecar_map)
+        {
+            sp_sidecar_map = NULL;
+        }
+        else
+        {
+            s_sidecar_size = info.st_size;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (sp_sidecar_map != NULL)
+    {
+        p_header = (const fatfs_sidecar_header_struct_t *)sp_sidecar_map;
+        p_fat = fatfs_get_fat(&fat_bytes);
+        retVal = (0 == memcmp(p_header->magic, FATFS_SIDECAR_MAGIC,
+                              FATFS_SIDECAR_MAGIC_BYTES)) &&
+                 (FATFS_SIDECAR_VERSION == p_header->version) &&
+                 (p_header->file_size == s_sidecar_size) &&
+                 (true == fatfs_sidecar_check_tables(p_header)) &&
+                 (p_header->byte_per_sector == p_boot->byte_per_sector) &&
+                 (p_header->sector_per_cluster ==
+                  p_boot->sector_per_cluster) &&
+                 (p_header->fat_type == p_boot->fat_type) &&
+                 (p_header->data_index == p_boot->data_index) &&
+                 (p_header->cluster_count == p_boot->cluster_count) &&
+                 (p_fat != NULL) &&
+                 (p_header->fat_hash ==
+                  fatfs_sidecar_hash(FATFS_SIDECAR_FNV_OFFSET, p_fat,
+                                     fat_bytes));
+        if (true == retVal)
+        {
+            retVal = (SUCCESS == fatfs_sidecar_hash_directories(
+                          (const fatfs_sidecar_directory_struct_t *)
+                          (sp_sidecar_map + p_header->directory_offset),
+                          p_header->directory_count,
+                          (const fatfs_sidecar_chain_struct_t *)
+                          (sp_sidecar_map + p_header->chain_offset),
+                          p_header->chain_count,
+                          (const fatfs_extent_struct_t *)
+                          (sp_sidecar_map + p_header->extent_offset),
+                          &hash)) &&
+                     (hash == p_header->directory_hash);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (true == retVal)
+        {
+            sp_sidecar_header = p_header;
+        }
+        else
+        {
+            fatfs_sidecar_close();
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to attach sidecar file */
+fatfs_error_enum_t fatfs_sidecar_open(const uint8_t *const sidecar_path)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_sidecar_build_struct_t build;
+
+    fatfs_sidecar_close();
+    if (false == fatfs_sidecar_map(sidecar_path))
+    {
+        error = fatfs_sidecar_build(&build);
+        if ((SUCCESS == error) &&
+                ((false == fatfs_sidecar_write(sidecar_path, &build)) ||
+                 (false == fatfs_sidecar_map(sidecar_path))))
+        {
+            error = FATFS_SIDECAR_FAILED;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        free(build.p_directories);
+        free(build.p_entries);
+        free(build.p_chains);
+        free(build.p_extents);
+        free(build.p_names);
+        free(build.p_bitmap);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    /* Directory indexes built from disk are replaced by sidecar content */
+    fatfs_index_clear();
+
+    return error;
+}
+
+/* Function is used to detach sidecar file */
+void fatfs_sidecar_close(void)
+{
+    if (sp_sidecar_map != NULL)
+    {
+        munmap(sp_sidecar_map, s_sidecar_size);
+        sp_sidecar_map = NULL;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    s_sidecar_size = 0;
+    sp_sidecar_header = NULL;
+}
+
+/* Function is used to find directory in sidecar */
+bool fatfs_sidecar_find_directory(const uint32_t first_cluster,
+                                  uint32_t *const p_first,
+                                  uint32_t *const p_count)
+{
+    bool retVal = false;
+    const fatfs_sidecar_directory_struct_t *p_directory = NULL;
+    fatfs_sidecar_directory_struct_t key;
+
+    if (sp_sidecar_header != NULL)
+    {
+        key.first_cluster = first_cluster;
+        p_directory = (const fatfs_sidecar_directory_struct_t *)bsearch(&key,
+                      sp_sidecar_map + sp_sidecar_header->directory_offset,
+                      sp_sidecar_header->directory_count,
+                      sizeof(fatfs_sidecar_directory_struct_t),
+                      fatfs_sidecar_compare_directory);
+        if (p_directory != NULL)
+        {
+            *p_first = p_directory->first_entry;
+            *p_count = p_directory->entry_count;
+            retVal = true;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to get entry from sidecar */
+void fatfs_sidecar_get_entry(const uint32_t position,
+                             fatfs_entry_info_struct_t *const p_info)
+{
+    const fatfs_boot_sector_struct_t *p_boot = fatfs_get_boot_sector();
+    const fatfs_sidecar_entry_struct_t *p_entry =
+        (const fatfs_sidecar_entry_struct_t *)(sp_sidecar_map +
+                sp_sidecar_header->entry_offset) + position;
+    const uint8_t *p_names = sp_sidecar_map + sp_sidecar_header->name_offset;
+    uint32_t cluster_bytes = p_boot->byte_per_sector *
+                             p_boot->sector_per_cluster;
+
+    strcpy(p_info->file_name, p_names + p_entry->name_offset);
+    strcpy(p_info->short_name, p_names + p_entry->short_offset);
+    memcpy(p_info->file_extension, p_entry->file_extension,
+           sizeof(p_info->file_extension));
+    p_info->file_attribute = p_entry->file_attribute;
+    p_info->modified_time.hour = p_entry->hour;
+    p_info->modified_time.minute = p_entry->minute;
+    p_info->modified_time.second = p_entry->second;
+    p_info->modified_date.year = p_entry->year;
+    p_info->modified_date.month = p_entry->month;
+    p_info->modified_date.day = p_entry->day;
+    p_info->file_size = p_entry->file_size;
+    p_info->file_round_up_size = ((p_entry->file_size + cluster_bytes - 1) /
+                                  cluster_bytes) * cluster_bytes;
+    p_info->first_cluster = p_entry->first_cluster;
+    p_info->p_next = NULL;
+}
+
+/* Function is used to get extents from sidecar */
+bool fatfs_sidecar_get_extents(const uint32_t first_cluster,
+                               const fatfs_extent_struct_t **const p_extents,
+                               uint32_t *const p_count)
+{
+    bool retVal = false;
+    const fatfs_sidecar_chain_struct_t *p_chain = NULL;
+
+    if (sp_sidecar_header != NULL)
+    {
+        p_chain = fatfs_sidecar_find_chain(
+                      (const fatfs_sidecar_chain_struct_t *)(sp_sidecar_map +
+                              sp_sidecar_header->chain_offset),
+                      sp_sidecar_header->chain_count, first_cluster);
+        if (p_chain != NULL)
+        {
+            *p_extents = (const fatfs_extent_struct_t *)(sp_sidecar_map +
+                         sp_sidecar_header->extent_offset) +
+                         p_chain->first_extent;
+            *p_count = p_chain->extent_count;
+            retVal = true;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return retVal;
+}
+
+/* Function is used to get bitmap from sidecar */
+const uint8_t *fatfs_sidecar_get_bitmap(uint32_t *const p_bytes)
+{
+    const uint8_t *p_bitmap = NULL;
+
+    *p_bytes = 0;
+    if (sp_sidecar_header != NULL)
+    {
+        p_bitmap = sp_sidecar_map + sp_sidecar_header->bitmap_offset;
+        *p_bytes = sp_sidecar_header->bitmap_bytes;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return p_bitmap;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
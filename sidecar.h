@@ -0,0 +1,72 @@
+#ifndef _SIDECAR_H_
+#define _SIDECAR_H_
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Attach metadata sidecar file to the volume opened by fatfs_init
+ *
+ * The sidecar holds the directory tree, the extents of every chain and the
+ * free cluster bitmap. It is mapped and used as is when its FAT hash and
+ * directory hash match the image, otherwise it is rebuilt and rewritten.
+ *
+ * @param [in] sidecar_path is path to sidecar file
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_sidecar_open(const uint8_t *const sidecar_path);
+
+/**
+ * @brief Detach sidecar file
+ *
+ */
+void fatfs_sidecar_close(void);
+
+/**
+ * @brief Find directory in sidecar
+ *
+ * @param [in] first_cluster is first cluster of directory, 0 for root
+ * @param [out] p_first is position of first entry of directory
+ * @param [out] p_count is number of entries of directory
+ * @return true if directory is in sidecar
+ * @return false if no sidecar or directory not found
+ */
+bool fatfs_sidecar_find_directory(const uint32_t first_cluster,
+                                  uint32_t *const p_first,
+                                  uint32_t *const p_count);
+
+/**
+ * @brief Get entry stored in sidecar
+ *
+ * @param [in] position is position of entry
+ * @param [out] p_info is entry
+ */
+void fatfs_sidecar_get_entry(const uint32_t position,
+                             fatfs_entry_info_struct_t *const p_info);
+
+/**
+ * @brief Get extents of chain stored in sidecar
+ *
+ * @param [in] first_cluster is first cluster of chain
+ * @param [out] p_extents is extents of chain, owned by sidecar
+ * @param [out] p_count is number of extents
+ * @return true if chain is in sidecar
+ * @return false if no sidecar or chain not found
+ */
+bool fatfs_sidecar_get_extents(const uint32_t first_cluster,
+                               const fatfs_extent_struct_t **const p_extents,
+                               uint32_t *const p_count);
+
+/**
+ * @brief Get free cluster bitmap stored in sidecar
+ *
+ * @param [out] p_bytes is size of bitmap in bytes
+ * @return const uint8_t* is bitmap, bit set for used cluster, NULL if none
+ */
+const uint8_t *fatfs_sidecar_get_bitmap(uint32_t *const p_bytes);
+
+#endif /* _SIDECAR_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,253 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hal.h"
+#include "trace.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define KMC_NANOSECOND_PER_SECOND 1000000000ULL
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Get monotonic time
+ *
+ * @return uint64_t is time in nanosecond
+ */
+static uint64_t kmc_trace_get_time(void);
+
+/**
+ * @brief Compare two latencies for qsort
+ *
+ * @param [in] p_first is first latency
+ * @param [in] p_second is second latency
+ * @return int is order of latencies
+ */
+static int kmc_trace_compare(const void *p_first, const void *p_second);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to get monotonic time */
+static uint64_t kmc_trace_get_time(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * KMC_NANOSECOND_PER_SECOND +
+           (uint64_t)now.tv_nsec;
+}
+
+/* Function is used to compare latencies */
+static int kmc_trace_compare(const void *p_first, const void *p_second)
+{
+    uint64_t first = *(const uint64_t *)p_first;
+    uint64_t second = *(const uint64_t *)p_second;
+
+    return (first > second) - (first < second);
+}
+
+/* Function is used to load trace file */
+bool kmc_trace_load(const uint8_t *const trace_path,
+                    kmc_trace_record_struct_t **const p_records,
+                    uint32_t *const p_count)
+{
+    bool retVal = false;
+    FILE *p_file = NULL;
+    uint8_t header[KMC_TRACE_HEADER_SIZE];
+    uint8_t record[KMC_TRACE_RECORD_SIZE];
+    kmc_trace_record_struct_t *p_list = NULL;
+    kmc_trace_record_struct_t *p_temp = NULL;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    uint8_t i = 0;
+
+    p_file = fopen(trace_path, "rb");
+    if ((p_file != NULL) &&
+            (KMC_TRACE_HEADER_SIZE == fread(header, sizeof(uint8_t),
+                                            KMC_TRACE_HEADER_SIZE, p_file)) &&
+            (0 == memcmp(header, KMC_TRACE_MAGIC, KMC_TRACE_MAGIC_BYTES)) &&
+            (KMC_TRACE_VERSION == header[4]) &&
+            (KMC_TRACE_RECORD_SIZE == header[6]))
+    {
+        retVal = true;
+        while (KMC_TRACE_RECORD_SIZE == fread(record, sizeof(uint8_t),
+                                              KMC_TRACE_RECORD_SIZE, p_file))
+        {
+            if (count == capacity)
+            {
+                capacity = (0 == capacity) ? 1024 : capacity * 2;
+                p_temp = realloc(p_list, capacity * sizeof(*p_list));
+                if (NULL == p_temp)
+                {
+                    free(p_list);
+                    p_list = NULL;
+                    count = 0;
+                    retVal = false;
+                    break;
+                }
+                else
+                {
+                    p_list = p_temp;
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            memset(&p_list[count], 0, sizeof(*p_list));
+            for (i = 0; i < 8; i++)
+            {
+                p_list[count].offset |= (uint64_t)record[i] << (8 * i);
+                p_list[count].timestamp |= (uint64_t)record[12 + i] << (8 * i);
+            }
+            for (i = 0; i < 4; i++)
+            {
+                p_list[count].length |= (uint32_t)record[8 + i] << (8 * i);
+            }
+            count++;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (p_file != NULL)
+    {
+        fclose(p_file);
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    *p_records = p_list;
+    *p_count = count;
+
+    return retVal;
+}
+
+/* Function is used to replay trace file */
+bool kmc_trace_replay(const uint8_t *const trace_path,
+                      const uint8_t *const image_path,
+                      const kmc_backend_enum_t backend,
+                      const bool recorded_speed,
+                      kmc_replay_stats_struct_t *const p_stats)
+{
+    bool retVal = false;
+    kmc_trace_record_struct_t *p_records = NULL;
+    uint64_t *p_latency = NULL;
+    uint8_t *p_buff = NULL;
+    uint32_t count = 0;
+    uint32_t max_length = 0;
+    uint32_t i = 0;
+    uint64_t start = 0;
+    uint64_t before = 0;
+    uint64_t target = 0;
+    struct timespec wait;
+    int32_t bytes = 0;
+
+    memset(p_stats, 0, sizeof(*p_stats));
+    if ((true == kmc_trace_load(trace_path, &p_records, &count)) &&
+            (true == kmc_init_backend(image_path, backend)))
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (p_records[i].length > max_length)
+            {
+                max_length = p_records[i].length;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        p_buff = (uint8_t *)malloc(max_length + 1);
+        p_latency = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));
+        start = kmc_trace_get_time();
+        for (i = 0; i < count; i++)
+        {
+            if (true == recorded_speed)
+            {
+                target = start + p_records[i].timestamp;
+                if (target > kmc_trace_get_time())
+                {
+                    wait.tv_sec = (time_t)(target / KMC_NANOSECOND_PER_SECOND);
+                    wait.tv_nsec = (long)(target % KMC_NANOSECOND_PER_SECOND);
+                    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wait,
+                                    NULL);
+                }
+                else
+                {
+                    /* Do nothing */
+                }
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            before = kmc_trace_get_time();
+            bytes = kmc_read_bytes(p_records[i].offset, p_records[i].length,
+                                   p_buff);
+            p_latency[i] = kmc_trace_get_time() - before;
+            if (bytes != (int32_t)p_records[i].length)
+            {
+                p_stats->failed_operations++;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+            p_stats->bytes += (bytes > 0) ? (uint64_t)bytes : 0;
+        }
+        p_stats->elapsed = kmc_trace_get_time() - start;
+        p_stats->operations = count;
+        if (p_stats->elapsed > 0)
+        {
+            p_stats->throughput = (uint64_t)((double)p_stats->bytes *
+                                             KMC_NANOSECOND_PER_SECOND /
+                                             p_stats->elapsed);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        if (count > 0)
+        {
+            qsort(p_latency, count, sizeof(uint64_t), kmc_trace_compare);
+            p_stats->latency_p50 = p_latency[(count - 1) * 50 / 100];
+            p_stats->latency_p90 = p_latency[(count - 1) * 90 / 100];
+            p_stats->latency_p99 = p_latency[(count - 1) * 99 / 100];
+            p_stats->latency_max = p_latency[count - 1];
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        kmc_deinit();
+        retVal = true;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    free(p_buff);
+    free(p_latency);
+    free(p_records);
+
+    return retVal;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,58 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t operations;
+    uint32_t failed_operations;
+    uint64_t bytes;
+    uint64_t elapsed;
+    uint64_t throughput;
+    uint64_t latency_p50;
+    uint64_t latency_p90;
+    uint64_t latency_p99;
+    uint64_t latency_max;
+} kmc_replay_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Load all records of a trace file
+ *
+ * @param [in] trace_path is path to trace file
+ * @param [out] p_records is array of records, freed by caller
+ * @param [out] p_count is number of records
+ * @return true if trace file is valid
+ * @return false if trace file can not be read
+ */
+bool kmc_trace_load(const uint8_t *const trace_path,
+                    kmc_trace_record_struct_t **const p_records,
+                    uint32_t *const p_count);
+
+/**
+ * @brief Replay a trace file against an image
+ *
+ * @param [in] trace_path is path to trace file
+ * @param [in] image_path is path to image
+ * @param [in] backend is backend used to access image
+ * @param [in] recorded_speed is true to keep recorded timing, false to run
+ *             at maximum speed
+ * @param [out] p_stats is throughput (bytes/s) and latency (ns) of replay
+ * @return true if replay success
+ * @return false if trace or image can not be opened
+ */
+bool kmc_trace_replay(const uint8_t *const trace_path,
+                      const uint8_t *const image_path,
+                      const kmc_backend_enum_t backend,
+                      const bool recorded_speed,
+                      kmc_replay_stats_struct_t *const p_stats);
+
+#endif /* _TRACE_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
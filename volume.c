@@ -0,0 +1,302 @@
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fat.h"
+#include "volume.h"
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define FATFS_VOLUME_NONE 0xFFFFFFFFU
+
+typedef struct
+{
+    uint8_t *p_path;
+    uint8_t *p_fat;         /* FAT kept while volume is not mounted */
+    uint32_t fat_bytes;     /* Size of FAT, charged while cached or mounted */
+    uint64_t last_used;
+    struct stat image;      /* Image state when volume was mounted */
+    bool image_known;       /* Image could be stat'ed at mount */
+    fatfs_volume_stats_struct_t stats;
+} fatfs_volume_struct_t;
+
+static fatfs_volume_struct_t *sp_volumes = NULL;
+static uint32_t s_volume_count = 0;
+static uint32_t s_volume_capacity = 0;
+static uint32_t s_active = FATFS_VOLUME_NONE;
+static uint64_t s_budget = 0;
+static uint64_t s_clock = 0;
+
+/*******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/**
+ * @brief Unmount active volume, keep its FAT
+ *
+ */
+static void fatfs_volume_unmount(void);
+
+/**
+ * @brief Drop cached FATs of least recently used volumes until memory fits
+ *
+ */
+static void fatfs_volume_trim(void);
+
+/*******************************************************************************
+ * Codes
+ ******************************************************************************/
+/* Function is used to unmount active volume */
+static void fatfs_volume_unmount(void)
+{
+    fatfs_volume_struct_t *p_volume = NULL;
+
+    if (s_active != FATFS_VOLUME_NONE)
+    {
+        p_volume = &sp_volumes[s_active];
+        p_volume->p_fat = fatfs_detach_fat(&p_volume->fat_bytes);
+        if ((p_volume->p_fat != NULL) && (false == p_volume->image_known))
+        {
+            free(p_volume->p_fat);
+            p_volume->p_fat = NULL;
+            p_volume->fat_bytes = 0;
+        }
+        else
+        {
+            /* Do nothing */
+        }
+        p_volume->stats.active = false;
+        fatfs_deinit();
+        s_active = FATFS_VOLUME_NONE;
+    }
+    else
+    {
+        /* Do nothing */
+    }
+}
+
+/* Function is used to keep memory in budget */
+static void fatfs_volume_trim(void)
+{
+    uint32_t i = 0;
+    uint32_t victim = 0;
+
+    while (fatfs_volume_memory_used() > s_budget)
+    {
+        victim = FATFS_VOLUME_NONE;
+        for (i = 0; i < s_volume_count; i++)
+        {
+            if ((sp_volumes[i].p_fat != NULL) &&
+                    ((FATFS_VOLUME_NONE == victim) ||
+                     (sp_volumes[i].last_used < sp_volumes[victim].last_used)))
+            {
+                victim = i;
+            }
+            else
+            {
+                /* Do nothing */
+            }
+        }
+        if (victim != FATFS_VOLUME_NONE)
+        {
+            free(sp_volumes[victim].p_fat);
+            sp_volumes[victim].p_fat = NULL;
+            sp_volumes[victim].fat_bytes = 0;
+            sp_volumes[victim].stats.evictions++;
+        }
+        else
+        {
+            /* Only mounted volume is left, it can not be evicted */
+            break;
+        }
+    }
+}
+
+/* Function is used to initialize volume manager */
+fatfs_error_enum_t fatfs_volume_manager_init(const uint64_t budget_bytes)
+{
+    fatfs_volume_manager_deinit();
+    s_budget = budget_bytes;
+
+    return SUCCESS;
+}
+
+/* Function is used to register an image */
+fatfs_error_enum_t fatfs_volume_add(const uint8_t *const file_path,
+                                    uint32_t *const p_id)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_volume_struct_t *p_temp = NULL;
+    uint32_t capacity = 0;
+
+    if (s_volume_count == s_volume_capacity)
+    {
+        capacity = (0 == s_volume_capacity) ? 16 : s_volume_capacity * 2;
+        p_temp = (fatfs_volume_struct_t *)realloc(sp_volumes,
+                 capacity * sizeof(fatfs_volume_struct_t));
+        if (p_temp != NULL)
+        {
+            sp_volumes = p_temp;
+            s_volume_capacity = capacity;
+        }
+        else
+        {
+            error = FATFS_INITIALIZE_FAILED;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+    if (SUCCESS == error)
+    {
+        memset(&sp_volumes[s_volume_count], 0, sizeof(fatfs_volume_struct_t));
+        sp_volumes[s_volume_count].p_path = (uint8_t *)strdup(file_path);
+        if (NULL == sp_volumes[s_volume_count].p_path)
+        {
+            error = FATFS_INITIALIZE_FAILED;
+        }
+        else
+        {
+            *p_id = s_volume_count++;
+        }
+    }
+    else
+    {
+        /* Do nothing */
+    }
+
+    return error;
+}
+
+/* Function is used to mount volume */
+fatfs_error_enum_t fatfs_volume_select(const uint32_t id,
+                                       fatfs_boot_sector_struct_t **const
+                                       p_boot)
+{
+    fatfs_error_enum_t error = SUCCESS;
+    fatfs_volume_struct_t *p_volume = NULL;
+    struct stat image;
+
+    if (id < s_volume_count)
+    {
+        p_volume = &sp_volumes[id];
+        p_volume->last_used = ++s_clock;
+        p_volume->stats.activations++;
+        if (id != s_active)
+        {
+            fatfs_volume_unmount();
+            if ((p_volume->p_fat != NULL) &&
+                    (0 == stat(p_volume->p_path, &image)) &&
+                    (image.st_ino == p_volume->image.st_ino) &&
+                    (image.st_size == p_volume->image.st_size) &&
+                    (image.st_mtim.tv_sec == p_volume->image.st_mtim.tv_sec) &&
+                    (image.st_mtim.tv_nsec == p_volume->image.st_mtim.tv_nsec))
+            {
+                /* Image is unchanged since FAT was kept */
+                fatfs_preload_fat(p_volume->p_fat, p_volume->fat_bytes);
+                p_volume->stats.fat_hits++;
+            }
+            else
+            {
+                free(p_volume->p_fat);
+            }
+            p_volume->p_fat = NULL;
+            p_volume->stats.opens++;
+            error = fatfs_init(p_volume->p_path, p_boot);
+            fatfs_get_fat(&p_volume->fat_bytes);
+            if (SUCCESS == error)
+            {
+                /* FAT read by fatfs_init matches image as it is now */
+                p_volume->image_known =
+                    (0 == stat(p_volume->p_path, &p_volume->image));
+                s_active = id;
+                p_volume->stats.active = true;
+            }
+            else
+            {
+                fatfs_deinit();
+                p_volume->fat_bytes = 0;
+            }
+            fatfs_volume_trim();
+        }
+        else
+        {
+            *p_boot = (fatfs_boot_sector_struct_t *)fatfs_get_boot_sector();
+        }
+    }
+    else
+    {
+        error = FATFS_INITIALIZE_FAILED;
+    }
+
+    return error;
+}
+
+/* Function is used to close file descriptor of mounted volume */
+void fatfs_volume_park(void)
+{
+    fatfs_volume_unmount();
+    fatfs_volume_trim();
+}
+
+/* Function is used to get statistics of a volume */
+fatfs_error_enum_t fatfs_volume_get_stats(const uint32_t id,
+        fatfs_volume_stats_struct_t *const p_stats)
+{
+    fatfs_error_enum_t error = SUCCESS;
+
+    if (id < s_volume_count)
+    {
+        *p_stats = sp_volumes[id].stats;
+        p_stats->memory_bytes = sp_volumes[id].fat_bytes;
+    }
+    else
+    {
+        error = FATFS_ENTRY_NOT_FOUND;
+    }
+
+    return error;
+}
+
+/* Function is used to get memory of all volumes */
+uint64_t fatfs_volume_memory_used(void)
+{
+    uint64_t bytes = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < s_volume_count; i++)
+    {
+        bytes += sp_volumes[i].fat_bytes;
+    }
+
+    return bytes;
+}
+
+/* Function is used to de-initialize volume manager */
+void fatfs_volume_manager_deinit(void)
+{
+    uint32_t i = 0;
+
+    fatfs_volume_unmount();
+    for (i = 0; i < s_volume_count; i++)
+    {
+        free(sp_volumes[i].p_path);
+        free(sp_volumes[i].p_fat);
+    }
+    free(sp_volumes);
+    sp_volumes = NULL;
+    s_volume_count = 0;
+    s_volume_capacity = 0;
+    s_clock = 0;
+}
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/
@@ -0,0 +1,84 @@
+#ifndef _VOLUME_H_
+#define _VOLUME_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t activations;   /* Times volume was selected */
+    uint32_t opens;         /* Times image was opened */
+    uint32_t fat_hits;      /* Opens served from cached FAT */
+    uint32_t evictions;     /* Times cached FAT was dropped for budget */
+    uint64_t memory_bytes;  /* Memory charged to volume */
+    bool active;            /* Volume is the one mounted now */
+} fatfs_volume_stats_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+/**
+ * @brief Initialize volume manager
+ *
+ * @param [in] budget_bytes is memory shared by cached FATs of all volumes
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_volume_manager_init(const uint64_t budget_bytes);
+
+/**
+ * @brief Register an image, it is opened only when selected
+ *
+ * @param [in] file_path is path to image
+ * @param [out] p_id is id of volume
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_volume_add(const uint8_t *const file_path,
+                                    uint32_t *const p_id);
+
+/**
+ * @brief Mount volume, fatfs_* calls then work on it
+ *
+ * Volume mounted before is closed and its FAT kept in memory budget.
+ *
+ * @param [in] id is id of volume
+ * @param [out] p_boot is boot sector info of volume
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_volume_select(const uint32_t id,
+                                       fatfs_boot_sector_struct_t **const
+                                       p_boot);
+
+/**
+ * @brief Close file descriptor of mounted volume, FAT stays cached
+ *
+ */
+void fatfs_volume_park(void);
+
+/**
+ * @brief Get statistics of a volume
+ *
+ * @param [in] id is id of volume
+ * @param [out] p_stats is statistics of volume
+ * @return fatfs_error_enum_t is error code
+ */
+fatfs_error_enum_t fatfs_volume_get_stats(const uint32_t id,
+        fatfs_volume_stats_struct_t *const p_stats);
+
+/**
+ * @brief Get memory charged to all volumes
+ *
+ * @return uint64_t is memory in bytes
+ */
+uint64_t fatfs_volume_memory_used(void);
+
+/**
+ * @brief De-initialize volume manager and unmount volume
+ *
+ */
+void fatfs_volume_manager_deinit(void);
+
+#endif /* _VOLUME_H_ */
+
+/*******************************************************************************
+ * EOF
+ ******************************************************************************/